@@ -107,30 +107,45 @@ static const char *asn1_pcstr(unsigned char asn1_type) {
   return pcstr;
 }
 
-const char *snmp_asn1_get_oidstr(pool *p, oid_t *asn1_oid,
+char *snmp_asn1_format_oid(char *buf, size_t bufsz, oid_t *asn1_oid,
     unsigned int asn1_oidlen) {
   register unsigned int i;
-  char *oidstr = "";
+  size_t len = 0;
 
-  if (asn1_oidlen == 0) {
-    return oidstr;
+  if (bufsz == 0) {
+    return buf;
   }
 
-  for (i = 0; i < asn1_oidlen; i++) {
-    char buf[16];
-
-    memset(buf, '\0', sizeof(buf));
-    snprintf(buf, sizeof(buf)-1, "%lu", (unsigned long) asn1_oid[i]);
+  buf[0] = '\0';
 
-    oidstr = pstrcat(p, oidstr, buf, NULL);
+  for (i = 0; i < asn1_oidlen; i++) {
+    int res;
 
     /* Skip the trailing '.' in the OID string. */
-    if (i != (asn1_oidlen-1)) {
-      oidstr = pstrcat(p, oidstr, ".", NULL);
+    res = snprintf(buf + len, bufsz - len, "%lu%s",
+      (unsigned long) asn1_oid[i], i != (asn1_oidlen-1) ? "." : "");
+    if (res < 0 ||
+        (size_t) res >= (bufsz - len)) {
+      /* Truncated. */
+      break;
     }
+
+    len += res;
   }
 
-  return oidstr;
+  return buf;
+}
+
+const char *snmp_asn1_get_oidstr(pool *p, oid_t *asn1_oid,
+    unsigned int asn1_oidlen) {
+  char buf[SNMP_ASN1_OIDSTR_MAX_LEN];
+
+  if (asn1_oidlen == 0) {
+    return "";
+  }
+
+  snmp_asn1_format_oid(buf, sizeof(buf), asn1_oid, asn1_oidlen);
+  return pstrdup(p, buf);
 }
 
 const char *snmp_asn1_get_tagstr(pool *p, unsigned char asn1_type) {
@@ -141,6 +156,148 @@ const char *snmp_asn1_get_tagstr(pool *p, unsigned char asn1_type) {
   return tagstr;
 }
 
+/* The following functions calculate the number of bytes that the
+ * corresponding snmp_asn1_write_*() and snmp_asn1_prepend_*() functions would
+ * write, without actually writing anything.  They MUST be kept in sync with
+ * those writers.
+ */
+
+size_t snmp_asn1_get_header_len(unsigned int asn1_len, int flags) {
+  /* One byte for the type, plus the bytes for the length. */
+
+  if (!(flags & SNMP_ASN1_FL_KNOWN_LEN)) {
+    /* Unknown lengths always use the three-byte long form. */
+    return 4;
+  }
+
+  if (asn1_len < SNMP_ASN1_LEN_LONG) {
+    return 2;
+  }
+
+  if (asn1_len <= 0xff) {
+    return 3;
+  }
+
+  if (asn1_len <= 0xffff) {
+    return 4;
+  }
+
+  /* Only the snmp_asn1_prepend_header() function writes these lengths. */
+  if (asn1_len <= 0xffffff) {
+    return 5;
+  }
+
+  return 6;
+}
+
+/* Returns the number of content bytes in the minimal 2's complement encoding
+ * of the given INTEGER.
+ */
+static unsigned int asn1_get_intsz(long asn1_int) {
+  unsigned int asn1_intsz;
+  unsigned long bitmask;
+  long objval;
+
+  asn1_intsz = (unsigned int) sizeof(long);
+
+  objval = asn1_int;
+  bitmask = (unsigned long) 0x1ff << ((8 * (sizeof(long) - 1)) - 1);
+
+  while (((objval & bitmask) == 0 ||
+          (objval & bitmask) == bitmask) &&
+         asn1_intsz > 1) {
+    asn1_intsz--;
+    objval <<= 8;
+  }
+
+  return asn1_intsz;
+}
+
+/* Returns the number of content bytes in the encoding of the given unsigned
+ * 32-bit value, including the leading null byte needed when the MSB is set.
+ */
+static unsigned int asn1_get_uintsz(unsigned long asn1_uint) {
+  unsigned int asn1_uintsz, bitmask;
+
+  /* Only the low 32 bits are ever encoded. */
+  asn1_uint &= 0xffffffff;
+  asn1_uintsz = (unsigned int) sizeof(unsigned int);
+
+  bitmask = (unsigned int) 0x80 << (8 * (sizeof(unsigned int) - 1));
+  if ((asn1_uint & bitmask) != 0) {
+    asn1_uintsz++;
+  }
+
+  bitmask = (unsigned int) 0x1ff << ((8 * (sizeof(unsigned int) - 1)) - 1);
+  while ((asn1_uint & bitmask) == 0 &&
+         asn1_uintsz > 1) {
+    asn1_uintsz--;
+    asn1_uint <<= 8;
+  }
+
+  return asn1_uintsz;
+}
+
+size_t snmp_asn1_get_int_len(long asn1_int) {
+  unsigned int asn1_intsz;
+
+  asn1_intsz = asn1_get_intsz(asn1_int);
+  return snmp_asn1_get_header_len(asn1_intsz, SNMP_ASN1_FL_KNOWN_LEN) +
+    asn1_intsz;
+}
+
+size_t snmp_asn1_get_uint_len(unsigned long asn1_uint) {
+  unsigned int asn1_uintsz;
+
+  asn1_uintsz = asn1_get_uintsz(asn1_uint);
+  return snmp_asn1_get_header_len(asn1_uintsz, SNMP_ASN1_FL_KNOWN_LEN) +
+    asn1_uintsz;
+}
+
+size_t snmp_asn1_get_oid_len(oid_t *asn1_oid, unsigned int asn1_oidlen) {
+  register unsigned int i;
+  unsigned int asn1_len = 0;
+  oid_t sub_id;
+
+  if (asn1_oidlen == 0) {
+    sub_id = 0;
+
+  } else if (asn1_oidlen == 1) {
+    sub_id = (asn1_oid[0] * 40);
+    asn1_oidlen = 2;
+
+  } else {
+    sub_id = ((asn1_oid[0] * 40) + asn1_oid[1]);
+  }
+
+  for (i = 1;; i++) {
+    if (sub_id < (unsigned int) 0x80) {
+      asn1_len += 1;
+
+    } else if (sub_id < (unsigned int) 0x4000) {
+      asn1_len += 2;
+
+    } else if (sub_id < (unsigned int) 0x200000) {
+      asn1_len += 3;
+
+    } else if (sub_id < (unsigned int) 0x10000000) {
+      asn1_len += 4;
+
+    } else {
+      asn1_len += 5;
+    }
+
+    if (i + 1 >= asn1_oidlen) {
+      break;
+    }
+
+    sub_id = asn1_oid[i + 1];
+  }
+
+  return snmp_asn1_get_header_len(asn1_len, SNMP_ASN1_FL_KNOWN_LEN) +
+    asn1_len;
+}
+
 static int asn1_read_byte(pool *p, unsigned char **buf, size_t *buflen,
     unsigned char *byte) {
 
@@ -172,12 +329,14 @@ static int asn1_read_type(pool *p, unsigned char **buf, size_t *buflen,
 
   *asn1_type = byte;
 
-  if (!(flags & SNMP_ASN1_FL_NO_TRACE_TYPESTR)) {
-    pr_trace_msg(trace_channel, 18,
-      "read ASN.1 type 0x%02x (%s)", *asn1_type, asn1_typestr(*asn1_type));
+  if (snmp_trace_is_enabled(trace_channel, 18)) {
+    if (!(flags & SNMP_ASN1_FL_NO_TRACE_TYPESTR)) {
+      pr_trace_msg(trace_channel, 18,
+        "read ASN.1 type 0x%02x (%s)", *asn1_type, asn1_typestr(*asn1_type));
 
-  } else {
-    pr_trace_msg(trace_channel, 18, "read byte 0x%02x", *asn1_type);
+    } else {
+      pr_trace_msg(trace_channel, 18, "read byte 0x%02x", *asn1_type);
+    }
   }
 
   return 0;
@@ -236,7 +395,9 @@ static int asn1_read_len(pool *p, unsigned char **buf, size_t *buflen,
     *asn1_len = (unsigned int) byte;
   }
 
-  pr_trace_msg(trace_channel, 18, "read ASN.1 length %u", *asn1_len);
+  if (snmp_trace_is_enabled(trace_channel, 18)) {
+    pr_trace_msg(trace_channel, 18, "read ASN.1 length %u", *asn1_len);
+  }
   return 0;
 }
 
@@ -434,15 +595,11 @@ int snmp_asn1_read_null(pool *p, unsigned char **buf, size_t *buflen,
  * leadingbyte ::= 1 7bitvalue
  * lastbyte ::= 0 7bitvalue
  */
-int snmp_asn1_read_oid(pool *p, unsigned char **buf, size_t *buflen,
-    unsigned char *asn1_type, oid_t *asn1_oid, unsigned int *asn1_oidlen) {
-
-  /* We leave room at the start of the OID memory for expansion into two
-   * bytes from the first byte of buffer data.
-   */
-  oid_t *oid_ptr = asn1_oid + 1;
-
-  unsigned int objlen, len, sub_id;
+int snmp_asn1_read_oid_view(pool *p, unsigned char **buf, size_t *buflen,
+    unsigned char *asn1_type, unsigned char **asn1_data,
+    unsigned int *asn1_datalen, unsigned int *asn1_oidlen) {
+  unsigned int objlen, oidlen = 0, sub_id = 0;
+  register unsigned int i;
   int res;
 
   /* Type */
@@ -477,36 +634,14 @@ int snmp_asn1_read_oid(pool *p, unsigned char **buf, size_t *buflen,
     return -1;
   }
 
-  /* Handle invalid OID encodings of the form 06 00 robustly. */
-  if (objlen == 0) {
-    memset(asn1_oid, 0, sizeof(oid_t));
-  }
-
-  /* XXX Not sure I like this section; it presumes that the value in
-   * *asn1_oidlen is already initialized to something sane.  Is that a valid
-   * assumption?
-   */
-
-  len = objlen;
-  (*asn1_oidlen)--;		/* account for expansion of first byte */
-  while (len > 0 && (*asn1_oidlen)-- > 0) {
+  /* Validate the encoded sub-identifiers, and count them, in one pass. */
+  for (i = 0; i < objlen; i++) {
     unsigned char byte;
 
-    pr_signals_handle();
-
-    sub_id = 0;
-
-    do {
-      res = asn1_read_byte(p, buf, buflen, &byte);
-      if (res < 0) {
-        return -1;
-      }
+    byte = (*buf)[i];
 
-      /* Shift and add in the low order 7 bits */
-      sub_id = (sub_id << 7) + (byte & ~0x80);
-      len--;
-
-    } while (byte & 0x80);
+    /* Shift and add in the low order 7 bits */
+    sub_id = (sub_id << 7) + (byte & ~0x80);
 
     if (sub_id > SNMP_ASN1_OID_MAX_ID) {
       pr_trace_msg(trace_channel, 3,
@@ -518,7 +653,96 @@ int snmp_asn1_read_oid(pool *p, unsigned char **buf, size_t *buflen,
       return -1;
     }
 
-    *oid_ptr++ = (oid_t) sub_id;
+    if (!(byte & 0x80)) {
+      oidlen++;
+      sub_id = 0;
+    }
+  }
+
+  if (objlen > 0 &&
+      ((*buf)[objlen-1] & 0x80)) {
+    pr_trace_msg(trace_channel, 3,
+      "failed reading OID object: last sub-identifier is truncated");
+
+    snmp_stacktrace_log();
+    errno = EINVAL;
+    return -1;
+  }
+
+  /* The first encoded sub-identifier decodes into the first two
+   * sub-identifiers.  An empty OID (06 00), which is invalid, decodes as a
+   * single zero sub-identifier.
+   */
+  oidlen++;
+
+  if (oidlen > SNMP_ASN1_OID_MAX_LEN) {
+    pr_trace_msg(trace_channel, 3,
+      "failed reading OID object: too many sub-identifiers (%u, max %u)",
+      oidlen, SNMP_ASN1_OID_MAX_LEN);
+
+    snmp_stacktrace_log();
+    errno = EINVAL;
+    return -1;
+  }
+
+  *asn1_data = *buf;
+  *asn1_datalen = objlen;
+  *asn1_oidlen = oidlen;
+
+  (*buf) += objlen;
+  (*buflen) -= objlen;
+
+  return 0;
+}
+
+int snmp_asn1_decode_oid(unsigned char *asn1_data, unsigned int asn1_datalen,
+    oid_t *asn1_oid, unsigned int *asn1_oidlen) {
+
+  /* We leave room at the start of the OID memory for expansion into two
+   * bytes from the first byte of buffer data.
+   */
+  oid_t *oid_ptr = asn1_oid + 1, *oid_end;
+  unsigned int sub_id = 0;
+  register unsigned int i;
+
+  if (asn1_datalen == 0) {
+    /* Handle invalid OID encodings of the form 06 00 robustly; these need
+     * room for only the one sub-identifier.
+     */
+    if (*asn1_oidlen < 1) {
+      errno = ENOSPC;
+      return -1;
+    }
+
+    asn1_oid[0] = 0;
+    *asn1_oidlen = 1;
+    return 0;
+  }
+
+  if (*asn1_oidlen < 2) {
+    errno = ENOSPC;
+    return -1;
+  }
+
+  oid_end = asn1_oid + *asn1_oidlen;
+
+  for (i = 0; i < asn1_datalen; i++) {
+    unsigned char byte;
+
+    byte = asn1_data[i];
+
+    /* Shift and add in the low order 7 bits */
+    sub_id = (sub_id << 7) + (byte & ~0x80);
+
+    if (!(byte & 0x80)) {
+      if (oid_ptr == oid_end) {
+        errno = ENOSPC;
+        return -1;
+      }
+
+      *oid_ptr++ = (oid_t) sub_id;
+      sub_id = 0;
+    }
   }
 
   /* The first two subidentifiers are encoded into the first component with
@@ -541,12 +765,28 @@ int snmp_asn1_read_oid(pool *p, unsigned char **buf, size_t *buflen,
   return 0;
 }
 
+int snmp_asn1_read_oid(pool *p, unsigned char **buf, size_t *buflen,
+    unsigned char *asn1_type, oid_t *asn1_oid, unsigned int *asn1_oidlen) {
+  unsigned char *asn1_data;
+  unsigned int asn1_datalen, oidlen;
+  int res;
+
+  res = snmp_asn1_read_oid_view(p, buf, buflen, asn1_type, &asn1_data,
+    &asn1_datalen, &oidlen);
+  if (res < 0) {
+    return -1;
+  }
+
+  return snmp_asn1_decode_oid(asn1_data, asn1_datalen, asn1_oid, asn1_oidlen);
+}
+
 /* ASN.1 octet string ::= primitive-string | compound-string
  * primitive-string ::= 0x04 asnlength byte {byte}*
  * compound-string ::= 0x24 asnlength string {string}*
  */
-int snmp_asn1_read_string(pool *p, unsigned char **buf, size_t *buflen,
-    unsigned char *asn1_type, char **asn1_str, unsigned int *asn1_strlen) {
+int snmp_asn1_read_string_view(pool *p, unsigned char **buf, size_t *buflen,
+    unsigned char *asn1_type, unsigned char **asn1_str,
+    unsigned int *asn1_strlen) {
   unsigned int objlen;
   int res;
 
@@ -585,13 +825,28 @@ int snmp_asn1_read_string(pool *p, unsigned char **buf, size_t *buflen,
   }
 
   *asn1_strlen = objlen;
-  *asn1_str = pstrndup(p, (char *) *buf, objlen);
+  *asn1_str = *buf;
   (*buf) += objlen;
   (*buflen) -= objlen;
 
   return 0;
 }
 
+int snmp_asn1_read_string(pool *p, unsigned char **buf, size_t *buflen,
+    unsigned char *asn1_type, char **asn1_str, unsigned int *asn1_strlen) {
+  unsigned char *str;
+  int res;
+
+  res = snmp_asn1_read_string_view(p, buf, buflen, asn1_type, &str,
+    asn1_strlen);
+  if (res < 0) {
+    return -1;
+  }
+
+  *asn1_str = pstrndup(p, (char *) str, *asn1_strlen);
+  return 0;
+}
+
 static int asn1_write_byte(unsigned char **buf, size_t *buflen,
     unsigned char byte) {
 
@@ -620,12 +875,14 @@ static int asn1_write_type(unsigned char **buf, size_t *buflen,
     return -1;
   }
 
-  if (!(flags & SNMP_ASN1_FL_NO_TRACE_TYPESTR)) {
-    pr_trace_msg(trace_channel, 18,
-      "wrote ASN.1 type 0x%02x (%s)", asn1_type, asn1_typestr(asn1_type));
+  if (snmp_trace_is_enabled(trace_channel, 18)) {
+    if (!(flags & SNMP_ASN1_FL_NO_TRACE_TYPESTR)) {
+      pr_trace_msg(trace_channel, 18,
+        "wrote ASN.1 type 0x%02x (%s)", asn1_type, asn1_typestr(asn1_type));
 
-  } else {
-    pr_trace_msg(trace_channel, 18, "wrote byte 0x%02x", asn1_type);
+    } else {
+      pr_trace_msg(trace_channel, 18, "wrote byte 0x%02x", asn1_type);
+    }
   }
 
   return 0;
@@ -636,7 +893,10 @@ static int asn1_write_len(unsigned char **buf, size_t *buflen,
   int res;
 
   if (flags & SNMP_ASN1_FL_KNOWN_LEN) {
-    pr_trace_msg(trace_channel, 19, "writing ASN.1 known length %u", asn1_len);
+    if (snmp_trace_is_enabled(trace_channel, 19)) {
+      pr_trace_msg(trace_channel, 19, "writing ASN.1 known length %u",
+        asn1_len);
+    }
 
     /* No indefinite lengths sent. */
     if (asn1_len < SNMP_ASN1_LEN_LONG) {
@@ -718,8 +978,10 @@ static int asn1_write_len(unsigned char **buf, size_t *buflen,
     unsigned char first_byte;
     unsigned short len;
 
-    pr_trace_msg(trace_channel, 19, "writing ASN.1 unknown length %u",
-      asn1_len);
+    if (snmp_trace_is_enabled(trace_channel, 19)) {
+      pr_trace_msg(trace_channel, 19, "writing ASN.1 unknown length %u",
+        asn1_len);
+    }
 
     /* We don't know if this is the true length.  Make sure it's large
      * enough (i.e. three bytes) for later.
@@ -748,7 +1010,9 @@ static int asn1_write_len(unsigned char **buf, size_t *buflen,
     (*buflen) -= sizeof(unsigned short);
   }
 
-  pr_trace_msg(trace_channel, 18, "wrote ASN.1 length %u", asn1_len);
+  if (snmp_trace_is_enabled(trace_channel, 18)) {
+    pr_trace_msg(trace_channel, 18, "wrote ASN.1 length %u", asn1_len);
+  }
   return 0;
 }
 
@@ -842,7 +1106,9 @@ int snmp_asn1_write_int(pool *p, unsigned char **buf, size_t *buflen,
     objval <<= 8;
   }
 
-  pr_trace_msg(trace_channel, 18, "wrote ASN.1 value %ld", asn1_int);
+  if (snmp_trace_is_enabled(trace_channel, 18)) {
+    pr_trace_msg(trace_channel, 18, "wrote ASN.1 value %ld", asn1_int);
+  }
   return 0;
 }
 
@@ -927,7 +1193,9 @@ int snmp_asn1_write_uint(pool *p, unsigned char **buf, size_t *buflen,
     asn1_uint <<= 8;
   }
 
-  pr_trace_msg(trace_channel, 18, "wrote ASN.1 value %lu", asn1_uint);
+  if (snmp_trace_is_enabled(trace_channel, 18)) {
+    pr_trace_msg(trace_channel, 18, "wrote ASN.1 value %lu", asn1_uint);
+  }
   return 0;
 }
 
@@ -945,7 +1213,9 @@ int snmp_asn1_write_null(pool *p, unsigned char **buf, size_t *buflen,
     return -1;
   }
 
-  pr_trace_msg(trace_channel, 18, "%s", "wrote ASN.1 value null");
+  if (snmp_trace_is_enabled(trace_channel, 18)) {
+    pr_trace_msg(trace_channel, 18, "%s", "wrote ASN.1 value null");
+  }
   return res;
 }
 
@@ -1191,8 +1461,13 @@ int snmp_asn1_write_oid(pool *p, unsigned char **buf, size_t *buflen,
     }
   }
 
-  pr_trace_msg(trace_channel, 18, "wrote ASN.1 value %s (%u bytes)",
-    snmp_asn1_get_oidstr(p, asn1_oid, asn1_oidlen), asn1_len);
+  if (snmp_trace_is_enabled(trace_channel, 18)) {
+    char oidstr[SNMP_ASN1_OIDSTR_MAX_LEN];
+
+    pr_trace_msg(trace_channel, 18, "wrote ASN.1 value %s (%u bytes)",
+      snmp_asn1_format_oid(oidstr, sizeof(oidstr), asn1_oid, asn1_oidlen),
+      asn1_len);
+  }
   return 0;
 }
 
@@ -1231,8 +1506,10 @@ int snmp_asn1_write_string(pool *p, unsigned char **buf, size_t *buflen,
   (*buf) += asn1_strlen;
   (*buflen) -= asn1_strlen;
 
-  pr_trace_msg(trace_channel, 18, "wrote ASN.1 value '%.*s' (%u bytes)",
-    (int) asn1_strlen, asn1_str, asn1_strlen);
+  if (snmp_trace_is_enabled(trace_channel, 18)) {
+    pr_trace_msg(trace_channel, 18, "wrote ASN.1 value '%.*s' (%u bytes)",
+      (int) asn1_strlen, asn1_str, asn1_strlen);
+  }
   return 0;
 }
 
@@ -1252,6 +1529,335 @@ int snmp_asn1_write_exception(pool *p, unsigned char **buf, size_t *buflen,
     return -1;
   }
 
-  pr_trace_msg(trace_channel, 18, "wrote ASN.1 value %u", asn1_ex);
+  if (snmp_trace_is_enabled(trace_channel, 18)) {
+    pr_trace_msg(trace_channel, 18, "wrote ASN.1 value %u", asn1_ex);
+  }
   return res;
 }
+
+/* The snmp_asn1_prepend_*() functions encode their objects back-to-front.
+ * The buf pointer points just past the free space in the buffer, i.e. at the
+ * start of the data already encoded, and buflen is the amount of free space
+ * before it.  Each object is written in front of the data already there, so
+ * that the length of every constructed object is known by the time its
+ * header is written, and all lengths can be minimally encoded.
+ */
+
+static int asn1_prepend_data(unsigned char **buf, size_t *buflen,
+    const unsigned char *data, size_t datalen) {
+
+  if (*buflen < datalen) {
+    pr_trace_msg(trace_channel, 3,
+      "failed prepending ASN.1 data: data length (%lu bytes) is greater "
+      "than remaining buffer (%lu bytes)", (unsigned long) datalen,
+      (unsigned long) *buflen);
+
+    snmp_stacktrace_log();
+    errno = EINVAL;
+    return -1;
+  }
+
+  (*buf) -= datalen;
+  (*buflen) -= datalen;
+  memcpy(*buf, data, datalen);
+
+  return 0;
+}
+
+int snmp_asn1_prepend_header(pool *p, unsigned char **buf, size_t *buflen,
+    unsigned char asn1_type, unsigned int asn1_len, int flags) {
+  unsigned char hdr[2 + sizeof(unsigned int)];
+  size_t hdrlen;
+
+  if (asn1_len < SNMP_ASN1_LEN_LONG) {
+    hdr[0] = asn1_type;
+    hdr[1] = (unsigned char) asn1_len;
+    hdrlen = 2;
+
+  } else {
+    unsigned char *ptr;
+    unsigned int len, lensz = 0;
+
+    /* Fill in the length bytes from the end of the header, least significant
+     * byte first, then put the type and length-of-length bytes in front.
+     */
+    ptr = hdr + sizeof(hdr);
+    for (len = asn1_len; len > 0; len >>= 8) {
+      *(--ptr) = (unsigned char) (len & 0xff);
+      lensz++;
+    }
+
+    *(--ptr) = (unsigned char) (lensz|SNMP_ASN1_LEN_LONG);
+    *(--ptr) = asn1_type;
+
+    hdrlen = lensz + 2;
+    if (ptr != hdr) {
+      memmove(hdr, ptr, hdrlen);
+    }
+  }
+
+  if (asn1_prepend_data(buf, buflen, hdr, hdrlen) < 0) {
+    return -1;
+  }
+
+  if (snmp_trace_is_enabled(trace_channel, 18)) {
+    if (!(flags & SNMP_ASN1_FL_NO_TRACE_TYPESTR)) {
+      pr_trace_msg(trace_channel, 18,
+        "wrote ASN.1 type 0x%02x (%s), length %u", asn1_type,
+        asn1_typestr(asn1_type), asn1_len);
+
+    } else {
+      pr_trace_msg(trace_channel, 18, "wrote byte 0x%02x, ASN.1 length %u",
+        asn1_type, asn1_len);
+    }
+  }
+
+  return 0;
+}
+
+int snmp_asn1_prepend_int(pool *p, unsigned char **buf, size_t *buflen,
+    unsigned char asn1_type, long asn1_int, int flags) {
+  unsigned char data[sizeof(long)], *ptr;
+  unsigned long objval;
+  unsigned int asn1_intsz;
+
+  asn1_intsz = asn1_get_intsz(asn1_int);
+
+  /* Copy out the least significant bytes of the 2's complement value. */
+  objval = (unsigned long) asn1_int;
+  ptr = data + sizeof(data);
+  while (ptr > data + (sizeof(data) - asn1_intsz)) {
+    *(--ptr) = (unsigned char) (objval & 0xff);
+    objval >>= 8;
+  }
+
+  if (asn1_prepend_data(buf, buflen, ptr, asn1_intsz) < 0) {
+    return -1;
+  }
+
+  if (snmp_asn1_prepend_header(p, buf, buflen, asn1_type, asn1_intsz,
+      flags) < 0) {
+    return -1;
+  }
+
+  if (snmp_trace_is_enabled(trace_channel, 18)) {
+    pr_trace_msg(trace_channel, 18, "wrote ASN.1 value %ld", asn1_int);
+  }
+  return 0;
+}
+
+int snmp_asn1_prepend_uint(pool *p, unsigned char **buf, size_t *buflen,
+    unsigned char asn1_type, unsigned long asn1_uint) {
+  unsigned char data[sizeof(uint32_t) + 1], *ptr;
+  unsigned long objval;
+  unsigned int asn1_uintsz;
+
+  asn1_uintsz = asn1_get_uintsz(asn1_uint);
+
+  /* Any extra leading byte, to prevent sign extension, is left as zero. */
+  objval = asn1_uint & 0xffffffff;
+  ptr = data + sizeof(data);
+  while (ptr > data + (sizeof(data) - asn1_uintsz)) {
+    *(--ptr) = (unsigned char) (objval & 0xff);
+    objval >>= 8;
+  }
+
+  if (asn1_prepend_data(buf, buflen, ptr, asn1_uintsz) < 0) {
+    return -1;
+  }
+
+  if (snmp_asn1_prepend_header(p, buf, buflen, asn1_type, asn1_uintsz,
+      0) < 0) {
+    return -1;
+  }
+
+  if (snmp_trace_is_enabled(trace_channel, 18)) {
+    pr_trace_msg(trace_channel, 18, "wrote ASN.1 value %lu", asn1_uint);
+  }
+  return 0;
+}
+
+int snmp_asn1_prepend_null(pool *p, unsigned char **buf, size_t *buflen,
+    unsigned char asn1_type) {
+
+  if (snmp_asn1_prepend_header(p, buf, buflen, asn1_type, 0, 0) < 0) {
+    return -1;
+  }
+
+  if (snmp_trace_is_enabled(trace_channel, 18)) {
+    pr_trace_msg(trace_channel, 18, "%s", "wrote ASN.1 value null");
+  }
+  return 0;
+}
+
+static int asn1_prepend_sub_id(unsigned char **ptr, size_t *avail,
+    oid_t sub_id) {
+  unsigned int sub_idsz;
+
+  if (sub_id < (unsigned int) 0x80) {
+    sub_idsz = 1;
+
+  } else if (sub_id < (unsigned int) 0x4000) {
+    sub_idsz = 2;
+
+  } else if (sub_id < (unsigned int) 0x200000) {
+    sub_idsz = 3;
+
+  } else if (sub_id < (unsigned int) 0x10000000) {
+    sub_idsz = 4;
+
+  } else {
+    sub_idsz = 5;
+  }
+
+  if (*avail < sub_idsz) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  (*avail) -= sub_idsz;
+
+  /* The last byte has the high bit clear; all others have it set. */
+  *(--(*ptr)) = (unsigned char) (sub_id & 0x7f);
+  while (--sub_idsz > 0) {
+    sub_id >>= 7;
+    *(--(*ptr)) = (unsigned char) ((sub_id & 0x7f)|0x80);
+  }
+
+  return 0;
+}
+
+int snmp_asn1_prepend_oid(pool *p, unsigned char **buf, size_t *buflen,
+    unsigned char asn1_type, oid_t *asn1_oid, unsigned int asn1_oidlen) {
+  unsigned char *ptr;
+  unsigned int asn1_len;
+  size_t avail;
+  oid_t first_sub_id;
+
+  if (asn1_oidlen == 0) {
+    /* An empty OID is encoded as 0.0. */
+    first_sub_id = 0;
+
+  } else if (asn1_oid[0] > 2) {
+    /* The first sub-identifiers are limited to ccitt(0), iso(1), and
+     * joint-iso-ccitt(2) as per RFC 2578.
+     */
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "invalid first sub-identifier (%lu) in OID", (unsigned long) asn1_oid[0]);
+    snmp_stacktrace_log();
+    errno = EINVAL;
+    return -1;
+
+  } else if (asn1_oidlen > SNMP_MIB_MAX_OIDLEN) {
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "OID sub-identifier count (%u) exceeds max supported (%u)", asn1_oidlen,
+      SNMP_MIB_MAX_OIDLEN);
+    snmp_stacktrace_log();
+    errno = EINVAL;
+    return -1;
+
+  } else if (asn1_oidlen == 1) {
+    first_sub_id = (asn1_oid[0] * 40);
+
+  } else {
+    first_sub_id = ((asn1_oid[0] * 40) + asn1_oid[1]);
+  }
+
+  ptr = *buf;
+  avail = *buflen;
+
+  /* Encode the sub-identifiers last to first; the first two are combined
+   * into a single sub-identifier, per ISO/IEC 8825.
+   */
+  if (asn1_oidlen > 2) {
+    register unsigned int i;
+
+    for (i = asn1_oidlen - 1; i >= 2; i--) {
+      if (asn1_prepend_sub_id(&ptr, &avail, asn1_oid[i]) < 0) {
+        break;
+      }
+    }
+
+    if (i >= 2) {
+      (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+        "failed writing OID object: object length is greater than remaining "
+        "buffer (%lu bytes)", (unsigned long) *buflen);
+      snmp_stacktrace_log();
+      errno = EINVAL;
+      return -1;
+    }
+  }
+
+  if (asn1_prepend_sub_id(&ptr, &avail, first_sub_id) < 0) {
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "failed writing OID object: object length is greater than remaining "
+      "buffer (%lu bytes)", (unsigned long) *buflen);
+    snmp_stacktrace_log();
+    errno = EINVAL;
+    return -1;
+  }
+
+  asn1_len = (unsigned int) (*buf - ptr);
+  *buf = ptr;
+  *buflen = avail;
+
+  if (snmp_asn1_prepend_header(p, buf, buflen, asn1_type, asn1_len, 0) < 0) {
+    return -1;
+  }
+
+  if (snmp_trace_is_enabled(trace_channel, 18)) {
+    char oidstr[SNMP_ASN1_OIDSTR_MAX_LEN];
+
+    pr_trace_msg(trace_channel, 18, "wrote ASN.1 value %s (%u bytes)",
+      snmp_asn1_format_oid(oidstr, sizeof(oidstr), asn1_oid, asn1_oidlen),
+      asn1_len);
+  }
+  return 0;
+}
+
+int snmp_asn1_prepend_string(pool *p, unsigned char **buf, size_t *buflen,
+    unsigned char asn1_type, const char *asn1_str, unsigned int asn1_strlen) {
+
+  if (asn1_prepend_data(buf, buflen, (const unsigned char *) asn1_str,
+      asn1_strlen) < 0) {
+    return -1;
+  }
+
+  if (snmp_asn1_prepend_header(p, buf, buflen, asn1_type, asn1_strlen,
+      0) < 0) {
+    return -1;
+  }
+
+  if (snmp_trace_is_enabled(trace_channel, 18)) {
+    pr_trace_msg(trace_channel, 18, "wrote ASN.1 value '%.*s' (%u bytes)",
+      (int) asn1_strlen, asn1_str, asn1_strlen);
+  }
+  return 0;
+}
+
+int snmp_asn1_prepend_exception(pool *p, unsigned char **buf, size_t *buflen,
+    unsigned char asn1_type, unsigned char asn1_ex) {
+
+  if (snmp_asn1_prepend_header(p, buf, buflen, asn1_type, asn1_ex, 0) < 0) {
+    return -1;
+  }
+
+  if (snmp_trace_is_enabled(trace_channel, 18)) {
+    pr_trace_msg(trace_channel, 18, "wrote ASN.1 value %u", asn1_ex);
+  }
+  return 0;
+}
+
+int snmp_asn1_prepend_encoded(pool *p, unsigned char **buf, size_t *buflen,
+    const unsigned char *asn1_data, unsigned int asn1_datalen) {
+
+  if (asn1_prepend_data(buf, buflen, asn1_data, asn1_datalen) < 0) {
+    return -1;
+  }
+
+  if (snmp_trace_is_enabled(trace_channel, 18)) {
+    pr_trace_msg(trace_channel, 18, "wrote encoded ASN.1 object (%u bytes)",
+      asn1_datalen);
+  }
+  return 0;
+}
@@ -66,6 +66,17 @@ typedef uint32_t oid_t;
 
 const char *snmp_asn1_get_oidstr(pool *p, oid_t *asn1_oid,
   unsigned int asn1_oidlen);
+
+/* Large enough for the dotted string of any OID we accept: up to ten digits
+ * and a '.' for each sub-identifier.
+ */
+#define SNMP_ASN1_OIDSTR_MAX_LEN	(SNMP_ASN1_OID_MAX_LEN * 11)
+
+/* Formats the dotted OID string into the given buffer, rather than
+ * allocating it; longer strings are truncated.  Returns the buffer.
+ */
+char *snmp_asn1_format_oid(char *buf, size_t bufsz, oid_t *asn1_oid,
+  unsigned int asn1_oidlen);
 const char *snmp_asn1_get_tagstr(pool *p, unsigned char asn1_type);
 
 /* API flags */
@@ -73,6 +84,15 @@ const char *snmp_asn1_get_tagstr(pool *p, unsigned char asn1_type);
 #define SNMP_ASN1_FL_NO_TRACE_TYPESTR	0x02
 #define SNMP_ASN1_FL_UNSIGNED		0x04
 
+/* Encoded sizes, in bytes, of ASN.1 objects, as written by the
+ * snmp_asn1_write_*() and snmp_asn1_prepend_*() functions.  The INTEGER and OID sizes include the
+ * header.
+ */
+size_t snmp_asn1_get_header_len(unsigned int asn1_len, int flags);
+size_t snmp_asn1_get_int_len(long asn1_int);
+size_t snmp_asn1_get_uint_len(unsigned long asn1_uint);
+size_t snmp_asn1_get_oid_len(oid_t *asn1_oid, unsigned int asn1_oidlen);
+
 int snmp_asn1_read_header(pool *p, unsigned char **buf, size_t *buflen,
   unsigned char *asn1_type, unsigned int *asn1_len, int flags);
 int snmp_asn1_read_int(pool *p, unsigned char **buf, size_t *buflen,
@@ -88,6 +108,20 @@ int snmp_asn1_read_oid(pool *p, unsigned char **buf, size_t *buflen,
 int snmp_asn1_read_string(pool *p, unsigned char **buf, size_t *buflen,
   unsigned char *asn1_type, char **asn_1str, unsigned int *asn1_strlen);
 
+/* The view readers validate the object, and return pointers into the buffer
+ * rather than copies; the views are valid as long as the buffer is.  For
+ * OIDs, asn1_oidlen is set to the number of sub-identifiers which
+ * snmp_asn1_decode_oid() will produce from the view.
+ */
+int snmp_asn1_read_oid_view(pool *p, unsigned char **buf, size_t *buflen,
+  unsigned char *asn1_type, unsigned char **asn1_data,
+  unsigned int *asn1_datalen, unsigned int *asn1_oidlen);
+int snmp_asn1_decode_oid(unsigned char *asn1_data, unsigned int asn1_datalen,
+  oid_t *asn1_oid, unsigned int *asn1_oidlen);
+int snmp_asn1_read_string_view(pool *p, unsigned char **buf, size_t *buflen,
+  unsigned char *asn1_type, unsigned char **asn1_str,
+  unsigned int *asn1_strlen);
+
 /* XXX Need an snmp_asn1_read_sequence() function? */
 
 int snmp_asn1_write_header(pool *p, unsigned char **buf, size_t *buflen,
@@ -120,4 +154,29 @@ int snmp_asn1_write_exception(pool *p, unsigned char **buf, size_t *buflen,
 
 /* XXX Need an snmp_asn1_write_sequence() function? */
 
+/* Back-to-front writers.  These write each object immediately in front of
+ * *buf, moving *buf toward the start of the buffer; *buflen is the amount
+ * of free space remaining in front of *buf.  Since the contents of a
+ * constructed object are written before its header, every length is known
+ * when written, and so is always minimally encoded.
+ */
+int snmp_asn1_prepend_header(pool *p, unsigned char **buf, size_t *buflen,
+  unsigned char asn1_type, unsigned int asn1_len, int flags);
+int snmp_asn1_prepend_int(pool *p, unsigned char **buf, size_t *buflen,
+  unsigned char asn1_type, long asn1_int, int flags);
+int snmp_asn1_prepend_uint(pool *p, unsigned char **buf, size_t *buflen,
+  unsigned char asn1_type, unsigned long asn1_uint);
+int snmp_asn1_prepend_null(pool *p, unsigned char **buf, size_t *buflen,
+  unsigned char asn1_type);
+int snmp_asn1_prepend_oid(pool *p, unsigned char **buf, size_t *buflen,
+  unsigned char asn1_type, oid_t *asn1_oid, unsigned int asn1_oidlen);
+int snmp_asn1_prepend_string(pool *p, unsigned char **buf, size_t *buflen,
+  unsigned char asn1_type, const char *asn1_str, unsigned int asn1_strlen);
+int snmp_asn1_prepend_exception(pool *p, unsigned char **buf, size_t *buflen,
+  unsigned char asn1_type, unsigned char asn1_ex);
+
+/* Copies an already-encoded object, header included, in front of *buf. */
+int snmp_asn1_prepend_encoded(pool *p, unsigned char **buf, size_t *buflen,
+  const unsigned char *asn1_data, unsigned int asn1_datalen);
+
 #endif
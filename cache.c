@@ -0,0 +1,485 @@
+/*
+ * ProFTPD - mod_snmp response cache
+ * Copyright (c) 2013 TJ Saunders
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, TJ Saunders and other respective copyright holders
+ * give permission to link this program with OpenSSL, and distribute the
+ * resulting executable, without including the source code for OpenSSL in the
+ * source distribution.
+ *
+ * $Id$
+ */
+
+#include "mod_snmp.h"
+#include "asn1.h"
+#include "smi.h"
+#include "pdu.h"
+#include "msg.h"
+#include "packet.h"
+#include "cache.h"
+#include "db.h"
+
+struct snmp_cache_entry {
+  unsigned int hash;
+
+  /* The normalized request. */
+  unsigned char *key;
+  size_t keylen;
+
+  /* The encoded response, and the location of its request-id INTEGER. */
+  unsigned char *resp_data;
+  size_t resp_datalen;
+  size_t rid_offset;
+  size_t rid_len;
+
+  struct timeval expires;
+};
+
+struct snmp_retransmit_entry {
+  int in_use;
+
+  pr_netaddr_t remote_addr;
+  long request_id;
+
+  /* The raw request, and its encoded response. */
+  unsigned char *req_data;
+  size_t req_datalen;
+  unsigned char *resp_data;
+  size_t resp_datalen;
+
+  time_t expires;
+};
+
+static pool *cache_pool = NULL;
+static struct snmp_cache_entry *cache_entries = NULL;
+static unsigned int cache_nentries = 0;
+static unsigned long cache_ttl_ms = 0;
+
+static pool *retransmit_pool = NULL;
+static struct snmp_retransmit_entry *retransmit_entries = NULL;
+
+static const char *trace_channel = "snmp.cache";
+
+static void cache_incr_value(pool *p, unsigned int field_id,
+    const char *field_str) {
+  int res;
+
+  res = snmp_db_incr_value(p, field_id, 1);
+  if (res < 0) {
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "error incrementing SNMP database for %s: %s", field_str,
+      strerror(errno));
+  }
+}
+
+static int cache_add_key_data(unsigned char *key, size_t *keylen,
+    const void *data, size_t datalen) {
+
+  if (*keylen + datalen > SNMP_CACHE_MAX_KEYLEN) {
+    errno = ENOSPC;
+    return -1;
+  }
+
+  memcpy(key + *keylen, data, datalen);
+  *keylen += datalen;
+  return 0;
+}
+
+/* Build the normalized form of the request: everything which determines the
+ * response, except for the request-id.
+ */
+static int cache_get_key(struct snmp_packet *pkt, unsigned char *key,
+    size_t *keylen) {
+  register unsigned int i;
+  struct snmp_pdu *pdu;
+  struct snmp_var *vars;
+  unsigned char version, request_type;
+
+  pdu = pkt->req_pdu;
+  *keylen = 0;
+
+  version = (unsigned char) pkt->snmp_version;
+  request_type = pdu->request_type;
+
+  if (cache_add_key_data(key, keylen, &version, sizeof(version)) < 0 ||
+      cache_add_key_data(key, keylen, &request_type,
+        sizeof(request_type)) < 0 ||
+      cache_add_key_data(key, keylen, &(pdu->non_repeaters),
+        sizeof(pdu->non_repeaters)) < 0 ||
+      cache_add_key_data(key, keylen, &(pdu->max_repetitions),
+        sizeof(pdu->max_repetitions)) < 0 ||
+      cache_add_key_data(key, keylen, &(pkt->community_len),
+        sizeof(pkt->community_len)) < 0 ||
+      cache_add_key_data(key, keylen, pkt->community,
+        pkt->community_len) < 0) {
+    return -1;
+  }
+
+  if (pdu->varlist == NULL) {
+    return 0;
+  }
+
+  vars = pdu->varlist->elts;
+  for (i = 0; i < (unsigned int) pdu->varlist->nelts; i++) {
+    if (cache_add_key_data(key, keylen, &(vars[i].namelen),
+          sizeof(vars[i].namelen)) < 0 ||
+        cache_add_key_data(key, keylen, vars[i].name,
+          vars[i].namelen * sizeof(oid_t)) < 0) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/* FNV-1a */
+static unsigned int cache_get_hash(const unsigned char *key, size_t keylen) {
+  register unsigned int i;
+  unsigned int hash = 2166136261U;
+
+  for (i = 0; i < keylen; i++) {
+    hash ^= key[i];
+    hash *= 16777619U;
+  }
+
+  return hash;
+}
+
+/* Find the request-id INTEGER within an encoded response message, i.e.:
+ *
+ *  SEQUENCE { version, community, PDU { request-id, ... } }
+ */
+static int cache_find_request_id(pool *p, unsigned char *data, size_t datalen,
+    size_t *rid_offset, size_t *rid_len) {
+  unsigned char *buf, *community, asn1_type;
+  unsigned int asn1_len, community_len;
+  size_t buflen;
+  long asn1_int;
+  int res;
+
+  buf = data;
+  buflen = datalen;
+
+  res = snmp_asn1_read_header(p, &buf, &buflen, &asn1_type, &asn1_len, 0);
+  if (res < 0) {
+    return -1;
+  }
+
+  res = snmp_asn1_read_int(p, &buf, &buflen, &asn1_type, &asn1_int, 0);
+  if (res < 0) {
+    return -1;
+  }
+
+  res = snmp_asn1_read_string_view(p, &buf, &buflen, &asn1_type, &community,
+    &community_len);
+  if (res < 0) {
+    return -1;
+  }
+
+  res = snmp_asn1_read_header(p, &buf, &buflen, &asn1_type, &asn1_len, 0);
+  if (res < 0) {
+    return -1;
+  }
+
+  *rid_offset = buf - data;
+
+  res = snmp_asn1_read_int(p, &buf, &buflen, &asn1_type, &asn1_int, 0);
+  if (res < 0) {
+    return -1;
+  }
+
+  *rid_len = (buf - data) - *rid_offset;
+  return 0;
+}
+
+int snmp_cache_init(pool *p, unsigned long ttl_ms, unsigned int max_entries) {
+  register unsigned int i;
+
+  if (p == NULL ||
+      ttl_ms == 0 ||
+      max_entries == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (cache_pool != NULL) {
+    destroy_pool(cache_pool);
+  }
+
+  cache_pool = make_sub_pool(p);
+  pr_pool_tag(cache_pool, "SNMP response cache pool");
+
+  cache_entries = pcalloc(cache_pool,
+    max_entries * sizeof(struct snmp_cache_entry));
+  for (i = 0; i < max_entries; i++) {
+    cache_entries[i].key = palloc(cache_pool, SNMP_CACHE_MAX_KEYLEN);
+    cache_entries[i].resp_data = palloc(cache_pool, SNMP_PACKET_MAX_LEN);
+  }
+
+  cache_nentries = max_entries;
+  cache_ttl_ms = ttl_ms;
+
+  pr_trace_msg(trace_channel, 9,
+    "caching up to %u responses for %lu ms", cache_nentries, cache_ttl_ms);
+  return 0;
+}
+
+int snmp_cache_get(pool *p, struct snmp_packet *pkt) {
+  struct snmp_cache_entry *entry;
+  unsigned char key[SNMP_CACHE_MAX_KEYLEN], rid[16], *buf;
+  size_t keylen, buflen;
+  unsigned int hash;
+  struct timeval now;
+  int res;
+
+  if (cache_entries == NULL) {
+    errno = ENOENT;
+    return -1;
+  }
+
+  /* We never cache responses for SetRequest-PDUs. */
+  if (pkt->req_pdu->request_type == SNMP_PDU_SET) {
+    errno = ENOENT;
+    return -1;
+  }
+
+  if (cache_get_key(pkt, key, &keylen) < 0) {
+    errno = ENOENT;
+    return -1;
+  }
+
+  hash = cache_get_hash(key, keylen);
+  entry = &(cache_entries[hash % cache_nentries]);
+
+  gettimeofday(&now, NULL);
+
+  if (entry->keylen != keylen ||
+      entry->hash != hash ||
+      memcmp(entry->key, key, keylen) != 0 ||
+      timercmp(&now, &(entry->expires), >)) {
+    cache_incr_value(p, SNMP_DB_SNMP_F_RESP_CACHE_MISS_TOTAL,
+      "snmp.responseCacheMissesTotal");
+    errno = ENOENT;
+    return -1;
+  }
+
+  /* Encode the new request-id.  If its encoding has a different length than
+   * the cached one, we cannot patch it in place, and treat this as a miss.
+   */
+  buf = rid;
+  buflen = sizeof(rid);
+  res = snmp_asn1_write_int(p, &buf, &buflen,
+    (SNMP_ASN1_CLASS_UNIVERSAL|SNMP_ASN1_PRIMITIVE|SNMP_ASN1_TYPE_INTEGER),
+    pkt->req_pdu->request_id, 0);
+  if (res < 0 ||
+      (size_t) (buf - rid) != entry->rid_len) {
+    pr_trace_msg(trace_channel, 17,
+      "unable to reuse cached response for request ID %ld: request ID "
+      "length differs", pkt->req_pdu->request_id);
+    cache_incr_value(p, SNMP_DB_SNMP_F_RESP_CACHE_MISS_TOTAL,
+      "snmp.responseCacheMissesTotal");
+    errno = ENOENT;
+    return -1;
+  }
+
+  memcpy(pkt->resp_data, entry->resp_data, entry->resp_datalen);
+  memcpy(pkt->resp_data + entry->rid_offset, rid, entry->rid_len);
+  pkt->resp_datalen = entry->resp_datalen;
+
+  pr_trace_msg(trace_channel, 17,
+    "using cached response (%lu bytes) for request ID %ld",
+    (unsigned long) pkt->resp_datalen, pkt->req_pdu->request_id);
+
+  cache_incr_value(p, SNMP_DB_SNMP_F_RESP_CACHE_HIT_TOTAL,
+    "snmp.responseCacheHitsTotal");
+  return 0;
+}
+
+int snmp_cache_add(pool *p, struct snmp_packet *pkt) {
+  struct snmp_cache_entry *entry;
+  unsigned char key[SNMP_CACHE_MAX_KEYLEN];
+  size_t keylen, rid_offset = 0, rid_len = 0;
+  unsigned int hash;
+  int res;
+
+  if (cache_entries == NULL) {
+    errno = EPERM;
+    return -1;
+  }
+
+  if (pkt->req_pdu == NULL ||
+      pkt->req_pdu->request_type == SNMP_PDU_SET ||
+      pkt->resp_datalen > SNMP_PACKET_MAX_LEN) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  res = cache_get_key(pkt, key, &keylen);
+  if (res < 0) {
+    pr_trace_msg(trace_channel, 17, "%s",
+      "request too large to cache, ignoring");
+    return -1;
+  }
+
+  res = cache_find_request_id(p, pkt->resp_data, pkt->resp_datalen,
+    &rid_offset, &rid_len);
+  if (res < 0) {
+    return -1;
+  }
+
+  hash = cache_get_hash(key, keylen);
+  entry = &(cache_entries[hash % cache_nentries]);
+
+  entry->hash = hash;
+  memcpy(entry->key, key, keylen);
+  entry->keylen = keylen;
+
+  memcpy(entry->resp_data, pkt->resp_data, pkt->resp_datalen);
+  entry->resp_datalen = pkt->resp_datalen;
+  entry->rid_offset = rid_offset;
+  entry->rid_len = rid_len;
+
+  gettimeofday(&(entry->expires), NULL);
+  entry->expires.tv_sec += (cache_ttl_ms / 1000);
+  entry->expires.tv_usec += ((cache_ttl_ms % 1000) * 1000);
+  if (entry->expires.tv_usec >= 1000000) {
+    entry->expires.tv_sec++;
+    entry->expires.tv_usec -= 1000000;
+  }
+
+  return 0;
+}
+
+int snmp_cache_retransmit_init(pool *p) {
+  register unsigned int i;
+
+  if (p == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (retransmit_pool != NULL) {
+    destroy_pool(retransmit_pool);
+  }
+
+  retransmit_pool = make_sub_pool(p);
+  pr_pool_tag(retransmit_pool, "SNMP retransmit cache pool");
+
+  retransmit_entries = pcalloc(retransmit_pool,
+    SNMP_CACHE_RETRANSMIT_MAX_ENTRIES * sizeof(struct snmp_retransmit_entry));
+  for (i = 0; i < SNMP_CACHE_RETRANSMIT_MAX_ENTRIES; i++) {
+    retransmit_entries[i].req_data = palloc(retransmit_pool,
+      SNMP_PACKET_MAX_LEN);
+    retransmit_entries[i].resp_data = palloc(retransmit_pool,
+      SNMP_PACKET_MAX_LEN);
+  }
+
+  return 0;
+}
+
+static struct snmp_retransmit_entry *retransmit_get_entry(
+    pr_netaddr_t *remote_addr, long request_id) {
+  unsigned int idx;
+
+  idx = ((unsigned int) request_id) ^ pr_netaddr_get_port(remote_addr);
+  return &(retransmit_entries[idx % SNMP_CACHE_RETRANSMIT_MAX_ENTRIES]);
+}
+
+int snmp_cache_retransmit_get(pool *p, struct snmp_packet *pkt,
+    unsigned char *req_data, size_t req_datalen) {
+  struct snmp_retransmit_entry *entry;
+  long request_id;
+  int res;
+
+  if (retransmit_entries == NULL) {
+    errno = ENOENT;
+    return -1;
+  }
+
+  res = snmp_msg_peek(req_data, req_datalen, NULL, NULL, NULL, NULL,
+    &request_id);
+  if (res < 0) {
+    errno = ENOENT;
+    return -1;
+  }
+
+  entry = retransmit_get_entry(pkt->remote_addr, request_id);
+  if (entry->in_use == FALSE ||
+      entry->request_id != request_id ||
+      entry->req_datalen != req_datalen ||
+      entry->expires < time(NULL) ||
+      pr_netaddr_get_port(&(entry->remote_addr)) !=
+        pr_netaddr_get_port(pkt->remote_addr) ||
+      pr_netaddr_cmp(&(entry->remote_addr), pkt->remote_addr) != 0 ||
+      memcmp(entry->req_data, req_data, req_datalen) != 0) {
+    errno = ENOENT;
+    return -1;
+  }
+
+  memcpy(pkt->resp_data, entry->resp_data, entry->resp_datalen);
+  pkt->resp_datalen = entry->resp_datalen;
+
+  pr_trace_msg(trace_channel, 12,
+    "answering retransmitted request ID %ld from %s#%u with previous "
+    "response (%lu bytes)", request_id, pr_netaddr_get_ipstr(pkt->remote_addr),
+    ntohs(pr_netaddr_get_port(pkt->remote_addr)),
+    (unsigned long) pkt->resp_datalen);
+
+  cache_incr_value(p, SNMP_DB_SNMP_F_RETRANSMIT_HIT_TOTAL,
+    "snmp.retransmitHitsTotal");
+  return 0;
+}
+
+int snmp_cache_retransmit_add(pool *p, struct snmp_packet *pkt,
+    unsigned char *req_data, size_t req_datalen) {
+  struct snmp_retransmit_entry *entry;
+  long request_id;
+  int res;
+
+  if (retransmit_entries == NULL) {
+    errno = EPERM;
+    return -1;
+  }
+
+  if (req_datalen > SNMP_PACKET_MAX_LEN ||
+      pkt->resp_datalen > SNMP_PACKET_MAX_LEN) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  res = snmp_msg_peek(req_data, req_datalen, NULL, NULL, NULL, NULL,
+    &request_id);
+  if (res < 0) {
+    return -1;
+  }
+
+  entry = retransmit_get_entry(pkt->remote_addr, request_id);
+
+  memcpy(&(entry->remote_addr), pkt->remote_addr, sizeof(pr_netaddr_t));
+  entry->request_id = request_id;
+
+  memcpy(entry->req_data, req_data, req_datalen);
+  entry->req_datalen = req_datalen;
+
+  memcpy(entry->resp_data, pkt->resp_data, pkt->resp_datalen);
+  entry->resp_datalen = pkt->resp_datalen;
+
+  entry->expires = time(NULL) + SNMP_CACHE_RETRANSMIT_WINDOW_SECS;
+  entry->in_use = TRUE;
+
+  return 0;
+}
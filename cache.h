@@ -0,0 +1,72 @@
+/*
+ * ProFTPD - mod_snmp response cache
+ * Copyright (c) 2013 TJ Saunders
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, TJ Saunders and other respective copyright holders
+ * give permission to link this program with OpenSSL, and distribute the
+ * resulting executable, without including the source code for OpenSSL in the
+ * source distribution.
+ *
+ * $Id$
+ */
+
+#include "mod_snmp.h"
+#include "packet.h"
+
+#ifndef MOD_SNMP_CACHE_H
+#define MOD_SNMP_CACHE_H
+
+/* Default number of cached responses, if not configured otherwise. */
+#define SNMP_CACHE_DEFAULT_MAX_ENTRIES		32
+
+/* Requests whose normalized form is larger than this are not cached. */
+#define SNMP_CACHE_MAX_KEYLEN			512
+
+int snmp_cache_init(pool *p, unsigned long ttl_ms, unsigned int max_entries);
+
+/* Looks up a cached response for the given (decoded) request packet.  On a
+ * hit, the response, with its request-id rewritten to match the request, is
+ * copied into pkt->resp_data, and zero is returned.  Otherwise, -1 is
+ * returned, with errno set to ENOENT.
+ */
+int snmp_cache_get(pool *p, struct snmp_packet *pkt);
+
+/* Adds the encoded response for the given packet to the cache. */
+int snmp_cache_add(pool *p, struct snmp_packet *pkt);
+
+/* Retransmitted requests, i.e. byte-identical requests from the same address
+ * and port, with the same request-id, received within this many seconds of
+ * the original, are answered with the original response.
+ */
+#define SNMP_CACHE_RETRANSMIT_WINDOW_SECS	5
+#define SNMP_CACHE_RETRANSMIT_MAX_ENTRIES	32
+
+int snmp_cache_retransmit_init(pool *p);
+
+/* Looks up the response to a previous instance of the given raw request
+ * data, received from the packet's remote address.  On a hit, the response
+ * is copied into pkt->resp_data, and zero is returned.  Otherwise, -1 is
+ * returned, with errno set to ENOENT.  The request data is not decoded.
+ */
+int snmp_cache_retransmit_get(pool *p, struct snmp_packet *pkt,
+  unsigned char *req_data, size_t req_datalen);
+
+/* Remembers the encoded response for the given raw request data. */
+int snmp_cache_retransmit_add(pool *p, struct snmp_packet *pkt,
+  unsigned char *req_data, size_t req_datalen);
+
+#endif
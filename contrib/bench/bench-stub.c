@@ -0,0 +1,308 @@
+/*
+ * ProFTPD - mod_snmp codec benchmark stubs
+ * Copyright (c) 2008-2011 TJ Saunders
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, TJ Saunders and other respective copyright holders
+ * give permission to link this program with OpenSSL, and distribute the
+ * resulting executable, without including the source code for OpenSSL in the
+ * source distribution.
+ *
+ * $Id$
+ */
+
+/* Stub implementations of the proftpd API declared in include/conf.h.
+ *
+ * The pools are simple block allocators, like the real ones, so that the
+ * cost of a palloc() stays representative; every pool created and every
+ * allocation made is counted, for reporting allocations per operation.
+ * Trace logging is disabled unless a trace level is set, in which case the
+ * messages are formatted (as proftpd would) and then discarded.
+ */
+
+#include "bench.h"
+#include "db.h"
+
+#include <stdarg.h>
+
+#define BENCH_POOL_BLOCK_SZ		1024
+
+struct pool_block {
+  struct pool_block *next;
+  size_t used, size;
+  /* Aligned block data follows. */
+};
+
+struct pool_rec {
+  struct pool_rec *parent;
+  struct pool_rec *sub_pools;
+  struct pool_rec *next_sibling;
+  struct pool_block *blocks;
+};
+
+unsigned long bench_alloc_count = 0;
+unsigned long bench_pool_count = 0;
+int bench_trace_level = -1;
+
+/* Not used by the codecs directly, but referenced by stacktrace.c. */
+int snmp_logfd = -1;
+
+#define BENCH_ALIGN(sz)		(((sz) + 15) & ~((size_t) 15))
+#define BENCH_BLOCK_HDR_SZ	BENCH_ALIGN(sizeof(struct pool_block))
+
+static struct pool_block *new_block(size_t minsz) {
+  struct pool_block *blk;
+  size_t sz;
+
+  sz = minsz > BENCH_POOL_BLOCK_SZ ? minsz : BENCH_POOL_BLOCK_SZ;
+
+  blk = malloc(BENCH_BLOCK_HDR_SZ + sz);
+  if (blk == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+
+  blk->next = NULL;
+  blk->used = 0;
+  blk->size = sz;
+  return blk;
+}
+
+pool *pr_pool_create_sz(pool *p, size_t sz) {
+  pool *sub_pool;
+
+  sub_pool = malloc(sizeof(struct pool_rec));
+  if (sub_pool == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+
+  sub_pool->parent = p;
+  sub_pool->sub_pools = NULL;
+  sub_pool->blocks = new_block(sz);
+
+  if (p != NULL) {
+    sub_pool->next_sibling = p->sub_pools;
+    p->sub_pools = sub_pool;
+
+  } else {
+    sub_pool->next_sibling = NULL;
+  }
+
+  bench_pool_count++;
+  return sub_pool;
+}
+
+pool *make_sub_pool(pool *p) {
+  return pr_pool_create_sz(p, BENCH_POOL_BLOCK_SZ);
+}
+
+void pr_pool_tag(pool *p, const char *tag) {
+  (void) p;
+  (void) tag;
+}
+
+void destroy_pool(pool *p) {
+  struct pool_block *blk;
+
+  if (p == NULL) {
+    return;
+  }
+
+  while (p->sub_pools != NULL) {
+    destroy_pool(p->sub_pools);
+  }
+
+  /* Unlink this pool from its parent's list of sub-pools. */
+  if (p->parent != NULL) {
+    pool **link;
+
+    for (link = &(p->parent->sub_pools); *link != NULL;
+         link = &((*link)->next_sibling)) {
+      if (*link == p) {
+        *link = p->next_sibling;
+        break;
+      }
+    }
+  }
+
+  blk = p->blocks;
+  while (blk != NULL) {
+    struct pool_block *next;
+
+    next = blk->next;
+    free(blk);
+    blk = next;
+  }
+
+  free(p);
+}
+
+void *palloc(pool *p, size_t sz) {
+  struct pool_block *blk;
+  void *ptr;
+
+  sz = BENCH_ALIGN(sz > 0 ? sz : 1);
+
+  blk = p->blocks;
+  if (blk->size - blk->used < sz) {
+    blk = new_block(sz);
+    blk->next = p->blocks;
+    p->blocks = blk;
+  }
+
+  ptr = ((char *) blk) + BENCH_BLOCK_HDR_SZ + blk->used;
+  blk->used += sz;
+
+  bench_alloc_count++;
+  return ptr;
+}
+
+void *pcalloc(pool *p, size_t sz) {
+  void *ptr;
+
+  ptr = palloc(p, sz);
+  memset(ptr, 0, sz);
+  return ptr;
+}
+
+char *pstrndup(pool *p, const char *str, size_t len) {
+  char *res;
+  size_t n;
+
+  n = strnlen(str, len);
+  res = palloc(p, n + 1);
+  memcpy(res, str, n);
+  res[n] = '\0';
+  return res;
+}
+
+char *pstrdup(pool *p, const char *str) {
+  return pstrndup(p, str, strlen(str));
+}
+
+char *pstrcat(pool *p, ...) {
+  va_list ap;
+  char *res, *ptr, *str;
+  size_t len = 0;
+
+  va_start(ap, p);
+  while ((str = va_arg(ap, char *)) != NULL) {
+    len += strlen(str);
+  }
+  va_end(ap);
+
+  res = ptr = palloc(p, len + 1);
+
+  va_start(ap, p);
+  while ((str = va_arg(ap, char *)) != NULL) {
+    size_t n;
+
+    n = strlen(str);
+    memcpy(ptr, str, n);
+    ptr += n;
+  }
+  va_end(ap);
+
+  *ptr = '\0';
+  return res;
+}
+
+array_header *make_array(pool *p, unsigned int nelts, size_t elt_size) {
+  array_header *arr;
+
+  if (nelts < 1) {
+    nelts = 1;
+  }
+
+  arr = palloc(p, sizeof(array_header));
+  arr->pool = p;
+  arr->elt_size = (int) elt_size;
+  arr->nelts = 0;
+  arr->nalloc = (int) nelts;
+  arr->elts = pcalloc(p, nelts * elt_size);
+
+  return arr;
+}
+
+void *push_array(array_header *arr) {
+  if (arr->nelts == arr->nalloc) {
+    void *elts;
+
+    elts = pcalloc(arr->pool, arr->nalloc * 2 * arr->elt_size);
+    memcpy(elts, arr->elts, arr->nalloc * arr->elt_size);
+    arr->elts = elts;
+    arr->nalloc *= 2;
+  }
+
+  return ((char *) arr->elts) + (arr->elt_size * arr->nelts++);
+}
+
+int pr_log_writefile(int fd, const char *name, const char *fmt, ...) {
+  (void) fd;
+  (void) name;
+  (void) fmt;
+  return 0;
+}
+
+int pr_trace_get_level(const char *channel) {
+  (void) channel;
+  return bench_trace_level;
+}
+
+int pr_trace_msg(const char *channel, int level, const char *fmt, ...) {
+  char buf[1024];
+  va_list ap;
+
+  (void) channel;
+
+  if (level > bench_trace_level) {
+    return 0;
+  }
+
+  va_start(ap, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+
+  return 0;
+}
+
+void pr_signals_handle(void) {
+}
+
+/* The codecs call into the database (for error counters) and the MIB (for
+ * trace logging of OID names); neither is needed for benchmarking.
+ */
+
+int snmp_db_incr_value(pool *p, unsigned int field, int32_t incr) {
+  (void) p;
+  (void) field;
+  (void) incr;
+  return 0;
+}
+
+struct snmp_mib *snmp_mib_get_by_oid(oid_t *mib_oid, unsigned int mib_oidlen,
+    int *lacks_instance_id) {
+  (void) mib_oid;
+  (void) mib_oidlen;
+
+  if (lacks_instance_id != NULL) {
+    *lacks_instance_id = FALSE;
+  }
+
+  errno = ENOENT;
+  return NULL;
+}
@@ -0,0 +1,91 @@
+/*
+ * ProFTPD - mod_snmp benchmark utilities
+ * Copyright (c) 2008-2011 TJ Saunders
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, TJ Saunders and other respective copyright holders
+ * give permission to link this program with OpenSSL, and distribute the
+ * resulting executable, without including the source code for OpenSSL in the
+ * source distribution.
+ *
+ * $Id$
+ */
+
+/* Helpers shared by the benchmark programs. */
+
+#include "bench.h"
+#include "msg.h"
+
+double bench_now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((double) ts.tv_sec * 1000000000.0) + (double) ts.tv_nsec;
+}
+
+/* Returns a pointer to the PDU header of an encoded message, which
+ * immediately follows the community string.
+ */
+static unsigned char *bench_get_pdu(unsigned char *buf, size_t buflen) {
+  unsigned char *community = NULL, pdu_type = 0;
+  unsigned int community_len = 0;
+  long snmp_version = 0, request_id = 0;
+
+  if (snmp_msg_peek(buf, buflen, &snmp_version, &community, &community_len,
+      &pdu_type, &request_id) < 0) {
+    return NULL;
+  }
+
+  return community + community_len;
+}
+
+int bench_set_pdu_type(unsigned char *buf, size_t buflen,
+    unsigned char pdu_type) {
+  unsigned char *pdu;
+
+  pdu = bench_get_pdu(buf, buflen);
+  if (pdu == NULL) {
+    return -1;
+  }
+
+  *pdu = pdu_type;
+  return 0;
+}
+
+int bench_get_request_id_offset(unsigned char *buf, size_t buflen,
+    size_t *offset, unsigned int *len) {
+  unsigned char *pdu, *ptr;
+
+  pdu = bench_get_pdu(buf, buflen);
+  if (pdu == NULL) {
+    return -1;
+  }
+
+  /* Skip the PDU type and length; snmp_msg_peek() has already validated
+   * them.
+   */
+  ptr = pdu + 1;
+  if (*ptr & SNMP_ASN1_LEN_LONG) {
+    ptr += (*ptr & ~SNMP_ASN1_LEN_LONG);
+  }
+  ptr++;
+
+  /* The request ID INTEGER: type, (short) length, value. */
+  ptr++;
+  *len = *ptr++;
+  *offset = ptr - buf;
+  return 0;
+}
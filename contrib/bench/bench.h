@@ -0,0 +1,58 @@
+/*
+ * ProFTPD - mod_snmp codec benchmark
+ * Copyright (c) 2008-2011 TJ Saunders
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, TJ Saunders and other respective copyright holders
+ * give permission to link this program with OpenSSL, and distribute the
+ * resulting executable, without including the source code for OpenSSL in the
+ * source distribution.
+ *
+ * $Id$
+ */
+
+#include "mod_snmp.h"
+#include "asn1.h"
+#include "mib.h"
+
+#ifndef MOD_SNMP_BENCH_H
+#define MOD_SNMP_BENCH_H
+
+/* Counters maintained by the stub pool API, for reporting allocations
+ * per operation.
+ */
+extern unsigned long bench_alloc_count;
+extern unsigned long bench_pool_count;
+
+/* Trace level returned by the stub pr_trace_get_level(); -1 (the default)
+ * disables trace logging.
+ */
+extern int bench_trace_level;
+
+/* Returns a monotonic timestamp, in nanoseconds. */
+double bench_now_ns(void);
+
+/* Rewrites the PDU type of an encoded message. */
+int bench_set_pdu_type(unsigned char *buf, size_t buflen,
+  unsigned char pdu_type);
+
+/* Finds the offset and length, in bytes, of the request ID value in an
+ * encoded message.
+ */
+int bench_get_request_id_offset(unsigned char *buf, size_t buflen,
+  size_t *offset, unsigned int *len);
+
+#endif
@@ -0,0 +1,384 @@
+/*
+ * ProFTPD - mod_snmp codec benchmark
+ * Copyright (c) 2008-2011 TJ Saunders
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, TJ Saunders and other respective copyright holders
+ * give permission to link this program with OpenSSL, and distribute the
+ * resulting executable, without including the source code for OpenSSL in the
+ * source distribution.
+ *
+ * $Id$
+ */
+
+/* Microbenchmark for the mod_snmp message codecs.
+ *
+ * Times the encoding and decoding of representative GetRequest,
+ * GetNextRequest, GetBulkRequest, Response, and SNMPv2-Trap messages, for
+ * a range of variable binding counts, and reports the time and the number
+ * of pool allocations per operation.  Each operation uses its own pool, as
+ * the agent does for each packet.
+ */
+
+#include "bench.h"
+#include "asn1.h"
+#include "smi.h"
+#include "mib.h"
+#include "pdu.h"
+#include "msg.h"
+#include "packet.h"
+
+#define BENCH_DEFAULT_ITERS		20000
+#define BENCH_MAX_VARS			128
+
+static const char *bench_community = "public";
+
+struct bench_msg {
+  const char *name;
+
+  /* The PDU type with which the message is encoded. */
+  unsigned char pdu_type;
+
+  /* The request readers reject Response and Trap PDUs; those messages are
+   * decoded as SetRequests instead, which have the same layout.
+   */
+  unsigned char decode_type;
+
+  /* Whether the variable bindings carry values, or are NULL (requests). */
+  int with_values;
+
+  /* Whether the message is encoded from struct snmp_binding, as the agent
+   * does for its responses, rather than from struct snmp_var.
+   */
+  int with_bindings;
+};
+
+static struct bench_msg bench_msgs[] = {
+  { "get",	SNMP_PDU_GET,		SNMP_PDU_GET,		FALSE, FALSE },
+  { "getnext",	SNMP_PDU_GETNEXT,	SNMP_PDU_GETNEXT,	FALSE, FALSE },
+  { "getbulk",	SNMP_PDU_GETBULK,	SNMP_PDU_GETBULK,	FALSE, FALSE },
+  { "response",	SNMP_PDU_RESPONSE,	SNMP_PDU_SET,		TRUE, FALSE },
+  { "resp-bind", SNMP_PDU_RESPONSE,	SNMP_PDU_SET,		TRUE, TRUE },
+  { "trap",	SNMP_PDU_TRAP_V2,	SNMP_PDU_SET,		TRUE, FALSE },
+  { NULL, 0, 0, FALSE, FALSE }
+};
+
+/* PROFTPD-MIB::ftp.sessions.* (and friends) */
+static oid_t bench_base_oid[] = { 1, 3, 6, 1, 4, 1, 17852, 2, 2, 3, 1, 1, 0 };
+#define BENCH_BASE_OIDLEN \
+  (sizeof(bench_base_oid) / sizeof(oid_t))
+
+/* SNMPv2-MIB::sysUpTime.0 and SNMPv2-MIB::snmpTrapOID.0 */
+static oid_t bench_uptime_oid[] = { 1, 3, 6, 1, 2, 1, 1, 3, 0 };
+static oid_t bench_trap_oid[] = { 1, 3, 6, 1, 6, 3, 1, 1, 4, 1, 0 };
+static oid_t bench_trap_value[] = { 1, 3, 6, 1, 4, 1, 17852, 2, 2, 1, 100 };
+
+static struct snmp_var *bench_create_var(pool *p, struct bench_msg *msg,
+    unsigned int idx) {
+  oid_t name[BENCH_BASE_OIDLEN];
+
+  memcpy(name, bench_base_oid, sizeof(bench_base_oid));
+  name[BENCH_BASE_OIDLEN - 3] = 1 + (idx / 10);
+  name[BENCH_BASE_OIDLEN - 2] = 1 + (idx % 10);
+
+  if (msg->with_values == FALSE) {
+    struct snmp_var *var;
+
+    var = snmp_smi_alloc_var(p, name, BENCH_BASE_OIDLEN);
+    var->smi_type = SNMP_SMI_NULL;
+    return var;
+  }
+
+  /* Traps start with sysUpTime.0 and snmpTrapOID.0, per RFC 3416. */
+  if (msg->pdu_type == SNMP_PDU_TRAP_V2) {
+    if (idx == 0) {
+      return snmp_smi_create_int(p, bench_uptime_oid,
+        sizeof(bench_uptime_oid) / sizeof(oid_t), SNMP_SMI_TIMETICKS,
+        8675309);
+    }
+
+    if (idx == 1) {
+      return snmp_smi_create_oid(p, bench_trap_oid,
+        sizeof(bench_trap_oid) / sizeof(oid_t), SNMP_SMI_OID,
+        bench_trap_value, sizeof(bench_trap_value) / sizeof(oid_t));
+    }
+  }
+
+  /* A mix of the value types which the proftpd MIB uses.  Gauge32 stands in
+   * for Counter32 (which encodes the same way), since the request reader
+   * does not accept Counter32 values.
+   */
+  switch (idx % 3) {
+    case 0:
+      return snmp_smi_create_int(p, name, BENCH_BASE_OIDLEN, SNMP_SMI_GAUGE32,
+        (int32_t) (idx * 104729));
+
+    case 1:
+      return snmp_smi_create_int(p, name, BENCH_BASE_OIDLEN, SNMP_SMI_INTEGER,
+        (int32_t) idx);
+
+    default:
+      return snmp_smi_create_string(p, name, BENCH_BASE_OIDLEN, SNMP_SMI_STRING,
+        "ftp.example.com", 15);
+  }
+}
+
+static struct snmp_pdu *bench_create_pdu(pool *p, struct bench_msg *msg,
+    unsigned int nvars) {
+  struct snmp_pdu *pdu;
+  unsigned int i;
+
+  /* GetBulkRequests share the GetRequest layout, with non-repeaters and
+   * max-repetitions in place of error-status and error-index; the PDU writer
+   * does not write the variable bindings of GetBulkRequests, so the message
+   * is encoded as a GetRequest, and its PDU type rewritten afterward.
+   */
+  if (msg->pdu_type == SNMP_PDU_GETBULK) {
+    pdu = snmp_pdu_create(p, SNMP_PDU_GET);
+    pdu->err_code = 0;
+    pdu->err_idx = 10;
+
+  } else {
+    pdu = snmp_pdu_create(p, msg->pdu_type);
+  }
+
+  pdu->request_id = 1103515245;
+  pdu->varlist = snmp_smi_alloc_varlist(p, nvars);
+
+  for (i = 0; i < nvars; i++) {
+    struct snmp_var *var;
+
+    var = bench_create_var(p, msg, i);
+    snmp_smi_util_add_list_var(pdu->varlist, var);
+  }
+
+  if (msg->with_bindings) {
+    struct snmp_var *vars;
+
+    /* Bind the same names and values, as the agent would from its MIB. */
+    pdu->bindings = make_array(p, nvars, sizeof(struct snmp_binding));
+    vars = pdu->varlist->elts;
+
+    for (i = 0; i < nvars; i++) {
+      struct snmp_binding *binding;
+
+      unsigned char *enc_name, *buf;
+      size_t buflen;
+
+      binding = push_array(pdu->bindings);
+      memset(binding, 0, sizeof(struct snmp_binding));
+      binding->name = vars[i].name;
+      binding->namelen = vars[i].namelen;
+      binding->smi_type = vars[i].smi_type;
+
+      /* The agent's MIB objects have their OIDs encoded in advance. */
+      buflen = SNMP_MIB_MAX_OID_ENCLEN;
+      enc_name = palloc(p, buflen);
+      buf = enc_name + buflen;
+
+      if (snmp_asn1_prepend_oid(p, &buf, &buflen,
+          (SNMP_ASN1_CLASS_UNIVERSAL|SNMP_ASN1_PRIMITIVE|SNMP_ASN1_TYPE_OID),
+          vars[i].name, vars[i].namelen) == 0) {
+        binding->enc_name = buf;
+        binding->enc_namelen = SNMP_MIB_MAX_OID_ENCLEN - buflen;
+      }
+
+      if (vars[i].smi_type == SNMP_SMI_STRING) {
+        binding->str_value = vars[i].value.string;
+        binding->str_valuelen = vars[i].valuelen;
+
+      } else {
+        binding->int_value = (int32_t) vars[i].value.integer;
+      }
+    }
+  }
+
+  return pdu;
+}
+
+static void bench_report(const char *name, const char *op, unsigned int nvars,
+    size_t msglen, unsigned long iters, double elapsed_ns,
+    unsigned long allocs, unsigned long pools) {
+  printf("%-10s %-7s %5u %6lu %11.1f %10.1f %9.1f\n", name, op, nvars,
+    (unsigned long) msglen, elapsed_ns / iters, (double) allocs / iters,
+    (double) pools / iters);
+}
+
+static int bench_msg(struct bench_msg *msg, unsigned int nvars,
+    unsigned long iters) {
+  pool *msg_pool, *tmp_pool;
+  struct snmp_pdu *pdu;
+  unsigned char pkt[SNMP_PACKET_MAX_LEN], *buf;
+  unsigned char wire[SNMP_PACKET_MAX_LEN];
+  size_t buflen, msglen;
+  unsigned long i, allocs, pools;
+  double start_ns;
+
+  msg_pool = make_sub_pool(NULL);
+  pdu = bench_create_pdu(msg_pool, msg, nvars);
+
+  /* Encode */
+  allocs = bench_alloc_count;
+  pools = bench_pool_count;
+  msglen = 0;
+
+  start_ns = bench_now_ns();
+  for (i = 0; i < iters; i++) {
+    tmp_pool = make_sub_pool(NULL);
+
+    buf = pkt;
+    buflen = sizeof(pkt);
+    if (snmp_msg_write(tmp_pool, &buf, &buflen, (char *) bench_community,
+        strlen(bench_community), SNMP_PROTOCOL_VERSION_2, pdu) < 0) {
+      fprintf(stderr, "%s: error encoding %u variables: %s\n", msg->name,
+        nvars, strerror(errno));
+      destroy_pool(tmp_pool);
+      destroy_pool(msg_pool);
+      return -1;
+    }
+
+    destroy_pool(tmp_pool);
+  }
+
+  bench_report(msg->name, "encode", nvars, buflen, iters,
+    bench_now_ns() - start_ns, bench_alloc_count - allocs,
+    bench_pool_count - pools);
+
+  /* Keep a copy of the encoded message, for decoding. */
+  msglen = buflen;
+  memcpy(wire, buf, msglen);
+  destroy_pool(msg_pool);
+
+  if (msg->decode_type != msg->pdu_type ||
+      msg->pdu_type == SNMP_PDU_GETBULK) {
+    if (bench_set_pdu_type(wire, msglen, msg->decode_type) < 0) {
+      fprintf(stderr, "%s: error rewriting PDU type: %s\n", msg->name,
+        strerror(errno));
+      return -1;
+    }
+  }
+
+  /* Decode */
+  allocs = bench_alloc_count;
+  pools = bench_pool_count;
+
+  start_ns = bench_now_ns();
+  for (i = 0; i < iters; i++) {
+    char *community = NULL;
+    unsigned int community_len = 0;
+    long snmp_version = 0;
+    struct snmp_pdu *req_pdu = NULL;
+
+    tmp_pool = make_sub_pool(NULL);
+
+    buf = wire;
+    buflen = msglen;
+    if (snmp_msg_read(tmp_pool, &buf, &buflen, &community, &community_len,
+        &snmp_version, &req_pdu) < 0) {
+      fprintf(stderr, "%s: error decoding %u variables: %s\n", msg->name,
+        nvars, strerror(errno));
+      destroy_pool(tmp_pool);
+      return -1;
+    }
+
+    destroy_pool(tmp_pool);
+  }
+
+  bench_report(msg->name, "decode", nvars, msglen, iters,
+    bench_now_ns() - start_ns, bench_alloc_count - allocs,
+    bench_pool_count - pools);
+
+  return 0;
+}
+
+static void usage(const char *progname) {
+  fprintf(stderr, "usage: %s [-n iterations] [-t trace-level] "
+    "[-v varcount[,varcount...]]\n", progname);
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  unsigned int varcounts[32] = { 1, 10, 50 }, nvarcounts = 3, i;
+  unsigned long iters = BENCH_DEFAULT_ITERS;
+  int c, res = 0;
+
+  while ((c = getopt(argc, argv, "n:t:v:")) != -1) {
+    switch (c) {
+      case 'n':
+        iters = strtoul(optarg, NULL, 10);
+        if (iters == 0) {
+          usage(argv[0]);
+        }
+        break;
+
+      case 't':
+        bench_trace_level = atoi(optarg);
+        break;
+
+      case 'v': {
+        char *ptr, *next;
+
+        nvarcounts = 0;
+        for (ptr = optarg; *ptr != '\0' && nvarcounts < 32; ptr = next) {
+          unsigned long nvars;
+
+          nvars = strtoul(ptr, &next, 10);
+          if (next == ptr ||
+              nvars == 0 ||
+              nvars > BENCH_MAX_VARS) {
+            usage(argv[0]);
+          }
+
+          varcounts[nvarcounts++] = (unsigned int) nvars;
+          if (*next == ',') {
+            next++;
+          }
+        }
+        break;
+      }
+
+      default:
+        usage(argv[0]);
+    }
+  }
+
+  printf("%lu iterations per test, trace level %d\n\n", iters,
+    bench_trace_level);
+  printf("%-10s %-7s %5s %6s %11s %10s %9s\n", "message", "op", "vars",
+    "bytes", "ns/op", "allocs/op", "pools/op");
+
+  for (i = 0; bench_msgs[i].name != NULL; i++) {
+    unsigned int j;
+
+    for (j = 0; j < nvarcounts; j++) {
+      unsigned int nvars;
+
+      nvars = varcounts[j];
+
+      /* A trap always carries sysUpTime.0 and snmpTrapOID.0. */
+      if (bench_msgs[i].pdu_type == SNMP_PDU_TRAP_V2 &&
+          nvars < 2) {
+        nvars = 2;
+      }
+
+      if (bench_msg(&(bench_msgs[i]), nvars, iters) < 0) {
+        res = 1;
+      }
+    }
+  }
+
+  return res;
+}
@@ -0,0 +1,99 @@
+/*
+ * ProFTPD - mod_snmp codec benchmark
+ * Copyright (c) 2008-2011 TJ Saunders
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, TJ Saunders and other respective copyright holders
+ * give permission to link this program with OpenSSL, and distribute the
+ * resulting executable, without including the source code for OpenSSL in the
+ * source distribution.
+ *
+ * $Id$
+ */
+
+/* The minimal subset of the proftpd API used by the mod_snmp codecs (asn1.c,
+ * smi.c, pdu.c, msg.c), so that they can be built and benchmarked outside of
+ * proftpd.  The implementations live in bench-stub.c.
+ */
+
+#ifndef MOD_SNMP_BENCH_CONF_H
+#define MOD_SNMP_BENCH_CONF_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#define PROFTPD_VERSION_NUMBER		0x0001030501
+#define PR_TUNABLE_CALLER_DEPTH		32
+#define PR_USE_TRACE			1
+
+#ifndef TRUE
+# define TRUE				1
+#endif
+
+#ifndef FALSE
+# define FALSE				0
+#endif
+
+typedef struct pool_rec pool;
+
+typedef struct {
+  pool *pool;
+  int elt_size;
+  int nelts;
+  int nalloc;
+  void *elts;
+} array_header;
+
+typedef struct pr_netaddr_t {
+  int na_family;
+  struct sockaddr_storage na_addr;
+} pr_netaddr_t;
+
+typedef struct pr_class_t {
+  char *cls_name;
+} pr_class_t;
+
+/* Pools */
+pool *make_sub_pool(pool *p);
+pool *pr_pool_create_sz(pool *p, size_t sz);
+void pr_pool_tag(pool *p, const char *tag);
+void destroy_pool(pool *p);
+void *palloc(pool *p, size_t sz);
+void *pcalloc(pool *p, size_t sz);
+char *pstrdup(pool *p, const char *str);
+char *pstrndup(pool *p, const char *str, size_t len);
+char *pstrcat(pool *p, ...);
+
+array_header *make_array(pool *p, unsigned int nelts, size_t elt_size);
+void *push_array(array_header *arr);
+
+/* Logging */
+int pr_log_writefile(int fd, const char *name, const char *fmt, ...);
+int pr_trace_get_level(const char *channel);
+int pr_trace_msg(const char *channel, int level, const char *fmt, ...);
+
+void pr_signals_handle(void);
+
+#endif
@@ -0,0 +1,810 @@
+/*
+ * ProFTPD - mod_snmp agent replay benchmark
+ * Copyright (c) 2008-2011 TJ Saunders
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, TJ Saunders and other respective copyright holders
+ * give permission to link this program with OpenSSL, and distribute the
+ * resulting executable, without including the source code for OpenSSL in the
+ * source distribution.
+ *
+ * $Id$
+ */
+
+/* Load benchmark for a running mod_snmp agent.
+ *
+ * Replays a corpus of SNMPv1/SNMPv2c request datagrams (GetRequests,
+ * GetNextRequest walks, GetBulkRequests of varying max-repetitions, and
+ * requests with a bad community) over UDP at a controlled rate, and reports
+ * the throughput, latency percentiles, and the requests left unanswered.
+ *
+ * The request ID of every datagram is rewritten before it is sent, so that
+ * each response can be matched to its request (and so that the agent's
+ * response cache is not hit, unless -k is used).
+ */
+
+#include "bench.h"
+#include "smi.h"
+#include "pdu.h"
+#include "msg.h"
+#include "packet.h"
+
+#include <poll.h>
+#include <fcntl.h>
+#include <netdb.h>
+
+#define REPLAY_DEFAULT_ADDR		"127.0.0.1"
+#define REPLAY_DEFAULT_PORT		"1161"
+#define REPLAY_DEFAULT_COMMUNITY	"public"
+#define REPLAY_DEFAULT_RATE		1000
+#define REPLAY_DEFAULT_DURATION		10
+#define REPLAY_DEFAULT_TIMEOUT_MS	1000
+#define REPLAY_DEFAULT_WINDOW		256
+
+/* The maximum number of outstanding requests; must be a power of 2. */
+#define REPLAY_MAX_PENDING		65536
+
+/* Rewritten request IDs are this base plus the sequence number of the
+ * request, which keeps them at 4 bytes, and positive.
+ */
+#define REPLAY_REQUEST_ID_BASE		0x10000000UL
+#define REPLAY_REQUEST_ID_MASK		0x0fffffffUL
+
+#define REPLAY_MAX_CORPUS		256
+
+struct replay_entry {
+  char label[32];
+
+  unsigned char *data;
+  size_t datalen;
+
+  /* The offset of the 4-byte request ID value within the datagram. */
+  size_t request_id_offset;
+
+  /* Requests with a bad community are not expected to be answered. */
+  int expect_response;
+
+  unsigned long sent;
+  unsigned long answered;
+  unsigned long unanswered;
+  double total_latency_ns;
+};
+
+struct replay_pending {
+  unsigned long seq;
+  double sent_ns;
+  struct replay_entry *entry;
+  int active;
+};
+
+static struct replay_entry replay_corpus[REPLAY_MAX_CORPUS];
+static unsigned int replay_ncorpus = 0;
+
+static struct replay_pending replay_pending[REPLAY_MAX_PENDING];
+
+/* The number of outstanding requests which are expected to be answered;
+ * requests which the agent should drop do not count against the window.
+ */
+static unsigned long replay_npending = 0;
+
+/* Latencies, in nanoseconds, of the answered requests. */
+static double *replay_latencies = NULL;
+static unsigned long replay_nlatencies = 0, replay_latencies_size = 0;
+
+static int replay_add_entry(const char *label, unsigned char *data,
+    size_t datalen, int expect_response) {
+  struct replay_entry *entry;
+  size_t offset = 0;
+  unsigned int len = 0;
+
+  if (replay_ncorpus == REPLAY_MAX_CORPUS) {
+    fprintf(stderr, "too many corpus entries (max %u)\n", REPLAY_MAX_CORPUS);
+    return -1;
+  }
+
+  if (bench_get_request_id_offset(data, datalen, &offset, &len) < 0) {
+    fprintf(stderr, "%s: unable to parse datagram\n", label);
+    return -1;
+  }
+
+  if (len != 4) {
+    fprintf(stderr, "%s: request ID is %u bytes, 4 bytes required\n", label,
+      len);
+    return -1;
+  }
+
+  entry = &(replay_corpus[replay_ncorpus++]);
+  memset(entry, 0, sizeof(struct replay_entry));
+  snprintf(entry->label, sizeof(entry->label), "%s", label);
+  entry->data = malloc(datalen);
+  memcpy(entry->data, data, datalen);
+  entry->datalen = datalen;
+  entry->request_id_offset = offset;
+  entry->expect_response = expect_response;
+
+  return 0;
+}
+
+static int replay_add_request(pool *p, const char *label, long snmp_version,
+    const char *community, unsigned char pdu_type, oid_t **names,
+    unsigned int *namelens, unsigned int nnames, long non_repeaters,
+    long max_repetitions, int expect_response) {
+  struct snmp_pdu *pdu;
+  unsigned char pkt[SNMP_PACKET_MAX_LEN], *buf;
+  size_t buflen;
+  unsigned int i;
+
+  /* The PDU writer does not write the variable bindings of GetBulkRequests,
+   * so these are written as GetRequests (which have the same layout), and
+   * the PDU type rewritten afterward.
+   */
+  if (pdu_type == SNMP_PDU_GETBULK) {
+    pdu = snmp_pdu_create(p, SNMP_PDU_GET);
+    pdu->err_code = non_repeaters;
+    pdu->err_idx = max_repetitions;
+
+  } else {
+    pdu = snmp_pdu_create(p, pdu_type);
+  }
+
+  pdu->request_id = REPLAY_REQUEST_ID_BASE;
+  pdu->varlist = snmp_smi_alloc_varlist(p, nnames);
+
+  for (i = 0; i < nnames; i++) {
+    struct snmp_var *var;
+
+    var = snmp_smi_alloc_var(p, names[i], namelens[i]);
+    var->smi_type = SNMP_SMI_NULL;
+    snmp_smi_util_add_list_var(pdu->varlist, var);
+  }
+
+  buf = pkt;
+  buflen = sizeof(pkt);
+  if (snmp_msg_write(p, &buf, &buflen, (char *) community, strlen(community),
+      snmp_version, pdu) < 0) {
+    fprintf(stderr, "%s: error encoding request: %s\n", label,
+      strerror(errno));
+    return -1;
+  }
+
+  if (pdu_type == SNMP_PDU_GETBULK &&
+      bench_set_pdu_type(buf, buflen, pdu_type) < 0) {
+    return -1;
+  }
+
+  return replay_add_entry(label, buf, buflen, expect_response);
+}
+
+/* The built-in corpus. */
+
+static oid_t replay_software_oid[] = { SNMP_MIB_DAEMON_OID_SOFTWARE, 0 };
+static oid_t replay_version_oid[] = { SNMP_MIB_DAEMON_OID_VERSION, 0 };
+static oid_t replay_admin_oid[] = { SNMP_MIB_DAEMON_OID_ADMIN, 0 };
+static oid_t replay_uptime_oid[] = { SNMP_MIB_DAEMON_OID_UPTIME, 0 };
+static oid_t replay_conn_count_oid[] = { SNMP_MIB_DAEMON_OID_CONN_COUNT, 0 };
+static oid_t replay_conn_total_oid[] = { SNMP_MIB_DAEMON_OID_CONN_TOTAL, 0 };
+static oid_t replay_logins_oid[] = { SNMP_MIB_FTP_LOGINS_OID_TOTAL, 0 };
+static oid_t replay_logins_err_oid[] = { SNMP_MIB_FTP_LOGINS_OID_ERR_TOTAL, 0 };
+static oid_t replay_sess_count_oid[] = { SNMP_MIB_FTP_SESS_OID_SESS_COUNT, 0 };
+static oid_t replay_sess_total_oid[] = { SNMP_MIB_FTP_SESS_OID_SESS_TOTAL, 0 };
+static oid_t replay_pkts_recvd_oid[] = { SNMP_MIB_SNMP_OID_PKTS_RECVD_TOTAL, 0 };
+static oid_t replay_pkts_sent_oid[] = { SNMP_MIB_SNMP_OID_PKTS_SENT_TOTAL, 0 };
+static oid_t replay_snmp_oid[] = { SNMP_OID_BASE };
+static oid_t replay_daemon_oid[] = { SNMP_DAEMON_OID_BASE };
+
+#define REPLAY_OIDLEN(oid)	(sizeof(oid) / sizeof(oid_t))
+
+static int replay_build_corpus(const char *community) {
+  pool *tmp_pool;
+  char bad_community[256];
+  oid_t *get_names[] = {
+    replay_software_oid, replay_version_oid, replay_admin_oid,
+    replay_uptime_oid, replay_conn_count_oid, replay_conn_total_oid,
+    replay_logins_oid, replay_logins_err_oid, replay_sess_count_oid,
+    replay_sess_total_oid, replay_pkts_recvd_oid, replay_pkts_sent_oid
+  };
+  unsigned int get_namelens[] = {
+    REPLAY_OIDLEN(replay_software_oid), REPLAY_OIDLEN(replay_version_oid),
+    REPLAY_OIDLEN(replay_admin_oid), REPLAY_OIDLEN(replay_uptime_oid),
+    REPLAY_OIDLEN(replay_conn_count_oid), REPLAY_OIDLEN(replay_conn_total_oid),
+    REPLAY_OIDLEN(replay_logins_oid), REPLAY_OIDLEN(replay_logins_err_oid),
+    REPLAY_OIDLEN(replay_sess_count_oid), REPLAY_OIDLEN(replay_sess_total_oid),
+    REPLAY_OIDLEN(replay_pkts_recvd_oid), REPLAY_OIDLEN(replay_pkts_sent_oid)
+  };
+  unsigned int nnames = sizeof(get_names) / sizeof(oid_t *), i;
+  long max_repetitions[] = { 5, 10, 25, 50 };
+  oid_t *walk_name;
+  unsigned int walk_namelen;
+  int res = 0;
+
+  snprintf(bad_community, sizeof(bad_community), "%s-bad", community);
+  tmp_pool = make_sub_pool(NULL);
+
+  /* Single-variable and multi-variable GetRequests. */
+  res |= replay_add_request(tmp_pool, "v1-get", SNMP_PROTOCOL_VERSION_1,
+    community, SNMP_PDU_GET, get_names, get_namelens, 1, 0, 0, TRUE);
+  res |= replay_add_request(tmp_pool, "v2c-get", SNMP_PROTOCOL_VERSION_2,
+    community, SNMP_PDU_GET, get_names, get_namelens, 1, 0, 0, TRUE);
+  res |= replay_add_request(tmp_pool, "v2c-get-multi", SNMP_PROTOCOL_VERSION_2,
+    community, SNMP_PDU_GET, get_names, get_namelens, nnames, 0, 0, TRUE);
+
+  /* A walk of the daemon group, one GetNextRequest per step, as a manager
+   * would issue them.
+   */
+  walk_name = replay_snmp_oid;
+  walk_namelen = REPLAY_OIDLEN(replay_snmp_oid);
+  for (i = 0; i <= 6; i++) {
+    res |= replay_add_request(tmp_pool, "v2c-getnext-walk",
+      SNMP_PROTOCOL_VERSION_2, community, SNMP_PDU_GETNEXT, &walk_name,
+      &walk_namelen, 1, 0, 0, TRUE);
+
+    walk_name = get_names[i];
+    walk_namelen = get_namelens[i];
+  }
+
+  res |= replay_add_request(tmp_pool, "v1-getnext", SNMP_PROTOCOL_VERSION_1,
+    community, SNMP_PDU_GETNEXT, &walk_name, &walk_namelen, 1, 0, 0, TRUE);
+
+  /* GetBulkRequests of the daemon group. */
+  walk_name = replay_daemon_oid;
+  walk_namelen = REPLAY_OIDLEN(replay_daemon_oid);
+  for (i = 0; i < sizeof(max_repetitions) / sizeof(long); i++) {
+    char label[32];
+
+    snprintf(label, sizeof(label), "v2c-getbulk-%ld", max_repetitions[i]);
+    res |= replay_add_request(tmp_pool, label, SNMP_PROTOCOL_VERSION_2,
+      community, SNMP_PDU_GETBULK, &walk_name, &walk_namelen, 1, 0,
+      max_repetitions[i], TRUE);
+  }
+
+  /* Requests which the agent should silently drop. */
+  res |= replay_add_request(tmp_pool, "v1-bad-community",
+    SNMP_PROTOCOL_VERSION_1, bad_community, SNMP_PDU_GET, get_names,
+    get_namelens, 1, 0, 0, FALSE);
+  res |= replay_add_request(tmp_pool, "v2c-bad-community",
+    SNMP_PROTOCOL_VERSION_2, bad_community, SNMP_PDU_GET, get_names,
+    get_namelens, 1, 0, 0, FALSE);
+
+  destroy_pool(tmp_pool);
+  return res;
+}
+
+/* Corpus files have one datagram per line:
+ *
+ *   label response|none hex-bytes
+ *
+ * Blank lines, and lines starting with '#', are ignored.
+ */
+static int replay_read_corpus(const char *path) {
+  FILE *fh;
+  char line[SNMP_PACKET_MAX_LEN * 2 + 128];
+  unsigned int lineno = 0;
+  int res = 0;
+
+  fh = fopen(path, "r");
+  if (fh == NULL) {
+    fprintf(stderr, "unable to open %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+
+  while (fgets(line, sizeof(line), fh) != NULL) {
+    char label[32], expect[16], *hex;
+    unsigned char data[SNMP_PACKET_MAX_LEN];
+    size_t datalen = 0;
+    int n = 0;
+
+    lineno++;
+
+    if (line[0] == '#' ||
+        line[0] == '\n' ||
+        line[0] == '\0') {
+      continue;
+    }
+
+    if (sscanf(line, "%31s %15s %n", label, expect, &n) != 2 ||
+        n == 0) {
+      fprintf(stderr, "%s:%u: malformed line\n", path, lineno);
+      res = -1;
+      break;
+    }
+
+    for (hex = line + n; hex[0] != '\0' && hex[0] != '\n'; hex += 2) {
+      unsigned int byte;
+
+      if (datalen == sizeof(data) ||
+          sscanf(hex, "%2x", &byte) != 1) {
+        break;
+      }
+
+      data[datalen++] = (unsigned char) byte;
+    }
+
+    if (hex[0] != '\0' && hex[0] != '\n') {
+      fprintf(stderr, "%s:%u: malformed datagram\n", path, lineno);
+      res = -1;
+      break;
+    }
+
+    if (replay_add_entry(label, data, datalen,
+        strcmp(expect, "none") != 0) < 0) {
+      res = -1;
+      break;
+    }
+  }
+
+  fclose(fh);
+  return res;
+}
+
+static void replay_write_corpus(FILE *fh) {
+  unsigned int i;
+
+  fprintf(fh, "# label response|none datagram\n");
+  for (i = 0; i < replay_ncorpus; i++) {
+    struct replay_entry *entry;
+    size_t j;
+
+    entry = &(replay_corpus[i]);
+    fprintf(fh, "%s %s ", entry->label,
+      entry->expect_response ? "response" : "none");
+    for (j = 0; j < entry->datalen; j++) {
+      fprintf(fh, "%02x", entry->data[j]);
+    }
+    fputc('\n', fh);
+  }
+}
+
+static void replay_add_latency(double latency_ns) {
+  if (replay_nlatencies == replay_latencies_size) {
+    replay_latencies_size = replay_latencies_size ?
+      replay_latencies_size * 2 : 65536;
+    replay_latencies = realloc(replay_latencies,
+      replay_latencies_size * sizeof(double));
+    if (replay_latencies == NULL) {
+      fprintf(stderr, "out of memory\n");
+      exit(1);
+    }
+  }
+
+  replay_latencies[replay_nlatencies++] = latency_ns;
+}
+
+static int replay_cmp_latency(const void *a, const void *b) {
+  double x = *((const double *) a), y = *((const double *) b);
+
+  return (x > y) - (x < y);
+}
+
+static double replay_get_percentile(double pct) {
+  unsigned long idx;
+
+  if (replay_nlatencies == 0) {
+    return 0.0;
+  }
+
+  idx = (unsigned long) ((pct / 100.0) * replay_nlatencies);
+  if (idx >= replay_nlatencies) {
+    idx = replay_nlatencies - 1;
+  }
+
+  return replay_latencies[idx];
+}
+
+static int replay_connect(const char *addr, const char *port) {
+  struct addrinfo hints, *ai = NULL;
+  int fd, res, bufsz = 4 * 1024 * 1024;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+
+  res = getaddrinfo(addr, port, &hints, &ai);
+  if (res != 0) {
+    fprintf(stderr, "unable to resolve %s:%s: %s\n", addr, port,
+      gai_strerror(res));
+    return -1;
+  }
+
+  fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+  if (fd < 0) {
+    fprintf(stderr, "unable to create socket: %s\n", strerror(errno));
+    freeaddrinfo(ai);
+    return -1;
+  }
+
+  (void) setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufsz, sizeof(bufsz));
+
+  if (connect(fd, ai->ai_addr, ai->ai_addrlen) < 0) {
+    fprintf(stderr, "unable to connect to %s:%s: %s\n", addr, port,
+      strerror(errno));
+    freeaddrinfo(ai);
+    close(fd);
+    return -1;
+  }
+
+  freeaddrinfo(ai);
+
+  if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0) {
+    fprintf(stderr, "unable to set O_NONBLOCK: %s\n", strerror(errno));
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+struct replay_stats {
+  unsigned long sent;
+  unsigned long send_errors;
+  unsigned long answered;
+  unsigned long unanswered;
+  unsigned long dropped_as_expected;
+  unsigned long unexpected_responses;
+  unsigned long unknown_responses;
+  double last_response_ns;
+};
+
+static void replay_recv(int fd, struct replay_stats *stats) {
+  unsigned char buf[SNMP_PACKET_MAX_LEN];
+
+  while (TRUE) {
+    struct replay_pending *pending;
+    ssize_t len;
+    long request_id = 0;
+    unsigned long seq;
+    double now_ns;
+
+    len = recv(fd, buf, sizeof(buf), 0);
+    if (len < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      /* EAGAIN, or an ICMP error (e.g. ECONNREFUSED) from the agent. */
+      return;
+    }
+
+    now_ns = bench_now_ns();
+
+    if (snmp_msg_peek(buf, (size_t) len, NULL, NULL, NULL, NULL,
+        &request_id) < 0 ||
+        request_id < (long) REPLAY_REQUEST_ID_BASE) {
+      stats->unknown_responses++;
+      continue;
+    }
+
+    seq = (unsigned long) request_id - REPLAY_REQUEST_ID_BASE;
+    pending = &(replay_pending[seq & (REPLAY_MAX_PENDING - 1)]);
+
+    if (pending->active == FALSE ||
+        (pending->seq & REPLAY_REQUEST_ID_MASK) != seq) {
+      /* A late response, to a request already counted as unanswered. */
+      stats->unknown_responses++;
+      continue;
+    }
+
+    pending->active = FALSE;
+
+    if (pending->entry->expect_response == FALSE) {
+      stats->unexpected_responses++;
+      continue;
+    }
+
+    replay_npending--;
+
+    stats->answered++;
+    stats->last_response_ns = now_ns;
+    pending->entry->answered++;
+    pending->entry->total_latency_ns += (now_ns - pending->sent_ns);
+    replay_add_latency(now_ns - pending->sent_ns);
+  }
+}
+
+static void usage(const char *progname) {
+  fprintf(stderr, "usage: %s [options] [address [port]]\n\n"
+    "  -C community  community of the agent (default: %s)\n"
+    "  -d seconds    duration of the run (default: %u)\n"
+    "  -f file       replay the datagrams from file, instead of the built-in "
+      "corpus\n"
+    "  -k            keep the original request IDs (exercises the agent's "
+      "response cache)\n"
+    "  -o file       write the corpus to file, and exit\n"
+    "  -r rate       requests per second; 0 sends as fast as the window "
+      "allows (default: %u)\n"
+    "  -t msecs      time after which a request is unanswered "
+      "(default: %u)\n"
+    "  -v            report per-datagram results\n"
+    "  -w count      maximum outstanding requests (default: %u)\n\n"
+    "The default agent address is %s, port %s.\n", progname,
+    REPLAY_DEFAULT_COMMUNITY, REPLAY_DEFAULT_DURATION, REPLAY_DEFAULT_RATE,
+    REPLAY_DEFAULT_TIMEOUT_MS, REPLAY_DEFAULT_WINDOW, REPLAY_DEFAULT_ADDR,
+    REPLAY_DEFAULT_PORT);
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  const char *addr = REPLAY_DEFAULT_ADDR, *port = REPLAY_DEFAULT_PORT;
+  const char *community = REPLAY_DEFAULT_COMMUNITY;
+  const char *corpus_path = NULL, *output_path = NULL;
+  unsigned long rate = REPLAY_DEFAULT_RATE, window = REPLAY_DEFAULT_WINDOW;
+  unsigned long duration = REPLAY_DEFAULT_DURATION;
+  unsigned long next_seq = 0, oldest_seq = 0;
+  double timeout_ns = REPLAY_DEFAULT_TIMEOUT_MS * 1000000.0;
+  double start_ns, end_ns, next_send_ns, interval_ns, now_ns, elapsed_ns;
+  int c, fd, keep_ids = FALSE, verbose = FALSE;
+  struct replay_stats stats;
+  unsigned int i;
+
+  while ((c = getopt(argc, argv, "C:d:f:ko:r:t:vw:")) != -1) {
+    switch (c) {
+      case 'C':
+        community = optarg;
+        break;
+
+      case 'd':
+        duration = strtoul(optarg, NULL, 10);
+        break;
+
+      case 'f':
+        corpus_path = optarg;
+        break;
+
+      case 'k':
+        keep_ids = TRUE;
+        break;
+
+      case 'o':
+        output_path = optarg;
+        break;
+
+      case 'r':
+        rate = strtoul(optarg, NULL, 10);
+        break;
+
+      case 't':
+        timeout_ns = strtoul(optarg, NULL, 10) * 1000000.0;
+        break;
+
+      case 'v':
+        verbose = TRUE;
+        break;
+
+      case 'w':
+        window = strtoul(optarg, NULL, 10);
+        if (window == 0 ||
+            window > REPLAY_MAX_PENDING) {
+          usage(argv[0]);
+        }
+        break;
+
+      default:
+        usage(argv[0]);
+    }
+  }
+
+  if (optind < argc) {
+    addr = argv[optind++];
+  }
+
+  if (optind < argc) {
+    port = argv[optind++];
+  }
+
+  if (optind < argc ||
+      duration == 0) {
+    usage(argv[0]);
+  }
+
+  if (corpus_path != NULL) {
+    if (replay_read_corpus(corpus_path) < 0) {
+      return 1;
+    }
+
+  } else {
+    if (replay_build_corpus(community) < 0) {
+      return 1;
+    }
+  }
+
+  if (replay_ncorpus == 0) {
+    fprintf(stderr, "empty corpus\n");
+    return 1;
+  }
+
+  if (output_path != NULL) {
+    FILE *fh;
+
+    fh = fopen(output_path, "w");
+    if (fh == NULL) {
+      fprintf(stderr, "unable to open %s: %s\n", output_path,
+        strerror(errno));
+      return 1;
+    }
+
+    replay_write_corpus(fh);
+    fclose(fh);
+    return 0;
+  }
+
+  fd = replay_connect(addr, port);
+  if (fd < 0) {
+    return 1;
+  }
+
+  memset(&stats, 0, sizeof(stats));
+  interval_ns = rate > 0 ? 1000000000.0 / rate : 0.0;
+
+  start_ns = next_send_ns = bench_now_ns();
+  end_ns = start_ns + (duration * 1000000000.0);
+
+  while (TRUE) {
+    struct pollfd pfd;
+    int poll_ms = 1;
+
+    now_ns = bench_now_ns();
+
+    /* Send whatever is due, up to the window of outstanding requests. */
+    while (now_ns < end_ns &&
+           now_ns >= next_send_ns &&
+           replay_npending < window) {
+      struct replay_entry *entry;
+      struct replay_pending *pending;
+      unsigned char *request_id;
+
+      entry = &(replay_corpus[next_seq % replay_ncorpus]);
+      pending = &(replay_pending[next_seq & (REPLAY_MAX_PENDING - 1)]);
+
+      /* Wait for the request last using this slot to be answered, or to
+       * time out.
+       */
+      if (pending->active == TRUE) {
+        break;
+      }
+
+      if (keep_ids == FALSE) {
+        unsigned long id;
+
+        id = REPLAY_REQUEST_ID_BASE + (next_seq & REPLAY_REQUEST_ID_MASK);
+        request_id = entry->data + entry->request_id_offset;
+        request_id[0] = (unsigned char) (id >> 24);
+        request_id[1] = (unsigned char) (id >> 16);
+        request_id[2] = (unsigned char) (id >> 8);
+        request_id[3] = (unsigned char) id;
+      }
+
+      if (send(fd, entry->data, entry->datalen, 0) < 0) {
+        if (errno == EAGAIN ||
+            errno == EWOULDBLOCK) {
+          break;
+        }
+
+        stats.send_errors++;
+
+      } else {
+        pending->seq = next_seq;
+        pending->sent_ns = now_ns;
+        pending->entry = entry;
+        pending->active = TRUE;
+
+        if (entry->expect_response) {
+          replay_npending++;
+        }
+
+        entry->sent++;
+        stats.sent++;
+      }
+
+      next_seq++;
+      next_send_ns += interval_ns;
+    }
+
+    replay_recv(fd, &stats);
+
+    /* Expire the requests which have timed out, oldest first. */
+    now_ns = bench_now_ns();
+    while (oldest_seq < next_seq) {
+      struct replay_pending *pending;
+
+      pending = &(replay_pending[oldest_seq & (REPLAY_MAX_PENDING - 1)]);
+      if (pending->seq == oldest_seq &&
+          pending->active == TRUE) {
+        if (now_ns - pending->sent_ns < timeout_ns) {
+          break;
+        }
+
+        pending->active = FALSE;
+
+        if (pending->entry->expect_response) {
+          replay_npending--;
+          pending->entry->unanswered++;
+          stats.unanswered++;
+
+        } else {
+          stats.dropped_as_expected++;
+        }
+      }
+
+      oldest_seq++;
+    }
+
+    if (now_ns >= end_ns &&
+        oldest_seq == next_seq) {
+      break;
+    }
+
+    /* Wait for responses until the next request is due. */
+    if (now_ns < end_ns &&
+        replay_npending < window &&
+        next_send_ns > now_ns) {
+      poll_ms = (int) ((next_send_ns - now_ns) / 1000000.0);
+
+    } else if (now_ns < end_ns &&
+               replay_npending < window) {
+      poll_ms = 0;
+    }
+
+    if (poll_ms > 0 ||
+        oldest_seq < next_seq) {
+      pfd.fd = fd;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      (void) poll(&pfd, 1, poll_ms);
+    }
+  }
+
+  /* Throughput is measured up to the last response, rather than including
+   * the wait for any unanswered requests to time out.
+   */
+  elapsed_ns = (stats.answered > 0 ? stats.last_response_ns : end_ns) -
+    start_ns;
+  close(fd);
+
+  qsort(replay_latencies, replay_nlatencies, sizeof(double),
+    replay_cmp_latency);
+
+  printf("agent %s:%s, %u corpus datagrams, %lu secs, rate %lu/sec, "
+    "window %lu\n\n", addr, port, replay_ncorpus, duration, rate, window);
+  printf("  requests sent:           %lu (%lu send errors)\n", stats.sent,
+    stats.send_errors);
+  printf("  responses:               %lu\n", stats.answered);
+  printf("  unanswered (dropped):    %lu\n", stats.unanswered);
+  printf("  bad community, dropped:  %lu\n", stats.dropped_as_expected);
+  printf("  bad community, answered: %lu\n", stats.unexpected_responses);
+  printf("  late/unmatched:          %lu\n", stats.unknown_responses);
+  printf("  throughput:              %.1f responses/sec\n",
+    stats.answered / (elapsed_ns / 1000000000.0));
+  printf("  latency (usecs):         p50 %.1f, p99 %.1f, p99.9 %.1f, "
+    "max %.1f\n", replay_get_percentile(50.0) / 1000.0,
+    replay_get_percentile(99.0) / 1000.0,
+    replay_get_percentile(99.9) / 1000.0,
+    replay_get_percentile(100.0) / 1000.0);
+
+  if (verbose) {
+    printf("\n  %-20s %10s %10s %10s %12s\n", "datagram", "sent", "answered",
+      "unanswered", "mean usecs");
+
+    for (i = 0; i < replay_ncorpus; i++) {
+      struct replay_entry *entry;
+
+      entry = &(replay_corpus[i]);
+      printf("  %-20s %10lu %10lu %10lu %12.1f\n", entry->label, entry->sent,
+        entry->answered, entry->unanswered, entry->answered > 0 ?
+          (entry->total_latency_ns / entry->answered) / 1000.0 : 0.0);
+    }
+  }
+
+  return 0;
+}
@@ -190,6 +190,28 @@ static struct snmp_field_info snmp_fields[] = {
     sizeof(uint32_t), "SNMP_F_PKTS_AUTH_ERR_TOTAL" },
   { SNMP_DB_SNMP_F_PKTS_DROPPED_TOTAL, SNMP_DB_ID_SNMP, 16,
     sizeof(uint32_t), "SNMP_F_PKTS_DROPPED_TOTAL" },
+  { SNMP_DB_SNMP_F_RESP_CACHE_HIT_TOTAL, SNMP_DB_ID_SNMP, 20,
+    sizeof(uint32_t), "SNMP_F_RESP_CACHE_HIT_TOTAL" },
+  { SNMP_DB_SNMP_F_RESP_CACHE_MISS_TOTAL, SNMP_DB_ID_SNMP, 24,
+    sizeof(uint32_t), "SNMP_F_RESP_CACHE_MISS_TOTAL" },
+  { SNMP_DB_SNMP_F_RETRANSMIT_HIT_TOTAL, SNMP_DB_ID_SNMP, 28,
+    sizeof(uint32_t), "SNMP_F_RETRANSMIT_HIT_TOTAL" },
+  { SNMP_DB_SNMP_F_LOG_DROPPED_TOTAL, SNMP_DB_ID_SNMP, 32,
+    sizeof(uint32_t), "SNMP_F_LOG_DROPPED_TOTAL" },
+  { SNMP_DB_SNMP_F_TRAPS_DROPPED_TOTAL, SNMP_DB_ID_SNMP, 36,
+    sizeof(uint32_t), "SNMP_F_TRAPS_DROPPED_TOTAL" },
+  { SNMP_DB_SNMP_F_TRAPS_SEND_ERR_TOTAL, SNMP_DB_ID_SNMP, 40,
+    sizeof(uint32_t), "SNMP_F_TRAPS_SEND_ERR_TOTAL" },
+  { SNMP_DB_SNMP_F_TRAPS_SUPPRESSED_TOTAL, SNMP_DB_ID_SNMP, 44,
+    sizeof(uint32_t), "SNMP_F_TRAPS_SUPPRESSED_TOTAL" },
+  { SNMP_DB_SNMP_F_INFORMS_PENDING_COUNT, SNMP_DB_ID_SNMP, 48,
+    sizeof(uint32_t), "SNMP_F_INFORMS_PENDING_COUNT" },
+  { SNMP_DB_SNMP_F_INFORMS_RETRIES_TOTAL, SNMP_DB_ID_SNMP, 52,
+    sizeof(uint32_t), "SNMP_F_INFORMS_RETRIES_TOTAL" },
+  { SNMP_DB_SNMP_F_INFORMS_ACKED_TOTAL, SNMP_DB_ID_SNMP, 56,
+    sizeof(uint32_t), "SNMP_F_INFORMS_ACKED_TOTAL" },
+  { SNMP_DB_SNMP_F_INFORMS_TIMEOUT_TOTAL, SNMP_DB_ID_SNMP, 60,
+    sizeof(uint32_t), "SNMP_F_INFORMS_TIMEOUT_TOTAL" },
 
   /* ftps.tlsSessions fields */
   { SNMP_DB_FTPS_SESS_F_SESS_COUNT, SNMP_DB_ID_TLS, 0,
@@ -381,9 +403,9 @@ static struct snmp_db_info snmp_dbs[] = {
 
   /* The size of the snmp table is calculated as:
    *
-   *  4 fields                x 4 bytes = 20 bytes
+   *  16 fields               x 4 bytes = 64 bytes
    */
-  { SNMP_DB_ID_SNMP, -1, "snmp.dat", NULL, NULL, 20 },
+  { SNMP_DB_ID_SNMP, -1, "snmp.dat", NULL, NULL, 64 },
 
   /* The size of the ftps table is calculated as:
    *
@@ -1170,6 +1192,120 @@ int snmp_db_get_value(pool *p, unsigned int field, int32_t *int_value,
   return 0;
 }
 
+/* Read-locks (or unlocks) an entire table. */
+static int lock_table(int db_id, int lock_type) {
+  struct flock lock;
+  unsigned int nattempts = 1;
+  int db_fd;
+
+  lock.l_type = lock_type;
+  lock.l_whence = SEEK_SET;
+  lock.l_start = 0;
+  lock.l_len = 0;
+
+  db_fd = snmp_dbs[db_id].db_fd;
+
+  while (fcntl(db_fd, F_SETLK, &lock) < 0) {
+    int xerrno = errno;
+
+    if (xerrno == EINTR) {
+      pr_signals_handle();
+      continue;
+    }
+
+    if (xerrno == EAGAIN ||
+        xerrno == EACCES) {
+      /* As for fields, retry a few times before giving up. */
+      nattempts++;
+      if (nattempts <= SNMP_MAX_LOCK_ATTEMPTS) {
+        errno = EINTR;
+
+        pr_signals_handle();
+
+        errno = 0;
+        continue;
+      }
+    }
+
+    pr_trace_msg(trace_channel, 3,
+      "unable to %s table '%s' (fd %d): %s",
+      lock_type == F_UNLCK ? "unlock" : "read-lock", snmp_dbs[db_id].db_path,
+      db_fd, strerror(xerrno));
+
+    errno = xerrno;
+    return -1;
+  }
+
+  return 0;
+}
+
+int snmp_db_get_values(pool *p, unsigned int *fields, unsigned int nfields,
+    int32_t *int_values) {
+  register unsigned int i;
+  int locked_db_id = -1;
+
+  if (fields == NULL ||
+      int_values == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  for (i = 0; i < nfields; i++) {
+    void *db_data, *field_data;
+    int db_id;
+    off_t field_start;
+    size_t field_len;
+
+    db_id = snmp_db_get_field_db_id(fields[i]);
+    if (db_id < 0 ||
+        get_field_range(fields[i], &field_start, &field_len) < 0) {
+      break;
+    }
+
+    /* Only fields stored in tables can be read this way. */
+    db_data = snmp_dbs[db_id].db_data;
+    if (db_data == NULL) {
+      errno = EPERM;
+      break;
+    }
+
+    if (db_id != locked_db_id) {
+      if (locked_db_id > 0) {
+        (void) lock_table(locked_db_id, F_UNLCK);
+        locked_db_id = -1;
+      }
+
+      if (lock_table(db_id, F_RDLCK) < 0) {
+        break;
+      }
+
+      locked_db_id = db_id;
+    }
+
+    if (field_len > sizeof(int32_t)) {
+      field_len = sizeof(int32_t);
+    }
+
+    int_values[i] = 0;
+    field_data = &(((uint32_t *) db_data)[field_start]);
+    memmove(&(int_values[i]), field_data, field_len);
+  }
+
+  if (locked_db_id > 0) {
+    int xerrno = errno;
+
+    (void) lock_table(locked_db_id, F_UNLCK);
+    errno = xerrno;
+  }
+
+  if (i < nfields) {
+    return -1;
+  }
+
+  pr_trace_msg(trace_channel, 19, "read values for %u fields", nfields);
+  return 0;
+}
+
 int snmp_db_incr_value(pool *p, unsigned int field, int32_t incr) {
   uint32_t orig_val, new_val;
   int db_id, res;
@@ -1207,9 +1343,11 @@ int snmp_db_incr_value(pool *p, unsigned int field, int32_t incr) {
       return -1;
     }
 
-    pr_trace_msg(trace_channel, 19,
-      "value already zero for field %s (%d), not decrementing by %ld",
-      snmp_db_get_fieldstr(p, field), field, (long) incr);
+    if (snmp_trace_is_enabled(trace_channel, 19)) {
+      pr_trace_msg(trace_channel, 19,
+        "value already zero for field %s (%d), not decrementing by %ld",
+        snmp_db_get_fieldstr(p, field), field, (long) incr);
+    }
     return 0;
   }
 
@@ -1229,9 +1367,11 @@ int snmp_db_incr_value(pool *p, unsigned int field, int32_t incr) {
     return -1;
   }
 
-  pr_trace_msg(trace_channel, 19,
-    "wrote value %lu (was %lu) for field %s (%d)", (unsigned long) new_val,
-    (unsigned long) orig_val, snmp_db_get_fieldstr(p, field), field);
+  if (snmp_trace_is_enabled(trace_channel, 19)) {
+    pr_trace_msg(trace_channel, 19,
+      "wrote value %lu (was %lu) for field %s (%d)", (unsigned long) new_val,
+      (unsigned long) orig_val, snmp_db_get_fieldstr(p, field), field);
+  }
   return 0;
 }
 
@@ -115,6 +115,17 @@ extern int snmp_table_ids[];
 #define SNMP_DB_SNMP_F_TRAPS_SENT_TOTAL				202
 #define SNMP_DB_SNMP_F_PKTS_AUTH_ERR_TOTAL			203
 #define SNMP_DB_SNMP_F_PKTS_DROPPED_TOTAL			204
+#define SNMP_DB_SNMP_F_RESP_CACHE_HIT_TOTAL			205
+#define SNMP_DB_SNMP_F_RESP_CACHE_MISS_TOTAL			206
+#define SNMP_DB_SNMP_F_RETRANSMIT_HIT_TOTAL			207
+#define SNMP_DB_SNMP_F_LOG_DROPPED_TOTAL			208
+#define SNMP_DB_SNMP_F_TRAPS_DROPPED_TOTAL			209
+#define SNMP_DB_SNMP_F_TRAPS_SEND_ERR_TOTAL			210
+#define SNMP_DB_SNMP_F_TRAPS_SUPPRESSED_TOTAL			211
+#define SNMP_DB_SNMP_F_INFORMS_PENDING_COUNT			212
+#define SNMP_DB_SNMP_F_INFORMS_RETRIES_TOTAL			213
+#define SNMP_DB_SNMP_F_INFORMS_ACKED_TOTAL			214
+#define SNMP_DB_SNMP_F_INFORMS_TIMEOUT_TOTAL			215
 
 /* ftps.tlsSessions database fields */
 #define SNMP_DB_FTPS_SESS_F_SESS_COUNT				310
@@ -220,6 +231,14 @@ int snmp_db_get_value(pool *p, unsigned int field, int32_t *int_value,
   char **str_value, size_t *str_valuelen);
 int snmp_db_incr_value(pool *p, unsigned int field, int32_t incr);
 
+/* Reads the values of several numeric fields at once.  The fields of each
+ * table are read under a single lock on the whole table, so that they are
+ * consistent with each other; sorting the fields by table thus means each
+ * table is locked once.
+ */
+int snmp_db_get_values(pool *p, unsigned int *fields, unsigned int nfields,
+  int32_t *int_values);
+
 /* Used to reset/clear counters. */
 int snmp_db_reset_value(pool *p, unsigned int field);
 
@@ -0,0 +1,206 @@
+/*
+ * ProFTPD - mod_snmp logging
+ * Copyright (c) 2013 TJ Saunders
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, TJ Saunders and other respective copyright holders
+ * give permission to link this program with OpenSSL, and distribute the
+ * resulting executable, without including the source code for OpenSSL in the
+ * source distribution.
+ *
+ * $Id$
+ */
+
+#include "mod_snmp.h"
+#include "log.h"
+#include "db.h"
+
+#include <stdarg.h>
+
+static int log_level = PR_LOG_INFO;
+
+static pool *log_pool = NULL;
+static char *log_buf = NULL;
+static size_t log_bufsz = 0;
+static size_t log_buflen = 0;
+static uint32_t log_dropped = 0;
+
+static int log_buf_write(int fd) {
+  size_t off = 0;
+  ssize_t res;
+
+  while (off < log_buflen) {
+    res = write(fd, log_buf + off, log_buflen - off);
+    if (res < 0) {
+      if (errno == EINTR) {
+        pr_signals_handle();
+        continue;
+      }
+
+      /* Discard what we could not write, rather than retrying it forever. */
+      log_buflen = 0;
+      return -1;
+    }
+
+    off += res;
+  }
+
+  log_buflen = 0;
+  return 0;
+}
+
+/* Formats the message the same way as pr_log_writefile(3), so that buffered
+ * and unbuffered messages look the same in the SNMPLog.
+ */
+static size_t log_format_msg(char *buf, size_t bufsz, const char *msg) {
+  struct timeval now;
+  struct tm *tm;
+  time_t now_secs;
+  size_t len;
+
+  gettimeofday(&now, NULL);
+  now_secs = now.tv_sec;
+  tm = localtime(&now_secs);
+
+  len = strftime(buf, bufsz, "%Y-%m-%d %H:%M:%S", tm);
+  len += snprintf(buf + len, bufsz - len, ",%03lu %s[%u]: %s\n",
+    (unsigned long) (now.tv_usec / 1000), MOD_SNMP_VERSION,
+    (unsigned int) (session.pid ? session.pid : getpid()), msg);
+  if (len >= bufsz) {
+    /* Truncated; make sure the line is still terminated. */
+    len = bufsz - 1;
+    buf[len - 1] = '\n';
+  }
+
+  return len;
+}
+
+void snmp_log_set_level(int level) {
+  log_level = level;
+}
+
+int snmp_log_get_level(void) {
+  return log_level;
+}
+
+int snmp_log_init(pool *p, size_t bufsz) {
+  if (p == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (log_pool != NULL) {
+    destroy_pool(log_pool);
+    log_pool = NULL;
+  }
+
+  log_buf = NULL;
+  log_bufsz = log_buflen = 0;
+  log_dropped = 0;
+
+  if (bufsz == 0) {
+    return 0;
+  }
+
+  log_pool = make_sub_pool(p);
+  pr_pool_tag(log_pool, "SNMP log buffer pool");
+
+  log_buf = palloc(log_pool, bufsz);
+  log_bufsz = bufsz;
+
+  return 0;
+}
+
+void snmp_log_msg(int level, const char *fmt, ...) {
+  char msg[SNMP_LOG_MAX_MSGSZ], line[SNMP_LOG_MAX_MSGSZ + 64];
+  size_t linelen;
+  va_list msg_args;
+
+  if (!snmp_log_is_enabled(level)) {
+    return;
+  }
+
+  va_start(msg_args, fmt);
+  vsnprintf(msg, sizeof(msg), fmt, msg_args);
+  va_end(msg_args);
+  msg[sizeof(msg)-1] = '\0';
+
+  if (log_buf == NULL) {
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION, "%s", msg);
+    return;
+  }
+
+  if (level <= PR_LOG_WARNING) {
+    /* Keep the log in order, and do not keep important messages waiting. */
+    (void) snmp_log_flush(NULL);
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION, "%s", msg);
+    return;
+  }
+
+  linelen = log_format_msg(line, sizeof(line), msg);
+  if (linelen > log_bufsz - log_buflen) {
+    log_dropped++;
+    return;
+  }
+
+  memcpy(log_buf + log_buflen, line, linelen);
+  log_buflen += linelen;
+}
+
+int snmp_log_want_flush(void) {
+  if (log_buf == NULL) {
+    return FALSE;
+  }
+
+  return (log_buflen > (log_bufsz / 2) ? TRUE : FALSE);
+}
+
+int snmp_log_flush(pool *p) {
+  int res = 0;
+
+  if (log_buf == NULL ||
+      snmp_logfd < 0) {
+    return 0;
+  }
+
+  if (log_buflen > 0) {
+    res = log_buf_write(snmp_logfd);
+  }
+
+  /* Without a pool, we cannot update the counter; leave the count for the
+   * next flush.
+   */
+  if (log_dropped > 0 &&
+      p != NULL) {
+    uint32_t dropped;
+
+    dropped = log_dropped;
+    log_dropped = 0;
+
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "dropped %lu log %s (log buffer full)", (unsigned long) dropped,
+      dropped != 1 ? "messages" : "message");
+
+    if (snmp_db_incr_value(p, SNMP_DB_SNMP_F_LOG_DROPPED_TOTAL,
+        (int32_t) dropped) < 0) {
+      (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+        "error incrementing SNMP database for "
+        "snmp.logMessagesDroppedTotal: %s", strerror(errno));
+    }
+  }
+
+  return res;
+}
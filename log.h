@@ -0,0 +1,73 @@
+/*
+ * ProFTPD - mod_snmp logging
+ * Copyright (c) 2013 TJ Saunders
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, TJ Saunders and other respective copyright holders
+ * give permission to link this program with OpenSSL, and distribute the
+ * resulting executable, without including the source code for OpenSSL in the
+ * source distribution.
+ *
+ * $Id$
+ */
+
+#include "mod_snmp.h"
+
+#ifndef MOD_SNMP_LOG_H
+#define MOD_SNMP_LOG_H
+
+/* How often, in millisecs, the SNMP agent flushes buffered log messages. */
+#define SNMP_LOG_FLUSH_INTERVAL_MS		1000
+
+/* Largest single log message; longer messages are truncated. */
+#define SNMP_LOG_MAX_MSGSZ			1024
+
+/* Smallest configurable SNMPLogBuffer size. */
+#define SNMP_LOG_MIN_BUFSZ			4096
+
+/* Messages more verbose than the given level (one of the PR_LOG_ syslog
+ * levels) are discarded, without being formatted.  The default is
+ * PR_LOG_INFO.
+ */
+void snmp_log_set_level(int level);
+int snmp_log_get_level(void);
+
+/* Callers can use this to avoid preparing the arguments for messages which
+ * would be discarded anyway, e.g. OID strings.
+ */
+#define snmp_log_is_enabled(level) \
+  (snmp_logfd >= 0 && (level) <= snmp_log_get_level())
+
+/* If bufsz is non-zero, messages are appended to an in-memory buffer of
+ * that size, and written to the SNMPLog by snmp_log_flush().  Messages
+ * which do not fit in the buffer are dropped, and counted.  Warnings and
+ * errors are always written out immediately.
+ */
+int snmp_log_init(pool *p, size_t bufsz);
+
+void snmp_log_msg(int level, const char *fmt, ...)
+#ifdef __GNUC__
+  __attribute__ ((format (printf, 2, 3)));
+#else
+  ;
+#endif
+
+/* Returns TRUE if the buffer is more than half full. */
+int snmp_log_want_flush(void);
+
+int snmp_log_flush(pool *p);
+
+#endif
@@ -431,6 +431,83 @@ static struct snmp_mib snmp_mibs[] = {
     SNMP_MIB_NAME_PREFIX "snmp.packetsDroppedTotal.0",
     SNMP_SMI_COUNTER32 },
 
+  { { SNMP_MIB_SNMP_OID_RESP_CACHE_HIT_TOTAL, 0 },
+    SNMP_MIB_SNMP_OIDLEN_RESP_CACHE_HIT_TOTAL + 1,
+    SNMP_DB_SNMP_F_RESP_CACHE_HIT_TOTAL, TRUE, FALSE,
+    SNMP_MIB_NAME_PREFIX "snmp.responseCacheHitsTotal",
+    SNMP_MIB_NAME_PREFIX "snmp.responseCacheHitsTotal.0",
+    SNMP_SMI_COUNTER32 },
+
+  { { SNMP_MIB_SNMP_OID_RESP_CACHE_MISS_TOTAL, 0 },
+    SNMP_MIB_SNMP_OIDLEN_RESP_CACHE_MISS_TOTAL + 1,
+    SNMP_DB_SNMP_F_RESP_CACHE_MISS_TOTAL, TRUE, FALSE,
+    SNMP_MIB_NAME_PREFIX "snmp.responseCacheMissesTotal",
+    SNMP_MIB_NAME_PREFIX "snmp.responseCacheMissesTotal.0",
+    SNMP_SMI_COUNTER32 },
+
+  { { SNMP_MIB_SNMP_OID_RETRANSMIT_HIT_TOTAL, 0 },
+    SNMP_MIB_SNMP_OIDLEN_RETRANSMIT_HIT_TOTAL + 1,
+    SNMP_DB_SNMP_F_RETRANSMIT_HIT_TOTAL, TRUE, FALSE,
+    SNMP_MIB_NAME_PREFIX "snmp.retransmitHitsTotal",
+    SNMP_MIB_NAME_PREFIX "snmp.retransmitHitsTotal.0",
+    SNMP_SMI_COUNTER32 },
+
+  { { SNMP_MIB_SNMP_OID_LOG_DROPPED_TOTAL, 0 },
+    SNMP_MIB_SNMP_OIDLEN_LOG_DROPPED_TOTAL + 1,
+    SNMP_DB_SNMP_F_LOG_DROPPED_TOTAL, TRUE, FALSE,
+    SNMP_MIB_NAME_PREFIX "snmp.logMessagesDroppedTotal",
+    SNMP_MIB_NAME_PREFIX "snmp.logMessagesDroppedTotal.0",
+    SNMP_SMI_COUNTER32 },
+
+  { { SNMP_MIB_SNMP_OID_TRAPS_DROPPED_TOTAL, 0 },
+    SNMP_MIB_SNMP_OIDLEN_TRAPS_DROPPED_TOTAL + 1,
+    SNMP_DB_SNMP_F_TRAPS_DROPPED_TOTAL, TRUE, FALSE,
+    SNMP_MIB_NAME_PREFIX "snmp.trapsDroppedTotal",
+    SNMP_MIB_NAME_PREFIX "snmp.trapsDroppedTotal.0",
+    SNMP_SMI_COUNTER32 },
+
+  { { SNMP_MIB_SNMP_OID_TRAPS_SEND_ERR_TOTAL, 0 },
+    SNMP_MIB_SNMP_OIDLEN_TRAPS_SEND_ERR_TOTAL + 1,
+    SNMP_DB_SNMP_F_TRAPS_SEND_ERR_TOTAL, TRUE, FALSE,
+    SNMP_MIB_NAME_PREFIX "snmp.trapsSendFailedTotal",
+    SNMP_MIB_NAME_PREFIX "snmp.trapsSendFailedTotal.0",
+    SNMP_SMI_COUNTER32 },
+
+  { { SNMP_MIB_SNMP_OID_TRAPS_SUPPRESSED_TOTAL, 0 },
+    SNMP_MIB_SNMP_OIDLEN_TRAPS_SUPPRESSED_TOTAL + 1,
+    SNMP_DB_SNMP_F_TRAPS_SUPPRESSED_TOTAL, TRUE, FALSE,
+    SNMP_MIB_NAME_PREFIX "snmp.trapsSuppressedTotal",
+    SNMP_MIB_NAME_PREFIX "snmp.trapsSuppressedTotal.0",
+    SNMP_SMI_COUNTER32 },
+
+  { { SNMP_MIB_SNMP_OID_INFORMS_PENDING_COUNT, 0 },
+    SNMP_MIB_SNMP_OIDLEN_INFORMS_PENDING_COUNT + 1,
+    SNMP_DB_SNMP_F_INFORMS_PENDING_COUNT, TRUE, FALSE,
+    SNMP_MIB_NAME_PREFIX "snmp.informsPendingCount",
+    SNMP_MIB_NAME_PREFIX "snmp.informsPendingCount.0",
+    SNMP_SMI_GAUGE32 },
+
+  { { SNMP_MIB_SNMP_OID_INFORMS_RETRIES_TOTAL, 0 },
+    SNMP_MIB_SNMP_OIDLEN_INFORMS_RETRIES_TOTAL + 1,
+    SNMP_DB_SNMP_F_INFORMS_RETRIES_TOTAL, TRUE, FALSE,
+    SNMP_MIB_NAME_PREFIX "snmp.informsRetriedTotal",
+    SNMP_MIB_NAME_PREFIX "snmp.informsRetriedTotal.0",
+    SNMP_SMI_COUNTER32 },
+
+  { { SNMP_MIB_SNMP_OID_INFORMS_ACKED_TOTAL, 0 },
+    SNMP_MIB_SNMP_OIDLEN_INFORMS_ACKED_TOTAL + 1,
+    SNMP_DB_SNMP_F_INFORMS_ACKED_TOTAL, TRUE, FALSE,
+    SNMP_MIB_NAME_PREFIX "snmp.informsAckedTotal",
+    SNMP_MIB_NAME_PREFIX "snmp.informsAckedTotal.0",
+    SNMP_SMI_COUNTER32 },
+
+  { { SNMP_MIB_SNMP_OID_INFORMS_TIMEOUT_TOTAL, 0 },
+    SNMP_MIB_SNMP_OIDLEN_INFORMS_TIMEOUT_TOTAL + 1,
+    SNMP_DB_SNMP_F_INFORMS_TIMEOUT_TOTAL, TRUE, FALSE,
+    SNMP_MIB_NAME_PREFIX "snmp.informsTimedOutTotal",
+    SNMP_MIB_NAME_PREFIX "snmp.informsTimedOutTotal.0",
+    SNMP_SMI_COUNTER32 },
+
   /* ftps.tlsSessions MIBs */
   { { SNMP_MIB_FTPS_SESS_OID_SESS_COUNT, 0 },
     SNMP_MIB_FTPS_SESS_OIDLEN_SESS_COUNT + 1,
@@ -1056,6 +1133,50 @@ struct snmp_mib *snmp_mib_get_by_oid(oid_t *mib_oid, unsigned int mib_oidlen,
   return snmp_mib_get_by_idx(mib_idx); 
 }
 
+int snmp_mib_get_idx_by_name(const char *mib_name) {
+  register unsigned int i;
+  size_t prefixlen;
+
+  if (mib_name == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  prefixlen = strlen(SNMP_MIB_NAME_PREFIX);
+
+  for (i = 1; snmp_mibs[i].mib_oidlen != 0; i++) {
+    const char *name;
+
+    if (snmp_mibs[i].mib_name == NULL ||
+        snmp_mibs[i].instance_name == NULL) {
+      continue;
+    }
+
+    if (strcmp(snmp_mibs[i].mib_name, mib_name) == 0 ||
+        strcmp(snmp_mibs[i].instance_name, mib_name) == 0) {
+      return i;
+    }
+
+    if (strncmp(snmp_mibs[i].mib_name, SNMP_MIB_NAME_PREFIX,
+        prefixlen) != 0) {
+      continue;
+    }
+
+    name = snmp_mibs[i].mib_name + prefixlen;
+    if (strcmp(name, mib_name) == 0) {
+      return i;
+    }
+
+    name = snmp_mibs[i].instance_name + prefixlen;
+    if (strcmp(name, mib_name) == 0) {
+      return i;
+    }
+  }
+
+  errno = ENOENT;
+  return -1;
+}
+
 int snmp_mib_reset_counters(void) {
   register unsigned int i;
 
@@ -1086,6 +1207,31 @@ int snmp_mib_reset_counters(void) {
 }
 
 int snmp_mib_init(void) {
+  register unsigned int i;
+
+  /* Encode the OID of each MIB once, so that responses can copy the
+   * encoded OID, rather than encoding it again for every request.
+   */
+  for (i = 1; snmp_mibs[i].mib_oidlen != 0; i++) {
+    unsigned char *buf;
+    size_t buflen;
+    int res;
+
+    buf = snmp_mibs[i].mib_oid_enc + sizeof(snmp_mibs[i].mib_oid_enc);
+    buflen = sizeof(snmp_mibs[i].mib_oid_enc);
+
+    res = snmp_asn1_prepend_oid(permanent_pool, &buf, &buflen,
+      (SNMP_ASN1_CLASS_UNIVERSAL|SNMP_ASN1_PRIMITIVE|SNMP_ASN1_TYPE_OID),
+      snmp_mibs[i].mib_oid, snmp_mibs[i].mib_oidlen);
+    if (res < 0) {
+      snmp_mibs[i].mib_oid_enclen = 0;
+      continue;
+    }
+
+    snmp_mibs[i].mib_oid_enclen = sizeof(snmp_mibs[i].mib_oid_enc) - buflen;
+    memmove(snmp_mibs[i].mib_oid_enc, buf, snmp_mibs[i].mib_oid_enclen);
+  }
+
   /* Iterate through all of the MIBs, deactivating some of them
    * if the related module is not loaded.
    */
@@ -177,6 +177,31 @@
 #define SNMP_MIB_DAEMON_NOTIFY_OIDLEN_MAX_INSTANCES \
   SNMP_DAEMON_NOTIFY_OID_BASELEN + 1
 
+#define SNMP_MIB_DAEMON_NOTIFY_OID_SUPPRESSED \
+  SNMP_DAEMON_NOTIFY_OID_BASE, 2
+#define SNMP_MIB_DAEMON_NOTIFY_OIDLEN_SUPPRESSED \
+  SNMP_DAEMON_NOTIFY_OID_BASELEN + 1
+
+#define SNMP_MIB_DAEMON_NOTIFY_OID_THRESHOLD_EXCEEDED \
+  SNMP_DAEMON_NOTIFY_OID_BASE, 3
+#define SNMP_MIB_DAEMON_NOTIFY_OIDLEN_THRESHOLD_EXCEEDED \
+  SNMP_DAEMON_NOTIFY_OID_BASELEN + 1
+
+#define SNMP_MIB_DAEMON_NOTIFY_OID_THRESHOLD_CLEARED \
+  SNMP_DAEMON_NOTIFY_OID_BASE, 4
+#define SNMP_MIB_DAEMON_NOTIFY_OIDLEN_THRESHOLD_CLEARED \
+  SNMP_DAEMON_NOTIFY_OID_BASELEN + 1
+
+#define SNMP_MIB_DAEMON_NOTIFY_OID_THROUGHPUT_DEGRADED \
+  SNMP_DAEMON_NOTIFY_OID_BASE, 5
+#define SNMP_MIB_DAEMON_NOTIFY_OIDLEN_THROUGHPUT_DEGRADED \
+  SNMP_DAEMON_NOTIFY_OID_BASELEN + 1
+
+#define SNMP_MIB_DAEMON_NOTIFY_OID_THROUGHPUT_RECOVERED \
+  SNMP_DAEMON_NOTIFY_OID_BASE, 6
+#define SNMP_MIB_DAEMON_NOTIFY_OIDLEN_THROUGHPUT_RECOVERED \
+  SNMP_DAEMON_NOTIFY_OID_BASELEN + 1
+
 /* timeouts MIBs */
 #define SNMP_MIB_TIMEOUTS_OID_IDLE_TOTAL	SNMP_TIMEOUTS_OID_BASE, 1
 #define SNMP_MIB_TIMEOUTS_OIDLEN_IDLE_TOTAL	SNMP_TIMEOUTS_OID_BASELEN + 1
@@ -329,6 +354,118 @@
 #define SNMP_MIB_SNMP_OIDLEN_PKTS_DROPPED_TOTAL \
   SNMP_SNMP_OID_BASELEN + 1
 
+#define SNMP_MIB_SNMP_OID_RESP_CACHE_HIT_TOTAL \
+  SNMP_SNMP_OID_BASE, 6
+#define SNMP_MIB_SNMP_OIDLEN_RESP_CACHE_HIT_TOTAL \
+  SNMP_SNMP_OID_BASELEN + 1
+
+#define SNMP_MIB_SNMP_OID_RESP_CACHE_MISS_TOTAL \
+  SNMP_SNMP_OID_BASE, 7
+#define SNMP_MIB_SNMP_OIDLEN_RESP_CACHE_MISS_TOTAL \
+  SNMP_SNMP_OID_BASELEN + 1
+
+#define SNMP_MIB_SNMP_OID_RETRANSMIT_HIT_TOTAL \
+  SNMP_SNMP_OID_BASE, 8
+#define SNMP_MIB_SNMP_OIDLEN_RETRANSMIT_HIT_TOTAL \
+  SNMP_SNMP_OID_BASELEN + 1
+
+#define SNMP_MIB_SNMP_OID_LOG_DROPPED_TOTAL \
+  SNMP_SNMP_OID_BASE, 9
+#define SNMP_MIB_SNMP_OIDLEN_LOG_DROPPED_TOTAL \
+  SNMP_SNMP_OID_BASELEN + 1
+
+#define SNMP_MIB_SNMP_OID_TRAPS_DROPPED_TOTAL \
+  SNMP_SNMP_OID_BASE, 10
+#define SNMP_MIB_SNMP_OIDLEN_TRAPS_DROPPED_TOTAL \
+  SNMP_SNMP_OID_BASELEN + 1
+
+#define SNMP_MIB_SNMP_OID_TRAPS_SEND_ERR_TOTAL \
+  SNMP_SNMP_OID_BASE, 11
+#define SNMP_MIB_SNMP_OIDLEN_TRAPS_SEND_ERR_TOTAL \
+  SNMP_SNMP_OID_BASELEN + 1
+
+#define SNMP_MIB_SNMP_OID_TRAPS_SUPPRESSED_TOTAL \
+  SNMP_SNMP_OID_BASE, 12
+#define SNMP_MIB_SNMP_OIDLEN_TRAPS_SUPPRESSED_TOTAL \
+  SNMP_SNMP_OID_BASELEN + 1
+
+#define SNMP_MIB_SNMP_OID_INFORMS_PENDING_COUNT \
+  SNMP_SNMP_OID_BASE, 21
+#define SNMP_MIB_SNMP_OIDLEN_INFORMS_PENDING_COUNT \
+  SNMP_SNMP_OID_BASELEN + 1
+
+#define SNMP_MIB_SNMP_OID_INFORMS_RETRIES_TOTAL \
+  SNMP_SNMP_OID_BASE, 22
+#define SNMP_MIB_SNMP_OIDLEN_INFORMS_RETRIES_TOTAL \
+  SNMP_SNMP_OID_BASELEN + 1
+
+#define SNMP_MIB_SNMP_OID_INFORMS_ACKED_TOTAL \
+  SNMP_SNMP_OID_BASE, 23
+#define SNMP_MIB_SNMP_OIDLEN_INFORMS_ACKED_TOTAL \
+  SNMP_SNMP_OID_BASELEN + 1
+
+#define SNMP_MIB_SNMP_OID_INFORMS_TIMEOUT_TOTAL \
+  SNMP_SNMP_OID_BASE, 24
+#define SNMP_MIB_SNMP_OIDLEN_INFORMS_TIMEOUT_TOTAL \
+  SNMP_SNMP_OID_BASELEN + 1
+
+/* These objects are only sent in notificationsSuppressed notifications. */
+#define SNMP_MIB_SNMP_OID_SUPPRESSED_NOTIFY \
+  SNMP_SNMP_OID_BASE, 13
+#define SNMP_MIB_SNMP_OIDLEN_SUPPRESSED_NOTIFY \
+  SNMP_SNMP_OID_BASELEN + 1
+
+#define SNMP_MIB_SNMP_OID_SUPPRESSED_COUNT \
+  SNMP_SNMP_OID_BASE, 14
+#define SNMP_MIB_SNMP_OIDLEN_SUPPRESSED_COUNT \
+  SNMP_SNMP_OID_BASELEN + 1
+
+#define SNMP_MIB_SNMP_OID_SUPPRESSED_SECS \
+  SNMP_SNMP_OID_BASE, 15
+#define SNMP_MIB_SNMP_OIDLEN_SUPPRESSED_SECS \
+  SNMP_SNMP_OID_BASELEN + 1
+
+#define SNMP_MIB_SNMP_OID_SUPPRESSED_CLIENTS \
+  SNMP_SNMP_OID_BASE, 16
+#define SNMP_MIB_SNMP_OIDLEN_SUPPRESSED_CLIENTS \
+  SNMP_SNMP_OID_BASELEN + 1
+
+/* These objects are only sent in thresholdExceeded/thresholdCleared
+ * notifications.
+ */
+#define SNMP_MIB_SNMP_OID_THRESHOLD_TEXT \
+  SNMP_SNMP_OID_BASE, 17
+#define SNMP_MIB_SNMP_OIDLEN_THRESHOLD_TEXT \
+  SNMP_SNMP_OID_BASELEN + 1
+
+#define SNMP_MIB_SNMP_OID_THRESHOLD_OBJECT \
+  SNMP_SNMP_OID_BASE, 18
+#define SNMP_MIB_SNMP_OIDLEN_THRESHOLD_OBJECT \
+  SNMP_SNMP_OID_BASELEN + 1
+
+#define SNMP_MIB_SNMP_OID_THRESHOLD_VALUE \
+  SNMP_SNMP_OID_BASE, 19
+#define SNMP_MIB_SNMP_OIDLEN_THRESHOLD_VALUE \
+  SNMP_SNMP_OID_BASELEN + 1
+
+#define SNMP_MIB_SNMP_OID_THRESHOLD_LIMIT \
+  SNMP_SNMP_OID_BASE, 20
+#define SNMP_MIB_SNMP_OIDLEN_THRESHOLD_LIMIT \
+  SNMP_SNMP_OID_BASELEN + 1
+
+/* These objects are only sent in throughputDegraded/throughputRecovered
+ * notifications.
+ */
+#define SNMP_MIB_SNMP_OID_THROUGHPUT_MEDIAN \
+  SNMP_SNMP_OID_BASE, 25
+#define SNMP_MIB_SNMP_OIDLEN_THROUGHPUT_MEDIAN \
+  SNMP_SNMP_OID_BASELEN + 1
+
+#define SNMP_MIB_SNMP_OID_THROUGHPUT_BASELINE \
+  SNMP_SNMP_OID_BASE, 26
+#define SNMP_MIB_SNMP_OIDLEN_THROUGHPUT_BASELINE \
+  SNMP_SNMP_OID_BASELEN + 1
+
 /* ftps.tlsSessions MIBs */
 #define SNMP_FTPS_SESS_OID_BASE			SNMP_TLS_OID_BASE, 1
 #define SNMP_FTPS_SESS_OID_BASELEN		SNMP_TLS_OID_BASELEN + 1
@@ -657,6 +794,11 @@
 /* The longest MIB that we support/define. */
 #define SNMP_MIB_MAX_OIDLEN		14
 
+/* The longest encoding of such a MIB's OID, including the ASN.1 header:
+ * each sub-identifier takes at most five bytes.
+ */
+#define SNMP_MIB_MAX_OID_ENCLEN		(2 + (5 * SNMP_MIB_MAX_OIDLEN))
+
 /* The index at which the sysUpTime OID appears in our MIBs array. */
 #define SNMP_MIB_SYS_UPTIME_IDX		1
 
@@ -672,6 +814,10 @@ struct snmp_mib {
   const char *mib_name;
   const char *instance_name;
   unsigned char smi_type;
+
+  /* The OID, as encoded in a VarBind; filled in by snmp_mib_init(). */
+  unsigned char mib_oid_enc[SNMP_MIB_MAX_OID_ENCLEN];
+  unsigned int mib_oid_enclen;
 };
 
 struct snmp_mib *snmp_mib_get_by_idx(unsigned int mib_idx);
@@ -681,6 +827,11 @@ int snmp_mib_get_idx(oid_t *mib_oid, unsigned int mib_oidlen,
   int *lacks_instance_id);
 int snmp_mib_get_nearest_idx(oid_t *mib_oid, unsigned int mib_oidlen);
 
+/* Looks up a MIB by its name, e.g. "ftp.sessions.sessionCount", with or
+ * without the "proftpd.modules.snmp." prefix and the ".0" instance suffix.
+ */
+int snmp_mib_get_idx_by_name(const char *mib_name);
+
 /* Returns the highest valid MIB index.  Why is this a runtime function,
  * rather than a compile-time constant?  Because of the conditional nature
  * of some of the MIBs e.g. pertaining to mod_tls or mod_sftp; those modules
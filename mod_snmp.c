@@ -33,6 +33,11 @@
 #include "pdu.h"
 #include "msg.h"
 #include "notify.h"
+#include "cache.h"
+#include "timer.h"
+#include "log.h"
+#include "threshold.h"
+#include "throughput.h"
 
 /* Defaults */
 #define SNMP_DEFAULT_AGENT_PORT		161
@@ -42,6 +47,12 @@
 #define SNMP_AGENT_TYPE_MASTER		1
 #define SNMP_AGENT_TYPE_AGENTX		2
 
+/* SEQUENCE lengths are minimally encoded, so adding variables to a GetBulk
+ * response can grow the varlist, PDU, and message headers, by at most two
+ * bytes each for messages up to 64KB.
+ */
+#define SNMP_AGENT_BULK_HDR_GROWTH	6
+
 extern xaset_t *server_list;
 
 module snmp_module;
@@ -62,16 +73,46 @@ static const char *snmp_logname = NULL;
 static unsigned long snmp_opts = 0UL;
 
 static const char *snmp_community = NULL;
+static size_t snmp_community_len = 0;
 
 /* The list of SNMPNotify receivers/managers to which to send notifications. */
 static array_header *snmp_notifys = NULL;
 
+/* The SNMPNotify receivers of every server, for the SNMP agent process, which
+ * sends the notifications queued by the other processes.
+ */
+struct snmp_server_notifys {
+  unsigned int server_id;
+  array_header *notifys;
+};
+
+static array_header *snmp_server_notifys = NULL;
+
 /* This number defined as the maximum 'max-bindings' value in RFC19105; it's
  * good enough for the default maximum number of variables in a bindings list
  * to process.
  */
 static unsigned int snmp_max_variables = SNMP_PDU_MAX_BINDINGS;
 
+/* The maximum size, in bytes, of the SNMP messages we will send.  GetBulk
+ * responses are filled with as many variables as will fit within this size.
+ */
+static size_t snmp_max_msgsz = SNMP_PACKET_MAX_LEN;
+
+/* Receive buffer for the agent's datagrams. */
+static unsigned char snmp_agent_rcvbuf[SNMP_PACKET_MAX_LEN];
+
+/* How long, in millisecs, encoded responses are cached for repeated identical
+ * requests; zero disables the response cache.
+ */
+static unsigned long snmp_cache_ttl = 0UL;
+static unsigned int snmp_cache_max_entries = SNMP_CACHE_DEFAULT_MAX_ENTRIES;
+
+/* Size, in bytes, of the buffer for SNMPLog messages; zero means that
+ * messages are written out immediately.
+ */
+static size_t snmp_log_bufsz = 0;
+
 /* Number of seconds to wait for the SNMP agent process to stop before
  * we terminate it with extreme prejudice.
  *
@@ -386,7 +427,8 @@ static int snmp_security_check(struct snmp_packet *pkt) {
     case SNMP_PROTOCOL_VERSION_1:
     case SNMP_PROTOCOL_VERSION_2:
       /* Check the community string against the configured SNMPCommunity. */
-      if (strncmp(snmp_community, pkt->community, pkt->community_len) != 0) {
+      if (pkt->community_len != snmp_community_len ||
+          strncmp(snmp_community, pkt->community, pkt->community_len) != 0) {
         (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
           "%s message community '%s' does not match configured community, "
           "ignoring message", snmp_msg_get_versionstr(pkt->snmp_version),
@@ -572,12 +614,98 @@ static void snmp_daemonize(const char *daemon_dir) {
   pr_fsio_chdir(daemon_dir, 0);
 }
 
+/* OIDs in log messages are formatted into this scratch buffer, rather than
+ * into a string allocated for each one.  No message logs more than one
+ * OID, and the callers only format an OID once they know that the message
+ * will be logged (or traced).
+ */
+static char snmp_agent_oidbuf[SNMP_ASN1_OIDSTR_MAX_LEN];
+
+static const char *snmp_agent_get_oidstr(oid_t *oid, unsigned int oidlen) {
+  return snmp_asn1_format_oid(snmp_agent_oidbuf, sizeof(snmp_agent_oidbuf),
+    oid, oidlen);
+}
+
+/* Fills in a response binding for the given MIB object, using its current
+ * value from the database.
+ */
+static int snmp_agent_bind_mib(struct snmp_packet *pkt,
+    struct snmp_binding *binding, struct snmp_mib *mib) {
+  int32_t mib_int = -1;
+  char *mib_str = NULL;
+  size_t mib_strlen = 0;
+  int res;
+
+  res = snmp_db_get_value(pkt->pool, mib->db_field, &mib_int, &mib_str,
+    &mib_strlen);
+
+  /* XXX Response with genErr instead? */
+  if (res < 0) {
+    int xerrno = errno;
+
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "error retrieving database value for field %s: %s",
+      snmp_db_get_fieldstr(pkt->pool, mib->db_field), strerror(xerrno));
+    errno = xerrno;
+    return -1;
+  }
+
+  memset(binding, 0, sizeof(struct snmp_binding));
+  binding->name = mib->mib_oid;
+  binding->namelen = mib->mib_oidlen;
+  binding->enc_name = mib->mib_oid_enc;
+  binding->enc_namelen = mib->mib_oid_enclen;
+  binding->smi_type = mib->smi_type;
+
+  switch (mib->smi_type) {
+    case SNMP_SMI_INTEGER:
+    case SNMP_SMI_COUNTER32:
+    case SNMP_SMI_GAUGE32:
+    case SNMP_SMI_TIMETICKS:
+      binding->int_value = mib_int;
+      break;
+
+    case SNMP_SMI_STRING:
+    case SNMP_SMI_IPADDR:
+      if (mib_str == NULL) {
+        errno = EINVAL;
+        return -1;
+      }
+
+      binding->str_value = mib_str;
+      binding->str_valuelen = mib_strlen;
+      break;
+
+    default:
+      (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+        "unable to create variable for SMI type %s",
+        snmp_smi_get_varstr(pkt->pool, mib->smi_type));
+      errno = ENOENT;
+      return -1;
+  }
+
+  return 0;
+}
+
+/* Fills in a response binding of the given exception type, for the given
+ * name.
+ */
+static void snmp_agent_bind_exception(struct snmp_binding *binding,
+    oid_t *name, unsigned int namelen, unsigned char smi_type) {
+  memset(binding, 0, sizeof(struct snmp_binding));
+  binding->name = name;
+  binding->namelen = namelen;
+  binding->smi_type = smi_type;
+}
+
 static int snmp_agent_handle_get(struct snmp_packet *pkt) {
-  struct snmp_var *iter_var = NULL, *head_var = NULL, *tail_var = NULL;
+  register unsigned int i;
+  struct snmp_var *iter_var = NULL, *req_vars;
+  array_header *resp_bindings;
   unsigned int var_count = 0;
-  int res;
 
-  if (pkt->req_pdu->varlist == NULL) {
+  if (pkt->req_pdu->varlist == NULL ||
+      pkt->req_pdu->varlist->nelts == 0) {
     (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
       "missing request PDU variable bindings list, rejecting invalid request");
     errno = EINVAL;
@@ -587,12 +715,12 @@ static int snmp_agent_handle_get(struct snmp_packet *pkt) {
   pkt->resp_pdu = snmp_pdu_dup(pkt->pool, pkt->req_pdu);
   pkt->resp_pdu->request_type = SNMP_PDU_RESPONSE;
 
-  if (pkt->req_pdu->varlistlen > snmp_max_variables) {
-    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+  if ((unsigned int) pkt->req_pdu->varlist->nelts > snmp_max_variables) {
+    snmp_log_msg(PR_LOG_NOTICE,
       "%s %s of too many OIDs (%u, max %u)",
       snmp_msg_get_versionstr(pkt->snmp_version),
       snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
-      pkt->req_pdu->varlistlen, snmp_max_variables);
+      pkt->req_pdu->varlist->nelts, snmp_max_variables);
 
     pkt->resp_pdu->err_code = SNMP_ERR_TOO_BIG;
     pkt->resp_pdu->err_idx = 0;
@@ -600,25 +728,30 @@ static int snmp_agent_handle_get(struct snmp_packet *pkt) {
     return 0;
   }
 
-  for (iter_var = pkt->req_pdu->varlist; iter_var; iter_var = iter_var->next) { 
+  req_vars = pkt->req_pdu->varlist->elts;
+  resp_bindings = make_array(pkt->pool, pkt->req_pdu->varlist->nelts,
+    sizeof(struct snmp_binding));
+
+  for (i = 0; i < (unsigned int) pkt->req_pdu->varlist->nelts; i++) {
     struct snmp_mib *mib = NULL;
-    struct snmp_var *resp_var = NULL;
-    int32_t mib_int = -1;
-    char *mib_str = NULL;
-    size_t mib_strlen = 0;
+    struct snmp_binding *binding = NULL;
     int lacks_instance_id = FALSE;
 
+    iter_var = &(req_vars[i]);
+
     pr_signals_handle();
 
     mib = snmp_mib_get_by_oid(iter_var->name, iter_var->namelen,
       &lacks_instance_id);
     if (mib == NULL) {
-      (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
-        "%s %s of unknown OID %s (lacks instance ID = %s)",
-        snmp_msg_get_versionstr(pkt->snmp_version),
-        snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
-        snmp_asn1_get_oidstr(pkt->req_pdu->pool, iter_var->name,
-          iter_var->namelen), lacks_instance_id ? "true" : "false");
+      if (snmp_log_is_enabled(PR_LOG_DEBUG)) {
+        snmp_log_msg(PR_LOG_DEBUG,
+          "%s %s of unknown OID %s (lacks instance ID = %s)",
+          snmp_msg_get_versionstr(pkt->snmp_version),
+          snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
+          snmp_agent_get_oidstr(iter_var->name,
+            iter_var->namelen), lacks_instance_id ? "true" : "false");
+      }
 
       /* If SNMPv1, then set the err_code/err_idx values, and duplicate the
        * varlist.
@@ -632,67 +765,62 @@ static int snmp_agent_handle_get(struct snmp_packet *pkt) {
         case SNMP_PROTOCOL_VERSION_1:
           pkt->resp_pdu->err_code = SNMP_ERR_NO_SUCH_NAME;
           pkt->resp_pdu->err_idx = var_count + 1;
-          pkt->resp_pdu->varlist = snmp_smi_dup_var(pkt->pool,
+          pkt->resp_pdu->varlist = snmp_smi_dup_varlist(pkt->pool,
             pkt->req_pdu->varlist);
-          pkt->resp_pdu->varlistlen = pkt->req_pdu->varlistlen;
           break;
 
         case SNMP_PROTOCOL_VERSION_2:
         case SNMP_PROTOCOL_VERSION_3:
-          resp_var = snmp_smi_create_exception(pkt->pool, iter_var->name,
+          binding = push_array(resp_bindings);
+          snmp_agent_bind_exception(binding, iter_var->name,
             iter_var->namelen, lacks_instance_id ? SNMP_SMI_NO_SUCH_INSTANCE :
               SNMP_SMI_NO_SUCH_OBJECT);
           break;
       }
 
-      if (resp_var == NULL) {
+      if (binding == NULL) {
         return 0;
       }
     }
 
-    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
-      "%s %s of OID %s (%s)", snmp_msg_get_versionstr(pkt->snmp_version),
-      snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
-      snmp_asn1_get_oidstr(iter_var->pool, iter_var->name, iter_var->namelen),
-      mib ? mib->instance_name : "unknown");
+    if (snmp_log_is_enabled(PR_LOG_DEBUG)) {
+      snmp_log_msg(PR_LOG_DEBUG,
+        "%s %s of OID %s (%s)", snmp_msg_get_versionstr(pkt->snmp_version),
+        snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
+        snmp_agent_get_oidstr(iter_var->name, iter_var->namelen),
+        mib ? mib->instance_name : "unknown");
+    }
 
-    /* A response variable may be have generated above, e.g. when the MIB
+    /* A response binding may be have generated above, e.g. when the MIB
      * not known/supported.
      */
-    if (resp_var == NULL) { 
-      res = snmp_db_get_value(pkt->pool, mib->db_field, &mib_int, &mib_str,
-        &mib_strlen);
+    if (binding == NULL) {
+      binding = push_array(resp_bindings);
 
-      /* XXX Response with genErr instead? */
-      if (res < 0) {
-        int xerrno = errno;
-
-        (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
-          "error retrieving database value for field %s: %s",
-          snmp_db_get_fieldstr(pkt->pool, mib->db_field), strerror(xerrno));
-        errno = xerrno;
+      if (snmp_agent_bind_mib(pkt, binding, mib) < 0) {
         return -1;
       }
-
-      resp_var = snmp_smi_create_var(pkt->pool, mib->mib_oid, mib->mib_oidlen,
-        mib->smi_type, mib_int, mib_str, mib_strlen);
     }
 
-    var_count = snmp_smi_util_add_list_var(&head_var, &tail_var, resp_var);
+    var_count = resp_bindings->nelts;
   }
 
-  pkt->resp_pdu->varlist = head_var;
-  pkt->resp_pdu->varlistlen = var_count;
+  /* The response is encoded directly from the bindings. */
+  pkt->resp_pdu->varlist = NULL;
+  pkt->resp_pdu->bindings = resp_bindings;
 
   return 0;
 }
 
 static int snmp_agent_handle_getnext(struct snmp_packet *pkt) {
-  struct snmp_var *iter_var = NULL, *head_var = NULL, *tail_var = NULL;
+  register unsigned int i;
+  struct snmp_var *iter_var = NULL, *req_vars;
+  array_header *resp_bindings;
   unsigned int var_count = 0;
-  int max_idx, res;
+  int max_idx;
 
-  if (pkt->req_pdu->varlist == NULL) {
+  if (pkt->req_pdu->varlist == NULL ||
+      pkt->req_pdu->varlist->nelts == 0) {
     (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
       "missing request PDU variable bindings list, rejecting invalid request");
     errno = EINVAL;
@@ -702,12 +830,12 @@ static int snmp_agent_handle_getnext(struct snmp_packet *pkt) {
   pkt->resp_pdu = snmp_pdu_dup(pkt->pool, pkt->req_pdu);
   pkt->resp_pdu->request_type = SNMP_PDU_RESPONSE;
 
-  if (pkt->req_pdu->varlistlen > snmp_max_variables) {
-    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+  if ((unsigned int) pkt->req_pdu->varlist->nelts > snmp_max_variables) {
+    snmp_log_msg(PR_LOG_NOTICE,
       "%s %s of too many OIDs (%u, max %u)",
       snmp_msg_get_versionstr(pkt->snmp_version),
       snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
-      pkt->req_pdu->varlistlen, snmp_max_variables);
+      pkt->req_pdu->varlist->nelts, snmp_max_variables);
 
     pkt->resp_pdu->err_code = SNMP_ERR_TOO_BIG;
     pkt->resp_pdu->err_idx = 0;
@@ -717,13 +845,16 @@ static int snmp_agent_handle_getnext(struct snmp_packet *pkt) {
 
   max_idx = snmp_mib_get_max_idx();
 
-  for (iter_var = pkt->req_pdu->varlist; iter_var; iter_var = iter_var->next) { 
+  req_vars = pkt->req_pdu->varlist->elts;
+  resp_bindings = make_array(pkt->pool, pkt->req_pdu->varlist->nelts,
+    sizeof(struct snmp_binding));
+
+  for (i = 0; i < (unsigned int) pkt->req_pdu->varlist->nelts; i++) {
     struct snmp_mib *mib = NULL;
-    struct snmp_var *resp_var = NULL;
+    struct snmp_binding *binding = NULL;
     int mib_idx = -1, next_idx = -1, lacks_instance_id = FALSE;
-    int32_t mib_int = -1;
-    char *mib_str = NULL;
-    size_t mib_strlen = 0;
+
+    iter_var = &(req_vars[i]);
 
     pr_signals_handle();
 
@@ -732,12 +863,14 @@ static int snmp_agent_handle_getnext(struct snmp_packet *pkt) {
     if (mib_idx < 0) {
       int unknown_oid = FALSE;
 
-      (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
-        "%s %s of unknown OID %s (lacks instance ID = %s)",
-        snmp_msg_get_versionstr(pkt->snmp_version),
-        snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
-        snmp_asn1_get_oidstr(pkt->req_pdu->pool, iter_var->name,
-          iter_var->namelen), lacks_instance_id ? "true" : "false");
+      if (snmp_log_is_enabled(PR_LOG_DEBUG)) {
+        snmp_log_msg(PR_LOG_DEBUG,
+          "%s %s of unknown OID %s (lacks instance ID = %s)",
+          snmp_msg_get_versionstr(pkt->snmp_version),
+          snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
+          snmp_agent_get_oidstr(iter_var->name,
+            iter_var->namelen), lacks_instance_id ? "true" : "false");
+      }
 
       if (lacks_instance_id) {
         oid_t *oid;
@@ -785,31 +918,33 @@ static int snmp_agent_handle_getnext(struct snmp_packet *pkt) {
           case SNMP_PROTOCOL_VERSION_1:
             pkt->resp_pdu->err_code = SNMP_ERR_NO_SUCH_NAME;
             pkt->resp_pdu->err_idx = var_count + 1;
-            pkt->resp_pdu->varlist = snmp_smi_dup_var(pkt->pool,
+            pkt->resp_pdu->varlist = snmp_smi_dup_varlist(pkt->pool,
               pkt->req_pdu->varlist);
-            pkt->resp_pdu->varlistlen = pkt->req_pdu->varlistlen;
             break;
 
           case SNMP_PROTOCOL_VERSION_2:
           case SNMP_PROTOCOL_VERSION_3:
-            resp_var = snmp_smi_create_exception(pkt->pool, iter_var->name,
+            binding = push_array(resp_bindings);
+            snmp_agent_bind_exception(binding, iter_var->name,
               iter_var->namelen, lacks_instance_id ? SNMP_SMI_NO_SUCH_INSTANCE :
                 SNMP_SMI_NO_SUCH_OBJECT);
             break;
         }
 
-        if (resp_var == NULL) {
+        if (binding == NULL) {
           return 0;
         }
       }
     }
 
-    pr_trace_msg(trace_channel, 19,
-      "%s %s for OID %s at MIB index %d (max index %d)",
-      snmp_msg_get_versionstr(pkt->snmp_version),
-      snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
-      snmp_asn1_get_oidstr(pkt->req_pdu->pool, iter_var->name,
-        iter_var->namelen), mib_idx, max_idx);
+    if (snmp_trace_is_enabled(trace_channel, 19)) {
+      pr_trace_msg(trace_channel, 19,
+        "%s %s for OID %s at MIB index %d (max index %d)",
+        snmp_msg_get_versionstr(pkt->snmp_version),
+        snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
+        snmp_agent_get_oidstr(iter_var->name, iter_var->namelen), mib_idx,
+        max_idx);
+    }
 
     next_idx = mib_idx + 1;
 
@@ -833,12 +968,13 @@ static int snmp_agent_handle_getnext(struct snmp_packet *pkt) {
 
     if (mib_idx >= max_idx ||
         next_idx > max_idx) {
-      (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
-        "%s %s of last OID %s",
-        snmp_msg_get_versionstr(pkt->snmp_version),
-        snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
-        snmp_asn1_get_oidstr(pkt->req_pdu->pool, iter_var->name,
-          iter_var->namelen));
+      if (snmp_log_is_enabled(PR_LOG_DEBUG)) {
+        snmp_log_msg(PR_LOG_DEBUG,
+          "%s %s of last OID %s",
+          snmp_msg_get_versionstr(pkt->snmp_version),
+          snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
+          snmp_agent_get_oidstr(iter_var->name, iter_var->namelen));
+      }
 
       /* If SNMPv1, then set the err_code/err_idx values, and duplicate the
        * varlist.
@@ -851,65 +987,135 @@ static int snmp_agent_handle_getnext(struct snmp_packet *pkt) {
         case SNMP_PROTOCOL_VERSION_1:
           pkt->resp_pdu->err_code = SNMP_ERR_NO_SUCH_NAME;
           pkt->resp_pdu->err_idx = var_count + 1;
-          pkt->resp_pdu->varlist = snmp_smi_dup_var(pkt->pool,
+          pkt->resp_pdu->varlist = snmp_smi_dup_varlist(pkt->pool,
             pkt->req_pdu->varlist);
-          pkt->resp_pdu->varlistlen = pkt->req_pdu->varlistlen;
           break;
 
         case SNMP_PROTOCOL_VERSION_2:
         case SNMP_PROTOCOL_VERSION_3:
-          resp_var = snmp_smi_create_exception(pkt->pool, iter_var->name,
+          binding = push_array(resp_bindings);
+          snmp_agent_bind_exception(binding, iter_var->name,
             iter_var->namelen, SNMP_SMI_END_OF_MIB_VIEW);
           break;
       }
 
-      if (resp_var == NULL) {
+      if (binding == NULL) {
         return 0;
       }
     }
 
-    if (resp_var == NULL) {
+    if (binding == NULL) {
       /* Get the next MIB in the list. */
       mib = snmp_mib_get_by_idx(next_idx);
 
-      (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
-        "%s %s of OID %s (%s)", snmp_msg_get_versionstr(pkt->snmp_version),
-        snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
-        snmp_asn1_get_oidstr(iter_var->pool, mib->mib_oid, mib->mib_oidlen),
-        mib->mib_name);
- 
-      res = snmp_db_get_value(pkt->pool, mib->db_field, &mib_int, &mib_str,
-        &mib_strlen);
+      if (snmp_log_is_enabled(PR_LOG_DEBUG)) {
+        snmp_log_msg(PR_LOG_DEBUG,
+          "%s %s of OID %s (%s)", snmp_msg_get_versionstr(pkt->snmp_version),
+          snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
+          snmp_agent_get_oidstr(mib->mib_oid, mib->mib_oidlen),
+          mib->mib_name);
+      }
 
-      /* XXX Response with genErr instead? */
-      if (res < 0) {
-        int xerrno = errno;
+      binding = push_array(resp_bindings);
 
-        (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
-          "error retrieving database value for field %s: %s",
-          snmp_db_get_fieldstr(pkt->pool, mib->db_field), strerror(xerrno));
-        errno = xerrno;
+      if (snmp_agent_bind_mib(pkt, binding, mib) < 0) {
         return -1;
       }
-
-      resp_var = snmp_smi_create_var(pkt->pool, mib->mib_oid, mib->mib_oidlen,
-        mib->smi_type, mib_int, mib_str, mib_strlen);
     }
 
-    var_count = snmp_smi_util_add_list_var(&head_var, &tail_var, resp_var);
+    var_count = resp_bindings->nelts;
+  }
+
+  /* The response is encoded directly from the bindings. */
+  pkt->resp_pdu->varlist = NULL;
+  pkt->resp_pdu->bindings = resp_bindings;
+
+  return 0;
+}
+
+/* Calculates the encoded size of the response message for the given packet,
+ * as it currently stands.
+ */
+static int snmp_agent_get_resp_len(struct snmp_packet *pkt, size_t *resp_len) {
+  unsigned char *buf;
+  size_t buflen;
+  int res;
+
+  buf = pkt->resp_data;
+  buflen = pkt->resp_datalen;
+
+  res = snmp_msg_write(pkt->pool, &buf, &buflen, pkt->community,
+    pkt->community_len, pkt->snmp_version, pkt->resp_pdu);
+  if (res < 0) {
+    int xerrno = errno;
+
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "error calculating SNMP response message size: %s", strerror(xerrno));
+    errno = xerrno;
+    return -1;
+  }
+
+  *resp_len = buflen;
+  return 0;
+}
+
+/* Adds the given binding to the GetBulk response bindings, provided that
+ * doing so keeps the response within both the SNMPMaxMessageSize and
+ * SNMPMaxVariables limits.  If the binding does not fit, -1 is returned and
+ * errno is set to ENOSPC.
+ */
+static int snmp_agent_add_bulk_var(struct snmp_packet *pkt,
+    array_header *bindings, unsigned int *var_count, size_t *resp_len,
+    struct snmp_binding *binding) {
+  size_t varlen;
+
+  if (*var_count >= snmp_max_variables) {
+    pr_trace_msg(trace_channel, 17,
+      "GetBulk response already contains max %u variables",
+      snmp_max_variables);
+    errno = ENOSPC;
+    return -1;
+  }
+
+  varlen = snmp_smi_get_binding_len(binding, pkt->snmp_version);
+  if (varlen == 0 ||
+      (*resp_len + varlen + SNMP_AGENT_BULK_HDR_GROWTH) > snmp_max_msgsz) {
+    pr_trace_msg(trace_channel, 17,
+      "GetBulk response variable (%lu bytes) does not fit in remaining "
+      "message space (%lu bytes)", (unsigned long) varlen,
+      (unsigned long) (snmp_max_msgsz - *resp_len));
+    errno = ENOSPC;
+    return -1;
   }
 
-  pkt->resp_pdu->varlist = head_var;
-  pkt->resp_pdu->varlistlen = var_count;
+  memcpy(push_array(bindings), binding, sizeof(struct snmp_binding));
+  *var_count = bindings->nelts;
+  *resp_len += varlen;
 
   return 0;
 }
 
+/* A repeater variable of a GetBulkRequest-PDU, and how far along the MIB
+ * it has got.
+ */
+struct snmp_agent_repeater {
+  struct snmp_var *var;
+  int mib_idx;
+  struct snmp_mib *prev_mib;
+
+  /* Once done, the repeater's remaining variables are all this binding. */
+  int done;
+  struct snmp_binding binding;
+};
+
 static int snmp_agent_handle_getbulk(struct snmp_packet *pkt) {
-  register unsigned int i = 0;
-  struct snmp_var *iter_var = NULL, *head_var = NULL, *tail_var = NULL;
-  unsigned int var_count = 0;
-  int max_idx, res;
+  register unsigned int i = 0, j, k;
+  struct snmp_var *iter_var = NULL, *req_vars;
+  struct snmp_agent_repeater *repeaters = NULL;
+  array_header *resp_bindings;
+  unsigned int var_count = 0, req_var_count, nrepeaters;
+  size_t resp_len = 0;
+  int max_idx, res, resp_full = FALSE;
 
   /* SNMPv1 does not support GetBulkRequest PDUs. */
   if (pkt->snmp_version == SNMP_PROTOCOL_VERSION_1) {
@@ -920,7 +1126,8 @@ static int snmp_agent_handle_getbulk(struct snmp_packet *pkt) {
     return -1;
   }
 
-  if (pkt->req_pdu->varlist == NULL) {
+  if (pkt->req_pdu->varlist == NULL ||
+      pkt->req_pdu->varlist->nelts == 0) {
     (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
       "missing request PDU variable bindings list, rejecting invalid request");
     errno = EINVAL;
@@ -938,17 +1145,16 @@ static int snmp_agent_handle_getbulk(struct snmp_packet *pkt) {
   pkt->resp_pdu = snmp_pdu_dup(pkt->pool, pkt->req_pdu);
   pkt->resp_pdu->request_type = SNMP_PDU_RESPONSE;
 
-  if (pkt->req_pdu->varlistlen > snmp_max_variables) {
-    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
-      "%s %s of too many OIDs (%u, max %u)",
-      snmp_msg_get_versionstr(pkt->snmp_version),
-      snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
-      pkt->req_pdu->varlistlen, snmp_max_variables);
-
-    pkt->resp_pdu->err_code = SNMP_ERR_TOO_BIG;
-    pkt->resp_pdu->err_idx = 0;
+  /* Unlike the other request types, a GetBulkRequest-PDU which would produce
+   * too large a response does not get a tooBig error; instead, we return as
+   * many of the variables as will fit (RFC 3416, Section 4.2.3).  To do that,
+   * we start with the size of the response without any variables.
+   */
+  pkt->resp_pdu->varlist = NULL;
 
-    return 0;
+  res = snmp_agent_get_resp_len(pkt, &resp_len);
+  if (res < 0) {
+    return -1;
   }
 
   max_idx = snmp_mib_get_max_idx();
@@ -956,15 +1162,20 @@ static int snmp_agent_handle_getbulk(struct snmp_packet *pkt) {
   /* First, deal with the non_repeaters count.  This part is just like handling
    * any other GetNextRequest PDU.
    */
-  for (i = 0, iter_var = pkt->req_pdu->varlist;
-       i < pkt->req_pdu->non_repeaters && iter_var != NULL;
-       i++, iter_var = iter_var->next) { 
+  req_vars = pkt->req_pdu->varlist->elts;
+  req_var_count = pkt->req_pdu->varlist->nelts;
+  resp_bindings = make_array(pkt->pool, SNMP_SMI_DEFAULT_VARLIST_SIZE,
+    sizeof(struct snmp_binding));
+
+  for (i = 0;
+       i < pkt->req_pdu->non_repeaters && i < req_var_count &&
+         resp_full == FALSE;
+       i++) {
     struct snmp_mib *mib = NULL;
-    struct snmp_var *resp_var = NULL;
-    int mib_idx = -1, lacks_instance_id = FALSE;
-    int32_t mib_int = -1;
-    char *mib_str = NULL;
-    size_t mib_strlen = 0;
+    struct snmp_binding binding;
+    int mib_idx = -1, lacks_instance_id = FALSE, have_binding = FALSE;
+
+    iter_var = &(req_vars[i]);
 
     pr_signals_handle();
 
@@ -973,12 +1184,14 @@ static int snmp_agent_handle_getbulk(struct snmp_packet *pkt) {
     if (mib_idx < 0) {
       int unknown_oid = FALSE;
 
-      (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
-        "%s %s of unknown OID %s (lacks instance ID = %s)",
-        snmp_msg_get_versionstr(pkt->snmp_version),
-        snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
-        snmp_asn1_get_oidstr(pkt->req_pdu->pool, iter_var->name,
-          iter_var->namelen), lacks_instance_id ? "true" : "false");
+      if (snmp_log_is_enabled(PR_LOG_DEBUG)) {
+        snmp_log_msg(PR_LOG_DEBUG,
+          "%s %s of unknown OID %s (lacks instance ID = %s)",
+          snmp_msg_get_versionstr(pkt->snmp_version),
+          snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
+          snmp_agent_get_oidstr(iter_var->name,
+            iter_var->namelen), lacks_instance_id ? "true" : "false");
+      }
 
       if (lacks_instance_id) {
         oid_t *oid;
@@ -1014,89 +1227,97 @@ static int snmp_agent_handle_getbulk(struct snmp_packet *pkt) {
       }
 
       if (unknown_oid) {
-        resp_var = snmp_smi_create_exception(pkt->pool, iter_var->name,
+        snmp_agent_bind_exception(&binding, iter_var->name,
           iter_var->namelen, lacks_instance_id ? SNMP_SMI_NO_SUCH_INSTANCE :
             SNMP_SMI_NO_SUCH_OBJECT);
+        have_binding = TRUE;
       }
     }
 
-    pr_trace_msg(trace_channel, 19,
-      "%s %s for OID %s at MIB index %d (max index %d)",
-      snmp_msg_get_versionstr(pkt->snmp_version),
-      snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
-      snmp_asn1_get_oidstr(pkt->req_pdu->pool, iter_var->name,
-        iter_var->namelen), mib_idx, max_idx);
-
-    if (mib_idx >= max_idx) {
-      (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
-        "%s %s of last OID %s",
+    if (snmp_trace_is_enabled(trace_channel, 19)) {
+      pr_trace_msg(trace_channel, 19,
+        "%s %s for OID %s at MIB index %d (max index %d)",
         snmp_msg_get_versionstr(pkt->snmp_version),
         snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
-        snmp_asn1_get_oidstr(pkt->req_pdu->pool, iter_var->name,
-          iter_var->namelen));
+        snmp_agent_get_oidstr(iter_var->name, iter_var->namelen), mib_idx,
+        max_idx);
+    }
+
+    if (mib_idx >= max_idx) {
+      if (snmp_log_is_enabled(PR_LOG_DEBUG)) {
+        snmp_log_msg(PR_LOG_DEBUG,
+          "%s %s of last OID %s",
+          snmp_msg_get_versionstr(pkt->snmp_version),
+          snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
+          snmp_agent_get_oidstr(iter_var->name, iter_var->namelen));
+      }
 
-      resp_var = snmp_smi_create_exception(pkt->pool, iter_var->name,
+      snmp_agent_bind_exception(&binding, iter_var->name,
         iter_var->namelen, SNMP_SMI_END_OF_MIB_VIEW);
+      have_binding = TRUE;
     }
 
-    if (resp_var == NULL) {
+    if (have_binding == FALSE) {
       /* Get the next MIB in the list. */
       mib = snmp_mib_get_by_idx(mib_idx + 1);
 
-      (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
-        "%s %s of OID %s (%s)", snmp_msg_get_versionstr(pkt->snmp_version),
-        snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
-        snmp_asn1_get_oidstr(iter_var->pool, mib->mib_oid, mib->mib_oidlen),
-        mib->mib_name);
+      if (snmp_log_is_enabled(PR_LOG_DEBUG)) {
+        snmp_log_msg(PR_LOG_DEBUG,
+          "%s %s of OID %s (%s)", snmp_msg_get_versionstr(pkt->snmp_version),
+          snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
+          snmp_agent_get_oidstr(mib->mib_oid, mib->mib_oidlen),
+          mib->mib_name);
+      }
  
-      res = snmp_db_get_value(pkt->pool, mib->db_field, &mib_int, &mib_str,
-        &mib_strlen);
-
-      /* XXX Response with genErr instead? */
-      if (res < 0) {
-        int xerrno = errno;
-
-        (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
-          "error retrieving database value for field %s: %s",
-          snmp_db_get_fieldstr(pkt->pool, mib->db_field), strerror(xerrno));
-        errno = xerrno;
+      if (snmp_agent_bind_mib(pkt, &binding, mib) < 0) {
         return -1;
       }
-
-      resp_var = snmp_smi_create_var(pkt->pool, mib->mib_oid, mib->mib_oidlen,
-        mib->smi_type, mib_int, mib_str, mib_strlen);
     }
 
-    var_count = snmp_smi_util_add_list_var(&head_var, &tail_var, resp_var);
+    res = snmp_agent_add_bulk_var(pkt, resp_bindings, &var_count,
+      &resp_len, &binding);
+    if (res < 0) {
+      resp_full = TRUE;
+    }
   }
 
-  /* Now, deal with the max_repetitions count.  Keep in mind the max_variables
-   * limits.
+  /* Now, deal with the max_repetitions count, for the remaining (repeater)
+   * variables.  Per RFC 3416, Section 4.2.3, the repetitions are interleaved:
+   * the first successor of each repeater, then the second successor of each,
+   * and so on.  Thus a response truncated by the max_variables or message
+   * size limits only loses its trailing variables.
    *
-   * The iter_var variable should (after the above non_repeaters loop) be
-   * pointing at the starting variable for us to process in the max_repetitions
-   * loop.
+   * The i index should (after the above non_repeaters loop) be pointing at
+   * the first repeater.  First, find where each repeater starts.
    */
-  for (; iter_var; iter_var = iter_var->next) {
-    register unsigned int j;
-    struct snmp_mib *mib = NULL;
-    struct snmp_var *resp_var = NULL;
+  nrepeaters = 0;
+  if (resp_full == FALSE &&
+      i < req_var_count) {
+    nrepeaters = req_var_count - i;
+    repeaters = pcalloc(pkt->pool,
+      nrepeaters * sizeof(struct snmp_agent_repeater));
+  }
+
+  for (k = 0; k < nrepeaters; k++, i++) {
+    struct snmp_agent_repeater *repeater;
     int mib_idx = -1, lacks_instance_id = FALSE;
-    int32_t mib_int = -1;
-    char *mib_str = NULL;
-    size_t mib_strlen = 0;
+
+    repeater = &(repeaters[k]);
+    iter_var = repeater->var = &(req_vars[i]);
 
     mib_idx = snmp_mib_get_idx(iter_var->name, iter_var->namelen,
       &lacks_instance_id);
     if (mib_idx < 0) {
       int unknown_oid = FALSE;
 
-      (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
-        "%s %s of unknown OID %s (lacks instance ID = %s)",
-        snmp_msg_get_versionstr(pkt->snmp_version),
-        snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
-        snmp_asn1_get_oidstr(pkt->req_pdu->pool, iter_var->name,
-          iter_var->namelen), lacks_instance_id ? "true" : "false");
+      if (snmp_log_is_enabled(PR_LOG_DEBUG)) {
+        snmp_log_msg(PR_LOG_DEBUG,
+          "%s %s of unknown OID %s (lacks instance ID = %s)",
+          snmp_msg_get_versionstr(pkt->snmp_version),
+          snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
+          snmp_agent_get_oidstr(iter_var->name,
+            iter_var->namelen), lacks_instance_id ? "true" : "false");
+      }
 
       if (lacks_instance_id) {
         oid_t *oid;
@@ -1132,123 +1353,145 @@ static int snmp_agent_handle_getbulk(struct snmp_packet *pkt) {
       }
 
       if (unknown_oid) {
-        resp_var = snmp_smi_create_exception(pkt->pool, iter_var->name,
+        snmp_agent_bind_exception(&(repeater->binding), iter_var->name,
           iter_var->namelen, lacks_instance_id ? SNMP_SMI_NO_SUCH_INSTANCE :
             SNMP_SMI_NO_SUCH_OBJECT);
+        repeater->done = TRUE;
+        continue;
       }
     }
 
-    if (resp_var == NULL) {
+    if (snmp_trace_is_enabled(trace_channel, 19)) {
       pr_trace_msg(trace_channel, 19,
         "%s %s for OID %s at MIB index %d (max index %d)",
         snmp_msg_get_versionstr(pkt->snmp_version),
         snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
-        snmp_asn1_get_oidstr(pkt->req_pdu->pool, iter_var->name,
-          iter_var->namelen), mib_idx, max_idx);
+        snmp_agent_get_oidstr(iter_var->name, iter_var->namelen), mib_idx,
+        max_idx);
+    }
 
-      if (mib_idx >= max_idx) {
-        (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+    if (mib_idx >= max_idx) {
+      if (snmp_log_is_enabled(PR_LOG_DEBUG)) {
+        snmp_log_msg(PR_LOG_DEBUG,
           "%s %s of last OID %s",
           snmp_msg_get_versionstr(pkt->snmp_version),
           snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
-          snmp_asn1_get_oidstr(pkt->req_pdu->pool, iter_var->name,
-            iter_var->namelen));
-
-        resp_var = snmp_smi_create_exception(pkt->pool, iter_var->name,
-          iter_var->namelen, SNMP_SMI_END_OF_MIB_VIEW);
+          snmp_agent_get_oidstr(iter_var->name, iter_var->namelen));
       }
 
-      if (resp_var == NULL) {
-        struct snmp_mib *prev_mib = NULL;
+      snmp_agent_bind_exception(&(repeater->binding), iter_var->name,
+        iter_var->namelen, SNMP_SMI_END_OF_MIB_VIEW);
+      repeater->done = TRUE;
+      continue;
+    }
 
-        for (j = 1; j <= pkt->req_pdu->max_repetitions; j++) {
-          int next_idx;
+    repeater->mib_idx = mib_idx;
+  }
 
-          pr_signals_handle();
+  /* Then generate the repetitions, one row (of one variable per repeater)
+   * at a time.  A repeater which has reached the end of the MIB view keeps
+   * its place in each row, with an endOfMibView exception; once all of them
+   * have, there is no need for any more rows.
+   */
+  for (j = 0;
+       j < pkt->req_pdu->max_repetitions && nrepeaters > 0 &&
+         resp_full == FALSE;
+       j++) {
+    unsigned int ndone = 0;
 
-          /* Get the next MIB in the list. */
-          next_idx = mib_idx + j;
-          if (next_idx < max_idx) {
-            mib = snmp_mib_get_by_idx(next_idx);
-            while (mib != NULL &&
-                   (mib->mib_enabled == FALSE ||
-                    mib->notify_only == TRUE)) {
-              pr_signals_handle();
+    for (k = 0; k < nrepeaters; k++) {
+      struct snmp_agent_repeater *repeater;
+      struct snmp_binding binding;
 
-              if (next_idx > max_idx) {
-                break;
-              }
+      pr_signals_handle();
 
-              mib = snmp_mib_get_by_idx(++next_idx);
-            }
-          }
+      repeater = &(repeaters[k]);
 
+      if (repeater->done == FALSE) {
+        struct snmp_mib *mib = NULL;
+        int next_idx;
+
+        /* Get the next enabled MIB in the list. */
+        for (next_idx = repeater->mib_idx + 1; next_idx <= max_idx;
+             next_idx++) {
           mib = snmp_mib_get_by_idx(next_idx);
-          if (mib != NULL) {
-            (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+          if (mib != NULL &&
+              mib->mib_enabled == TRUE &&
+              mib->notify_only == FALSE) {
+            break;
+          }
+
+          mib = NULL;
+        }
+
+        if (mib != NULL) {
+          if (snmp_log_is_enabled(PR_LOG_DEBUG)) {
+            snmp_log_msg(PR_LOG_DEBUG,
               "%s %s of OID %s (%s)",
               snmp_msg_get_versionstr(pkt->snmp_version),
               snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
-              snmp_asn1_get_oidstr(iter_var->pool, mib->mib_oid,
+              snmp_agent_get_oidstr(mib->mib_oid,
                 mib->mib_oidlen), mib->mib_name);
+          }
 
-            res = snmp_db_get_value(pkt->pool, mib->db_field, &mib_int,
-              &mib_str, &mib_strlen);
+          if (snmp_agent_bind_mib(pkt, &binding, mib) < 0) {
+            return -1;
+          }
 
-            /* XXX Response with genErr instead? */
-            if (res < 0) {
-              int xerrno = errno;
+          repeater->mib_idx = next_idx;
+          repeater->prev_mib = mib;
 
-              (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
-                "error retrieving database value for field %s: %s",
-                snmp_db_get_fieldstr(pkt->pool, mib->db_field),
-                strerror(xerrno));
-              errno = xerrno;
-              return -1;
-            }
+        } else {
+          oid_t *end_oid;
+          unsigned int end_oidlen;
 
-            resp_var = snmp_smi_create_var(pkt->pool, mib->mib_oid,
-              mib->mib_oidlen, mib->smi_type, mib_int, mib_str, mib_strlen);
-            prev_mib = mib;
+          /* We want to use the OID of the last MIB we processed, or the
+           * OID in the request, whichever is present.
+           */
+          if (repeater->prev_mib != NULL) {
+            end_oid = repeater->prev_mib->mib_oid;
+            end_oidlen = repeater->prev_mib->mib_oidlen;
 
           } else {
-            oid_t *end_oid;
-            unsigned int end_oidlen;
-
-            /* We want to use the OID of the last MIB we processed, or the
-             * last OID in the request, whichever is present.
-             */
-            if (prev_mib != NULL) {
-              end_oid = prev_mib->mib_oid;
-              end_oidlen = prev_mib->mib_oidlen;
-
-            } else {
-              end_oid = iter_var->name;
-              end_oidlen = iter_var->namelen;
-            }
-
-            resp_var = snmp_smi_create_exception(pkt->pool, end_oid,
-              end_oidlen, SNMP_SMI_END_OF_MIB_VIEW);
-            var_count = snmp_smi_util_add_list_var(&head_var, &tail_var,
-              resp_var);
-            break;
+            end_oid = repeater->var->name;
+            end_oidlen = repeater->var->namelen;
           }
 
-          var_count = snmp_smi_util_add_list_var(&head_var, &tail_var,
-            resp_var);
+          snmp_agent_bind_exception(&(repeater->binding), end_oid,
+            end_oidlen, SNMP_SMI_END_OF_MIB_VIEW);
+          repeater->done = TRUE;
         }
+      }
 
-      } else {
-        var_count = snmp_smi_util_add_list_var(&head_var, &tail_var, resp_var);
+      if (repeater->done == TRUE) {
+        memcpy(&binding, &(repeater->binding), sizeof(struct snmp_binding));
+        ndone++;
       }
 
-    } else {
-      var_count = snmp_smi_util_add_list_var(&head_var, &tail_var, resp_var);
+      res = snmp_agent_add_bulk_var(pkt, resp_bindings, &var_count,
+        &resp_len, &binding);
+      if (res < 0) {
+        resp_full = TRUE;
+        break;
+      }
     }
+
+    if (ndone == nrepeaters) {
+      break;
+    }
+  }
+
+  if (resp_full) {
+    pr_trace_msg(trace_channel, 12,
+      "%s %s response truncated at %u %s (%lu bytes, max %lu)",
+      snmp_msg_get_versionstr(pkt->snmp_version),
+      snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type), var_count,
+      var_count != 1 ? "variables" : "variable", (unsigned long) resp_len,
+      (unsigned long) snmp_max_msgsz);
   }
 
-  pkt->resp_pdu->varlist = head_var;
-  pkt->resp_pdu->varlistlen = var_count;
+  /* The response is encoded directly from the bindings. */
+  pkt->resp_pdu->bindings = resp_bindings;
 
   return 0;
 }
@@ -1273,18 +1516,16 @@ static int snmp_agent_handle_set(struct snmp_packet *pkt) {
     case SNMP_PROTOCOL_VERSION_1:
       pkt->resp_pdu->err_code = SNMP_ERR_NO_SUCH_NAME;
       pkt->resp_pdu->err_idx = 1;
-      pkt->resp_pdu->varlist = snmp_smi_dup_var(pkt->pool,
+      pkt->resp_pdu->varlist = snmp_smi_dup_varlist(pkt->pool,
         pkt->req_pdu->varlist);
-      pkt->resp_pdu->varlistlen = pkt->req_pdu->varlistlen;
       break;
 
     case SNMP_PROTOCOL_VERSION_2:
     case SNMP_PROTOCOL_VERSION_3:
       pkt->resp_pdu->err_code = SNMP_ERR_NO_ACCESS;
       pkt->resp_pdu->err_idx = 1;
-      pkt->resp_pdu->varlist = snmp_smi_dup_var(pkt->pool,
+      pkt->resp_pdu->varlist = snmp_smi_dup_varlist(pkt->pool,
         pkt->req_pdu->varlist);
-      pkt->resp_pdu->varlistlen = pkt->req_pdu->varlistlen;
       break;
   }
 
@@ -1319,66 +1560,163 @@ static int snmp_agent_handle_request(struct snmp_packet *pkt) {
   return res;
 }
 
-static int snmp_agent_handle_packet(int sockfd) {
-  int nbytes, res;
-  struct sockaddr_in from_sockaddr;
-  socklen_t from_sockaddrlen;
-  pr_netaddr_t from_addr;
-  struct snmp_packet *pkt = NULL;
-  
-  pkt = snmp_packet_create(snmp_pool);
-
-  from_sockaddrlen = sizeof(struct sockaddr_in);
-  nbytes = recvfrom(sockfd, pkt->req_data, pkt->req_datalen, 0,
-    (struct sockaddr *) &from_sockaddr, &from_sockaddrlen);
-  if (nbytes < 0) {
-    int xerrno = errno;
-
-    pr_trace_msg(trace_channel, 3,
-      "error receiving data from socket %d: %s", sockfd, strerror(xerrno));
+/* Logs a single line for each handled request.  The more detailed messages
+ * about each step are only logged at SNMPLogLevel debug.
+ */
+static void snmp_agent_log_request(struct snmp_packet *pkt, int cached) {
+  unsigned int var_count;
 
-    destroy_pool(pkt->pool);
-    errno = xerrno;
-    return -1;
+  if (!snmp_log_is_enabled(PR_LOG_INFO)) {
+    return;
   }
 
-  pkt->req_datalen = nbytes;
-
-  /* XXX Support UDP/IPv6 in the future */
-
-  pr_netaddr_clear(&from_addr);
-  pr_netaddr_set_family(&from_addr, AF_INET);
-  pr_netaddr_set_sockaddr(&from_addr, (struct sockaddr *) &from_sockaddr);
-
-  pkt->remote_addr = &from_addr;
+  var_count = pkt->req_pdu->varlist != NULL ? pkt->req_pdu->varlist->nelts : 0;
 
-  pr_trace_msg(trace_channel, 3,
-    "read %d UDP bytes from %s#%u", nbytes,
+  snmp_log_msg(PR_LOG_INFO,
+    "%s#%u: %s %s, community '%s', request ID %ld, %u %s: "
+    "%s%lu bytes (error status %ld)",
     pr_netaddr_get_ipstr(pkt->remote_addr),
-    ntohs(pr_netaddr_get_port(pkt->remote_addr))); 
+    ntohs(pr_netaddr_get_port(pkt->remote_addr)),
+    snmp_msg_get_versionstr(pkt->snmp_version),
+    snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type),
+    pkt->community, pkt->req_pdu->request_id, var_count,
+    var_count != 1 ? "variables" : "variable",
+    cached ? "cached response, " : "", (unsigned long) pkt->resp_datalen,
+    pkt->resp_pdu != NULL ? pkt->resp_pdu->err_code : 0L);
+}
+
+/* Checks the outer layers of a received datagram -- the message SEQUENCE, its
+ * version, and its community -- in place, so that malformed messages, and
+ * messages with the wrong community, can be dropped before anything is
+ * allocated for them, or any further work done.  Returns -1 if the datagram
+ * should be dropped, having incremented the appropriate counter.
+ */
+static int snmp_agent_prefilter(unsigned char *data, size_t datalen,
+    const pr_netaddr_t *addr) {
+  unsigned char *community = NULL;
+  unsigned int community_len = 0;
+  long snmp_version = -1;
+  int res;
 
-  res = snmp_db_incr_value(pkt->pool, SNMP_DB_SNMP_F_PKTS_RECVD_TOTAL, 1);
+  res = snmp_msg_peek(data, datalen, &snmp_version, &community,
+    &community_len, NULL, NULL);
+  if (res < 0) {
+    if (errno == ENOSYS) {
+      snmp_log_msg(PR_LOG_DEBUG,
+        "%s messages not currently supported, dropping packet from %s#%u",
+        snmp_msg_get_versionstr(snmp_version), pr_netaddr_get_ipstr(addr),
+        ntohs(pr_netaddr_get_port(addr)));
+
+    } else {
+      snmp_log_msg(PR_LOG_DEBUG,
+        "dropping malformed SNMP message from %s#%u",
+        pr_netaddr_get_ipstr(addr), ntohs(pr_netaddr_get_port(addr)));
+    }
+
+    res = snmp_db_incr_value(snmp_pool, SNMP_DB_SNMP_F_PKTS_DROPPED_TOTAL, 1);
+    if (res < 0) {
+      (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+        "error incrementing snmp.packetsDroppedTotal: %s", strerror(errno));
+    }
+
+    return -1;
+  }
+
+  if (community_len != snmp_community_len ||
+      memcmp(community, snmp_community, community_len) != 0) {
+    /* Such packets are counted in snmp.packetsAuthFailedTotal; logging each
+     * one at a higher level would let a flood of them fill the log.
+     */
+    snmp_log_msg(PR_LOG_DEBUG,
+      "%s message from %s#%u does not match configured community, "
+      "dropping packet", snmp_msg_get_versionstr(snmp_version),
+      pr_netaddr_get_ipstr(addr), ntohs(pr_netaddr_get_port(addr)));
+
+    res = snmp_db_incr_value(snmp_pool, SNMP_DB_SNMP_F_PKTS_AUTH_ERR_TOTAL, 1);
+    if (res < 0) {
+      (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+        "error incrementing snmp.packetsAuthFailedTotal: %s", strerror(errno));
+    }
+
+    return -1;
+  }
+
+  return 0;
+}
+
+static int snmp_agent_handle_packet(int sockfd) {
+  int nbytes, res;
+  struct sockaddr_in from_sockaddr;
+  socklen_t from_sockaddrlen;
+  pr_netaddr_t from_addr;
+  struct snmp_packet *pkt = NULL;
+  unsigned char *req_data;
+  size_t req_datalen;
+
+  /* Datagrams are first received into a static buffer, so that nothing needs
+   * to be allocated for the ones which are dropped by the prefilter.
+   */
+  from_sockaddrlen = sizeof(struct sockaddr_in);
+  nbytes = recvfrom(sockfd, snmp_agent_rcvbuf, sizeof(snmp_agent_rcvbuf), 0,
+    (struct sockaddr *) &from_sockaddr, &from_sockaddrlen);
+  if (nbytes < 0) {
+    int xerrno = errno;
+
+    pr_trace_msg(trace_channel, 3,
+      "error receiving data from socket %d: %s", sockfd, strerror(xerrno));
+
+    errno = xerrno;
+    return -1;
+  }
+
+  /* XXX Support UDP/IPv6 in the future */
+
+  pr_netaddr_clear(&from_addr);
+  pr_netaddr_set_family(&from_addr, AF_INET);
+  pr_netaddr_set_sockaddr(&from_addr, (struct sockaddr *) &from_sockaddr);
+
+  if (snmp_trace_is_enabled(trace_channel, 3)) {
+    pr_trace_msg(trace_channel, 3,
+      "read %d UDP bytes from %s#%u", nbytes,
+      pr_netaddr_get_ipstr(&from_addr),
+      ntohs(pr_netaddr_get_port(&from_addr)));
+  }
+
+  res = snmp_db_incr_value(snmp_pool, SNMP_DB_SNMP_F_PKTS_RECVD_TOTAL, 1);
   if (res < 0) {
     (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
       "error incrementing SNMP database for "
       "snmp.packetsReceivedTotal: %s", strerror(errno));
   }
 
+  if (snmp_agent_prefilter(snmp_agent_rcvbuf, (size_t) nbytes,
+      &from_addr) < 0) {
+    /* Already logged and counted; during a flood of such packets, logging
+     * each one again as an error would only add to the cost.
+     */
+    return 0;
+  }
+
+  pkt = snmp_packet_create(snmp_pool);
+  memcpy(pkt->req_data, snmp_agent_rcvbuf, nbytes);
+  pkt->req_datalen = nbytes;
+  pkt->remote_addr = &from_addr;
+
   pkt->remote_class = pr_class_match_addr(&from_addr);
   if (pkt->remote_class != NULL) {
-    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+    snmp_log_msg(PR_LOG_DEBUG,
       "received %d UDP bytes from client in '%s' class", nbytes,
       pkt->remote_class->cls_name);
 
   } else {
-    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+    snmp_log_msg(PR_LOG_DEBUG,
       "received %d UDP bytes from client in unknown class", nbytes);
   }
 
   /* Note: mod_ifsession does NOT affect mod_snmp ACLs; use <Limit SNMP> */
 
   if (snmp_limits_allow(main_server->conf, pkt) == FALSE) {
-    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+    snmp_log_msg(PR_LOG_NOTICE,
       "UDP packet from %s#%u denied by <Limit SNMP> rules",
       pr_netaddr_get_ipstr(&from_addr), ntohs(pr_netaddr_get_port(&from_addr)));
 
@@ -1387,11 +1725,29 @@ static int snmp_agent_handle_packet(int sockfd) {
     return -1;
   }
 
+  /* If this is a retransmission of a request we recently answered, send
+   * the same response again, without decoding the request.
+   */
+  res = snmp_cache_retransmit_get(pkt->pool, pkt, pkt->req_data,
+    pkt->req_datalen);
+  if (res == 0) {
+    snmp_packet_write(snmp_pool, sockfd, pkt);
+
+    destroy_pool(pkt->pool);
+    return 0;
+  }
+
+  /* Reading the message advances pkt->req_data, so keep track of the raw
+   * request for the retransmission cache.
+   */
+  req_data = pkt->req_data;
+  req_datalen = pkt->req_datalen;
+
   res = snmp_msg_read(pkt->pool, &(pkt->req_data), &(pkt->req_datalen),
     &(pkt->community), &(pkt->community_len), &(pkt->snmp_version),
     &(pkt->req_pdu));
   if (res < 0) {
-    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+    snmp_log_msg(PR_LOG_NOTICE,
       "error reading SNMP message from UDP packet: %s", strerror(errno));
 
     destroy_pool(pkt->pool);
@@ -1402,7 +1758,7 @@ static int snmp_agent_handle_packet(int sockfd) {
   /* Check ACLs (community, SNMPv3, etc) */
   res = snmp_security_check(pkt);
   if (res < 0) {
-    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+    snmp_log_msg(PR_LOG_NOTICE,
       "%s message does not contain correct authentication info, "
       "ignoring message", snmp_msg_get_versionstr(pkt->snmp_version));
 
@@ -1411,28 +1767,34 @@ static int snmp_agent_handle_packet(int sockfd) {
     return -1;
   }
 
-  (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+  snmp_log_msg(PR_LOG_DEBUG,
     "read SNMP message for %s, community = '%s', request ID %ld, "
     "request type '%s'", snmp_msg_get_versionstr(pkt->snmp_version),
     pkt->community, pkt->req_pdu->request_id,
     snmp_pdu_get_request_type_desc(pkt->req_pdu->request_type));
 
+  if (snmp_cache_ttl > 0) {
+    res = snmp_cache_get(pkt->pool, pkt);
+    if (res == 0) {
+      snmp_agent_log_request(pkt, TRUE);
+      (void) snmp_cache_retransmit_add(pkt->pool, pkt, req_data, req_datalen);
+      snmp_packet_write(snmp_pool, sockfd, pkt);
+
+      destroy_pool(pkt->pool);
+      return 0;
+    }
+  }
+
   res = snmp_agent_handle_request(pkt);
   if (res < 0) {
-    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+    snmp_log_msg(PR_LOG_ERR,
       "error handling SNMP message: %s", strerror(errno));
     destroy_pool(pkt->pool);
     errno = EINVAL;
     return -1;
   }
 
-  if (pkt->req_pdu != NULL) {
-    /* We're done with the request PDU here. */
-    destroy_pool(pkt->req_pdu->pool);
-    pkt->req_pdu = NULL;
-  }
-
-  (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+  snmp_log_msg(PR_LOG_DEBUG,
     "writing SNMP message for %s, community = '%s', request ID %ld, "
     "request type '%s'", snmp_msg_get_versionstr(pkt->snmp_version),
     pkt->community, pkt->resp_pdu->request_id,
@@ -1441,7 +1803,7 @@ static int snmp_agent_handle_packet(int sockfd) {
   res = snmp_msg_write(pkt->pool, &(pkt->resp_data), &(pkt->resp_datalen),
     pkt->community, pkt->community_len, pkt->snmp_version, pkt->resp_pdu);
   if (res < 0) {
-    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+    snmp_log_msg(PR_LOG_ERR,
       "error writing SNMP message to UDP packet: %s", strerror(errno));
 
     destroy_pool(pkt->pool);
@@ -1449,6 +1811,20 @@ static int snmp_agent_handle_packet(int sockfd) {
     return -1;
   }
 
+  if (snmp_cache_ttl > 0) {
+    /* The response cache needs the request PDU for its lookup key. */
+    (void) snmp_cache_add(pkt->pool, pkt);
+  }
+
+  snmp_agent_log_request(pkt, FALSE);
+
+  if (pkt->req_pdu != NULL) {
+    /* We're done with the request PDU here. */
+    destroy_pool(pkt->req_pdu->pool);
+    pkt->req_pdu = NULL;
+  }
+
+  (void) snmp_cache_retransmit_add(pkt->pool, pkt, req_data, req_datalen);
   snmp_packet_write(snmp_pool, sockfd, pkt);
 
   destroy_pool(pkt->pool);
@@ -1480,50 +1856,235 @@ static int snmp_agent_listen(pr_netaddr_t *agent_addr) {
   return 0;
 }
 
+static array_header *snmp_agent_get_notifys(unsigned int server_id) {
+  register unsigned int i;
+  struct snmp_server_notifys *server_notifys;
+
+  if (snmp_server_notifys == NULL) {
+    return NULL;
+  }
+
+  server_notifys = snmp_server_notifys->elts;
+  for (i = 0; i < snmp_server_notifys->nelts; i++) {
+    if (server_notifys[i].server_id == server_id) {
+      return server_notifys[i].notifys;
+    }
+  }
+
+  return NULL;
+}
+
+static void snmp_agent_send_notify(struct snmp_notify_record *record) {
+  array_header *notifys;
+
+  notifys = snmp_agent_get_notifys(record->server_id);
+  if (notifys == NULL) {
+    return;
+  }
+
+  if (snmp_notify_generate(snmp_pool, -1, snmp_community, NULL, notifys,
+      record) < 0) {
+    snmp_log_msg(PR_LOG_WARNING, "unable to generate notification: %s",
+      strerror(errno));
+  }
+}
+
+/* Generates the notifications queued by the session (and daemon) processes,
+ * for their SNMPNotify receivers, subject to any SNMPNotifyRateLimit.
+ */
+static void snmp_agent_send_notifys(void) {
+  struct snmp_notify_record record;
+
+  while (snmp_notify_queue_next(&record) == 0) {
+    pr_signals_handle();
+
+    if (snmp_notify_limit(snmp_pool, &record) != TRUE) {
+      continue;
+    }
+
+    snmp_agent_send_notify(&record);
+  }
+}
+
+/* Generates the summaries of any rate-limited notifications. */
+static void snmp_agent_send_notify_summaries(void) {
+  struct snmp_notify_record record;
+
+  while (snmp_notify_get_summary(snmp_pool, &record) == 0) {
+    pr_signals_handle();
+    snmp_agent_send_notify(&record);
+  }
+}
+
+static void snmp_agent_poll_notify_cond(void *user_data) {
+  /* Pick up any queued notifications whose wakeup we missed, e.g. because
+   * their producer was slow to finish writing them.
+   */
+  snmp_agent_send_notifys();
+  snmp_agent_send_notify_summaries();
+
+  /* Evaluate any SNMPNotifyThreshold and SNMPNotifyThroughput conditions;
+   * their notifications are queued, and sent like any others.
+   */
+  if (snmp_notify_poll_cond(snmp_pool) > 0) {
+    snmp_agent_send_notifys();
+  }
+}
+
+/* Returns TRUE if there is anything for the notification polling timer to
+ * do: queued notifications (and so rate-limit summaries) to pick up, or
+ * SNMPNotifyThreshold/SNMPNotifyThroughput conditions to evaluate.
+ */
+static int snmp_agent_have_notify_cond(void) {
+  if (snmp_notify_queue_get_fd() >= 0) {
+    return TRUE;
+  }
+
+  if (find_config(main_server->conf, CONF_PARAM, "SNMPNotifyThreshold",
+        FALSE) != NULL ||
+      find_config(main_server->conf, CONF_PARAM, "SNMPNotifyThroughput",
+        FALSE) != NULL) {
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* Returns TRUE if any SNMPNotify receiver wants InformRequests. */
+static int snmp_agent_have_informs(void) {
+  register unsigned int i, j;
+  struct snmp_server_notifys *server_notifys;
+
+  if (snmp_server_notifys == NULL) {
+    return FALSE;
+  }
+
+  server_notifys = snmp_server_notifys->elts;
+  for (i = 0; i < snmp_server_notifys->nelts; i++) {
+    struct snmp_notify_receiver **receivers;
+
+    receivers = server_notifys[i].notifys->elts;
+    for (j = 0; j < server_notifys[i].notifys->nelts; j++) {
+      if (receivers[j]->flags & SNMP_NOTIFY_RECEIVER_FL_INFORM) {
+        return TRUE;
+      }
+    }
+  }
+
+  return FALSE;
+}
+
+static void snmp_agent_flush_log(void *user_data) {
+  (void) snmp_log_flush(snmp_pool);
+}
+
+static void snmp_agent_exit_ev(const void *event_data, void *user_data) {
+  /* Write any buffered SNMPLog messages, e.g. when the daemon terminates
+   * us, rather than losing them.
+   */
+  (void) snmp_log_flush(snmp_pool);
+}
+
 static void snmp_agent_loop(int sockfd, pr_netaddr_t *agent_addr) {
   fd_set listenfds;
-  struct timeval tv;
-  int res;
+  struct timeval tv, *tvp;
+  int maxfd, res, timerfd, notifyfd;
+
+  /* Periodic work (e.g. polling the trap table for any trap-generating
+   * state) is driven by timers.  If timerfd(2) is available, the timer fd
+   * becomes readable when a timer is due; otherwise, we use the time until
+   * the next timer as the select(2) timeout.  Either way, an idle agent only
+   * wakes up when there is something to do.
+   */
+  if (snmp_agent_have_notify_cond() == TRUE) {
+    if (snmp_timer_add(SNMP_NOTIFY_POLL_INTERVAL_MS,
+        snmp_agent_poll_notify_cond, NULL, "notify conditions") < 0) {
+      (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+        "error adding notification polling timer: %s", strerror(errno));
+    }
+  }
 
-  while (TRUE) {
-    /* XXX Is it necessary to even have a timeout?  We could simply block
-     * in select(2) indefinitely, until either an event arrives or we are
-     * interrupted by a signal.
-     *
-     * Yes, we DO need a timeout here, specifically to poll the trap table
-     * for any trap-generating state.  Rather than using a timer and using
-     * SIGALRM handling, we can reuse this event loop.
-     */
-    tv.tv_sec = 60;
-    tv.tv_usec = 0L;
+  if (snmp_log_bufsz > 0) {
+    if (snmp_timer_add(SNMP_LOG_FLUSH_INTERVAL_MS, snmp_agent_flush_log,
+        NULL, "log flush") < 0) {
+      (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+        "error adding SNMPLog flush timer: %s", strerror(errno));
+    }
+  }
 
-    /* To implement notification criteria/thresholds, we poll for the
-     * necessary conditions here.
-     */
-    snmp_notify_poll_cond();
+  /* The InformRequest retransmit timer is only added while InformRequests
+   * are pending.
+   */
+  if (snmp_agent_have_informs() == TRUE) {
+    (void) snmp_notify_inform_init(snmp_pool);
+  }
+
+  timerfd = snmp_timer_get_fd();
+  notifyfd = snmp_notify_queue_get_fd();
 
+  while (TRUE) {
     FD_ZERO(&listenfds);
     FD_SET(sockfd, &listenfds);
+    maxfd = sockfd;
 
-    res = select(sockfd + 1, &listenfds, NULL, NULL, &tv);
-    if (res == 0) {
-      /* Select timeout reached.  Just try again. */
-      continue;
+    if (notifyfd >= 0) {
+      FD_SET(notifyfd, &listenfds);
+      if (notifyfd > maxfd) {
+        maxfd = notifyfd;
+      }
     }
 
+    /* Responses to our InformRequests arrive on the notification sockets. */
+    maxfd = snmp_notify_inform_set_fds(&listenfds, maxfd);
+
+    tvp = NULL;
+    if (timerfd >= 0) {
+      FD_SET(timerfd, &listenfds);
+      if (timerfd > maxfd) {
+        maxfd = timerfd;
+      }
+
+    } else {
+      if (snmp_timer_get_timeout(&tv) == 0) {
+        tvp = &tv;
+      }
+    }
+
+    res = select(maxfd + 1, &listenfds, NULL, NULL, tvp);
     if (res < 0) {
       if (errno == EINTR) {
         pr_signals_handle();
-        continue;
       }
 
-    } else {
-      if (FD_ISSET(sockfd, &listenfds)) {
-        res = snmp_agent_handle_packet(sockfd);
-        if (res < 0) {
-          (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
-            "error handling SNMP packet: %s", strerror(errno));
-        } 
+      continue;
+    }
+
+    if (timerfd < 0 ||
+        FD_ISSET(timerfd, &listenfds)) {
+      snmp_timer_run();
+    }
+
+    if (res > 0) {
+      (void) snmp_notify_inform_handle_fds(snmp_pool, &listenfds);
+    }
+
+    if (res > 0 &&
+        notifyfd >= 0 &&
+        FD_ISSET(notifyfd, &listenfds)) {
+      snmp_agent_send_notifys();
+    }
+
+    if (res > 0 &&
+        FD_ISSET(sockfd, &listenfds)) {
+      res = snmp_agent_handle_packet(sockfd);
+      if (res < 0) {
+        snmp_log_msg(PR_LOG_NOTICE,
+          "error handling SNMP packet: %s", strerror(errno));
+      } 
+
+      /* Do not wait for the flush timer if the buffer is filling up. */
+      if (snmp_log_want_flush()) {
+        (void) snmp_log_flush(snmp_pool);
       }
     }
   }
@@ -1565,8 +2126,9 @@ static pid_t snmp_agent_start(const char *tables_dir, int agent_type,
   (void) signal(SIGUSR1, SIG_IGN);
   (void) signal(SIGUSR2, SIG_IGN);
 
-  /* Remove our event listeners. */
+  /* Remove our event listeners, except for flushing the SNMPLog on exit. */
   pr_event_unregister(&snmp_module, NULL, NULL);
+  pr_event_register(&snmp_module, "core.exit", snmp_agent_exit_ev, NULL);
 
   /* XXX Check the agent_type variable, to see if we are a master agent or
    * an AgentX sub-agent.
@@ -1586,6 +2148,19 @@ static pid_t snmp_agent_start(const char *tables_dir, int agent_type,
 
   PRIVS_ROOT
 
+  /* Local SNMPNotify receivers' paths cannot be reached from within the
+   * chroot; connect to them now.
+   */
+  if (snmp_server_notifys != NULL) {
+    register unsigned int i;
+    struct snmp_server_notifys *server_notifys;
+
+    server_notifys = snmp_server_notifys->elts;
+    for (i = 0; i < snmp_server_notifys->nelts; i++) {
+      (void) snmp_notify_open_local(server_notifys[i].notifys);
+    }
+  }
+
   if (getuid() == PR_ROOT_UID) {
     int res;
 
@@ -1636,11 +2211,36 @@ static pid_t snmp_agent_start(const char *tables_dir, int agent_type,
       (unsigned long) getuid(), (unsigned long) getgid(), getcwd(NULL, 0));
   }
 
+  if (snmp_cache_ttl > 0) {
+    if (snmp_cache_init(snmp_pool, snmp_cache_ttl,
+        snmp_cache_max_entries) < 0) {
+      (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+        "unable to initialize SNMP response cache: %s", strerror(errno));
+      snmp_cache_ttl = 0;
+    }
+  }
+
+  if (snmp_log_init(snmp_pool, snmp_log_bufsz) < 0) {
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "unable to initialize SNMPLog buffer: %s", strerror(errno));
+  }
+
+  if (snmp_timer_init() < 0) {
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "unable to initialize SNMP agent timers: %s", strerror(errno));
+  }
+
+  if (snmp_cache_retransmit_init(snmp_pool) < 0) {
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "unable to initialize SNMP retransmission cache: %s", strerror(errno));
+  }
+
   snmp_agent_loop(agent_fd, agent_addr);
 
   /* When we are done, we simply exit. */;
   pr_trace_msg("snmp", 3, "SNMP agent PID %lu exiting",
     (unsigned long) session.pid);
+  (void) snmp_log_flush(snmp_pool);
   exit(0);
 }
 
@@ -1795,137 +2395,409 @@ MODRET set_snmpagent(cmd_rec *cmd) {
       cmd->argv[2], "\"", NULL));
   }
 
-  pr_netaddr_set_port(agent_addr, htons(agent_port));
+  pr_netaddr_set_port(agent_addr, htons(agent_port));
+
+  c = add_config_param(cmd->argv[0], 2, NULL, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(int));
+  *((int *) c->argv[0]) = agent_type;
+  c->argv[1] = agent_addr;
+ 
+  return PR_HANDLED(cmd);
+}
+
+/* usage: SNMPCommunity community */
+MODRET set_snmpcommunity(cmd_rec *cmd) {
+  CHECK_ARGS(cmd, 1);
+  CHECK_CONF(cmd, CONF_ROOT);
+
+  (void) add_config_param_str(cmd->argv[0], 1, cmd->argv[1]);
+  return PR_HANDLED(cmd);
+}
+
+/* usage: SNMPEnable on|off */
+MODRET set_snmpenable(cmd_rec *cmd) {
+  int bool = -1;
+  config_rec *c;
+
+  CHECK_ARGS(cmd, 1);
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
+
+  bool = get_boolean(cmd, 1);
+  if (bool == -1) {
+    CONF_ERROR(cmd, "expected Boolean parameter");
+  }
+
+  c = add_config_param(cmd->argv[0], 1, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(int));
+  *((int *) c->argv[0]) = bool;
+
+  return PR_HANDLED(cmd);
+}
+
+/* usage: SNMPEngine on|off */
+MODRET set_snmpengine(cmd_rec *cmd) {
+  int bool = 1;
+  config_rec *c;
+
+  CHECK_ARGS(cmd, 1);
+  CHECK_CONF(cmd, CONF_ROOT);
+
+  bool = get_boolean(cmd, 1);
+  if (bool == -1)
+    CONF_ERROR(cmd, "expected Boolean parameter");
+
+  c = add_config_param(cmd->argv[0], 1, NULL);
+  c->argv[0] = pcalloc(c->pool, sizeof(int));
+  *((int *) c->argv[0]) = bool;
+
+  return PR_HANDLED(cmd);
+}
+
+/* usage: SNMPLog path|"none" */
+MODRET set_snmplog(cmd_rec *cmd) {
+  CHECK_ARGS(cmd, 1);
+  CHECK_CONF(cmd, CONF_ROOT);
+
+  (void) add_config_param_str(cmd->argv[0], 1, cmd->argv[1]);
+  return PR_HANDLED(cmd);
+}
+
+/* usage: SNMPLogBuffer size|"none" */
+MODRET set_snmplogbuffer(cmd_rec *cmd) {
+  int bufsz = 0;
+  config_rec *c;
+
+  CHECK_ARGS(cmd, 1);
+  CHECK_CONF(cmd, CONF_ROOT);
+
+  if (strcasecmp(cmd->argv[1], "none") != 0) {
+    bufsz = atoi(cmd->argv[1]);
+    if (bufsz < SNMP_LOG_MIN_BUFSZ) {
+      char min_str[32];
+
+      memset(min_str, '\0', sizeof(min_str));
+      snprintf(min_str, sizeof(min_str)-1, "%d", SNMP_LOG_MIN_BUFSZ);
+
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "size '", cmd->argv[1],
+        "' must be at least ", min_str, NULL));
+    }
+  }
+
+  c = add_config_param(cmd->argv[0], 1, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(size_t));
+  *((size_t *) c->argv[0]) = bufsz;
+
+  return PR_HANDLED(cmd);
+}
+
+/* usage: SNMPLogLevel error|warn|notice|info|debug */
+MODRET set_snmploglevel(cmd_rec *cmd) {
+  int level;
+  config_rec *c;
+
+  CHECK_ARGS(cmd, 1);
+  CHECK_CONF(cmd, CONF_ROOT);
+
+  if (strcasecmp(cmd->argv[1], "error") == 0) {
+    level = PR_LOG_ERR;
+
+  } else if (strcasecmp(cmd->argv[1], "warn") == 0) {
+    level = PR_LOG_WARNING;
+
+  } else if (strcasecmp(cmd->argv[1], "notice") == 0) {
+    level = PR_LOG_NOTICE;
+
+  } else if (strcasecmp(cmd->argv[1], "info") == 0) {
+    level = PR_LOG_INFO;
+
+  } else if (strcasecmp(cmd->argv[1], "debug") == 0) {
+    level = PR_LOG_DEBUG;
+
+  } else {
+    CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "unknown log level '",
+      cmd->argv[1], "'", NULL));
+  }
+
+  c = add_config_param(cmd->argv[0], 1, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(int));
+  *((int *) c->argv[0]) = level;
+
+  return PR_HANDLED(cmd);
+}
+
+/* usage: SNMPMaxVariables count */
+MODRET set_snmpmaxvariables(cmd_rec *cmd) {
+  int count = 0;
+  config_rec *c;
+
+  CHECK_ARGS(cmd, 1);
+  CHECK_CONF(cmd, CONF_ROOT);
+
+  count = atoi(cmd->argv[1]);
+  if (count < 0) {
+    CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "count '", cmd->argv[1],
+      "' must be greater than zero", NULL));
+  }
+
+  c = add_config_param(cmd->argv[0], 1, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(unsigned int));
+  *((unsigned int *) c->argv[0]) = count;
+
+  return PR_HANDLED(cmd);
+}
+
+/* usage: SNMPMaxMessageSize bytes */
+MODRET set_snmpmaxmessagesize(cmd_rec *cmd) {
+  int msgsz = 0;
+  config_rec *c;
+
+  CHECK_ARGS(cmd, 1);
+  CHECK_CONF(cmd, CONF_ROOT);
+
+  /* RFC 3417, Section 3.2, requires that we be able to send messages of
+   * at least 484 bytes.  We cannot send messages larger than our packet
+   * buffers.
+   */
+  msgsz = atoi(cmd->argv[1]);
+  if (msgsz < SNMP_PACKET_MIN_LEN ||
+      msgsz > SNMP_PACKET_MAX_LEN) {
+    char min_str[32], max_str[32];
+
+    memset(min_str, '\0', sizeof(min_str));
+    snprintf(min_str, sizeof(min_str)-1, "%d", SNMP_PACKET_MIN_LEN);
+
+    memset(max_str, '\0', sizeof(max_str));
+    snprintf(max_str, sizeof(max_str)-1, "%d", SNMP_PACKET_MAX_LEN);
+
+    CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "size '", cmd->argv[1],
+      "' must be between ", min_str, " and ", max_str, NULL));
+  }
+
+  c = add_config_param(cmd->argv[0], 1, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(size_t));
+  *((size_t *) c->argv[0]) = msgsz;
+
+  return PR_HANDLED(cmd);
+}
+
+/* usage: SNMPNotify address[:port]|/path [Inform] [Notifications name,...]
+ *          [Severity info|warning|critical]
+ */
+MODRET set_snmpnotify(cmd_rec *cmd) {
+  register unsigned int i;
+  config_rec *c;
+  struct snmp_notify_receiver *receiver;
+  pr_netaddr_t *notify_addr;
+  int notify_port = SNMP_DEFAULT_TRAP_PORT;
+  int min_severity = SNMP_NOTIFY_SEVERITY_INFO;
+  unsigned long notify_mask = 0;
+  char *ptr;
+
+  if (cmd->argc < 2) {
+    CONF_ERROR(cmd, "wrong number of parameters");
+  }
+
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
+
+  c = add_config_param(cmd->argv[0], 1, NULL);
+  receiver = pcalloc(c->pool, sizeof(struct snmp_notify_receiver));
+
+  if (*cmd->argv[1] == '/') {
+    struct sockaddr_un local_addr;
+
+    /* A local receiver, listening on a Unix domain datagram socket. */
+    if (strlen(cmd->argv[1]) >= sizeof(local_addr.sun_path)) {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "path '", cmd->argv[1],
+        "' is too long", NULL));
+    }
+
+    receiver->path = pstrdup(c->pool, cmd->argv[1]);
+    receiver->flags |= SNMP_NOTIFY_RECEIVER_FL_LOCAL;
+
+  } else {
+    /* Separate the port out from the address, if present.
+     *
+     * XXX Make sure we can handle an IPv6 address here, e.g.:
+     *
+     *   [::1]:162
+     */
+    ptr = strrchr(cmd->argv[1], ':');
+    if (ptr != NULL) {
+      *ptr = '\0';
+
+      notify_port = atoi(ptr + 1);
+      if (notify_port < 1 ||
+          notify_port > 65535) {
+        CONF_ERROR(cmd, "port must be between 1-65535");
+      }
+    }
+
+    notify_addr = pr_netaddr_get_addr(c->pool, cmd->argv[1], NULL);
+    if (notify_addr == NULL) {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "unable to resolve '",
+        cmd->argv[1], "': ", strerror(errno), NULL));
+    }
+
+    pr_netaddr_set_port(notify_addr, htons(notify_port));
+    receiver->addr = notify_addr;
+  }
+
+  for (i = 2; i < cmd->argc; i++) {
+    if (strcasecmp(cmd->argv[i], "Inform") == 0) {
+      if (receiver->flags & SNMP_NOTIFY_RECEIVER_FL_LOCAL) {
+        CONF_ERROR(cmd, "Inform cannot be used for local receivers");
+      }
 
-  c = add_config_param(cmd->argv[0], 2, NULL, NULL);
-  c->argv[0] = palloc(c->pool, sizeof(int));
-  *((int *) c->argv[0]) = agent_type;
-  c->argv[1] = agent_addr;
- 
-  return PR_HANDLED(cmd);
-}
+      receiver->flags |= SNMP_NOTIFY_RECEIVER_FL_INFORM;
 
-/* usage: SNMPCommunity community */
-MODRET set_snmpcommunity(cmd_rec *cmd) {
-  CHECK_ARGS(cmd, 1);
-  CHECK_CONF(cmd, CONF_ROOT);
+    } else if (strcasecmp(cmd->argv[i], "Notifications") == 0) {
+      char *names, *name;
 
-  (void) add_config_param_str(cmd->argv[0], 1, cmd->argv[1]);
-  return PR_HANDLED(cmd);
-}
+      if (i + 1 >= cmd->argc) {
+        CONF_ERROR(cmd, "Notifications requires a list of notifications");
+      }
 
-/* usage: SNMPEnable on|off */
-MODRET set_snmpenable(cmd_rec *cmd) {
-  int bool = -1;
-  config_rec *c;
+      names = cmd->argv[++i];
+      while ((name = pr_str_get_token(&names, ",")) != NULL) {
+        int notify_id;
 
-  CHECK_ARGS(cmd, 1);
-  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
+        pr_signals_handle();
 
-  bool = get_boolean(cmd, 1);
-  if (bool == -1) {
-    CONF_ERROR(cmd, "expected Boolean parameter");
-  }
+        if (*name == '\0') {
+          continue;
+        }
 
-  c = add_config_param(cmd->argv[0], 1, NULL);
-  c->argv[0] = palloc(c->pool, sizeof(int));
-  *((int *) c->argv[0]) = bool;
+        notify_id = snmp_notify_get_id(name);
+        if (notify_id < 0) {
+          CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "unknown notification '",
+            name, "'", NULL));
+        }
 
-  return PR_HANDLED(cmd);
-}
+        notify_mask |= snmp_notify_get_mask(notify_id);
+      }
 
-/* usage: SNMPEngine on|off */
-MODRET set_snmpengine(cmd_rec *cmd) {
-  int bool = 1;
-  config_rec *c;
+    } else if (strcasecmp(cmd->argv[i], "Severity") == 0) {
+      const char *severity;
 
-  CHECK_ARGS(cmd, 1);
-  CHECK_CONF(cmd, CONF_ROOT);
+      if (i + 1 >= cmd->argc) {
+        CONF_ERROR(cmd, "Severity requires a severity");
+      }
 
-  bool = get_boolean(cmd, 1);
-  if (bool == -1)
-    CONF_ERROR(cmd, "expected Boolean parameter");
+      severity = cmd->argv[++i];
+      if (strcasecmp(severity, "info") == 0) {
+        min_severity = SNMP_NOTIFY_SEVERITY_INFO;
 
-  c = add_config_param(cmd->argv[0], 1, NULL);
-  c->argv[0] = pcalloc(c->pool, sizeof(int));
-  *((int *) c->argv[0]) = bool;
+      } else if (strcasecmp(severity, "warning") == 0) {
+        min_severity = SNMP_NOTIFY_SEVERITY_WARNING;
 
-  return PR_HANDLED(cmd);
-}
+      } else if (strcasecmp(severity, "critical") == 0) {
+        min_severity = SNMP_NOTIFY_SEVERITY_CRITICAL;
 
-/* usage: SNMPLog path|"none" */
-MODRET set_snmplog(cmd_rec *cmd) {
-  CHECK_ARGS(cmd, 1);
-  CHECK_CONF(cmd, CONF_ROOT);
+      } else {
+        CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "unknown severity '",
+          severity, "'", NULL));
+      }
 
-  (void) add_config_param_str(cmd->argv[0], 1, cmd->argv[1]);
+    } else {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "unknown SNMPNotify option '",
+        cmd->argv[i], "'", NULL));
+    }
+  }
+
+  /* Compile the filters into the single mask tested for each notification. */
+  if (notify_mask == 0) {
+    notify_mask = SNMP_NOTIFY_RECEIVER_MASK_ALL;
+  }
+
+  receiver->notify_mask = notify_mask &
+    snmp_notify_get_severity_mask(min_severity);
+  if (receiver->notify_mask == 0) {
+    CONF_ERROR(cmd, "filters exclude every notification");
+  }
+
+  c->argv[0] = receiver;
   return PR_HANDLED(cmd);
 }
 
-/* usage: SNMPMaxVariables count */
-MODRET set_snmpmaxvariables(cmd_rec *cmd) {
-  int count = 0;
+/* usage: SNMPNotifyRateLimit count secs */
+MODRET set_snmpnotifyratelimit(cmd_rec *cmd) {
   config_rec *c;
+  int count, secs;
 
-  CHECK_ARGS(cmd, 1);
+  CHECK_ARGS(cmd, 2);
   CHECK_CONF(cmd, CONF_ROOT);
 
   count = atoi(cmd->argv[1]);
-  if (count < 0) {
+  if (count < 1) {
     CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "count '", cmd->argv[1],
       "' must be greater than zero", NULL));
   }
 
-  c = add_config_param(cmd->argv[0], 1, NULL);
+  secs = atoi(cmd->argv[2]);
+  if (secs < 1) {
+    CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "secs '", cmd->argv[2],
+      "' must be greater than zero", NULL));
+  }
+
+  c = add_config_param(cmd->argv[0], 2, NULL, NULL);
   c->argv[0] = palloc(c->pool, sizeof(unsigned int));
   *((unsigned int *) c->argv[0]) = count;
+  c->argv[1] = palloc(c->pool, sizeof(unsigned int));
+  *((unsigned int *) c->argv[1]) = secs;
 
   return PR_HANDLED(cmd);
 }
 
-/* usage: SNMPNotify address[:port]
- *
- * XXX In the future, allow specifying of notification types/thresholds
- */
-MODRET set_snmpnotify(cmd_rec *cmd) {
+/* usage: SNMPNotifyThreshold expr op limit [clear] */
+MODRET set_snmpnotifythreshold(cmd_rec *cmd) {
   config_rec *c;
-  pr_netaddr_t *notify_addr;
-  int notify_port = SNMP_DEFAULT_TRAP_PORT;
-  char *ptr;
+  struct snmp_threshold *threshold;
+  const char *errstr = NULL;
 
-  if (cmd->argc != 2) {
+  if (cmd->argc < 4 ||
+      cmd->argc > 5) {
     CONF_ERROR(cmd, "wrong number of parameters");
   }
 
-  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
+  CHECK_CONF(cmd, CONF_ROOT);
 
-  /* Separate the port out from the address, if present.
-   *
-   * XXX Make sure we can handle an IPv6 address here, e.g.:
-   *
-   *   [::1]:162
-   */
-  ptr = strrchr(cmd->argv[1], ':');
-  if (ptr != NULL) {
-    *ptr = '\0';
+  c = add_config_param(cmd->argv[0], 1, NULL);
 
-    notify_port = atoi(ptr + 1);
-    if (notify_port < 1 ||
-        notify_port > 65535) {
-      CONF_ERROR(cmd, "port must be between 1-65535");
-    }
+  threshold = snmp_threshold_parse(c->pool, cmd->argv[1], cmd->argv[2],
+    cmd->argv[3], cmd->argc == 5 ? cmd->argv[4] : NULL, &errstr);
+  if (threshold == NULL) {
+    CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "badly formatted threshold: ",
+      errstr, NULL));
   }
- 
-  c = add_config_param(cmd->argv[0], 1, NULL);
 
-  notify_addr = pr_netaddr_get_addr(c->pool, cmd->argv[1], NULL);
-  if (notify_addr == NULL) {
-    CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "unable to resolve '", cmd->argv[1],
-      "': ", strerror(errno), NULL));
+  c->argv[0] = threshold;
+  return PR_HANDLED(cmd);
+}
+
+/* usage: SNMPNotifyThroughput fraction */
+MODRET set_snmpnotifythroughput(cmd_rec *cmd) {
+  config_rec *c;
+  char *ptr = NULL;
+  double fraction;
+
+  CHECK_ARGS(cmd, 1);
+  CHECK_CONF(cmd, CONF_ROOT);
+
+  fraction = strtod(cmd->argv[1], &ptr);
+  if (ptr == cmd->argv[1] ||
+      *ptr != '\0' ||
+      fraction <= 0.0 ||
+      fraction >= 1.0) {
+    CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "fraction '", cmd->argv[1],
+      "' must be between 0 and 1", NULL));
   }
 
-  pr_netaddr_set_port(notify_addr, htons(notify_port));
-  c->argv[0] = notify_addr;
+  c = add_config_param(cmd->argv[0], 1, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(unsigned int));
+  *((unsigned int *) c->argv[0]) = (unsigned int) (fraction * 1000.0);
+  if (*((unsigned int *) c->argv[0]) == 0) {
+    *((unsigned int *) c->argv[0]) = 1;
+  }
 
   return PR_HANDLED(cmd);
 }
@@ -1974,6 +2846,41 @@ MODRET set_snmpoptions(cmd_rec *cmd) {
   return PR_HANDLED(cmd);
 }
 
+/* usage: SNMPResponseCache millisecs [max-entries] */
+MODRET set_snmpresponsecache(cmd_rec *cmd) {
+  config_rec *c;
+  int ttl, max_entries = SNMP_CACHE_DEFAULT_MAX_ENTRIES;
+
+  if (cmd->argc < 2 ||
+      cmd->argc > 3) {
+    CONF_ERROR(cmd, "wrong number of parameters");
+  }
+
+  CHECK_CONF(cmd, CONF_ROOT);
+
+  ttl = atoi(cmd->argv[1]);
+  if (ttl < 0) {
+    CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "millisecs '", cmd->argv[1],
+      "' must be zero or greater", NULL));
+  }
+
+  if (cmd->argc == 3) {
+    max_entries = atoi(cmd->argv[2]);
+    if (max_entries < 1) {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "max-entries '", cmd->argv[2],
+        "' must be greater than zero", NULL));
+    }
+  }
+
+  c = add_config_param(cmd->argv[0], 2, NULL, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(unsigned long));
+  *((unsigned long *) c->argv[0]) = ttl;
+  c->argv[1] = palloc(c->pool, sizeof(unsigned int));
+  *((unsigned int *) c->argv[1]) = max_entries;
+
+  return PR_HANDLED(cmd);
+}
+
 /* usage: SNMPTables path */
 MODRET set_snmptables(cmd_rec *cmd) {
   int res;
@@ -2571,6 +3478,12 @@ MODRET snmp_log_retr(cmd_rec *cmd) {
     snmp_retr_bytes = rem_bytes;
   }
 
+  if (snmp_throughput_add(proto, session.xfer.total_bytes,
+      &(session.xfer.start_time)) < 0) {
+    pr_trace_msg(trace_channel, 3,
+      "unable to report transfer throughput: %s", strerror(errno));
+  }
+
   return PR_DECLINED(cmd);
 }
 
@@ -2894,6 +3807,12 @@ MODRET snmp_log_stor(cmd_rec *cmd) {
     snmp_stor_bytes = rem_bytes;
   }
 
+  if (snmp_throughput_add(proto, session.xfer.total_bytes,
+      &(session.xfer.start_time)) < 0) {
+    pr_trace_msg(trace_channel, 3,
+      "unable to report transfer throughput: %s", strerror(errno));
+  }
+
   return PR_DECLINED(cmd);
 }
 
@@ -3023,6 +3942,29 @@ MODRET snmp_log_auth(cmd_rec *cmd) {
   return PR_DECLINED(cmd);
 }
 
+/* Returns the list of SNMPNotify receivers configured for the given server,
+ * or NULL if there are none.
+ */
+static array_header *snmp_get_notifys(pool *p, server_rec *s) {
+  config_rec *c;
+  array_header *notifys = NULL;
+
+  c = find_config(s->conf, CONF_PARAM, "SNMPNotify", FALSE);
+  while (c != NULL) {
+    pr_signals_handle();
+
+    if (notifys == NULL) {
+      notifys = make_array(p, 1, sizeof(struct snmp_notify_receiver *));
+    }
+
+    *((struct snmp_notify_receiver **) push_array(notifys)) = c->argv[0];
+
+    c = find_config_next(c, c->next, CONF_PARAM, "SNMPNotify", FALSE);
+  }
+
+  return notifys;
+}
+
 /* Event handlers
  */
 
@@ -3044,8 +3986,50 @@ static void ev_incr_value(unsigned int field_id, const char *field_str,
   }
 }
 
+/* Sends the given notification to the SNMPNotify receivers.  Normally, the
+ * notification is queued for the SNMP agent process to generate and send,
+ * so that this process does not wait on the receivers.
+ */
+static void ev_notify(unsigned int notify_id, const char *notify_str) {
+  struct snmp_notify_record record;
+  pool *p;
+
+  if (snmp_notifys == NULL) {
+    return;
+  }
+
+  p = session.pool;
+  if (p == NULL) {
+    p = snmp_pool;
+  }
+
+  if (snmp_notify_record_init(p, &record, notify_id) < 0) {
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "unable to create %s notification: %s", notify_str, strerror(errno));
+    return;
+  }
+
+  if (snmp_notify_queue_add(p, &record) == 0) {
+    return;
+  }
+
+  if (errno != ENOSYS) {
+    pr_trace_msg(trace_channel, 3,
+      "unable to queue %s notification for SNMP agent: %s", notify_str,
+      strerror(errno));
+    return;
+  }
+
+  /* No notification queue on this platform; send them ourselves. */
+  if (snmp_notify_generate(snmp_pool, -1, snmp_community,
+      session.c ? session.c->local_addr : NULL, snmp_notifys, &record) < 0) {
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "unable to generate %s notification: %s", notify_str, strerror(errno));
+  }
+}
+
 static void snmp_auth_code_ev(const void *event_data, void *user_data) {
-  int auth_code, res;
+  int auth_code;
   unsigned int field_id, notify_id = 0;
   const char *notify_str = NULL, *proto;
 
@@ -3085,22 +4069,8 @@ static void snmp_auth_code_ev(const void *event_data, void *user_data) {
  
   ev_incr_value(field_id, "login failure total", 1); 
 
-  if (notify_id > 0 &&
-      snmp_notifys != NULL) {
-    register unsigned int i;
-    pr_netaddr_t **dst_addrs;
-
-    dst_addrs = snmp_notifys->elts;
-    for (i = 0; i < snmp_notifys->nelts; i++) {
-      res = snmp_notify_generate(snmp_pool, -1, snmp_community,
-        session.c->local_addr, dst_addrs[i], notify_id);
-      if (res < 0) {
-        (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
-          "unable to send %s notification to SNMPNotify %s:%d: %s", notify_str,
-          pr_netaddr_get_ipstr(dst_addrs[i]),
-          ntohs(pr_netaddr_get_port(dst_addrs[i])), strerror(errno));
-      }
-    }
+  if (notify_id > 0) {
+    ev_notify(notify_id, notify_str);
   }
 }
 
@@ -3149,6 +4119,7 @@ static void snmp_exit_ev(const void *event_data, void *user_data) {
   }
 
   if (snmp_logfd >= 0) {
+    (void) snmp_log_flush(session.pool ? session.pool : snmp_pool);
     (void) close(snmp_logfd);
     snmp_logfd = -1;
   }
@@ -3161,25 +4132,8 @@ static void snmp_max_inst_ev(const void *event_data, void *user_data) {
 
   ev_incr_value(SNMP_DB_DAEMON_F_MAXINST_TOTAL,
     "daemon.maxInstancesLimitTotal", 1);
-  
-  if (snmp_notifys != NULL) {
-    register unsigned int i;
-    pr_netaddr_t **dst_addrs;
-    unsigned int notify_id = SNMP_NOTIFY_DAEMON_MAX_INSTANCES;
-    int res;
 
-    dst_addrs = snmp_notifys->elts;
-    for (i = 0; i < snmp_notifys->nelts; i++) {
-      res = snmp_notify_generate(snmp_pool, -1, snmp_community,
-        session.c->local_addr, dst_addrs[i], notify_id);
-      if (res < 0) {
-        (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
-          "unable to send daemonMaxInstancesExceeded notification to "
-          "SNMPNotify %s:%d: %s", pr_netaddr_get_ipstr(dst_addrs[i]),
-          ntohs(pr_netaddr_get_port(dst_addrs[i])), strerror(errno));
-      }
-    }
-  }
+  ev_notify(SNMP_NOTIFY_DAEMON_MAX_INSTANCES, "daemonMaxInstancesExceeded");
 }
 
 #if defined(PR_SHARED_MODULE)
@@ -3194,6 +4148,9 @@ static void snmp_mod_unload_ev(const void *event_data, void *user_data) {
       snmp_db_close(snmp_pool, snmp_table_ids[i]);
     }
 
+    (void) snmp_notify_queue_close();
+    (void) snmp_throughput_close();
+
     destroy_pool(snmp_pool);
     snmp_pool = NULL;
 
@@ -3211,6 +4168,7 @@ static void snmp_postparse_ev(const void *event_data, void *user_data) {
   const char *tables_dir;
   int agent_type, res;
   pr_netaddr_t *agent_addr;
+  array_header *thresholds;
   unsigned char ban_loaded = FALSE, sftp_loaded = FALSE, tls_loaded = FALSE;
 
   c = find_config(main_server->conf, CONF_PARAM, "SNMPEngine", FALSE);
@@ -3224,6 +4182,16 @@ static void snmp_postparse_ev(const void *event_data, void *user_data) {
 
   snmp_openlog();
 
+  c = find_config(main_server->conf, CONF_PARAM, "SNMPLogLevel", FALSE);
+  if (c != NULL) {
+    snmp_log_set_level(*((int *) c->argv[0]));
+  }
+
+  c = find_config(main_server->conf, CONF_PARAM, "SNMPLogBuffer", FALSE);
+  if (c != NULL) {
+    snmp_log_bufsz = *((size_t *) c->argv[0]);
+  }
+
   c = find_config(main_server->conf, CONF_PARAM, "SNMPOptions", FALSE);
   while (c != NULL) {
     unsigned long opts = 0;
@@ -3249,12 +4217,24 @@ static void snmp_postparse_ev(const void *event_data, void *user_data) {
   }
 
   snmp_community = c->argv[0];
+  snmp_community_len = strlen(snmp_community);
+
+  c = find_config(main_server->conf, CONF_PARAM, "SNMPMaxMessageSize", FALSE);
+  if (c != NULL) {
+    snmp_max_msgsz = *((size_t *) c->argv[0]);
+  }
 
   c = find_config(main_server->conf, CONF_PARAM, "SNMPMaxVariables", FALSE);
   if (c != NULL) {
     snmp_max_variables = *((unsigned int *) c->argv[0]);
   }
 
+  c = find_config(main_server->conf, CONF_PARAM, "SNMPResponseCache", FALSE);
+  if (c != NULL) {
+    snmp_cache_ttl = *((unsigned long *) c->argv[0]);
+    snmp_cache_max_entries = *((unsigned int *) c->argv[1]);
+  }
+
   c = find_config(main_server->conf, CONF_PARAM, "SNMPTables", FALSE);
   if (c == NULL) {
     /* No SNMPTables configured, mod_snmp cannot run. */
@@ -3333,6 +4313,11 @@ static void snmp_postparse_ev(const void *event_data, void *user_data) {
   /* Initial the MIBs. */
   snmp_mib_init();
 
+  if (snmp_notify_init_templates(snmp_community) < 0) {
+    pr_trace_msg(trace_channel, 3,
+      "unable to create notification templates: %s", strerror(errno));
+  }
+
   /* Iterate through the server_list, and count up the number of vhosts. */
   for (s = (server_rec *) server_list->xas_list; s; s = s->next) {
     nvhosts++;
@@ -3340,6 +4325,89 @@ static void snmp_postparse_ev(const void *event_data, void *user_data) {
 
   ev_incr_value(SNMP_DB_DAEMON_F_VHOST_COUNT, "daemon.vhostCount", nvhosts);
 
+  /* Collect the SNMPNotify receivers of every server, for the agent process,
+   * and those of the main server, for notifications from this process.
+   */
+  snmp_notifys = NULL;
+  snmp_server_notifys = NULL;
+
+  for (s = (server_rec *) server_list->xas_list; s; s = s->next) {
+    array_header *notifys;
+    struct snmp_server_notifys *server_notifys;
+
+    notifys = snmp_get_notifys(snmp_pool, s);
+    if (notifys == NULL) {
+      continue;
+    }
+
+    if (s == main_server) {
+      snmp_notifys = notifys;
+    }
+
+    if (snmp_server_notifys == NULL) {
+      snmp_server_notifys = make_array(snmp_pool, 1,
+        sizeof(struct snmp_server_notifys));
+    }
+
+    server_notifys = push_array(snmp_server_notifys);
+    server_notifys->server_id = s->sid;
+    server_notifys->notifys = notifys;
+  }
+
+  if (snmp_server_notifys != NULL) {
+    if (snmp_notify_queue_open(snmp_pool) < 0) {
+      /* Without the queue, processes send their notifications themselves. */
+      pr_trace_msg(trace_channel, 3,
+        "unable to open notification queue: %s", strerror(errno));
+    }
+  }
+
+  /* Notifications are only rate-limited by the agent, i.e. when queued. */
+  c = find_config(main_server->conf, CONF_PARAM, "SNMPNotifyRateLimit", FALSE);
+  if (c != NULL) {
+    (void) snmp_notify_set_limit(*((unsigned int *) c->argv[0]),
+      *((unsigned int *) c->argv[1]));
+
+  } else {
+    (void) snmp_notify_set_limit(0, 0);
+  }
+
+  /* Thresholds are evaluated by the agent, on its notification timer. */
+  thresholds = NULL;
+
+  c = find_config(main_server->conf, CONF_PARAM, "SNMPNotifyThreshold", FALSE);
+  while (c != NULL) {
+    pr_signals_handle();
+
+    if (thresholds == NULL) {
+      thresholds = make_array(snmp_pool, 1, sizeof(struct snmp_threshold *));
+    }
+
+    *((struct snmp_threshold **) push_array(thresholds)) = c->argv[0];
+
+    c = find_config_next(c, c->next, CONF_PARAM, "SNMPNotifyThreshold", FALSE);
+  }
+
+  (void) snmp_threshold_set(thresholds);
+
+  /* Transfer throughputs are reported by the session processes, and
+   * evaluated by the agent, on its notification timer.
+   */
+  c = find_config(main_server->conf, CONF_PARAM, "SNMPNotifyThroughput",
+    FALSE);
+  if (c != NULL) {
+    (void) snmp_throughput_set(*((unsigned int *) c->argv[0]));
+
+    if (snmp_throughput_open(snmp_pool) < 0) {
+      (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+        "unable to open transfer throughput queue, ignoring "
+        "SNMPNotifyThroughput: %s", strerror(errno));
+    }
+
+  } else {
+    (void) snmp_throughput_set(0);
+  }
+
   c = find_config(main_server->conf, CONF_PARAM, "SNMPAgent", FALSE);
   if (c == NULL) {
     snmp_engine = FALSE;
@@ -3409,6 +4477,9 @@ static void snmp_shutdown_ev(const void *event_data, void *user_data) {
     snmp_db_close(snmp_pool, snmp_table_ids[i]);
   }
 
+  (void) snmp_notify_queue_close();
+  (void) snmp_throughput_close();
+
   destroy_pool(snmp_pool);
   snmp_pool = NULL;
 
@@ -3844,18 +4915,7 @@ static int snmp_sess_init(void) {
   srandom((unsigned int) (time(NULL) * getpid())); 
 #endif /* HAVE_RANDOM */
 
-  c = find_config(main_server->conf, CONF_PARAM, "SNMPNotify", FALSE);
-  while (c != NULL) {
-    pr_signals_handle();
-
-    if (snmp_notifys == NULL) {
-      snmp_notifys = make_array(session.pool, 1, sizeof(pr_netaddr_t *));
-    }
-
-    *((pr_netaddr_t **) push_array(snmp_notifys)) = c->argv[0];
-
-    c = find_config_next(c, c->next, CONF_PARAM, "SNMPNotify", FALSE);
-  }
+  snmp_notifys = snmp_get_notifys(session.pool, main_server);
 
   return 0;
 }
@@ -3869,9 +4929,16 @@ static conftable snmp_conftab[] = {
   { "SNMPEnable",	set_snmpenable,		NULL },
   { "SNMPEngine",	set_snmpengine,		NULL },
   { "SNMPLog",		set_snmplog,		NULL },
+  { "SNMPLogBuffer",	set_snmplogbuffer,	NULL },
+  { "SNMPLogLevel",	set_snmploglevel,	NULL },
+  { "SNMPMaxMessageSize",set_snmpmaxmessagesize,	NULL },
   { "SNMPMaxVariables",	set_snmpmaxvariables,	NULL },
   { "SNMPNotify",	set_snmpnotify,		NULL },
+  { "SNMPNotifyRateLimit",set_snmpnotifyratelimit,	NULL },
+  { "SNMPNotifyThreshold",set_snmpnotifythreshold,	NULL },
+  { "SNMPNotifyThroughput",set_snmpnotifythroughput,	NULL },
   { "SNMPOptions",	set_snmpoptions,	NULL },
+  { "SNMPResponseCache",set_snmpresponsecache,	NULL },
   { "SNMPTables",	set_snmptables,		NULL },
   { NULL }
 };
@@ -100,8 +100,10 @@ int snmp_msg_read(pool *p, unsigned char **buf, size_t *buflen,
     return -1;
   }
 
-  pr_trace_msg(trace_channel, 17,
-    "read SNMP message for %s", snmp_msg_get_versionstr(*snmp_version));
+  if (snmp_trace_is_enabled(trace_channel, 17)) {
+    pr_trace_msg(trace_channel, 17,
+      "read SNMP message for %s", snmp_msg_get_versionstr(*snmp_version));
+  }
 
   /* XXX Don't support SNMPv3 yet. */
 
@@ -136,9 +138,11 @@ int snmp_msg_read(pool *p, unsigned char **buf, size_t *buflen,
     return -1;
   }
 
-  pr_trace_msg(trace_channel, 17,
-    "read %s message: community = '%s'",
-    snmp_msg_get_versionstr(*snmp_version), *community);
+  if (snmp_trace_is_enabled(trace_channel, 17)) {
+    pr_trace_msg(trace_channel, 17,
+      "read %s message: community = '%s'",
+      snmp_msg_get_versionstr(*snmp_version), *community);
+  }
 
   res = snmp_pdu_read(p, buf, buflen, pdu, *snmp_version);
   if (res < 0) {
@@ -148,13 +152,192 @@ int snmp_msg_read(pool *p, unsigned char **buf, size_t *buflen,
   return 0;
 }
 
+/* Reads an ASN.1 tag and length in place, without allocating, tracing, or
+ * copying; the value pointer is left pointing at the start of the value.
+ */
+static int msg_peek_header(unsigned char **buf, size_t *buflen,
+    unsigned char *asn1_type, size_t *asn1_len) {
+  unsigned char *ptr, len_byte;
+  size_t len, remaining;
+
+  ptr = *buf;
+  remaining = *buflen;
+
+  if (remaining < 2) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  *asn1_type = *ptr++;
+  len_byte = *ptr++;
+  remaining -= 2;
+
+  if (!(len_byte & SNMP_ASN1_LEN_LONG)) {
+    len = len_byte;
+
+  } else {
+    register unsigned int i;
+    unsigned int nbytes;
+
+    nbytes = (len_byte & ~SNMP_ASN1_LEN_LONG);
+
+    /* Indefinite lengths are not allowed, and we do not expect lengths
+     * larger than a packet.
+     */
+    if (nbytes == 0 ||
+        nbytes > sizeof(unsigned int) ||
+        nbytes > remaining) {
+      errno = EINVAL;
+      return -1;
+    }
+
+    len = 0;
+    for (i = 0; i < nbytes; i++) {
+      len = (len << 8) | *ptr++;
+    }
+
+    remaining -= nbytes;
+  }
+
+  if (len > remaining) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  *asn1_len = len;
+  *buf = ptr;
+  *buflen = remaining;
+
+  return 0;
+}
+
+static int msg_peek_int(unsigned char **buf, size_t *buflen,
+    long *asn1_int) {
+  register unsigned int i;
+  unsigned char asn1_type;
+  size_t asn1_len;
+  unsigned long val;
+
+  if (msg_peek_header(buf, buflen, &asn1_type, &asn1_len) < 0) {
+    return -1;
+  }
+
+  if (asn1_type != (SNMP_ASN1_CLASS_UNIVERSAL|SNMP_ASN1_PRIMITIVE|SNMP_ASN1_TYPE_INTEGER) ||
+      asn1_len == 0 ||
+      asn1_len > sizeof(long)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  /* Sign-extend from the first byte. */
+  val = ((*buf)[0] & 0x80) ? ~0UL : 0UL;
+  for (i = 0; i < asn1_len; i++) {
+    val = (val << 8) | (*buf)[i];
+  }
+
+  *asn1_int = (long) val;
+  (*buf) += asn1_len;
+  (*buflen) -= asn1_len;
+
+  return 0;
+}
+
+/* Inspects the outer layers of an SNMPv1/SNMPv2c message in place:
+ *
+ *  SEQUENCE { version, community, PDU { request-id, ... } }
+ *
+ * This is much cheaper than snmp_msg_read(): nothing is allocated or copied,
+ * and the returned community points into the given buffer (and is NOT
+ * NUL-terminated).  Only the structure needed for the returned fields is
+ * checked.  If the message is for an unsupported SNMP version, -1 is returned
+ * with errno set to ENOSYS; the version will have been filled in.
+ */
+int snmp_msg_peek(unsigned char *buf, size_t buflen, long *snmp_version,
+    unsigned char **community, unsigned int *community_len,
+    unsigned char *pdu_type, long *request_id) {
+  unsigned char asn1_type;
+  size_t asn1_len;
+  long version, id;
+
+  if (buf == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (msg_peek_header(&buf, &buflen, &asn1_type, &asn1_len) < 0) {
+    return -1;
+  }
+
+  if (asn1_type != (SNMP_ASN1_TYPE_SEQUENCE|SNMP_ASN1_CONSTRUCT)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  /* Ignore any trailing bytes after the message. */
+  buflen = asn1_len;
+
+  if (msg_peek_int(&buf, &buflen, &version) < 0) {
+    return -1;
+  }
+
+  if (snmp_version != NULL) {
+    *snmp_version = version;
+  }
+
+  if (version != SNMP_PROTOCOL_VERSION_1 &&
+      version != SNMP_PROTOCOL_VERSION_2) {
+    errno = ENOSYS;
+    return -1;
+  }
+
+  if (msg_peek_header(&buf, &buflen, &asn1_type, &asn1_len) < 0) {
+    return -1;
+  }
+
+  if (asn1_type != (SNMP_ASN1_CLASS_UNIVERSAL|SNMP_ASN1_PRIMITIVE|SNMP_ASN1_TYPE_OCTETSTRING)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (community != NULL) {
+    *community = buf;
+  }
+
+  if (community_len != NULL) {
+    *community_len = asn1_len;
+  }
+
+  buf += asn1_len;
+  buflen -= asn1_len;
+
+  if (msg_peek_header(&buf, &buflen, &asn1_type, &asn1_len) < 0) {
+    return -1;
+  }
+
+  if (pdu_type != NULL) {
+    *pdu_type = asn1_type;
+  }
+
+  buflen = asn1_len;
+
+  if (msg_peek_int(&buf, &buflen, &id) < 0) {
+    return -1;
+  }
+
+  if (request_id != NULL) {
+    *request_id = id;
+  }
+
+  return 0;
+}
+
 int snmp_msg_write(pool *p, unsigned char **buf, size_t *buflen,
     char *community, unsigned int community_len, long snmp_version,
     struct snmp_pdu *pdu) {
   unsigned char asn1_type;
   unsigned int asn1_len;
-  unsigned char *msg_ptr, *msg_hdr_start, *msg_hdr_end;
-  size_t msg_hdr_startlen, msg_len;
+  unsigned char *msg_ptr, *msg_end;
+  size_t msg_len;
   int res;
 
   if (p == NULL ||
@@ -166,68 +349,48 @@ int snmp_msg_write(pool *p, unsigned char **buf, size_t *buflen,
     return -1;
   }
 
-  msg_ptr = msg_hdr_start = *buf;
-  msg_hdr_startlen = *buflen;
-
-  asn1_type = (SNMP_ASN1_TYPE_SEQUENCE|SNMP_ASN1_CONSTRUCT);
-  asn1_len = 0;
-
-  res = snmp_asn1_write_header(p, buf, buflen, asn1_type, asn1_len, 0);
-  if (res < 0) {
-    return -1;
-  }
-
-  msg_hdr_end = *buf;
+  /* The message is encoded back-to-front, starting from the end of the
+   * given buffer, so that the length of each SEQUENCE is known by the time
+   * its header is written.
+   */
+  msg_ptr = msg_end = *buf + *buflen;
 
-  asn1_type = (SNMP_ASN1_CLASS_UNIVERSAL|SNMP_ASN1_PRIMITIVE|SNMP_ASN1_TYPE_INTEGER);
-  res = snmp_asn1_write_int(p, buf, buflen, asn1_type, snmp_version, 0);
+  res = snmp_pdu_write(p, &msg_ptr, buflen, pdu, snmp_version);
   if (res < 0) {
     return -1;
   }
 
   asn1_type = (SNMP_ASN1_CLASS_UNIVERSAL|SNMP_ASN1_PRIMITIVE|SNMP_ASN1_TYPE_OCTETSTRING);
-  res = snmp_asn1_write_string(p, buf, buflen, asn1_type, community,
+  res = snmp_asn1_prepend_string(p, &msg_ptr, buflen, asn1_type, community,
     community_len);
   if (res < 0) {
     return -1;
   }
 
-  if (pdu != NULL) {
-    res = snmp_pdu_write(p, buf, buflen, pdu, snmp_version);
-    if (res < 0) {
-      return -1;
-    }
+  asn1_type = (SNMP_ASN1_CLASS_UNIVERSAL|SNMP_ASN1_PRIMITIVE|SNMP_ASN1_TYPE_INTEGER);
+  res = snmp_asn1_prepend_int(p, &msg_ptr, buflen, asn1_type, snmp_version, 0);
+  if (res < 0) {
+    return -1;
   }
 
-  /* Calculate the full message length, for use later. */
-  msg_len = (*buf - msg_hdr_start);
-
-  /* Having written out the entire message now, we can go back and fill
-   * in the appropriate length in the header.
-   */
-
   asn1_type = (SNMP_ASN1_TYPE_SEQUENCE|SNMP_ASN1_CONSTRUCT);
-  asn1_len = (*buf - msg_hdr_end);
-  
-  pr_trace_msg(trace_channel, 18,
-    "updating SNMP message header to have length %u", asn1_len);
+  asn1_len = (unsigned int) (msg_end - msg_ptr);
 
-  res = snmp_asn1_write_header(p, &msg_hdr_start, &msg_hdr_startlen,
-    asn1_type, asn1_len, 0);
+  if (snmp_trace_is_enabled(trace_channel, 18)) {
+    pr_trace_msg(trace_channel, 18,
+      "writing SNMP message header with length %u", asn1_len);
+  }
+  res = snmp_asn1_prepend_header(p, &msg_ptr, buflen, asn1_type, asn1_len, 0);
   if (res < 0) {
     return -1;
   }
 
-  /* XXX This is a bit of a hack here.  We started with a buflen, and steadily
-   * decremented that value as we wrote data into the buffer.
-   *
-   * However, buflen needs to the amount of data IN the buffer once we return
-   * the caller, NOT the amount of data REMAINING in the buffer.  So we
-   * cheat here.
-   *
-   * We also cheat by resetting buf to point to the start of the message.
-   */
+  msg_len = (size_t) (msg_end - msg_ptr);
 
+  /* On return, buf points to the start of the encoded message, which is at
+   * the end of the given buffer, and buflen is the length of the message,
+   * NOT the amount of space remaining in the buffer.
+   */
   *buflen = msg_len;
   *buf = msg_ptr;
 
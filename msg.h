@@ -35,6 +35,13 @@ const char *snmp_msg_get_versionstr(long snmp_version);
 int snmp_msg_read(pool *p, unsigned char **buf, size_t *buflen,
   char **community, unsigned int *community_len, long *snmp_version,
   struct snmp_pdu **pdu);
+int snmp_msg_peek(unsigned char *buf, size_t buflen, long *snmp_version,
+  unsigned char **community, unsigned int *community_len,
+  unsigned char *pdu_type, long *request_id);
+/* Encodes the message at the end of the given buffer.  On success, buf points
+ * to the start of the encoded message (within the given buffer), and buflen
+ * is set to the length of the message.
+ */
 int snmp_msg_write(pool *p, unsigned char **buf, size_t *buflen,
   char *community, unsigned int community_len, long snmp_version,
   struct snmp_pdu *pdu);
@@ -29,32 +29,349 @@
 #include "mib.h"
 #include "packet.h"
 #include "db.h"
+#include "uptime.h"
 #include "notify.h"
+#include "ring.h"
+#include "timer.h"
+#include "threshold.h"
+#include "throughput.h"
+
+#include <stddef.h>
+
+static struct snmp_ring *notify_queue = NULL;
+
+/* The sockets for sending notifications, one per receiver, are opened when
+ * first needed, and kept open.
+ */
+struct snmp_notify_sock {
+  pr_netaddr_t *addr;
+  int fd;
+  int flags;
+
+  /* Whether InformRequests have been sent on this socket, i.e. whether
+   * Responses may arrive on it.
+   */
+  int informs;
+};
+
+static pool *notify_sock_pool = NULL;
+static array_header *notify_socks = NULL;
+
+/* The sockets for sending records to local receivers, one per path.  Each is
+ * connected to its path when opened, so that the SNMP agent can still send
+ * on it once it has been chrooted.
+ */
+struct snmp_notify_local_sock {
+  const char *path;
+  int fd;
+};
+
+static array_header *notify_local_socks = NULL;
+
+/* The InformRequests awaiting Responses, in the SNMP agent process. */
+struct snmp_notify_inform {
+  int in_use;
+
+  /* For finding the oldest pending InformRequest. */
+  unsigned long seqno;
+
+  long request_id;
+  pr_netaddr_t *addr;
+  const char *notify_str;
+
+  unsigned int nretries;
+  unsigned long timeout_ms;
+  struct timeval retransmit_tv;
+
+  unsigned char data[SNMP_NOTIFY_INFORM_MAX_DATALEN];
+  size_t datalen;
+};
+
+static pool *notify_inform_pool = NULL;
+static struct snmp_notify_inform *notify_informs = NULL;
+static unsigned long notify_inform_seqno = 0;
+
+/* The retransmit timer only runs while InformRequests are pending. */
+static unsigned int notify_inform_npending = 0;
+static int notify_inform_timer_id = -1;
+
+/* Rate limiting uses a token bucket per notification type, per server.  To
+ * keep the arithmetic exact, a bucket holds limit_secs * 1000 units per
+ * token, and gains limit_count units per millisecond.
+ */
+#define SNMP_NOTIFY_LIMIT_MAX_CLIENTS		8
+#define SNMP_NOTIFY_LIMIT_TOP_CLIENTS		3
+
+struct snmp_notify_client {
+  char addr[SNMP_NOTIFY_RECORD_MAX_ADDRLEN];
+  unsigned int count;
+};
+
+struct snmp_notify_limit {
+  unsigned int server_id;
+  unsigned int notify_id;
+
+  uint64_t tokens;
+  struct timeval refill_tv;
+
+  /* The notifications suppressed since the first of them, and the clients
+   * (approximately) responsible for most of them.
+   */
+  unsigned int suppressed;
+  time_t suppressed_start;
+  struct snmp_notify_client clients[SNMP_NOTIFY_LIMIT_MAX_CLIENTS];
+};
+
+static pool *notify_limit_pool = NULL;
+static array_header *notify_limits = NULL;
+static unsigned int notify_limit_count = 0;
+static unsigned int notify_limit_secs = 0;
 
 static const char *trace_channel = "snmp.notify";
 
+/* The event-specific values carried by each type of notification, per
+ * PROFTPD-MIB, and where they are found in the notification record.
+ */
+struct snmp_notify_var {
+  oid_t var_oid[SNMP_MIB_MAX_OIDLEN];
+  unsigned int var_oidlen;
+  unsigned char smi_type;
+
+  int var_type;
+  size_t field_offset;
+};
+
+/* An integer field; omitted from the notification if -1. */
+#define SNMP_NOTIFY_VAR_INT		1
+
+/* A string field; omitted from the notification if empty. */
+#define SNMP_NOTIFY_VAR_STR		2
+
+/* The OID of the notification whose ID is in the field. */
+#define SNMP_NOTIFY_VAR_NOTIFY_OID	3
+
+/* The OID of the MIB whose index is in the field. */
+#define SNMP_NOTIFY_VAR_MIB_OID		4
+
+/* The sysUpTime of the event. */
+#define SNMP_NOTIFY_VAR_UPTIME		5
+
+#define SNMP_NOTIFY_RECORD_FIELD(field) \
+  offsetof(struct snmp_notify_record, field)
+
+/* The MaxInstances check happens very early on in the session lifecycle,
+ * thus there is not much information that we can add to notifications for
+ * this event, other than the fact that it happened.
+ */
+static struct snmp_notify_var maxinst_vars[] = {
+  { { SNMP_MIB_DAEMON_OID_MAXINST_CONF, 0 },
+    SNMP_MIB_DAEMON_OIDLEN_MAXINST_CONF + 1, SNMP_SMI_INTEGER,
+    SNMP_NOTIFY_VAR_INT, SNMP_NOTIFY_RECORD_FIELD(maxinst_conf) },
+
+  { { }, 0, 0, 0, 0 }
+};
+
+static struct snmp_notify_var suppressed_vars[] = {
+  { { SNMP_MIB_SNMP_OID_SUPPRESSED_NOTIFY, 0 },
+    SNMP_MIB_SNMP_OIDLEN_SUPPRESSED_NOTIFY + 1, SNMP_SMI_OID,
+    SNMP_NOTIFY_VAR_NOTIFY_OID, SNMP_NOTIFY_RECORD_FIELD(suppressed_id) },
+
+  { { SNMP_MIB_SNMP_OID_SUPPRESSED_COUNT, 0 },
+    SNMP_MIB_SNMP_OIDLEN_SUPPRESSED_COUNT + 1, SNMP_SMI_GAUGE32,
+    SNMP_NOTIFY_VAR_INT, SNMP_NOTIFY_RECORD_FIELD(suppressed_count) },
+
+  { { SNMP_MIB_SNMP_OID_SUPPRESSED_SECS, 0 },
+    SNMP_MIB_SNMP_OIDLEN_SUPPRESSED_SECS + 1, SNMP_SMI_INTEGER,
+    SNMP_NOTIFY_VAR_INT, SNMP_NOTIFY_RECORD_FIELD(suppressed_secs) },
+
+  { { SNMP_MIB_SNMP_OID_SUPPRESSED_CLIENTS, 0 },
+    SNMP_MIB_SNMP_OIDLEN_SUPPRESSED_CLIENTS + 1, SNMP_SMI_STRING,
+    SNMP_NOTIFY_VAR_STR, SNMP_NOTIFY_RECORD_FIELD(suppressed_clients) },
+
+  { { }, 0, 0, 0, 0 }
+};
+
+static struct snmp_notify_var threshold_vars[] = {
+  { { SNMP_MIB_SNMP_OID_THRESHOLD_TEXT, 0 },
+    SNMP_MIB_SNMP_OIDLEN_THRESHOLD_TEXT + 1, SNMP_SMI_STRING,
+    SNMP_NOTIFY_VAR_STR, SNMP_NOTIFY_RECORD_FIELD(threshold_text) },
+
+  { { SNMP_MIB_SNMP_OID_THRESHOLD_OBJECT, 0 },
+    SNMP_MIB_SNMP_OIDLEN_THRESHOLD_OBJECT + 1, SNMP_SMI_OID,
+    SNMP_NOTIFY_VAR_MIB_OID, SNMP_NOTIFY_RECORD_FIELD(threshold_mib_idx) },
+
+  { { SNMP_MIB_SNMP_OID_THRESHOLD_VALUE, 0 },
+    SNMP_MIB_SNMP_OIDLEN_THRESHOLD_VALUE + 1, SNMP_SMI_INTEGER,
+    SNMP_NOTIFY_VAR_INT, SNMP_NOTIFY_RECORD_FIELD(threshold_value) },
+
+  { { SNMP_MIB_SNMP_OID_THRESHOLD_LIMIT, 0 },
+    SNMP_MIB_SNMP_OIDLEN_THRESHOLD_LIMIT + 1, SNMP_SMI_INTEGER,
+    SNMP_NOTIFY_VAR_INT, SNMP_NOTIFY_RECORD_FIELD(threshold_limit) },
+
+  { { }, 0, 0, 0, 0 }
+};
+
+static struct snmp_notify_var throughput_vars[] = {
+  { { SNMP_MIB_CONN_OID_PROTOCOL, 0 },
+    SNMP_MIB_CONN_OIDLEN_PROTOCOL + 1, SNMP_SMI_STRING,
+    SNMP_NOTIFY_VAR_STR, SNMP_NOTIFY_RECORD_FIELD(protocol) },
+
+  { { SNMP_MIB_SNMP_OID_THROUGHPUT_MEDIAN, 0 },
+    SNMP_MIB_SNMP_OIDLEN_THROUGHPUT_MEDIAN + 1, SNMP_SMI_GAUGE32,
+    SNMP_NOTIFY_VAR_INT, SNMP_NOTIFY_RECORD_FIELD(throughput_median) },
+
+  { { SNMP_MIB_SNMP_OID_THROUGHPUT_BASELINE, 0 },
+    SNMP_MIB_SNMP_OIDLEN_THROUGHPUT_BASELINE + 1, SNMP_SMI_GAUGE32,
+    SNMP_NOTIFY_VAR_INT, SNMP_NOTIFY_RECORD_FIELD(throughput_baseline) },
+
+  { { }, 0, 0, 0, 0 }
+};
+
+static struct snmp_notify_var login_failed_vars[] = {
+  { { SNMP_MIB_CONN_OID_SERVER_NAME, 0 },
+    SNMP_MIB_CONN_OIDLEN_SERVER_NAME + 1, SNMP_SMI_STRING,
+    SNMP_NOTIFY_VAR_STR, SNMP_NOTIFY_RECORD_FIELD(server_name) },
+
+  { { SNMP_MIB_CONN_OID_SERVER_ADDR, 0 },
+    SNMP_MIB_CONN_OIDLEN_SERVER_ADDR + 1, SNMP_SMI_STRING,
+    SNMP_NOTIFY_VAR_STR, SNMP_NOTIFY_RECORD_FIELD(server_addr) },
+
+  { { SNMP_MIB_CONN_OID_SERVER_PORT, 0 },
+    SNMP_MIB_CONN_OIDLEN_SERVER_PORT + 1, SNMP_SMI_INTEGER,
+    SNMP_NOTIFY_VAR_INT, SNMP_NOTIFY_RECORD_FIELD(server_port) },
+
+  { { SNMP_MIB_CONN_OID_CLIENT_ADDR, 0 },
+    SNMP_MIB_CONN_OIDLEN_CLIENT_ADDR + 1, SNMP_SMI_STRING,
+    SNMP_NOTIFY_VAR_STR, SNMP_NOTIFY_RECORD_FIELD(client_addr) },
+
+  { { SNMP_MIB_CONN_OID_PID, 0 },
+    SNMP_MIB_CONN_OIDLEN_PID + 1, SNMP_SMI_INTEGER,
+    SNMP_NOTIFY_VAR_INT, SNMP_NOTIFY_RECORD_FIELD(pid) },
+
+  { { SNMP_MIB_CONN_OID_USER_NAME, 0 },
+    SNMP_MIB_CONN_OIDLEN_USER_NAME + 1, SNMP_SMI_STRING,
+    SNMP_NOTIFY_VAR_STR, SNMP_NOTIFY_RECORD_FIELD(user_name) },
+
+  { { SNMP_MIB_CONN_OID_PROTOCOL, 0 },
+    SNMP_MIB_CONN_OIDLEN_PROTOCOL + 1, SNMP_SMI_STRING,
+    SNMP_NOTIFY_VAR_STR, SNMP_NOTIFY_RECORD_FIELD(protocol) },
+
+  { { }, 0, 0, 0, 0 }
+};
+
+/* The first varbind of every notification is sysUpTime.0, per RFC 1905,
+ * Section 4.2.6; its OID is filled in from the MIB table.
+ */
+static struct snmp_notify_var uptime_var = {
+  { }, 0, SNMP_SMI_TIMETICKS, SNMP_NOTIFY_VAR_UPTIME, 0
+};
+
 struct snmp_notify_oid {
   unsigned int notify_id;
   oid_t notify_oid[SNMP_MIB_MAX_OIDLEN];
   unsigned int notify_oidlen;
+  struct snmp_notify_var *notify_vars;
+  int notify_severity;
 };
 
+/* Notifications which clear an alarm (e.g. thresholdCleared) have the
+ * severity of the alarm, so that receivers filtering by severity get both.
+ */
 static struct snmp_notify_oid notify_oids[] = {
   { SNMP_NOTIFY_DAEMON_MAX_INSTANCES,
     { SNMP_MIB_DAEMON_NOTIFY_OID_MAX_INSTANCES, 0 },
-    SNMP_MIB_DAEMON_NOTIFY_OIDLEN_MAX_INSTANCES + 1 },
+    SNMP_MIB_DAEMON_NOTIFY_OIDLEN_MAX_INSTANCES + 1, maxinst_vars,
+    SNMP_NOTIFY_SEVERITY_CRITICAL },
+
+  { SNMP_NOTIFY_DAEMON_SUPPRESSED,
+    { SNMP_MIB_DAEMON_NOTIFY_OID_SUPPRESSED, 0 },
+    SNMP_MIB_DAEMON_NOTIFY_OIDLEN_SUPPRESSED + 1, suppressed_vars,
+    SNMP_NOTIFY_SEVERITY_INFO },
+
+  { SNMP_NOTIFY_DAEMON_THRESHOLD_EXCEEDED,
+    { SNMP_MIB_DAEMON_NOTIFY_OID_THRESHOLD_EXCEEDED, 0 },
+    SNMP_MIB_DAEMON_NOTIFY_OIDLEN_THRESHOLD_EXCEEDED + 1, threshold_vars,
+    SNMP_NOTIFY_SEVERITY_WARNING },
+
+  { SNMP_NOTIFY_DAEMON_THRESHOLD_CLEARED,
+    { SNMP_MIB_DAEMON_NOTIFY_OID_THRESHOLD_CLEARED, 0 },
+    SNMP_MIB_DAEMON_NOTIFY_OIDLEN_THRESHOLD_CLEARED + 1, threshold_vars,
+    SNMP_NOTIFY_SEVERITY_WARNING },
+
+  { SNMP_NOTIFY_DAEMON_THROUGHPUT_DEGRADED,
+    { SNMP_MIB_DAEMON_NOTIFY_OID_THROUGHPUT_DEGRADED, 0 },
+    SNMP_MIB_DAEMON_NOTIFY_OIDLEN_THROUGHPUT_DEGRADED + 1, throughput_vars,
+    SNMP_NOTIFY_SEVERITY_WARNING },
+
+  { SNMP_NOTIFY_DAEMON_THROUGHPUT_RECOVERED,
+    { SNMP_MIB_DAEMON_NOTIFY_OID_THROUGHPUT_RECOVERED, 0 },
+    SNMP_MIB_DAEMON_NOTIFY_OIDLEN_THROUGHPUT_RECOVERED + 1, throughput_vars,
+    SNMP_NOTIFY_SEVERITY_WARNING },
 
   { SNMP_NOTIFY_FTP_BAD_PASSWD,
     { SNMP_MIB_FTP_NOTIFY_OID_LOGIN_BAD_PASSWORD, 0 },
-    SNMP_MIB_FTP_NOTIFY_OIDLEN_LOGIN_BAD_PASSWORD + 1 },
+    SNMP_MIB_FTP_NOTIFY_OIDLEN_LOGIN_BAD_PASSWORD + 1, login_failed_vars,
+    SNMP_NOTIFY_SEVERITY_WARNING },
 
   { SNMP_NOTIFY_FTP_BAD_USER,
     { SNMP_MIB_FTP_NOTIFY_OID_LOGIN_BAD_USER, 0 },
-    SNMP_MIB_FTP_NOTIFY_OIDLEN_LOGIN_BAD_USER + 1 },
+    SNMP_MIB_FTP_NOTIFY_OIDLEN_LOGIN_BAD_USER + 1, login_failed_vars,
+    SNMP_NOTIFY_SEVERITY_WARNING },
+
+  { 0, { }, 0, NULL, 0 }
+};
+
+/* Notification templates.
+ *
+ * Each type of notification is encoded once per community, at startup, into
+ * a template: the encoded message, less the values which differ from one
+ * notification to the next (the request ID, the sysUpTime, and the
+ * event-specific values).  Generating a notification copies the template,
+ * writing those values into their slots.
+ *
+ * So that a slot can be filled without re-encoding the rest of the message,
+ * every SEQUENCE length in a template is encoded in the three-byte long
+ * form (which BER allows, and which the ASN.1 writer uses for unknown
+ * lengths), and request IDs are chosen so that they always encode in four
+ * bytes; only the lengths of the enclosing SEQUENCEs need updating.
+ */
+struct snmp_notify_slot {
+  /* Where the value goes, and where the header of its VarBind is, in the
+   * template data.  The value is always the last part of its VarBind.
+   */
+  size_t offset;
+  size_t var_offset;
+
+  struct snmp_notify_var *var;
+};
+
+struct snmp_notify_template {
+  unsigned int notify_id;
+  const char *community;
 
-  { 0, { }, 0 }
+  unsigned char *data;
+  size_t datalen;
+
+  /* The headers whose lengths run to the end of the message (along with
+   * the message header itself, at the start), and the request ID.
+   */
+  size_t pdu_offset;
+  size_t request_id_offset;
+  size_t varlist_offset;
+
+  struct snmp_notify_slot *slots;
+  unsigned int nslots;
 };
 
+/* Request IDs from here to 0x7fffffff encode in exactly four bytes. */
+#define SNMP_NOTIFY_REQUEST_ID_MIN	0x00800000L
+
+/* The length of a SEQUENCE header with a three-byte length. */
+#define SNMP_NOTIFY_SEQ_HEADER_LEN	4
+
+static pool *notify_template_pool = NULL;
+static array_header *notify_templates = NULL;
+
 static const char *get_notify_str(unsigned int notify_id) {
   const char *name = NULL;
 
@@ -63,6 +380,26 @@ static const char *get_notify_str(unsigned int notify_id) {
       name = "maxInstancesExceeded";
       break;
 
+    case SNMP_NOTIFY_DAEMON_SUPPRESSED:
+      name = "notificationsSuppressed";
+      break;
+
+    case SNMP_NOTIFY_DAEMON_THRESHOLD_EXCEEDED:
+      name = "thresholdExceeded";
+      break;
+
+    case SNMP_NOTIFY_DAEMON_THRESHOLD_CLEARED:
+      name = "thresholdCleared";
+      break;
+
+    case SNMP_NOTIFY_DAEMON_THROUGHPUT_DEGRADED:
+      name = "throughputDegraded";
+      break;
+
+    case SNMP_NOTIFY_DAEMON_THROUGHPUT_RECOVERED:
+      name = "throughputRecovered";
+      break;
+
     case SNMP_NOTIFY_FTP_BAD_PASSWD:
       name = "loginFailedBadPassword";
       break;
@@ -78,14 +415,12 @@ static const char *get_notify_str(unsigned int notify_id) {
   return name;
 }
 
-static oid_t *get_notify_oid(pool *p, unsigned int notify_id,
-    unsigned int *oidlen) {
+static struct snmp_notify_oid *get_notify_info(unsigned int notify_id) {
   register unsigned int i;
 
   for (i = 0; notify_oids[i].notify_oidlen > 0; i++) {
     if (notify_oids[i].notify_id == notify_id) {
-      *oidlen = notify_oids[i].notify_oidlen;
-      return notify_oids[i].notify_oid;
+      return &(notify_oids[i]);
     }
   }
 
@@ -93,350 +428,1452 @@ static oid_t *get_notify_oid(pool *p, unsigned int notify_id,
   return NULL;
 }
 
-static struct snmp_packet *get_notify_pkt(pool *p, const char *community,
-    pr_netaddr_t *dst_addr, unsigned int notify_id,
-    struct snmp_var **head_var, struct snmp_var **tail_var) {
-  struct snmp_packet *pkt = NULL;
-  struct snmp_mib *mib = NULL;
-  struct snmp_var *resp_var = NULL;
-  int32_t mib_int = -1;
-  char *mib_str = NULL;
-  size_t mib_strlen = 0;
-  oid_t *notify_oid = NULL;
-  unsigned int notify_oidlen = 0;
-  int res;
-
-  pkt = snmp_packet_create(p);
-  pkt->snmp_version = SNMP_PROTOCOL_VERSION_2;
-  pkt->community = (char *) community;
-  pkt->community_len = strlen(community);
-  pkt->remote_addr = dst_addr;
+static oid_t *get_notify_oid(pool *p, unsigned int notify_id,
+    unsigned int *oidlen) {
+  struct snmp_notify_oid *info;
 
-  pkt->resp_pdu = snmp_pdu_create(pkt->pool, SNMP_PDU_TRAP_V2);
-  pkt->resp_pdu->err_code = 0;
-  pkt->resp_pdu->err_idx = 0;
-  pkt->resp_pdu->request_id = snmp_notify_get_request_id();
+  info = get_notify_info(notify_id);
+  if (info == NULL) {
+    return NULL;
+  }
 
-  /* Set first varbind to sysUptime.0 (1.3.6.1.2.1.1.3.0, TimeTicks),
-   * per RFC 1905, Section 4.2.6.
-   */
-  res = snmp_db_get_value(pkt->pool, SNMP_DB_NOTIFY_F_SYS_UPTIME, &mib_int,
-    &mib_str, &mib_strlen);
-  if (res < 0) {
-    int xerrno = errno;
+  *oidlen = info->notify_oidlen;
+  return info->notify_oid;
+}
 
-    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
-      "unable to get system uptime for notification: %s", strerror(xerrno));
+int snmp_notify_get_id(const char *name) {
+  register unsigned int i;
 
-    errno = xerrno;
-    return NULL;
+  if (name == NULL) {
+    errno = EINVAL;
+    return -1;
   }
 
-  mib = snmp_mib_get_by_idx(SNMP_MIB_SYS_UPTIME_IDX);
-  resp_var = snmp_smi_create_var(pkt->pool, mib->mib_oid, mib->mib_oidlen,
-    mib->smi_type, mib_int, mib_str, mib_strlen);
-  snmp_smi_util_add_list_var(head_var, tail_var, resp_var);
-
-  /* Set second varbind to snmpTrapOID.0 (1.3.6.1.6.3.1.1.4.1.0, OID)
-   * per RFC 1905, Section 4.2.6.
-   */
-  mib = snmp_mib_get_by_idx(SNMP_MIB_SNMP2_TRAP_OID_IDX);
-  notify_oid = get_notify_oid(pkt->pool, notify_id, &notify_oidlen);
-  resp_var = snmp_smi_create_oid(pkt->pool, mib->mib_oid, mib->mib_oidlen,
-    mib->smi_type, notify_oid, notify_oidlen);
-  snmp_smi_util_add_list_var(head_var, tail_var, resp_var);
+  for (i = 0; notify_oids[i].notify_oidlen > 0; i++) {
+    if (strcasecmp(get_notify_str(notify_oids[i].notify_id), name) == 0) {
+      return (int) notify_oids[i].notify_id;
+    }
+  }
 
-  return pkt;
+  errno = ENOENT;
+  return -1;
 }
 
-static int get_notify_varlist(pool *p, unsigned int notify_id,
-    struct snmp_var **head_var) {
-  struct snmp_var *tail_var = NULL;
-  int var_count = 0;
-
-  switch (notify_id) {
-    case SNMP_NOTIFY_DAEMON_MAX_INSTANCES: {
-      struct snmp_var *var;
-      int32_t int_value = 0;
-      char *str_value = NULL;
-      size_t str_valuelen = 0;
-      int res;
-
-      /* The MaxInstances check happens very early on in the session
-       * lifecycle, thus there is not much information that we can add
-       * to notifications for this event, other than the fact that it
-       * happened.
-       *
-       * Per PROFTPD-MIB, we need to include:
-       *
-       *  daemon.maxInstancesConfig
-       */
+/* Each notification's bit is its position in the notify_oids table. */
+unsigned long snmp_notify_get_mask(unsigned int notify_id) {
+  struct snmp_notify_oid *info;
 
-      res = snmp_db_get_value(p, SNMP_DB_DAEMON_F_MAXINST_CONF, &int_value,
-        &str_value, &str_valuelen);
-      if (res < 0) {
-        pr_trace_msg(trace_channel, 5,
-          "unable to get daemon.maxInstancesConfig value: %s", strerror(errno));
+  info = get_notify_info(notify_id);
+  if (info == NULL) {
+    return 0;
+  }
 
-      } else {
-        oid_t oid[] = { SNMP_MIB_DAEMON_OID_MAXINST_CONF, 0 };
-        unsigned int oidlen = SNMP_MIB_DAEMON_OIDLEN_MAXINST_CONF + 1;
+  return 1UL << (info - notify_oids);
+}
 
-        var = snmp_smi_create_var(p, oid, oidlen, SNMP_SMI_INTEGER, int_value,
-          str_value, str_valuelen);
-        var_count = snmp_smi_util_add_list_var(head_var, &tail_var, var);
-      }
+unsigned long snmp_notify_get_severity_mask(int min_severity) {
+  register unsigned int i;
+  unsigned long mask = 0;
 
-      return var_count;
+  for (i = 0; notify_oids[i].notify_oidlen > 0; i++) {
+    if (notify_oids[i].notify_severity >= min_severity) {
+      mask |= (1UL << i);
     }
+  }
 
-    case SNMP_NOTIFY_FTP_BAD_PASSWD:
-    case SNMP_NOTIFY_FTP_BAD_USER: {
-      struct snmp_var *var;
-      int32_t int_value = 0;
-      char *str_value = NULL;
-      size_t str_valuelen = 0;
-      int res;
-
-      /* Per PROFTPD-MIB, we need to include:
-       *
-       *  connection.serverName
-       *  connection.serverAddress
-       *  connection.serverPort
-       *  connection.clientAddress
-       *  connection.processId
-       *  connection.userName
-       *  connection.protocol
-       */
-
-      /* connection.serverName */
-      res = snmp_db_get_value(p, SNMP_DB_CONN_F_SERVER_NAME, &int_value,
-        &str_value, &str_valuelen);
-      if (res < 0) {
-        pr_trace_msg(trace_channel, 5,
-          "unable to get connection.serverName value: %s", strerror(errno));
-
-      } else {
-        oid_t oid[] = { SNMP_MIB_CONN_OID_SERVER_NAME, 0 };
-        unsigned int oidlen = SNMP_MIB_CONN_OIDLEN_SERVER_NAME + 1;
+  return mask;
+}
 
-        var = snmp_smi_create_var(p, oid, oidlen, SNMP_SMI_STRING, int_value,
-          str_value, str_valuelen);
-        var_count = snmp_smi_util_add_list_var(head_var, &tail_var, var);
-      }
+/* Returns the bit which receivers must have for the record's notification.
+ * A notificationsSuppressed summary goes to the receivers of the
+ * notifications it summarizes.
+ */
+static unsigned long get_record_mask(struct snmp_notify_record *record) {
+  if (record->notify_id == SNMP_NOTIFY_DAEMON_SUPPRESSED) {
+    return snmp_notify_get_mask(record->suppressed_id);
+  }
 
-      /* connection.serverAddress */
-      res = snmp_db_get_value(p, SNMP_DB_CONN_F_SERVER_ADDR, &int_value,
-        &str_value, &str_valuelen);
-      if (res < 0) {
-        pr_trace_msg(trace_channel, 5,
-          "unable to get connection.serverAddress value: %s", strerror(errno));
+  return snmp_notify_get_mask(record->notify_id);
+}
 
-      } else {
-        oid_t oid[] = { SNMP_MIB_CONN_OID_SERVER_ADDR, 0 };
-        unsigned int oidlen = SNMP_MIB_CONN_OIDLEN_SERVER_ADDR + 1;
+/* Returns the sysUpTime, in TimeTicks, at which the notified event
+ * happened.
+ */
+static int get_notify_uptime(pool *p, struct snmp_notify_record *record,
+    int32_t *ticks) {
+  struct timeval start_tv;
 
-        var = snmp_smi_create_var(p, oid, oidlen, SNMP_SMI_STRING, int_value,
-          str_value, str_valuelen);
-        var_count = snmp_smi_util_add_list_var(head_var, &tail_var, var);
-      }
+  if (snmp_uptime_get(p, &start_tv) < 0) {
+    return -1;
+  }
 
-      /* connection.serverPort */
-      res = snmp_db_get_value(p, SNMP_DB_CONN_F_SERVER_PORT, &int_value,
-        &str_value, &str_valuelen);
-      if (res < 0) {
-        pr_trace_msg(trace_channel, 5,
-          "unable to get connection.serverPort value: %s", strerror(errno));
+  *ticks = (int32_t) (((record->notify_tv.tv_sec - start_tv.tv_sec) * 100) +
+    ((record->notify_tv.tv_usec - start_tv.tv_usec) / 10000));
+  return 0;
+}
 
-      } else {
-        oid_t oid[] = { SNMP_MIB_CONN_OID_SERVER_PORT, 0 };
-        unsigned int oidlen = SNMP_MIB_CONN_OIDLEN_SERVER_PORT + 1;
+/* Sets the length of the SEQUENCE whose three-byte length header is at the
+ * given position.
+ */
+static void set_template_len(unsigned char *hdr, size_t len) {
+  hdr[2] = (unsigned char) ((len >> 8) & 0xff);
+  hdr[3] = (unsigned char) (len & 0xff);
+}
 
-        var = snmp_smi_create_var(p, oid, oidlen, SNMP_SMI_INTEGER, int_value,
-          str_value, str_valuelen);
-        var_count = snmp_smi_util_add_list_var(head_var, &tail_var, var);
-      }
+static int write_template_header(pool *p, unsigned char **buf,
+    size_t *buflen, unsigned char asn1_type) {
+  /* Without SNMP_ASN1_FL_KNOWN_LEN, the length is written in the three-byte
+   * long form, to be filled in later.
+   */
+  return snmp_asn1_write_header(p, buf, buflen, asn1_type, 0, 0);
+}
 
-      /* connection.clientAddress */
-      res = snmp_db_get_value(p, SNMP_DB_CONN_F_CLIENT_ADDR, &int_value,
-        &str_value, &str_valuelen);
-      if (res < 0) {
-        pr_trace_msg(trace_channel, 5,
-          "unable to get connection.clientAddress value: %s", strerror(errno));
+/* Writes the header and name of a VarBind, leaving its value to follow. */
+static int write_template_var(pool *p, unsigned char **buf, size_t *buflen,
+    oid_t *name, unsigned int namelen) {
+  unsigned char asn1_type;
 
-      } else {
-        oid_t oid[] = { SNMP_MIB_CONN_OID_CLIENT_ADDR, 0 };
-        unsigned int oidlen = SNMP_MIB_CONN_OIDLEN_CLIENT_ADDR + 1;
+  if (write_template_header(p, buf, buflen,
+      SNMP_ASN1_TYPE_SEQUENCE|SNMP_ASN1_CONSTRUCT) < 0) {
+    return -1;
+  }
 
-        var = snmp_smi_create_var(p, oid, oidlen, SNMP_SMI_STRING, int_value,
-          str_value, str_valuelen);
-        var_count = snmp_smi_util_add_list_var(head_var, &tail_var, var);
-      }
+  asn1_type = (SNMP_ASN1_CLASS_UNIVERSAL|SNMP_ASN1_PRIMITIVE|SNMP_ASN1_TYPE_OID);
+  return snmp_asn1_write_oid(p, buf, buflen, asn1_type, name, namelen);
+}
 
-      /* connection.processId */
-      res = snmp_db_get_value(p, SNMP_DB_CONN_F_PID, &int_value, &str_value,
-        &str_valuelen);
-      if (res < 0) {
-        pr_trace_msg(trace_channel, 5,
-          "unable to get connection.processId value: %s", strerror(errno));
+static struct snmp_notify_template *create_notify_template(pool *p,
+    unsigned int notify_id, const char *community) {
+  struct snmp_notify_oid *info;
+  struct snmp_notify_template *tmpl;
+  struct snmp_notify_slot *slot;
+  struct snmp_notify_var *var;
+  struct snmp_mib *mib;
+  array_header *slots;
+  unsigned char asn1_type, *buf, *ptr;
+  size_t buflen, var_offset;
+  pool *tmp_pool;
+  int res;
 
-      } else {
-        oid_t oid[] = { SNMP_MIB_CONN_OID_PID, 0 };
-        unsigned int oidlen = SNMP_MIB_CONN_OIDLEN_PID + 1;
+  info = get_notify_info(notify_id);
+  if (info == NULL) {
+    return NULL;
+  }
 
-        var = snmp_smi_create_var(p, oid, oidlen, SNMP_SMI_INTEGER, int_value,
-          str_value, str_valuelen);
-        var_count = snmp_smi_util_add_list_var(head_var, &tail_var, var);
-      }
+  tmp_pool = make_sub_pool(p);
+  buflen = SNMP_PACKET_MAX_LEN;
+  buf = ptr = palloc(tmp_pool, buflen);
 
-      /* connection.userName */
-      res = snmp_db_get_value(p, SNMP_DB_CONN_F_USER_NAME, &int_value,
-        &str_value, &str_valuelen);
-      if (res < 0) {
-        pr_trace_msg(trace_channel, 5,
-          "unable to get connection.userName value: %s", strerror(errno));
+  tmpl = pcalloc(p, sizeof(struct snmp_notify_template));
+  tmpl->notify_id = notify_id;
+  tmpl->community = pstrdup(p, community);
+  slots = make_array(p, 0, sizeof(struct snmp_notify_slot));
 
-      } else {
-        oid_t oid[] = { SNMP_MIB_CONN_OID_USER_NAME, 0 };
-        unsigned int oidlen = SNMP_MIB_CONN_OIDLEN_USER_NAME + 1;
+  /* Message header, version, and community. */
+  res = write_template_header(tmp_pool, &ptr, &buflen,
+    SNMP_ASN1_TYPE_SEQUENCE|SNMP_ASN1_CONSTRUCT);
+  if (res < 0) {
+    goto error;
+  }
 
-        var = snmp_smi_create_var(p, oid, oidlen, SNMP_SMI_STRING, int_value,
-          str_value, str_valuelen);
-        var_count = snmp_smi_util_add_list_var(head_var, &tail_var, var);
-      }
+  asn1_type = (SNMP_ASN1_CLASS_UNIVERSAL|SNMP_ASN1_PRIMITIVE|SNMP_ASN1_TYPE_INTEGER);
+  res = snmp_asn1_write_int(tmp_pool, &ptr, &buflen, asn1_type,
+    SNMP_PROTOCOL_VERSION_2, 0);
+  if (res < 0) {
+    goto error;
+  }
 
-      /* connection.protocol */
-      res = snmp_db_get_value(p, SNMP_DB_CONN_F_PROTOCOL, &int_value,
-        &str_value, &str_valuelen);
-      if (res < 0) {
-        pr_trace_msg(trace_channel, 5,
-          "unable to get connection.protocol value: %s", strerror(errno));
+  asn1_type = (SNMP_ASN1_CLASS_UNIVERSAL|SNMP_ASN1_PRIMITIVE|SNMP_ASN1_TYPE_OCTETSTRING);
+  res = snmp_asn1_write_string(tmp_pool, &ptr, &buflen, asn1_type,
+    community, strlen(community));
+  if (res < 0) {
+    goto error;
+  }
 
-      } else {
-        oid_t oid[] = { SNMP_MIB_CONN_OID_PROTOCOL, 0 };
-        unsigned int oidlen = SNMP_MIB_CONN_OIDLEN_PROTOCOL + 1;
+  /* PDU header (whose type is set for each notification), request ID,
+   * error status, and error index.
+   */
+  tmpl->pdu_offset = ptr - buf;
+  res = write_template_header(tmp_pool, &ptr, &buflen, SNMP_PDU_TRAP_V2);
+  if (res < 0) {
+    goto error;
+  }
 
-        var = snmp_smi_create_var(p, oid, oidlen, SNMP_SMI_STRING, int_value,
-          str_value, str_valuelen);
-        var_count = snmp_smi_util_add_list_var(head_var, &tail_var, var);
-      }
+  asn1_type = (SNMP_ASN1_CLASS_UNIVERSAL|SNMP_ASN1_PRIMITIVE|SNMP_ASN1_TYPE_INTEGER);
+  tmpl->request_id_offset = (ptr - buf) + 2;
+  res = snmp_asn1_write_int(tmp_pool, &ptr, &buflen, asn1_type,
+    SNMP_NOTIFY_REQUEST_ID_MIN, 0);
+  if (res < 0) {
+    goto error;
+  }
 
-      return var_count;
-    }
+  res = snmp_asn1_write_int(tmp_pool, &ptr, &buflen, asn1_type, 0, 0);
+  if (res < 0) {
+    goto error;
+  }
 
-    default:
-      break;
+  res = snmp_asn1_write_int(tmp_pool, &ptr, &buflen, asn1_type, 0, 0);
+  if (res < 0) {
+    goto error;
   }
 
-  errno = ENOENT;
-  return -1;
-}
+  tmpl->varlist_offset = ptr - buf;
+  res = write_template_header(tmp_pool, &ptr, &buflen,
+    SNMP_ASN1_TYPE_SEQUENCE|SNMP_ASN1_CONSTRUCT);
+  if (res < 0) {
+    goto error;
+  }
 
-int snmp_notify_generate(pool *p, int sockfd, const char *community,
-    pr_netaddr_t *src_addr, pr_netaddr_t *dst_addr, unsigned int notify_id) {
-  const char *notify_str;
-  struct snmp_packet *pkt;
-  struct snmp_var *notify_varlist = NULL, *head_var = NULL, *tail_var = NULL,
-    *iter_var;
-  int fd = -1, res;
-  unsigned int var_count;
+  /* sysUpTime.0, the time of the event. */
+  mib = snmp_mib_get_by_idx(SNMP_MIB_SYS_UPTIME_IDX);
 
-  notify_str = get_notify_str(notify_id);
+  var_offset = ptr - buf;
+  res = write_template_var(tmp_pool, &ptr, &buflen, mib->mib_oid,
+    mib->mib_oidlen);
+  if (res < 0) {
+    goto error;
+  }
 
-  pkt = get_notify_pkt(p, community, dst_addr, notify_id, &head_var, &tail_var);
-  if (pkt == NULL) {
-    int xerrno = errno;
+  slot = push_array(slots);
+  slot->offset = ptr - buf;
+  slot->var_offset = var_offset;
+  slot->var = &uptime_var;
 
-    pr_trace_msg(trace_channel, 7,
-      "unable to create %s notification packet: %s", notify_str,
-      strerror(xerrno));
+  /* snmpTrapOID.0, per RFC 1905, Section 4.2.6, which never changes. */
+  mib = snmp_mib_get_by_idx(SNMP_MIB_SNMP2_TRAP_OID_IDX);
 
-    errno = xerrno;
-    return -1;
+  var_offset = ptr - buf;
+  res = write_template_var(tmp_pool, &ptr, &buflen, mib->mib_oid,
+    mib->mib_oidlen);
+  if (res < 0) {
+    goto error;
   }
 
-  /* Add trap-specific varbinds */
-  res = get_notify_varlist(p, notify_id, &notify_varlist);
+  res = snmp_asn1_write_oid(tmp_pool, &ptr, &buflen, mib->smi_type,
+    info->notify_oid, info->notify_oidlen);
   if (res < 0) {
-    int xerrno = errno;
+    goto error;
+  }
 
-    pr_trace_msg(trace_channel, 7,
-      "unable to create %s notification varbind list: %s", notify_str,
-      strerror(xerrno));
+  set_template_len(buf + var_offset,
+    (ptr - buf) - var_offset - SNMP_NOTIFY_SEQ_HEADER_LEN);
 
-    destroy_pool(pkt->pool);
-    errno = xerrno;
-    return -1;
+  /* The event-specific values. */
+  for (var = info->notify_vars; var->var_oidlen > 0; var++) {
+    var_offset = ptr - buf;
+    res = write_template_var(tmp_pool, &ptr, &buflen, var->var_oid,
+      var->var_oidlen);
+    if (res < 0) {
+      goto error;
+    }
+
+    slot = push_array(slots);
+    slot->offset = ptr - buf;
+    slot->var_offset = var_offset;
+    slot->var = var;
   }
 
-  for (iter_var = notify_varlist; iter_var; iter_var = iter_var->next) {
-    pr_signals_handle();
+  tmpl->datalen = ptr - buf;
+  tmpl->data = palloc(p, tmpl->datalen);
+  memcpy(tmpl->data, buf, tmpl->datalen);
 
-    var_count = snmp_smi_util_add_list_var(&head_var, &tail_var, iter_var);
-  }
+  tmpl->slots = slots->elts;
+  tmpl->nslots = slots->nelts;
 
-  pkt->resp_pdu->varlist = head_var;
-  pkt->resp_pdu->varlistlen = var_count;
+  destroy_pool(tmp_pool);
+  return tmpl;
 
-  (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
-    "writing %s SNMP notification for %s, community = '%s', request ID %ld, "
-    "request type '%s'", notify_str,
-    snmp_msg_get_versionstr(pkt->snmp_version), pkt->community,
-    pkt->resp_pdu->request_id,
-    snmp_pdu_get_request_type_desc(pkt->resp_pdu->request_type));
+ error:
+  res = errno;
+  destroy_pool(tmp_pool);
+  errno = res;
+  return NULL;
+}
 
-  res = snmp_msg_write(pkt->pool, &(pkt->resp_data), &(pkt->resp_datalen),
-    pkt->community, pkt->community_len, pkt->snmp_version, pkt->resp_pdu);
-  if (res < 0) {
-    int xerrno = errno;
+/* Writes the record's value for the slot.  Returns 1 if the value was
+ * written, or 0 if the value is unavailable, and its VarBind is to be
+ * omitted.
+ */
+static int write_template_value(pool *p, unsigned char **buf, size_t *buflen,
+    struct snmp_notify_var *var, struct snmp_notify_record *record,
+    int32_t uptime) {
+  const char *field;
+  int32_t int_value;
+  int res;
 
-    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
-      "error writing %s SNMP notification to UDP packet: %s", notify_str,
-      strerror(xerrno));
+  field = ((const char *) record) + var->field_offset;
 
-    destroy_pool(pkt->pool);
-    errno = xerrno;
-    return -1;
-  }
+  switch (var->var_type) {
+    case SNMP_NOTIFY_VAR_UPTIME:
+      res = snmp_asn1_write_uint(p, buf, buflen, var->smi_type,
+        (unsigned long) uptime);
+      break;
 
-  if (sockfd < 0) {
-    /* If the given fd isn't open, then we need to open our own. */
+    case SNMP_NOTIFY_VAR_INT:
+      memcpy(&int_value, field, sizeof(int32_t));
+      if (int_value < 0) {
+        return 0;
+      }
 
-    /* XXX Support IPv6? */
+      if (var->smi_type == SNMP_SMI_INTEGER) {
+        res = snmp_asn1_write_int(p, buf, buflen, var->smi_type, int_value,
+          0);
 
-    fd = socket(AF_INET, SOCK_DGRAM, snmp_proto_udp);
-    if (fd < 0) {
+      } else {
+        res = snmp_asn1_write_uint(p, buf, buflen, var->smi_type,
+          (unsigned long) int_value);
+      }
+      break;
+
+    case SNMP_NOTIFY_VAR_STR:
+      if (*field == '\0') {
+        return 0;
+      }
+
+      res = snmp_asn1_write_string(p, buf, buflen, var->smi_type, field,
+        strlen(field));
+      break;
+
+    case SNMP_NOTIFY_VAR_NOTIFY_OID: {
+      unsigned int notify_id, notify_oidlen = 0;
+      oid_t *notify_oid;
+
+      memcpy(&notify_id, field, sizeof(unsigned int));
+      notify_oid = get_notify_oid(p, notify_id, &notify_oidlen);
+      if (notify_oid == NULL) {
+        return -1;
+      }
+
+      res = snmp_asn1_write_oid(p, buf, buflen, var->smi_type, notify_oid,
+        notify_oidlen);
+      break;
+    }
+
+    case SNMP_NOTIFY_VAR_MIB_OID: {
+      struct snmp_mib *mib;
+
+      memcpy(&int_value, field, sizeof(int32_t));
+      mib = snmp_mib_get_by_idx((unsigned int) int_value);
+      if (mib == NULL) {
+        return -1;
+      }
+
+      res = snmp_asn1_write_oid(p, buf, buflen, var->smi_type, mib->mib_oid,
+        mib->mib_oidlen);
+      break;
+    }
+
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+
+  if (res < 0) {
+    return -1;
+  }
+
+  return 1;
+}
+
+static void set_template_pdu_type(struct snmp_notify_template *tmpl,
+    unsigned char *buf, unsigned char pdu_type) {
+  buf[tmpl->pdu_offset] = pdu_type;
+}
+
+/* Generates the message for the record from the template, into the given
+ * buffer.  On return, buflen is the length of the message.
+ */
+static int fill_notify_template(pool *p, struct snmp_notify_template *tmpl,
+    unsigned char pdu_type, long request_id, int32_t uptime,
+    struct snmp_notify_record *record, unsigned char *buf, size_t *buflen) {
+  register unsigned int i;
+  unsigned char *ptr;
+  size_t avail, datalen, prev_offset = 0;
+
+  ptr = buf;
+  avail = *buflen;
+
+  for (i = 0; i < tmpl->nslots; i++) {
+    struct snmp_notify_slot *slot;
+    unsigned char *var_ptr;
+    int res;
+
+    slot = &(tmpl->slots[i]);
+
+    datalen = slot->offset - prev_offset;
+    if (avail < datalen) {
+      errno = EINVAL;
+      return -1;
+    }
+
+    memcpy(ptr, tmpl->data + prev_offset, datalen);
+    ptr += datalen;
+    avail -= datalen;
+    prev_offset = slot->offset;
+
+    /* The VarBind header is in the part just copied. */
+    var_ptr = ptr - (slot->offset - slot->var_offset);
+
+    res = write_template_value(p, &ptr, &avail, slot->var, record, uptime);
+    if (res < 0) {
+      return -1;
+    }
+
+    if (res == 0) {
+      /* Omit the VarBind. */
+      avail += ptr - var_ptr;
+      ptr = var_ptr;
+      continue;
+    }
+
+    set_template_len(var_ptr, (ptr - var_ptr) - SNMP_NOTIFY_SEQ_HEADER_LEN);
+  }
+
+  datalen = tmpl->datalen - prev_offset;
+  if (avail < datalen) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  memcpy(ptr, tmpl->data + prev_offset, datalen);
+  ptr += datalen;
+
+  datalen = ptr - buf;
+
+  /* None of the slots come before the varbind list, so the PDU and varbind
+   * list headers are where they are in the template.
+   */
+  set_template_len(buf, datalen - SNMP_NOTIFY_SEQ_HEADER_LEN);
+
+  set_template_pdu_type(tmpl, buf, pdu_type);
+  set_template_len(buf + tmpl->pdu_offset,
+    datalen - tmpl->pdu_offset - SNMP_NOTIFY_SEQ_HEADER_LEN);
+  set_template_len(buf + tmpl->varlist_offset,
+    datalen - tmpl->varlist_offset - SNMP_NOTIFY_SEQ_HEADER_LEN);
+
+  buf[tmpl->request_id_offset] = (unsigned char) ((request_id >> 24) & 0xff);
+  buf[tmpl->request_id_offset + 1] =
+    (unsigned char) ((request_id >> 16) & 0xff);
+  buf[tmpl->request_id_offset + 2] = (unsigned char) ((request_id >> 8) & 0xff);
+  buf[tmpl->request_id_offset + 3] = (unsigned char) (request_id & 0xff);
+
+  *buflen = datalen;
+  return 0;
+}
+
+static struct snmp_notify_template *get_notify_template(
+    unsigned int notify_id, const char *community) {
+  register unsigned int i;
+  struct snmp_notify_template **tmpls, *tmpl;
+
+  if (notify_templates != NULL) {
+    tmpls = notify_templates->elts;
+    for (i = 0; i < notify_templates->nelts; i++) {
+      if (tmpls[i]->notify_id == notify_id &&
+          strcmp(tmpls[i]->community, community) == 0) {
+        return tmpls[i];
+      }
+    }
+
+  } else {
+    notify_template_pool = make_sub_pool(permanent_pool);
+    pr_pool_tag(notify_template_pool, "SNMP notification template pool");
+
+    notify_templates = make_array(notify_template_pool, 1,
+      sizeof(struct snmp_notify_template *));
+  }
+
+  /* Templates for other communities are created when first needed. */
+  tmpl = create_notify_template(notify_template_pool, notify_id, community);
+  if (tmpl == NULL) {
+    return NULL;
+  }
+
+  *((struct snmp_notify_template **) push_array(notify_templates)) = tmpl;
+  return tmpl;
+}
+
+int snmp_notify_init_templates(const char *community) {
+  register unsigned int i;
+
+  if (community == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (notify_template_pool != NULL) {
+    destroy_pool(notify_template_pool);
+    notify_template_pool = NULL;
+    notify_templates = NULL;
+  }
+
+  for (i = 0; notify_oids[i].notify_oidlen > 0; i++) {
+    if (get_notify_template(notify_oids[i].notify_id, community) == NULL) {
+      int xerrno = errno;
+
+      (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+        "error creating %s notification template: %s",
+        get_notify_str(notify_oids[i].notify_id), strerror(xerrno));
+
+      errno = xerrno;
+      return -1;
+    }
+  }
+
+  pr_trace_msg(trace_channel, 9,
+    "created %u notification templates for community '%s'",
+    (unsigned int) notify_templates->nelts, community);
+  return 0;
+}
+
+/* Copies a database string value into a fixed-size record field. */
+static void set_record_str(pool *p, char *field, size_t fieldsz,
+    unsigned int db_field) {
+  int32_t int_value = 0;
+  char *str_value = NULL;
+  size_t str_valuelen = 0;
+
+  field[0] = '\0';
+
+  if (snmp_db_get_value(p, db_field, &int_value, &str_value,
+      &str_valuelen) < 0) {
+    pr_trace_msg(trace_channel, 5,
+      "unable to get %s value: %s", snmp_db_get_fieldstr(p, db_field),
+      strerror(errno));
+    return;
+  }
+
+  if (str_valuelen >= fieldsz) {
+    str_valuelen = fieldsz - 1;
+  }
+
+  memcpy(field, str_value, str_valuelen);
+  field[str_valuelen] = '\0';
+}
+
+static int32_t get_record_int(pool *p, unsigned int db_field) {
+  int32_t int_value = 0;
+  char *str_value = NULL;
+  size_t str_valuelen = 0;
+
+  if (snmp_db_get_value(p, db_field, &int_value, &str_value,
+      &str_valuelen) < 0) {
+    pr_trace_msg(trace_channel, 5,
+      "unable to get %s value: %s", snmp_db_get_fieldstr(p, db_field),
+      strerror(errno));
+    return -1;
+  }
+
+  return int_value;
+}
+
+int snmp_notify_record_init(pool *p, struct snmp_notify_record *record,
+    unsigned int notify_id) {
+  if (p == NULL ||
+      record == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  memset(record, 0, sizeof(struct snmp_notify_record));
+  record->notify_id = notify_id;
+  record->server_id = main_server->sid;
+  gettimeofday(&(record->notify_tv), NULL);
+
+  switch (notify_id) {
+    case SNMP_NOTIFY_DAEMON_MAX_INSTANCES:
+      record->pid = record->server_port = -1;
+      record->maxinst_conf = get_record_int(p, SNMP_DB_DAEMON_F_MAXINST_CONF);
+      break;
+
+    case SNMP_NOTIFY_FTP_BAD_PASSWD:
+    case SNMP_NOTIFY_FTP_BAD_USER:
+      record->maxinst_conf = -1;
+      record->pid = get_record_int(p, SNMP_DB_CONN_F_PID);
+      record->server_port = get_record_int(p, SNMP_DB_CONN_F_SERVER_PORT);
+
+      set_record_str(p, record->server_name, sizeof(record->server_name),
+        SNMP_DB_CONN_F_SERVER_NAME);
+      set_record_str(p, record->server_addr, sizeof(record->server_addr),
+        SNMP_DB_CONN_F_SERVER_ADDR);
+      set_record_str(p, record->client_addr, sizeof(record->client_addr),
+        SNMP_DB_CONN_F_CLIENT_ADDR);
+      set_record_str(p, record->user_name, sizeof(record->user_name),
+        SNMP_DB_CONN_F_USER_NAME);
+      set_record_str(p, record->protocol, sizeof(record->protocol),
+        SNMP_DB_CONN_F_PROTOCOL);
+      break;
+
+    default:
+      errno = ENOENT;
+      return -1;
+  }
+
+  return 0;
+}
+
+static int open_notify_sock(struct snmp_notify_sock *sock) {
+  int fd, flags;
+
+  fd = socket(pr_netaddr_get_family(sock->addr), SOCK_DGRAM, snmp_proto_udp);
+  if (fd < 0) {
+    int xerrno = errno;
+
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "unable to create UDP socket: %s", strerror(xerrno));
+
+    errno = xerrno;
+    return -1;
+  }
+
+  /* Notifications are never worth waiting for; if the socket buffer is
+   * full, the notification is dropped.
+   */
+  flags = fcntl(fd, F_GETFL);
+  if (flags < 0 ||
+      fcntl(fd, F_SETFL, flags|O_NONBLOCK) < 0) {
+    int xerrno = errno;
+
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "unable to make UDP socket non-blocking: %s", strerror(xerrno));
+
+    (void) close(fd);
+    errno = xerrno;
+    return -1;
+  }
+
+  /* Connecting the socket saves the kernel a route lookup for each datagram.
+   * If it fails, we can still send to the address.
+   */
+  sock->flags = 0;
+  if (connect(fd, pr_netaddr_get_sockaddr(sock->addr),
+      pr_netaddr_get_sockaddr_len(sock->addr)) == 0) {
+    sock->flags |= SNMP_PACKET_FL_CONNECTED;
+
+  } else {
+    pr_trace_msg(trace_channel, 5,
+      "unable to connect UDP socket to %s#%u, using unconnected socket: %s",
+      pr_netaddr_get_ipstr(sock->addr), ntohs(pr_netaddr_get_port(sock->addr)),
+      strerror(errno));
+  }
+
+  sock->fd = fd;
+  return 0;
+}
+
+static struct snmp_notify_sock *get_notify_sock(pr_netaddr_t *dst_addr) {
+  register unsigned int i;
+  struct snmp_notify_sock *socks, *sock;
+
+  if (notify_socks == NULL) {
+    if (notify_sock_pool == NULL) {
+      notify_sock_pool = make_sub_pool(permanent_pool);
+      pr_pool_tag(notify_sock_pool, "SNMP notification socket pool");
+    }
+
+    notify_socks = make_array(notify_sock_pool, 1,
+      sizeof(struct snmp_notify_sock));
+  }
+
+  socks = notify_socks->elts;
+  for (i = 0; i < notify_socks->nelts; i++) {
+    if (pr_netaddr_cmp(socks[i].addr, dst_addr) == 0 &&
+        pr_netaddr_get_port(socks[i].addr) == pr_netaddr_get_port(dst_addr)) {
+      sock = &(socks[i]);
+
+      if (sock->fd < 0 &&
+          open_notify_sock(sock) < 0) {
+        return NULL;
+      }
+
+      return sock;
+    }
+  }
+
+  sock = push_array(notify_socks);
+  sock->addr = pr_netaddr_dup(notify_sock_pool, dst_addr);
+  sock->fd = -1;
+
+  if (open_notify_sock(sock) < 0) {
+    return NULL;
+  }
+
+  return sock;
+}
+
+static void incr_inform_value(pool *p, unsigned int field, int32_t incr) {
+  if (snmp_db_incr_value(p, field, incr) < 0) {
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "error incrementing %s: %s", snmp_db_get_fieldstr(p, field),
+      strerror(errno));
+  }
+}
+
+static void free_notify_inform(pool *p, struct snmp_notify_inform *inform) {
+  inform->in_use = FALSE;
+  incr_inform_value(p, SNMP_DB_SNMP_F_INFORMS_PENDING_COUNT, -1);
+
+  notify_inform_npending--;
+  if (notify_inform_npending == 0 &&
+      notify_inform_timer_id >= 0) {
+    (void) snmp_timer_remove(notify_inform_timer_id);
+    notify_inform_timer_id = -1;
+  }
+}
+
+static void retransmit_notify_informs(void *user_data);
+
+/* Keeps the sent InformRequest, for retransmitting until it is
+ * acknowledged.
+ */
+static void add_notify_inform(struct snmp_packet *pkt,
+    struct snmp_notify_sock *sock, const char *notify_str) {
+  register unsigned int i;
+  struct snmp_notify_inform *inform = NULL;
+
+  if (pkt->resp_datalen > SNMP_NOTIFY_INFORM_MAX_DATALEN) {
+    pr_trace_msg(trace_channel, 3,
+      "%s InformRequest too large (%lu bytes) to retransmit", notify_str,
+      (unsigned long) pkt->resp_datalen);
+    return;
+  }
+
+  for (i = 0; i < SNMP_NOTIFY_INFORM_MAX_PENDING; i++) {
+    if (notify_informs[i].in_use == FALSE) {
+      inform = &(notify_informs[i]);
+      break;
+    }
+
+    if (inform == NULL ||
+        notify_informs[i].seqno < inform->seqno) {
+      inform = &(notify_informs[i]);
+    }
+  }
+
+  if (inform->in_use == TRUE) {
+    /* Too many are pending; drop the oldest. */
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "too many pending InformRequests, dropping %s InformRequest "
+      "(request ID %ld) to %s#%u", inform->notify_str, inform->request_id,
+      pr_netaddr_get_ipstr(inform->addr),
+      ntohs(pr_netaddr_get_port(inform->addr)));
+    incr_inform_value(pkt->pool, SNMP_DB_SNMP_F_TRAPS_DROPPED_TOTAL, 1);
+
+  } else {
+    incr_inform_value(pkt->pool, SNMP_DB_SNMP_F_INFORMS_PENDING_COUNT, 1);
+    notify_inform_npending++;
+  }
+
+  inform->in_use = TRUE;
+  inform->seqno = ++notify_inform_seqno;
+  inform->request_id = pkt->resp_pdu->request_id;
+  inform->addr = sock->addr;
+  inform->notify_str = notify_str;
+  inform->nretries = 0;
+  inform->timeout_ms = SNMP_NOTIFY_INFORM_TIMEOUT_MS;
+
+  gettimeofday(&(inform->retransmit_tv), NULL);
+  inform->retransmit_tv.tv_sec += (inform->timeout_ms / 1000);
+  inform->retransmit_tv.tv_usec += ((inform->timeout_ms % 1000) * 1000);
+  if (inform->retransmit_tv.tv_usec >= 1000000) {
+    inform->retransmit_tv.tv_sec++;
+    inform->retransmit_tv.tv_usec -= 1000000;
+  }
+
+  memcpy(inform->data, pkt->resp_data, pkt->resp_datalen);
+  inform->datalen = pkt->resp_datalen;
+
+  sock->informs = TRUE;
+
+  if (notify_inform_timer_id < 0) {
+    notify_inform_timer_id = snmp_timer_add(SNMP_NOTIFY_INFORM_INTERVAL_MS,
+      retransmit_notify_informs, NULL, "inform retransmits");
+    if (notify_inform_timer_id < 0) {
+      (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+        "error adding InformRequest retransmit timer: %s", strerror(errno));
+    }
+  }
+}
+
+/* Sends the notification on the receiver's socket. */
+static int send_notify_pkt(struct snmp_packet *pkt, const char *notify_str) {
+  struct snmp_notify_sock *sock;
+  int res, xerrno;
+
+  sock = get_notify_sock(pkt->remote_addr);
+  if (sock == NULL) {
+    return -1;
+  }
+
+  res = snmp_packet_send(pkt->pool, sock->fd, pkt, sock->flags);
+  if (res == 0) {
+    if (pkt->resp_pdu->request_type == SNMP_PDU_INFORM) {
+      add_notify_inform(pkt, sock, notify_str);
+    }
+
+    return 0;
+  }
+
+  xerrno = errno;
+
+  switch (xerrno) {
+    case EAGAIN:
+#if defined(EWOULDBLOCK) && EWOULDBLOCK != EAGAIN
+    case EWOULDBLOCK:
+#endif
+    case ECONNREFUSED:
+    case EHOSTUNREACH:
+    case ENETUNREACH:
+    case ENOBUFS:
+      /* Transient; the socket remains usable.  On a connected socket,
+       * ECONNREFUSED reports an ICMP error for an earlier datagram.
+       */
+      break;
+
+    default:
+      /* Reopen the socket for the next notification. */
+      (void) close(sock->fd);
+      sock->fd = -1;
+      break;
+  }
+
+  errno = xerrno;
+  return -1;
+}
+
+/* Sends the generated notification to one receiver, counting it as sent, or
+ * as failed.
+ */
+static int send_notify(int sockfd, struct snmp_packet *pkt,
+    pr_netaddr_t *dst_addr, const char *notify_str) {
+  int res;
+
+  pkt->remote_addr = dst_addr;
+
+  if (sockfd < 0) {
+    /* If not given a fd, use our socket for this receiver. */
+    res = send_notify_pkt(pkt, notify_str);
+
+  } else {
+    res = snmp_packet_write(pkt->pool, sockfd, pkt);
+  }
+
+  if (res < 0) {
+    int xerrno = errno;
+
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "unable to send %s notification to SNMPNotify %s#%u: %s", notify_str,
+      pr_netaddr_get_ipstr(dst_addr), ntohs(pr_netaddr_get_port(dst_addr)),
+      strerror(xerrno));
+
+    res = snmp_db_incr_value(pkt->pool, SNMP_DB_SNMP_F_TRAPS_SEND_ERR_TOTAL, 1);
+    if (res < 0) {
+      (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+        "error incrementing snmp.trapsSendFailedTotal: %s", strerror(errno));
+    }
+
+    errno = xerrno;
+    return -1;
+  }
+
+  res = snmp_db_incr_value(pkt->pool, SNMP_DB_SNMP_F_TRAPS_SENT_TOTAL, 1);
+  if (res < 0) {
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "error incrementing snmp.trapsSentTotal: %s", strerror(errno));
+  }
+
+  return 0;
+}
+
+static void get_notify_local(struct snmp_notify_record *record,
+    struct snmp_notify_local *local) {
+  memset(local, 0, sizeof(struct snmp_notify_local));
+
+  local->version = SNMP_NOTIFY_LOCAL_VERSION;
+  local->notify_id = record->notify_id;
+  local->server_id = record->server_id;
+  local->notify_sec = (int64_t) record->notify_tv.tv_sec;
+  local->notify_usec = (uint32_t) record->notify_tv.tv_usec;
+
+  local->pid = record->pid;
+  local->server_port = record->server_port;
+  sstrncpy(local->server_name, record->server_name, sizeof(local->server_name));
+  sstrncpy(local->server_addr, record->server_addr, sizeof(local->server_addr));
+  sstrncpy(local->client_addr, record->client_addr, sizeof(local->client_addr));
+  sstrncpy(local->user_name, record->user_name, sizeof(local->user_name));
+  sstrncpy(local->protocol, record->protocol, sizeof(local->protocol));
+
+  local->maxinst_conf = record->maxinst_conf;
+
+  local->suppressed_id = record->suppressed_id;
+  local->suppressed_count = record->suppressed_count;
+  local->suppressed_secs = record->suppressed_secs;
+  sstrncpy(local->suppressed_clients, record->suppressed_clients,
+    sizeof(local->suppressed_clients));
+
+  local->threshold_value = record->threshold_value;
+  local->threshold_limit = record->threshold_limit;
+  sstrncpy(local->threshold_text, record->threshold_text,
+    sizeof(local->threshold_text));
+
+  local->throughput_median = record->throughput_median;
+  local->throughput_baseline = record->throughput_baseline;
+}
+
+static int open_notify_local_sock(struct snmp_notify_local_sock *sock) {
+  struct sockaddr_un local_addr;
+  int fd, flags;
+
+  fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    int xerrno = errno;
+
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "unable to create Unix domain socket: %s", strerror(xerrno));
+
+    errno = xerrno;
+    return -1;
+  }
+
+  /* As for UDP, if the receiver is not keeping up, the record is dropped. */
+  flags = fcntl(fd, F_GETFL);
+  if (flags < 0 ||
+      fcntl(fd, F_SETFL, flags|O_NONBLOCK) < 0) {
+    int xerrno = errno;
+
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "unable to make Unix domain socket non-blocking: %s", strerror(xerrno));
+
+    (void) close(fd);
+    errno = xerrno;
+    return -1;
+  }
+
+  memset(&local_addr, 0, sizeof(local_addr));
+  local_addr.sun_family = AF_UNIX;
+  sstrncpy(local_addr.sun_path, sock->path, sizeof(local_addr.sun_path));
+
+  if (connect(fd, (struct sockaddr *) &local_addr, sizeof(local_addr)) < 0) {
+    int xerrno = errno;
+
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "unable to connect Unix domain socket to SNMPNotify %s: %s", sock->path,
+      strerror(xerrno));
+
+    (void) close(fd);
+    errno = xerrno;
+    return -1;
+  }
+
+  sock->fd = fd;
+  return 0;
+}
+
+static struct snmp_notify_local_sock *get_notify_local_sock(const char *path) {
+  register unsigned int i;
+  struct snmp_notify_local_sock *socks, *sock;
+
+  if (notify_local_socks == NULL) {
+    if (notify_sock_pool == NULL) {
+      notify_sock_pool = make_sub_pool(permanent_pool);
+      pr_pool_tag(notify_sock_pool, "SNMP notification socket pool");
+    }
+
+    notify_local_socks = make_array(notify_sock_pool, 1,
+      sizeof(struct snmp_notify_local_sock));
+  }
+
+  socks = notify_local_socks->elts;
+  for (i = 0; i < notify_local_socks->nelts; i++) {
+    if (strcmp(socks[i].path, path) == 0) {
+      sock = &(socks[i]);
+
+      if (sock->fd < 0 &&
+          open_notify_local_sock(sock) < 0) {
+        return NULL;
+      }
+
+      return sock;
+    }
+  }
+
+  sock = push_array(notify_local_socks);
+  sock->path = pstrdup(notify_sock_pool, path);
+  sock->fd = -1;
+
+  if (open_notify_local_sock(sock) < 0) {
+    return NULL;
+  }
+
+  return sock;
+}
+
+/* Sends the record to a local receiver, counting it as sent, or as
+ * failed.
+ */
+static int send_notify_local(pool *p, struct snmp_notify_local *local,
+    const char *path, const char *notify_str) {
+  struct snmp_notify_local_sock *sock;
+  int res;
+
+  sock = get_notify_local_sock(path);
+  if (sock == NULL) {
+    res = -1;
+
+  } else {
+    res = send(sock->fd, local, sizeof(struct snmp_notify_local), 0);
+    if (res < 0 &&
+        (errno == ECONNREFUSED ||
+         errno == ENOTCONN)) {
       int xerrno = errno;
 
-      (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
-        "unable to create UDP socket: %s", strerror(xerrno));
+      /* The receiver has gone away, or been restarted; connect again for
+       * the next record (which, in a chrooted agent, will fail).
+       */
+      (void) close(sock->fd);
+      sock->fd = -1;
+      errno = xerrno;
+    }
+  }
+
+  if (res < 0) {
+    int xerrno = errno;
+
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "unable to send %s notification to SNMPNotify %s: %s", notify_str,
+      path, strerror(xerrno));
+
+    res = snmp_db_incr_value(p, SNMP_DB_SNMP_F_TRAPS_SEND_ERR_TOTAL, 1);
+    if (res < 0) {
+      (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+        "error incrementing snmp.trapsSendFailedTotal: %s", strerror(errno));
+    }
+
+    errno = xerrno;
+    return -1;
+  }
+
+  res = snmp_db_incr_value(p, SNMP_DB_SNMP_F_TRAPS_SENT_TOTAL, 1);
+  if (res < 0) {
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "error incrementing snmp.trapsSentTotal: %s", strerror(errno));
+  }
+
+  return 0;
+}
+
+/* Whether the receiver is sent an InformRequest, rather than a trap.  Only
+ * the SNMP agent waits for the Responses to InformRequests.
+ */
+static int is_inform_receiver(struct snmp_notify_receiver *receiver,
+    int sockfd) {
+  if ((receiver->flags & SNMP_NOTIFY_RECEIVER_FL_INFORM) &&
+      notify_informs != NULL &&
+      sockfd < 0) {
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+int snmp_notify_generate(pool *p, int sockfd, const char *community,
+    pr_netaddr_t *src_addr, array_header *receivers,
+    struct snmp_notify_record *record) {
+  register unsigned int i;
+  const char *notify_str;
+  struct snmp_notify_template *tmpl;
+  struct snmp_notify_receiver **recvs;
+  struct snmp_packet *pkt;
+  unsigned int nreceivers = 0, nlocals = 0, ninforms = 0;
+  unsigned long notify_mask;
+  int32_t uptime = 0;
+  int res;
+
+  if (receivers == NULL ||
+      receivers->nelts == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  notify_str = get_notify_str(record->notify_id);
+
+  /* Skip the receivers whose SNMPNotify filters exclude this notification;
+   * if that is all of them, there is nothing to generate.
+   */
+  notify_mask = get_record_mask(record);
+
+  recvs = receivers->elts;
+  for (i = 0; i < receivers->nelts; i++) {
+    if (!(recvs[i]->notify_mask & notify_mask)) {
+      continue;
+    }
+
+    if (recvs[i]->flags & SNMP_NOTIFY_RECEIVER_FL_LOCAL) {
+      nlocals++;
+
+    } else {
+      nreceivers++;
+    }
+  }
+
+  /* Local receivers get the record itself, without any SNMP encoding. */
+  if (nlocals > 0) {
+    struct snmp_notify_local local;
+
+    get_notify_local(record, &local);
+
+    for (i = 0; i < receivers->nelts; i++) {
+      if (!(recvs[i]->notify_mask & notify_mask) ||
+          !(recvs[i]->flags & SNMP_NOTIFY_RECEIVER_FL_LOCAL)) {
+        continue;
+      }
+
+      (void) send_notify_local(p, &local, recvs[i]->path, notify_str);
+    }
+  }
+
+  if (nreceivers == 0) {
+    pr_trace_msg(trace_channel, 15,
+      "no SNMP receivers for %s notification", notify_str);
+    return 0;
+  }
+
+  tmpl = get_notify_template(record->notify_id, community);
+  if (tmpl == NULL) {
+    int xerrno = errno;
+
+    pr_trace_msg(trace_channel, 7,
+      "unable to get %s notification template: %s", notify_str,
+      strerror(xerrno));
+
+    errno = xerrno;
+    return -1;
+  }
+
+  if (get_notify_uptime(p, record, &uptime) < 0) {
+    int xerrno = errno;
+
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "unable to get system uptime for notification: %s", strerror(xerrno));
+
+    errno = xerrno;
+    return -1;
+  }
+
+  pkt = snmp_packet_create(p);
+  pkt->snmp_version = SNMP_PROTOCOL_VERSION_2;
+  pkt->community = (char *) community;
+  pkt->community_len = strlen(community);
+
+  pkt->resp_pdu = snmp_pdu_create(pkt->pool, SNMP_PDU_TRAP_V2);
+  pkt->resp_pdu->request_id = snmp_notify_get_request_id();
+
+  (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+    "writing %s SNMP notification for %s, community = '%s', request ID %ld, "
+    "for %u %s", notify_str, snmp_msg_get_versionstr(pkt->snmp_version),
+    pkt->community, pkt->resp_pdu->request_id, nreceivers,
+    nreceivers != 1 ? "receivers" : "receiver");
+
+  /* The notification is encoded once, and the same message sent to every
+   * receiver; InformRequests differ from traps only in their PDU type.
+   */
+  res = fill_notify_template(pkt->pool, tmpl, SNMP_PDU_TRAP_V2,
+    pkt->resp_pdu->request_id, uptime, record, pkt->resp_data,
+    &(pkt->resp_datalen));
+  if (res < 0) {
+    int xerrno = errno;
+
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "error writing %s SNMP notification to UDP packet: %s", notify_str,
+      strerror(xerrno));
+
+    destroy_pool(pkt->pool);
+    errno = xerrno;
+    return -1;
+  }
+
+  for (i = 0; i < receivers->nelts; i++) {
+    if (!(recvs[i]->notify_mask & notify_mask) ||
+        (recvs[i]->flags & SNMP_NOTIFY_RECEIVER_FL_LOCAL)) {
+      continue;
+    }
+
+    if (is_inform_receiver(recvs[i], sockfd) == TRUE) {
+      ninforms++;
+      continue;
+    }
+
+    (void) send_notify(sockfd, pkt, recvs[i]->addr, notify_str);
+  }
 
-      destroy_pool(pkt->pool);
-      errno = xerrno;
-      return -1;
+  if (ninforms > 0) {
+    set_template_pdu_type(tmpl, pkt->resp_data, SNMP_PDU_INFORM);
+    pkt->resp_pdu->request_type = SNMP_PDU_INFORM;
+
+    for (i = 0; i < receivers->nelts; i++) {
+      if (!(recvs[i]->notify_mask & notify_mask) ||
+          is_inform_receiver(recvs[i], sockfd) == FALSE) {
+        continue;
+      }
+
+      (void) send_notify(sockfd, pkt, recvs[i]->addr, notify_str);
     }
+  }
 
-  } else {
-    fd = sockfd;
+  destroy_pool(pkt->pool);
+  return 0;
+}
+
+int snmp_notify_open_local(array_header *receivers) {
+  register unsigned int i;
+  struct snmp_notify_receiver **recvs;
+
+  if (receivers == NULL) {
+    errno = EINVAL;
+    return -1;
   }
 
-  snmp_packet_write(p, fd, pkt);
+  recvs = receivers->elts;
+  for (i = 0; i < receivers->nelts; i++) {
+    if (!(recvs[i]->flags & SNMP_NOTIFY_RECEIVER_FL_LOCAL)) {
+      continue;
+    }
 
-  /* If we opened our own socket here, then close it. */
-  if (sockfd < 0) {
-    (void) close(fd);
+    /* Failures are logged; sending will try again. */
+    (void) get_notify_local_sock(recvs[i]->path);
   }
 
-  res = snmp_db_incr_value(pkt->pool, SNMP_DB_SNMP_F_TRAPS_SENT_TOTAL, 1);
-  if (res < 0) {
-    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
-      "error incrementing snmp.trapsSentTotal: %s", strerror(errno));
+  return 0;
+}
+
+int snmp_notify_inform_init(pool *p) {
+  if (notify_informs != NULL) {
+    return 0;
+  }
+
+  notify_inform_pool = p;
+  notify_informs = pcalloc(p, SNMP_NOTIFY_INFORM_MAX_PENDING *
+    sizeof(struct snmp_notify_inform));
+
+  /* Nothing is pending in a new agent. */
+  (void) snmp_db_reset_value(p, SNMP_DB_SNMP_F_INFORMS_PENDING_COUNT);
+  return 0;
+}
+
+int snmp_notify_inform_set_fds(fd_set *fds, int maxfd) {
+  register unsigned int i;
+  struct snmp_notify_sock *socks;
+
+  if (notify_informs == NULL ||
+      notify_socks == NULL) {
+    return maxfd;
+  }
+
+  socks = notify_socks->elts;
+  for (i = 0; i < notify_socks->nelts; i++) {
+    if (socks[i].informs == FALSE ||
+        socks[i].fd < 0) {
+      continue;
+    }
+
+    FD_SET(socks[i].fd, fds);
+    if (socks[i].fd > maxfd) {
+      maxfd = socks[i].fd;
+    }
+  }
+
+  return maxfd;
+}
+
+static void ack_notify_inform(pool *p, pr_netaddr_t *addr, long request_id) {
+  register unsigned int i;
+
+  for (i = 0; i < SNMP_NOTIFY_INFORM_MAX_PENDING; i++) {
+    struct snmp_notify_inform *inform;
+
+    inform = &(notify_informs[i]);
+    if (inform->in_use == FALSE ||
+        inform->request_id != request_id ||
+        inform->addr != addr) {
+      continue;
+    }
+
+    pr_trace_msg(trace_channel, 15,
+      "%s InformRequest (request ID %ld) acknowledged by %s#%u after %u %s",
+      inform->notify_str, request_id, pr_netaddr_get_ipstr(addr),
+      ntohs(pr_netaddr_get_port(addr)), inform->nretries,
+      inform->nretries != 1 ? "retries" : "retry");
+
+    free_notify_inform(p, inform);
+    incr_inform_value(p, SNMP_DB_SNMP_F_INFORMS_ACKED_TOTAL, 1);
+    return;
+  }
+
+  pr_trace_msg(trace_channel, 15,
+    "ignoring Response (request ID %ld) from %s#%u: no such InformRequest "
+    "pending", request_id, pr_netaddr_get_ipstr(addr),
+    ntohs(pr_netaddr_get_port(addr)));
+}
+
+static void read_inform_responses(pool *p, struct snmp_notify_sock *sock) {
+  unsigned char buf[SNMP_PACKET_MAX_LEN];
+
+  while (TRUE) {
+    struct sockaddr_storage from_sa;
+    socklen_t from_salen;
+    unsigned char pdu_type = 0, *community = NULL;
+    unsigned int community_len = 0;
+    long snmp_version = 0, request_id = 0;
+    int buflen;
+
+    from_salen = sizeof(from_sa);
+    buflen = recvfrom(sock->fd, buf, sizeof(buf), 0,
+      (struct sockaddr *) &from_sa, &from_salen);
+    if (buflen < 0) {
+      if (errno == EINTR) {
+        pr_signals_handle();
+        continue;
+      }
+
+      if (errno != EAGAIN &&
+          errno != EWOULDBLOCK) {
+        /* E.g. an ICMP error, for an earlier InformRequest. */
+        pr_trace_msg(trace_channel, 5,
+          "error reading Responses from %s#%u: %s",
+          pr_netaddr_get_ipstr(sock->addr),
+          ntohs(pr_netaddr_get_port(sock->addr)), strerror(errno));
+      }
+
+      break;
+    }
+
+    if (!(sock->flags & SNMP_PACKET_FL_CONNECTED)) {
+      pr_netaddr_t from_addr;
+
+      /* An unconnected socket receives datagrams from anywhere. */
+      memset(&from_addr, 0, sizeof(from_addr));
+      pr_netaddr_set_family(&from_addr, from_sa.ss_family);
+      pr_netaddr_set_sockaddr(&from_addr, (struct sockaddr *) &from_sa);
+
+      if (pr_netaddr_cmp(&from_addr, sock->addr) != 0 ||
+          pr_netaddr_get_port(&from_addr) != pr_netaddr_get_port(sock->addr)) {
+        continue;
+      }
+    }
+
+    if (snmp_msg_peek(buf, buflen, &snmp_version, &community, &community_len,
+        &pdu_type, &request_id) < 0) {
+      pr_trace_msg(trace_channel, 5,
+        "ignoring malformed message from %s#%u: %s",
+        pr_netaddr_get_ipstr(sock->addr),
+        ntohs(pr_netaddr_get_port(sock->addr)), strerror(errno));
+      continue;
+    }
+
+    if (pdu_type != SNMP_PDU_RESPONSE) {
+      continue;
+    }
+
+    ack_notify_inform(p, sock->addr, request_id);
+  }
+}
+
+int snmp_notify_inform_handle_fds(pool *p, fd_set *fds) {
+  register unsigned int i;
+  struct snmp_notify_sock *socks;
+
+  if (notify_informs == NULL ||
+      notify_socks == NULL) {
+    return 0;
+  }
+
+  socks = notify_socks->elts;
+  for (i = 0; i < notify_socks->nelts; i++) {
+    if (socks[i].informs == FALSE ||
+        socks[i].fd < 0 ||
+        !FD_ISSET(socks[i].fd, fds)) {
+      continue;
+    }
+
+    read_inform_responses(p, &(socks[i]));
   }
 
-  destroy_pool(pkt->pool);
   return 0;
 }
 
+/* Retransmits (or times out) the InformRequests which are due. */
+static void retransmit_notify_informs(void *user_data) {
+  register unsigned int i;
+  struct timeval now;
+  pool *p;
+
+  if (notify_informs == NULL) {
+    return;
+  }
+
+  p = notify_inform_pool;
+
+  gettimeofday(&now, NULL);
+
+  for (i = 0; i < SNMP_NOTIFY_INFORM_MAX_PENDING; i++) {
+    struct snmp_notify_inform *inform;
+    struct snmp_notify_sock *sock;
+    struct snmp_packet pkt;
+
+    inform = &(notify_informs[i]);
+    if (inform->in_use == FALSE ||
+        timercmp(&now, &(inform->retransmit_tv), <)) {
+      continue;
+    }
+
+    if (inform->nretries >= SNMP_NOTIFY_INFORM_MAX_RETRIES) {
+      (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+        "%s InformRequest (request ID %ld) to %s#%u timed out after %u "
+        "retries", inform->notify_str, inform->request_id,
+        pr_netaddr_get_ipstr(inform->addr),
+        ntohs(pr_netaddr_get_port(inform->addr)), inform->nretries);
+
+      free_notify_inform(p, inform);
+      incr_inform_value(p, SNMP_DB_SNMP_F_INFORMS_TIMEOUT_TOTAL, 1);
+      continue;
+    }
+
+    inform->nretries++;
+    incr_inform_value(p, SNMP_DB_SNMP_F_INFORMS_RETRIES_TOTAL, 1);
+
+    /* Back off exponentially. */
+    inform->timeout_ms *= 2;
+    inform->retransmit_tv = now;
+    inform->retransmit_tv.tv_sec += (inform->timeout_ms / 1000);
+    inform->retransmit_tv.tv_usec += ((inform->timeout_ms % 1000) * 1000);
+    if (inform->retransmit_tv.tv_usec >= 1000000) {
+      inform->retransmit_tv.tv_sec++;
+      inform->retransmit_tv.tv_usec -= 1000000;
+    }
+
+    sock = get_notify_sock(inform->addr);
+    if (sock == NULL) {
+      continue;
+    }
+
+    /* Retransmit the same message, with the same request ID. */
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.pool = p;
+    pkt.remote_addr = inform->addr;
+    pkt.resp_data = inform->data;
+    pkt.resp_datalen = inform->datalen;
+
+    pr_trace_msg(trace_channel, 15,
+      "retransmitting %s InformRequest (request ID %ld) to %s#%u, retry %u",
+      inform->notify_str, inform->request_id,
+      pr_netaddr_get_ipstr(inform->addr),
+      ntohs(pr_netaddr_get_port(inform->addr)), inform->nretries);
+
+    (void) snmp_packet_send(p, sock->fd, &pkt, sock->flags);
+    sock->informs = TRUE;
+  }
+}
+
 long snmp_notify_get_request_id(void) {
   long request_id;
 
@@ -446,11 +1883,367 @@ long snmp_notify_get_request_id(void) {
   request_id = rand();
 #endif /* HAVE_RANDOM */
 
+  /* Keep the request ID in the range which the request ID slot of the
+   * notification templates holds.
+   */
+  request_id &= 0x7fffffffL;
+  if (request_id < SNMP_NOTIFY_REQUEST_ID_MIN) {
+    request_id += SNMP_NOTIFY_REQUEST_ID_MIN;
+  }
+
   return request_id;
 }
 
-void snmp_notify_poll_cond(void) {
-  /* XXX Poll for notify conditions here, based on the criteria configured
-   * for various notification receivers.
+int snmp_notify_set_limit(unsigned int count, unsigned int secs) {
+  if (count > 0 &&
+      secs == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (notify_limit_pool != NULL) {
+    destroy_pool(notify_limit_pool);
+    notify_limit_pool = NULL;
+    notify_limits = NULL;
+  }
+
+  notify_limit_count = count;
+  notify_limit_secs = secs;
+
+  if (count > 0) {
+    notify_limit_pool = make_sub_pool(permanent_pool);
+    pr_pool_tag(notify_limit_pool, "SNMP Notification Rate Limit Pool");
+
+    notify_limits = make_array(notify_limit_pool, 4,
+      sizeof(struct snmp_notify_limit));
+  }
+
+  return 0;
+}
+
+static struct snmp_notify_limit *get_notify_limit(
+    struct snmp_notify_record *record) {
+  register unsigned int i;
+  struct snmp_notify_limit *limits, *limit;
+
+  limits = notify_limits->elts;
+  for (i = 0; i < notify_limits->nelts; i++) {
+    if (limits[i].server_id == record->server_id &&
+        limits[i].notify_id == record->notify_id) {
+      return &(limits[i]);
+    }
+  }
+
+  /* New buckets start full. */
+  limit = push_array(notify_limits);
+  memset(limit, 0, sizeof(struct snmp_notify_limit));
+  limit->server_id = record->server_id;
+  limit->notify_id = record->notify_id;
+  limit->tokens = (uint64_t) notify_limit_count * notify_limit_secs * 1000;
+  limit->refill_tv = record->notify_tv;
+
+  return limit;
+}
+
+/* Counts a suppressed notification against its client.  Only the clients
+ * with the most suppressed notifications are tracked: a new client replaces
+ * the least-counted one, inheriting its count (which thus over-estimates
+ * the new client's count, but never under-estimates it).
+ */
+static void add_notify_limit_client(struct snmp_notify_limit *limit,
+    const char *client_addr) {
+  register unsigned int i;
+  struct snmp_notify_client *client = NULL;
+
+  if (*client_addr == '\0') {
+    return;
+  }
+
+  for (i = 0; i < SNMP_NOTIFY_LIMIT_MAX_CLIENTS; i++) {
+    if (limit->clients[i].count == 0 ||
+        strcmp(limit->clients[i].addr, client_addr) == 0) {
+      client = &(limit->clients[i]);
+      break;
+    }
+
+    if (client == NULL ||
+        limit->clients[i].count < client->count) {
+      client = &(limit->clients[i]);
+    }
+  }
+
+  if (client->count == 0 ||
+      strcmp(client->addr, client_addr) != 0) {
+    sstrncpy(client->addr, client_addr, sizeof(client->addr));
+  }
+
+  client->count++;
+}
+
+int snmp_notify_limit(pool *p, struct snmp_notify_record *record) {
+  struct snmp_notify_limit *limit;
+  uint64_t cost, capacity;
+  long elapsed_ms;
+
+  if (record == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (notify_limits == NULL) {
+    return TRUE;
+  }
+
+  limit = get_notify_limit(record);
+
+  cost = (uint64_t) notify_limit_secs * 1000;
+  capacity = cost * notify_limit_count;
+
+  /* Records from different processes may arrive slightly out of order;
+   * the bucket is only refilled as time moves forward.
    */
+  elapsed_ms = ((record->notify_tv.tv_sec - limit->refill_tv.tv_sec) * 1000) +
+    ((record->notify_tv.tv_usec - limit->refill_tv.tv_usec) / 1000);
+  if (elapsed_ms > 0) {
+    limit->tokens += (uint64_t) elapsed_ms * notify_limit_count;
+    if (limit->tokens > capacity) {
+      limit->tokens = capacity;
+    }
+
+    limit->refill_tv = record->notify_tv;
+  }
+
+  if (limit->tokens >= cost) {
+    limit->tokens -= cost;
+    return TRUE;
+  }
+
+  if (limit->suppressed == 0) {
+    limit->suppressed_start = record->notify_tv.tv_sec;
+  }
+
+  limit->suppressed++;
+  add_notify_limit_client(limit, record->client_addr);
+
+  pr_trace_msg(trace_channel, 15,
+    "suppressed %s notification (%u suppressed since %lu)",
+    get_notify_str(record->notify_id), limit->suppressed,
+    (unsigned long) limit->suppressed_start);
+
+  if (snmp_db_incr_value(p, SNMP_DB_SNMP_F_TRAPS_SUPPRESSED_TOTAL, 1) < 0) {
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "error incrementing snmp.trapsSuppressedTotal: %s", strerror(errno));
+  }
+
+  return FALSE;
+}
+
+/* Formats the top suppressed clients as "addr (count), ...". */
+static void get_notify_limit_clients(struct snmp_notify_limit *limit,
+    char *buf, size_t bufsz) {
+  register unsigned int i;
+  size_t buflen = 0;
+
+  buf[0] = '\0';
+
+  for (i = 0; i < SNMP_NOTIFY_LIMIT_TOP_CLIENTS; i++) {
+    register unsigned int j;
+    struct snmp_notify_client *top = NULL;
+    int len;
+
+    for (j = 0; j < SNMP_NOTIFY_LIMIT_MAX_CLIENTS; j++) {
+      if (limit->clients[j].count > 0 &&
+          (top == NULL ||
+           limit->clients[j].count > top->count)) {
+        top = &(limit->clients[j]);
+      }
+    }
+
+    if (top == NULL) {
+      break;
+    }
+
+    len = snprintf(buf + buflen, bufsz - buflen, "%s%s (%u)",
+      buflen > 0 ? ", " : "", top->addr, top->count);
+    if (len < 0 ||
+        (size_t) len >= bufsz - buflen) {
+      /* Don't leave a partial entry. */
+      buf[buflen] = '\0';
+      break;
+    }
+
+    buflen += len;
+
+    /* Taken; don't pick this client again. */
+    top->count = 0;
+  }
+}
+
+int snmp_notify_get_summary(pool *p, struct snmp_notify_record *record) {
+  register unsigned int i;
+  struct snmp_notify_limit *limits;
+  struct timeval now;
+
+  if (record == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (notify_limits == NULL) {
+    errno = ENOENT;
+    return -1;
+  }
+
+  gettimeofday(&now, NULL);
+
+  limits = notify_limits->elts;
+  for (i = 0; i < notify_limits->nelts; i++) {
+    struct snmp_notify_limit *limit;
+
+    limit = &(limits[i]);
+    if (limit->suppressed == 0 ||
+        now.tv_sec - limit->suppressed_start < (time_t) notify_limit_secs) {
+      continue;
+    }
+
+    memset(record, 0, sizeof(struct snmp_notify_record));
+    record->notify_id = SNMP_NOTIFY_DAEMON_SUPPRESSED;
+    record->server_id = limit->server_id;
+    record->notify_tv = now;
+    record->pid = record->server_port = record->maxinst_conf = -1;
+    record->suppressed_id = limit->notify_id;
+    record->suppressed_count = (int32_t) limit->suppressed;
+    record->suppressed_secs = (int32_t) (now.tv_sec - limit->suppressed_start);
+    get_notify_limit_clients(limit, record->suppressed_clients,
+      sizeof(record->suppressed_clients));
+
+    pr_trace_msg(trace_channel, 9,
+      "summarizing %u suppressed %s notifications over %lu secs",
+      limit->suppressed, get_notify_str(limit->notify_id),
+      (unsigned long) record->suppressed_secs);
+
+    limit->suppressed = 0;
+    limit->suppressed_start = 0;
+    memset(limit->clients, 0, sizeof(limit->clients));
+
+    return 0;
+  }
+
+  errno = ENOENT;
+  return -1;
+}
+
+int snmp_notify_poll_cond(pool *p) {
+  int count = 0, res;
+
+  res = snmp_threshold_poll(p);
+  if (res > 0) {
+    count += res;
+  }
+
+  res = snmp_throughput_poll(p);
+  if (res > 0) {
+    count += res;
+  }
+
+  return count;
+}
+
+int snmp_notify_queue_open(pool *p) {
+  if (notify_queue != NULL) {
+    return 0;
+  }
+
+  notify_queue = snmp_ring_create(p, SNMP_NOTIFY_QUEUE_MAX_RECORDS,
+    sizeof(struct snmp_notify_record));
+  if (notify_queue == NULL) {
+    return -1;
+  }
+
+  return 0;
+}
+
+int snmp_notify_queue_close(void) {
+  int res;
+
+  if (notify_queue == NULL) {
+    return 0;
+  }
+
+  res = snmp_ring_destroy(notify_queue);
+  notify_queue = NULL;
+  return res;
+}
+
+int snmp_notify_queue_add(pool *p, struct snmp_notify_record *record) {
+  int res;
+
+  if (notify_queue == NULL) {
+    errno = ENOSYS;
+    return -1;
+  }
+
+  res = snmp_ring_add(notify_queue, record, sizeof(struct snmp_notify_record));
+  if (res < 0) {
+    int xerrno = errno;
+
+    if (xerrno == ENOSPC ||
+        xerrno == ETIMEDOUT) {
+      /* The agent is not keeping up (or is gone), or gave up waiting for
+       * us; drop the notification rather than make this process wait.
+       */
+      if (snmp_db_incr_value(p, SNMP_DB_SNMP_F_TRAPS_DROPPED_TOTAL, 1) < 0) {
+        (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+          "error incrementing snmp.trapsDroppedTotal: %s", strerror(errno));
+      }
+    }
+
+    errno = xerrno;
+    return -1;
+  }
+
+  pr_trace_msg(trace_channel, 17, "queued %s notification for SNMP agent",
+    get_notify_str(record->notify_id));
+  return 0;
+}
+
+int snmp_notify_queue_get_fd(void) {
+  if (notify_queue == NULL) {
+    errno = ENOSYS;
+    return -1;
+  }
+
+  return snmp_ring_get_fd(notify_queue);
+}
+
+int snmp_notify_queue_next(struct snmp_notify_record *record) {
+  int res;
+
+  if (notify_queue == NULL) {
+    errno = ENOSYS;
+    return -1;
+  }
+
+  res = snmp_ring_next(notify_queue, record,
+    sizeof(struct snmp_notify_record));
+  if (res < 0 &&
+      errno == ENOENT) {
+    /* Clear the fd, then check once more, for any records queued while
+     * the fd was still readable.
+     */
+    (void) snmp_ring_clear_fd(notify_queue);
+    res = snmp_ring_next(notify_queue, record,
+      sizeof(struct snmp_notify_record));
+  }
+
+  if (res < 0) {
+    return -1;
+  }
+
+  if ((size_t) res != sizeof(struct snmp_notify_record)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  return 0;
 }
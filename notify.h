@@ -30,12 +30,268 @@
 
 /* ftp.notifications */
 #define SNMP_NOTIFY_DAEMON_MAX_INSTANCES	100
+#define SNMP_NOTIFY_DAEMON_SUPPRESSED		101
+#define SNMP_NOTIFY_DAEMON_THRESHOLD_EXCEEDED	102
+#define SNMP_NOTIFY_DAEMON_THRESHOLD_CLEARED	103
+#define SNMP_NOTIFY_DAEMON_THROUGHPUT_DEGRADED	104
+#define SNMP_NOTIFY_DAEMON_THROUGHPUT_RECOVERED	105
 #define SNMP_NOTIFY_FTP_BAD_PASSWD		1000
 #define SNMP_NOTIFY_FTP_BAD_USER		1001
 
+/* How often, in millisecs, the SNMP agent polls for notification
+ * conditions.
+ */
+#define SNMP_NOTIFY_POLL_INTERVAL_MS		5000
+
+/* Maximum number of notification records queued for the SNMP agent. */
+#define SNMP_NOTIFY_QUEUE_MAX_RECORDS		256
+
+#define SNMP_NOTIFY_RECORD_MAX_ADDRLEN		48
+#define SNMP_NOTIFY_RECORD_MAX_NAMELEN		64
+#define SNMP_NOTIFY_RECORD_MAX_CLIENTSLEN	160
+#define SNMP_NOTIFY_RECORD_MAX_TEXTLEN		128
+
+/* A notification record holds the event-specific values for a notification,
+ * as collected in the process where the event happened (e.g. a session
+ * process), so that the notification can be generated elsewhere (e.g. in the
+ * SNMP agent process).  Unavailable strings are empty; unavailable integers
+ * are -1.
+ */
+struct snmp_notify_record {
+  unsigned int notify_id;
+
+  /* The server (vhost) whose SNMPNotify receivers are notified. */
+  unsigned int server_id;
+
+  /* When the event happened. */
+  struct timeval notify_tv;
+
+  int32_t pid;
+  int32_t server_port;
+  int32_t maxinst_conf;
+
+  char server_name[SNMP_NOTIFY_RECORD_MAX_NAMELEN];
+  char server_addr[SNMP_NOTIFY_RECORD_MAX_ADDRLEN];
+  char client_addr[SNMP_NOTIFY_RECORD_MAX_ADDRLEN];
+  char user_name[SNMP_NOTIFY_RECORD_MAX_NAMELEN];
+  char protocol[16];
+
+  /* For notificationsSuppressed summaries: the suppressed notification,
+   * how many were suppressed over how many seconds, and the clients which
+   * caused the most of them.
+   */
+  unsigned int suppressed_id;
+  int32_t suppressed_count;
+  int32_t suppressed_secs;
+  char suppressed_clients[SNMP_NOTIFY_RECORD_MAX_CLIENTSLEN];
+
+  /* For thresholdExceeded/thresholdCleared: the threshold, the MIB (as an
+   * index into the MIB table) it is on, its value, and the crossed limit.
+   */
+  char threshold_text[SNMP_NOTIFY_RECORD_MAX_TEXTLEN];
+  int32_t threshold_mib_idx;
+  int32_t threshold_value;
+  int32_t threshold_limit;
+
+  /* For throughputDegraded/throughputRecovered: the median of the recent
+   * transfer throughputs, and their baseline, in bytes/sec, for the
+   * protocol.
+   */
+  int32_t throughput_median;
+  int32_t throughput_baseline;
+};
+
+/* A notification receiver, as configured via SNMPNotify: either an SNMP
+ * manager, at addr, or a local receiver, listening on the Unix domain
+ * datagram socket at path.
+ */
+struct snmp_notify_receiver {
+  pr_netaddr_t *addr;
+  const char *path;
+  unsigned long flags;
+
+  /* The notifications, by their snmp_notify_get_mask() bits, which the
+   * receiver is sent.
+   */
+  unsigned long notify_mask;
+};
+
+/* Send InformRequests, rather than traps, to the receiver. */
+#define SNMP_NOTIFY_RECEIVER_FL_INFORM		0x001
+
+/* Send struct snmp_notify_local records, rather than SNMP messages, to the
+ * receiver's path.
+ */
+#define SNMP_NOTIFY_RECEIVER_FL_LOCAL		0x002
+
+#define SNMP_NOTIFY_RECEIVER_MASK_ALL		(~0UL)
+
+/* The record sent, as a single datagram, to local receivers, so that
+ * processes on the same host can receive notifications without decoding
+ * SNMP messages.  Integers are in host byte order; unavailable integers are
+ * -1, and unavailable strings are empty; fields which do not apply to the
+ * notify_id are to be ignored.  The version changes if the layout does.
+ */
+#define SNMP_NOTIFY_LOCAL_VERSION		2
+
+struct snmp_notify_local {
+  uint32_t version;
+  uint32_t notify_id;
+  uint32_t server_id;
+
+  /* When the event happened. */
+  uint32_t notify_usec;
+  int64_t notify_sec;
+
+  int32_t pid;
+  int32_t server_port;
+  char server_name[SNMP_NOTIFY_RECORD_MAX_NAMELEN];
+  char server_addr[SNMP_NOTIFY_RECORD_MAX_ADDRLEN];
+  char client_addr[SNMP_NOTIFY_RECORD_MAX_ADDRLEN];
+  char user_name[SNMP_NOTIFY_RECORD_MAX_NAMELEN];
+  char protocol[16];
+
+  /* maxInstancesExceeded */
+  int32_t maxinst_conf;
+
+  /* notificationsSuppressed */
+  uint32_t suppressed_id;
+  int32_t suppressed_count;
+  int32_t suppressed_secs;
+  char suppressed_clients[SNMP_NOTIFY_RECORD_MAX_CLIENTSLEN];
+
+  /* thresholdExceeded, thresholdCleared */
+  int32_t threshold_value;
+  int32_t threshold_limit;
+  char threshold_text[SNMP_NOTIFY_RECORD_MAX_TEXTLEN];
+
+  /* throughputDegraded, throughputRecovered */
+  int32_t throughput_median;
+  int32_t throughput_baseline;
+};
+
+/* Notification severities, for filtering receivers' notifications. */
+#define SNMP_NOTIFY_SEVERITY_INFO		1
+#define SNMP_NOTIFY_SEVERITY_WARNING		2
+#define SNMP_NOTIFY_SEVERITY_CRITICAL		3
+
+/* Returns the ID of the notification with the given name (e.g.
+ * "loginFailedBadUser"), or -1, with errno set to ENOENT, if there is no
+ * such notification.
+ */
+int snmp_notify_get_id(const char *name);
+
+/* Returns the bit for the given notification in a receiver's notify_mask,
+ * or zero for an unknown notification.
+ */
+unsigned long snmp_notify_get_mask(unsigned int notify_id);
+
+/* Returns the mask of the notifications of at least the given severity. */
+unsigned long snmp_notify_get_severity_mask(int min_severity);
+
+/* Fills in the record for the given notification, from the current
+ * process.
+ */
+int snmp_notify_record_init(pool *p, struct snmp_notify_record *record,
+  unsigned int notify_id);
+
+/* Encodes a template for each type of notification, for the given
+ * community, so that notifications need not be encoded from scratch.
+ * Templates for any other community are created when first used.
+ */
+int snmp_notify_init_templates(const char *community);
+
+/* Generates the notification for the record, and sends it to each of the
+ * receivers (an array of struct snmp_notify_receiver pointers) whose
+ * notify_mask includes it.  The notification is encoded once, however many
+ * SNMP receivers there are; local receivers are sent the record, as a
+ * struct snmp_notify_local.  Failures to send to a receiver are logged, and
+ * counted in snmp.trapsSendFailedTotal; returns -1 only if the notification
+ * could not be generated.
+ */
 int snmp_notify_generate(pool *p, int sockfd, const char *community,
-  pr_netaddr_t *src_addr, pr_netaddr_t *dst_addr, unsigned int notify_id);
+  pr_netaddr_t *src_addr, array_header *receivers,
+  struct snmp_notify_record *record);
 long snmp_notify_get_request_id(void);
-void snmp_notify_poll_cond(void);
+
+/* Opens, and connects, the sockets for the local receivers among the
+ * receivers.  Used by the SNMP agent before it is chrooted, after which the
+ * receivers' paths cannot be reached.
+ */
+int snmp_notify_open_local(array_header *receivers);
+
+/* Evaluates the configured notification conditions (see threshold.h and
+ * throughput.h), queuing notifications for any which have changed.  Returns
+ * the number of notifications queued.
+ */
+int snmp_notify_poll_cond(pool *p);
+
+/* Rate limiting: at most count notifications of each type, per server, are
+ * sent in any secs seconds (with bursts of up to count).  Suppressed
+ * notifications are summarized in a notificationsSuppressed notification,
+ * once secs seconds have passed since the first of them.  A count of zero
+ * disables rate limiting.
+ */
+int snmp_notify_set_limit(unsigned int count, unsigned int secs);
+
+/* Returns TRUE if the notification for the record may be sent, or FALSE if
+ * it is suppressed.
+ */
+int snmp_notify_limit(pool *p, struct snmp_notify_record *record);
+
+/* Fills in the next due notificationsSuppressed summary.  Returns -1, with
+ * errno set to ENOENT, if there are no more due summaries.
+ */
+int snmp_notify_get_summary(pool *p, struct snmp_notify_record *record);
+
+/* The notification queue carries records from the processes where events
+ * happen to the SNMP agent process, which generates the notifications.  It
+ * is opened in the daemon process, before the agent and session processes
+ * are forked.
+ */
+int snmp_notify_queue_open(pool *p);
+int snmp_notify_queue_close(void);
+
+/* Queues the record for the SNMP agent.  Returns -1, with errno set to
+ * ENOSYS, if there is no queue; the caller then generates the notifications
+ * itself.
+ */
+int snmp_notify_queue_add(pool *p, struct snmp_notify_record *record);
+
+/* Used by the SNMP agent: returns the fd which becomes readable when records
+ * are queued, and takes the queued records.  Once the queue is empty, the fd
+ * is cleared, until more records are queued.
+ */
+int snmp_notify_queue_get_fd(void);
+int snmp_notify_queue_next(struct snmp_notify_record *record);
+
+/* InformRequests are only sent by the SNMP agent process; elsewhere, inform
+ * receivers are sent traps.  Each InformRequest is kept until its Response
+ * arrives, and retransmitted, with exponential backoff, until it times out.
+ * If too many are pending, the oldest is dropped.
+ */
+#define SNMP_NOTIFY_INFORM_MAX_PENDING		64
+#define SNMP_NOTIFY_INFORM_MAX_RETRIES		4
+#define SNMP_NOTIFY_INFORM_TIMEOUT_MS		1000
+
+/* How often, in millisecs, the SNMP agent checks for InformRequests to
+ * retransmit, while any are pending.
+ */
+#define SNMP_NOTIFY_INFORM_INTERVAL_MS		250
+
+/* Larger InformRequests are sent, but not retransmitted. */
+#define SNMP_NOTIFY_INFORM_MAX_DATALEN		1472
+
+int snmp_notify_inform_init(pool *p);
+
+/* Adds the sockets on which Responses to InformRequests may arrive to the
+ * set, and returns the new highest fd.
+ */
+int snmp_notify_inform_set_fds(fd_set *fds, int maxfd);
+
+/* Reads the Responses on the sockets in the set, acknowledging their
+ * InformRequests.
+ */
+int snmp_notify_inform_handle_fds(pool *p, fd_set *fds);
 
 #endif
@@ -137,3 +137,61 @@ int snmp_packet_write(pool *p, int sockfd, struct snmp_packet *pkt) {
 
   return res;
 }
+
+int snmp_packet_send(pool *p, int sockfd, struct snmp_packet *pkt,
+    int flags) {
+  int res;
+
+  if (sockfd < 0 ||
+      pkt == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  pr_trace_msg(trace_channel, 3,
+    "sending %lu UDP message bytes to %s#%u",
+    (unsigned long) pkt->resp_datalen,
+    pr_netaddr_get_ipstr(pkt->remote_addr),
+    ntohs(pr_netaddr_get_port(pkt->remote_addr)));
+
+  while (TRUE) {
+    if (flags & SNMP_PACKET_FL_CONNECTED) {
+      res = send(sockfd, pkt->resp_data, pkt->resp_datalen, 0);
+
+    } else {
+      res = sendto(sockfd, pkt->resp_data, pkt->resp_datalen, 0,
+        pr_netaddr_get_sockaddr(pkt->remote_addr),
+        pr_netaddr_get_sockaddr_len(pkt->remote_addr));
+    }
+
+    if (res < 0 &&
+        errno == EINTR) {
+      pr_signals_handle();
+      continue;
+    }
+
+    break;
+  }
+
+  if (res < 0) {
+    int xerrno = errno;
+
+    pr_trace_msg(trace_channel, 3,
+      "error sending %lu UDP message bytes to %s#%u: %s",
+      (unsigned long) pkt->resp_datalen,
+      pr_netaddr_get_ipstr(pkt->remote_addr),
+      ntohs(pr_netaddr_get_port(pkt->remote_addr)), strerror(xerrno));
+
+    errno = xerrno;
+    return -1;
+  }
+
+  res = snmp_db_incr_value(pkt->pool, SNMP_DB_SNMP_F_PKTS_SENT_TOTAL, 1);
+  if (res < 0) {
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "error incrementing SNMP database for "
+      "snmp.packetsSentTotal: %s", strerror(errno));
+  }
+
+  return 0;
+}
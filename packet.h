@@ -33,6 +33,11 @@
 /* SNMP packets shouldn't be larger than 4K, right? */
 #define SNMP_PACKET_MAX_LEN		4096
 
+/* RFC 3417, Section 3.2: the smallest maximum message size that an SNMP
+ * entity must accept.
+ */
+#define SNMP_PACKET_MIN_LEN		484
+
 struct snmp_packet {
   pool *pool;
 
@@ -62,4 +67,13 @@ struct snmp_packet {
 struct snmp_packet *snmp_packet_create(pool *p);
 int snmp_packet_write(pool *p, int sockfd, struct snmp_packet *pkt);
 
+/* Sends the packet on a non-blocking socket, without waiting for socket
+ * space; if the datagram cannot be sent immediately, it is not sent.  If
+ * the socket is connected, it must be connected to the packet's remote
+ * address.
+ */
+int snmp_packet_send(pool *p, int sockfd, struct snmp_packet *pkt,
+  int flags);
+#define SNMP_PACKET_FL_CONNECTED	0x01
+
 #endif
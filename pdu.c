@@ -90,8 +90,10 @@ struct snmp_pdu *snmp_pdu_create(pool *p, unsigned char request_type) {
   pdu->pool = sub_pool;
   pdu->request_type = request_type;
 
-  pr_trace_msg(trace_channel, 19,
-    "created PDU of type '%s'", snmp_pdu_get_request_type_desc(request_type));
+  if (snmp_trace_is_enabled(trace_channel, 19)) {
+    pr_trace_msg(trace_channel, 19,
+      "created PDU of type '%s'", snmp_pdu_get_request_type_desc(request_type));
+  }
   return pdu;
 }
 
@@ -182,8 +184,10 @@ int snmp_pdu_read(pool *p, unsigned char **buf, size_t *buflen,
     return -1;
   }
 
-  pr_trace_msg(trace_channel, 19,
-    "read in PDU (0x%02x), length %u bytes", asn1_type, asn1_len);
+  if (snmp_trace_is_enabled(trace_channel, 19)) {
+    pr_trace_msg(trace_channel, 19,
+      "read in PDU (0x%02x), length %u bytes", asn1_type, asn1_len);
+  }
 
   *pdu = snmp_pdu_create(p, asn1_type);
 
@@ -206,8 +210,10 @@ int snmp_pdu_read(pool *p, unsigned char **buf, size_t *buflen,
       if (res < 0) {
         return -1;
       }
-      pr_trace_msg(trace_channel, 19,
-        "read PDU request ID: %ld", (*pdu)->request_id);
+      if (snmp_trace_is_enabled(trace_channel, 19)) {
+        pr_trace_msg(trace_channel, 19,
+          "read PDU request ID: %ld", (*pdu)->request_id);
+      }
 
       /* Non-repeaters */
       res = snmp_asn1_read_int(p, buf, buflen, &asn1_type,
@@ -215,8 +221,10 @@ int snmp_pdu_read(pool *p, unsigned char **buf, size_t *buflen,
       if (res < 0) {
         return -1;
       }
-      pr_trace_msg(trace_channel, 19,
-        "read PDU non-repeaters: %ld", (*pdu)->non_repeaters);
+      if (snmp_trace_is_enabled(trace_channel, 19)) {
+        pr_trace_msg(trace_channel, 19,
+          "read PDU non-repeaters: %ld", (*pdu)->non_repeaters);
+      }
 
       /* As per RFC1905, if non_repeaters is negative, it is set to zero. */
       if ((*pdu)->non_repeaters < 0) {
@@ -229,8 +237,10 @@ int snmp_pdu_read(pool *p, unsigned char **buf, size_t *buflen,
       if (res < 0) {
         return -1;
       }
-      pr_trace_msg(trace_channel, 19,
-        "read PDU max-repetitions: %ld", (*pdu)->max_repetitions);
+      if (snmp_trace_is_enabled(trace_channel, 19)) {
+        pr_trace_msg(trace_channel, 19,
+          "read PDU max-repetitions: %ld", (*pdu)->max_repetitions);
+      }
 
       /* As per RFC1905, if max_repetitions is negative, it is set to zero. */
       if ((*pdu)->max_repetitions < 0) {
@@ -246,8 +256,10 @@ int snmp_pdu_read(pool *p, unsigned char **buf, size_t *buflen,
       if (res < 0) {
         return -1;
       }
-      pr_trace_msg(trace_channel, 19,
-        "read PDU request ID: %ld", (*pdu)->request_id);
+      if (snmp_trace_is_enabled(trace_channel, 19)) {
+        pr_trace_msg(trace_channel, 19,
+          "read PDU request ID: %ld", (*pdu)->request_id);
+      }
 
       /* Error Status/Code */
       res = snmp_asn1_read_int(p, buf, buflen, &asn1_type,
@@ -255,8 +267,10 @@ int snmp_pdu_read(pool *p, unsigned char **buf, size_t *buflen,
       if (res < 0) {
         return -1;
       }
-      pr_trace_msg(trace_channel, 19,
-        "read PDU error status/code: %ld", (*pdu)->err_code);
+      if (snmp_trace_is_enabled(trace_channel, 19)) {
+        pr_trace_msg(trace_channel, 19,
+          "read PDU error status/code: %ld", (*pdu)->err_code);
+      }
 
       /* XXX What if err_code is non-zero? */
 
@@ -266,8 +280,10 @@ int snmp_pdu_read(pool *p, unsigned char **buf, size_t *buflen,
       if (res < 0) {
         return -1;
       }
-      pr_trace_msg(trace_channel, 19,
-        "read PDU error index: %ld", (*pdu)->err_idx);
+      if (snmp_trace_is_enabled(trace_channel, 19)) {
+        pr_trace_msg(trace_channel, 19,
+          "read PDU error index: %ld", (*pdu)->err_idx);
+      }
 
       /* XXX What if err_idx is non-zero? */
 
@@ -279,79 +295,72 @@ int snmp_pdu_read(pool *p, unsigned char **buf, size_t *buflen,
     return -1;
   }
 
-  (*pdu)->varlistlen = res;
-
-  pr_trace_msg(trace_channel, 17,
-    "read %d %s from %s message", res,
-    res != 1 ? "variables" : "variable",
-    snmp_msg_get_versionstr(snmp_version));
+  if (snmp_trace_is_enabled(trace_channel, 17)) {
+    pr_trace_msg(trace_channel, 17,
+      "read %d %s from %s message", res,
+      res != 1 ? "variables" : "variable",
+      snmp_msg_get_versionstr(snmp_version));
+  }
 
   return 0;
 }
 
+/* Note that the PDU is written back-to-front, i.e. the encoded PDU ends at the
+ * given *buf, and *buf is moved back to the start of the encoded PDU.
+ */
 int snmp_pdu_write(pool *p, unsigned char **buf, size_t *buflen,
     struct snmp_pdu *pdu, long snmp_version) {
-  unsigned char asn1_type, *pdu_hdr_start, *pdu_hdr_end;
-  size_t pdu_hdr_startlen;
+  unsigned char asn1_type, *pdu_end;
   unsigned int asn1_len;
   int flags, res;
 
-  pr_trace_msg(trace_channel, 19,
-    "writing %s PDU (0x%02x)",
-    snmp_pdu_get_request_type_desc(pdu->request_type), pdu->request_type);
-
-  /* Since the "type" in this header is the PDU request type, the trace logging
-   * of the ASN.1 type will be wrong.  That being the case, simply tell the
-   * writers to not trace log that wrong invalid ASN.1 type.  Makes the
-   * trace logging confusing and incorrect.
-   */
-  flags = SNMP_ASN1_FL_NO_TRACE_TYPESTR;
-
-  asn1_type = pdu->request_type;
-  asn1_len = 0;
-
-  pdu_hdr_start = *buf;
-  pdu_hdr_startlen = *buflen;
-
-  res = snmp_asn1_write_header(p, buf, buflen, asn1_type, asn1_len, flags);
-  if (res < 0) {
-    return -1;
+  if (snmp_trace_is_enabled(trace_channel, 19)) {
+    pr_trace_msg(trace_channel, 19,
+      "writing %s PDU (0x%02x)",
+      snmp_pdu_get_request_type_desc(pdu->request_type), pdu->request_type);
   }
 
-  pdu_hdr_end = *buf;
+  pdu_end = *buf;
 
   switch (pdu->request_type) {
     case SNMP_PDU_GETBULK:
       asn1_type = (SNMP_ASN1_CLASS_UNIVERSAL|SNMP_ASN1_PRIMITIVE|SNMP_ASN1_TYPE_INTEGER);
 
-      /* Request ID */
-      pr_trace_msg(trace_channel, 19,
-        "writing PDU request ID: %ld", pdu->request_id);
-      res = snmp_asn1_write_int(p, buf, buflen, asn1_type, pdu->request_id, 0);
+      /* XXX write varlist? */
+
+      /* Max-repetitions */
+      if (snmp_trace_is_enabled(trace_channel, 19)) {
+        pr_trace_msg(trace_channel, 19,
+          "writing PDU max-repetitions: %ld", pdu->max_repetitions);
+      }
+      res = snmp_asn1_prepend_int(p, buf, buflen, asn1_type,
+        pdu->max_repetitions, 0);
       if (res < 0) {
         return -1;
       }
 
       /* Non-repeaters */
-      pr_trace_msg(trace_channel, 19,
-        "writing PDU non-repeaters: %ld", pdu->non_repeaters);
-      res = snmp_asn1_write_int(p, buf, buflen, asn1_type,
+      if (snmp_trace_is_enabled(trace_channel, 19)) {
+        pr_trace_msg(trace_channel, 19,
+          "writing PDU non-repeaters: %ld", pdu->non_repeaters);
+      }
+      res = snmp_asn1_prepend_int(p, buf, buflen, asn1_type,
         pdu->non_repeaters, 0);
       if (res < 0) {
         return -1;
       }
 
-      /* Max-repetitions */
-      pr_trace_msg(trace_channel, 19,
-        "writing PDU max-repetitions: %ld", pdu->max_repetitions);
-      res = snmp_asn1_write_int(p, buf, buflen, asn1_type,
-        pdu->max_repetitions, 0);
+      /* Request ID */
+      if (snmp_trace_is_enabled(trace_channel, 19)) {
+        pr_trace_msg(trace_channel, 19,
+          "writing PDU request ID: %ld", pdu->request_id);
+      }
+      res = snmp_asn1_prepend_int(p, buf, buflen, asn1_type, pdu->request_id,
+        0);
       if (res < 0) {
         return -1;
       }
 
-      /* XXX write varlist? */
-
       break;
 
     default:
@@ -359,35 +368,61 @@ int snmp_pdu_write(pool *p, unsigned char **buf, size_t *buflen,
 
       asn1_type = (SNMP_ASN1_CLASS_UNIVERSAL|SNMP_ASN1_PRIMITIVE|SNMP_ASN1_TYPE_INTEGER);
 
-      /* Request ID */
-      pr_trace_msg(trace_channel, 19,
-        "writing PDU request ID: %ld", pdu->request_id);
-      res = snmp_asn1_write_int(p, buf, buflen, asn1_type, pdu->request_id, 0);
+      /* Variable bindings list */
+      if (snmp_trace_is_enabled(trace_channel, 19)) {
+        unsigned int var_count = 0;
+
+        if (pdu->bindings != NULL) {
+          var_count = pdu->bindings->nelts;
+
+        } else if (pdu->varlist != NULL) {
+          var_count = pdu->varlist->nelts;
+        }
+
+        pr_trace_msg(trace_channel, 19,
+          "writing PDU variable binding list: (%u %s)", var_count,
+          var_count != 1 ? "variables" : "variable");
+      }
+
+      if (pdu->bindings != NULL) {
+        res = snmp_smi_write_bindings(p, buf, buflen, pdu->bindings,
+          snmp_version);
+
+      } else {
+        res = snmp_smi_write_vars(p, buf, buflen, pdu->varlist, snmp_version);
+      }
+
       if (res < 0) {
         return -1;
       }
 
-      /* Error Status/Code */
-      pr_trace_msg(trace_channel, 19,
-        "writing PDU error status/code: %ld", pdu->err_code);
-      res = snmp_asn1_write_int(p, buf, buflen, asn1_type, pdu->err_code, 0);
+      /* Error Index */
+      if (snmp_trace_is_enabled(trace_channel, 19)) {
+        pr_trace_msg(trace_channel, 19,
+          "writing PDU error index: %ld", pdu->err_idx);
+      }
+      res = snmp_asn1_prepend_int(p, buf, buflen, asn1_type, pdu->err_idx, 0);
       if (res < 0) {
         return -1;
       }
 
-      /* Error Index */
-      pr_trace_msg(trace_channel, 19,
-        "writing PDU error index: %ld", pdu->err_idx);
-      res = snmp_asn1_write_int(p, buf, buflen, asn1_type, pdu->err_idx, 0);
+      /* Error Status/Code */
+      if (snmp_trace_is_enabled(trace_channel, 19)) {
+        pr_trace_msg(trace_channel, 19,
+          "writing PDU error status/code: %ld", pdu->err_code);
+      }
+      res = snmp_asn1_prepend_int(p, buf, buflen, asn1_type, pdu->err_code, 0);
       if (res < 0) {
         return -1;
       }
 
-      /* Variable bindings list */
-      pr_trace_msg(trace_channel, 19,
-        "writing PDU variable binding list: (%u %s)", pdu->varlistlen,
-        pdu->varlistlen != 1 ? "variables" : "variable");
-      res = snmp_smi_write_vars(p, buf, buflen, pdu->varlist, snmp_version);
+      /* Request ID */
+      if (snmp_trace_is_enabled(trace_channel, 19)) {
+        pr_trace_msg(trace_channel, 19,
+          "writing PDU request ID: %ld", pdu->request_id);
+      }
+      res = snmp_asn1_prepend_int(p, buf, buflen, asn1_type, pdu->request_id,
+        0);
       if (res < 0) {
         return -1;
       }
@@ -395,15 +430,21 @@ int snmp_pdu_write(pool *p, unsigned char **buf, size_t *buflen,
       break;
   }
 
-  /* Rewrite the PDU header, this time with the length of the entire PDU. */
+  /* Since the "type" in this header is the PDU request type, the trace logging
+   * of the ASN.1 type will be wrong.  That being the case, simply tell the
+   * writers to not trace log that wrong invalid ASN.1 type.  Makes the
+   * trace logging confusing and incorrect.
+   */
+  flags = SNMP_ASN1_FL_NO_TRACE_TYPESTR;
 
   asn1_type = pdu->request_type;
-  asn1_len = (*buf - pdu_hdr_end);
+  asn1_len = (unsigned int) (pdu_end - *buf);
 
-  pr_trace_msg(trace_channel, 18,
-    "updating PDU header to have length %u", asn1_len);
-  res = snmp_asn1_write_header(p, &pdu_hdr_start, &pdu_hdr_startlen, asn1_type,
-    asn1_len, flags);
+  if (snmp_trace_is_enabled(trace_channel, 18)) {
+    pr_trace_msg(trace_channel, 18,
+      "writing PDU header with length %u", asn1_len);
+  }
+  res = snmp_asn1_prepend_header(p, buf, buflen, asn1_type, asn1_len, flags);
   if (res < 0) {
     return -1;
   }
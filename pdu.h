@@ -94,9 +94,13 @@ struct snmp_pdu {
   long non_repeaters;
   long max_repetitions;
 
-  /* For responses. */
-  struct snmp_var *varlist;
-  unsigned int varlistlen;
+  /* For responses; an array of struct snmp_var. */
+  array_header *varlist;
+
+  /* For responses generated by the agent; an array of struct snmp_binding,
+   * which, if present, is written instead of the varlist.
+   */
+  array_header *bindings;
 
   /* For traps. */
   oid_t *trap_oid;
@@ -116,6 +120,7 @@ struct snmp_pdu *snmp_pdu_dup(pool *p, struct snmp_pdu *pdu);
 
 int snmp_pdu_read(pool *p, unsigned char **buf, size_t *buflen,
     struct snmp_pdu **pdu, long snmp_version);
+/* Writes the PDU back-to-front, immediately in front of *buf. */
 int snmp_pdu_write(pool *p, unsigned char **buf, size_t *buflen,
     struct snmp_pdu *pdu, long snmp_version);
 
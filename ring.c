@@ -0,0 +1,380 @@
+/*
+ * ProFTPD - mod_snmp shared-memory rings
+ * Copyright (c) 2013 TJ Saunders
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, TJ Saunders and other respective copyright holders
+ * give permission to link this program with OpenSSL, and distribute the
+ * resulting executable, without including the source code for OpenSSL in the
+ * source distribution.
+ *
+ * $Id$
+ */
+
+#include "mod_snmp.h"
+#include "ring.h"
+
+#ifndef MAP_FAILED
+# define MAP_FAILED	((void *) -1)
+#endif
+
+#if defined(MAP_ANONYMOUS)
+# define SNMP_RING_MAP_ANON	MAP_ANONYMOUS
+#elif defined(MAP_ANON)
+# define SNMP_RING_MAP_ANON	MAP_ANON
+#endif
+
+/* How long, in seconds, the consumer will wait for a claimed record to be
+ * written before deciding that its producer died, and skipping it.
+ */
+#define SNMP_RING_MAX_STALL_SECS	5
+
+/* The shared ring header.  The producers' and consumer's positions are kept
+ * on separate cache lines.
+ */
+struct snmp_ring_hdr {
+  volatile uint32_t head;
+  char pad1[60];
+
+  volatile uint32_t tail;
+  volatile uint32_t wakeup;
+  char pad2[56];
+};
+
+/* Each slot has a sequence number, which says whose turn it is: a slot at
+ * position pos is free for the producer claiming pos when its sequence is
+ * pos, and holds a record for the consumer when its sequence is pos + 1.
+ */
+struct snmp_ring_slot {
+  volatile uint32_t seqno;
+  uint32_t recordlen;
+};
+
+struct snmp_ring {
+  pool *pool;
+
+  struct snmp_ring_hdr *hdr;
+  unsigned char *slots;
+  size_t mapsz;
+
+  uint32_t nslots;
+  size_t recordsz;
+  size_t slotsz;
+
+  /* The pipe used for waking the consumer. */
+  int fds[2];
+
+  /* Consumer-only state, for skipping abandoned slots. */
+  uint32_t stall_pos;
+  time_t stall_start;
+};
+
+static const char *trace_channel = "snmp.ring";
+
+static struct snmp_ring_slot *ring_get_slot(struct snmp_ring *ring,
+    uint32_t pos) {
+  return (struct snmp_ring_slot *)
+    (ring->slots + ((pos & (ring->nslots - 1)) * ring->slotsz));
+}
+
+struct snmp_ring *snmp_ring_create(pool *p, unsigned int nrecords,
+    size_t recordsz) {
+#if defined(SNMP_RING_HAVE_ATOMICS) && defined(SNMP_RING_MAP_ANON)
+  register unsigned int i;
+  struct snmp_ring *ring;
+  void *data;
+  uint32_t nslots;
+  size_t slotsz, mapsz;
+
+  if (p == NULL ||
+      nrecords == 0 ||
+      recordsz == 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  nslots = 1;
+  while (nslots < nrecords) {
+    nslots <<= 1;
+  }
+
+  /* Keep each slot's header aligned. */
+  slotsz = sizeof(struct snmp_ring_slot) + recordsz;
+  slotsz = (slotsz + 7) & ~((size_t) 7);
+
+  mapsz = sizeof(struct snmp_ring_hdr) + (nslots * slotsz);
+
+  data = mmap(NULL, mapsz, PROT_READ|PROT_WRITE, MAP_SHARED|SNMP_RING_MAP_ANON,
+    -1, 0);
+  if (data == MAP_FAILED) {
+    int xerrno = errno;
+
+    pr_trace_msg(trace_channel, 1,
+      "error mapping ring of size %lu into memory: %s", (unsigned long) mapsz,
+      strerror(xerrno));
+
+    errno = xerrno;
+    return NULL;
+  }
+
+  ring = pcalloc(p, sizeof(struct snmp_ring));
+  ring->pool = p;
+  ring->hdr = data;
+  ring->slots = ((unsigned char *) data) + sizeof(struct snmp_ring_hdr);
+  ring->mapsz = mapsz;
+  ring->nslots = nslots;
+  ring->recordsz = recordsz;
+  ring->slotsz = slotsz;
+
+  if (pipe(ring->fds) < 0) {
+    int xerrno = errno;
+
+    pr_trace_msg(trace_channel, 1,
+      "error creating ring wakeup pipe: %s", strerror(xerrno));
+
+    (void) munmap(data, mapsz);
+    errno = xerrno;
+    return NULL;
+  }
+
+  /* Neither the producers nor the consumer ever wait on the pipe. */
+  for (i = 0; i < 2; i++) {
+    int flags;
+
+    flags = fcntl(ring->fds[i], F_GETFL);
+    if (flags >= 0) {
+      (void) fcntl(ring->fds[i], F_SETFL, flags|O_NONBLOCK);
+    }
+  }
+
+  memset(data, 0, mapsz);
+  for (i = 0; i < nslots; i++) {
+    ring_get_slot(ring, i)->seqno = i;
+  }
+
+  pr_trace_msg(trace_channel, 9,
+    "created ring of %lu records of %lu bytes (%lu bytes)",
+    (unsigned long) nslots, (unsigned long) recordsz, (unsigned long) mapsz);
+  return ring;
+#else
+  errno = ENOSYS;
+  return NULL;
+#endif /* SNMP_RING_HAVE_ATOMICS and SNMP_RING_MAP_ANON */
+}
+
+int snmp_ring_destroy(struct snmp_ring *ring) {
+  if (ring == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  (void) close(ring->fds[0]);
+  (void) close(ring->fds[1]);
+
+  if (munmap((void *) ring->hdr, ring->mapsz) < 0) {
+    return -1;
+  }
+
+  ring->hdr = NULL;
+  return 0;
+}
+
+int snmp_ring_add(struct snmp_ring *ring, const void *record,
+    size_t recordlen) {
+#ifdef SNMP_RING_HAVE_ATOMICS
+  struct snmp_ring_slot *slot;
+  uint32_t pos;
+
+  if (ring == NULL ||
+      record == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (recordlen > ring->recordsz) {
+    errno = EMSGSIZE;
+    return -1;
+  }
+
+  /* Claim a position, by advancing the head past it. */
+  pos = ring->hdr->head;
+  while (TRUE) {
+    int32_t diff;
+
+    slot = ring_get_slot(ring, pos);
+    diff = (int32_t) (slot->seqno - pos);
+    __sync_synchronize();
+
+    if (diff == 0) {
+      if (__sync_bool_compare_and_swap(&(ring->hdr->head), pos, pos + 1)) {
+        break;
+      }
+
+    } else if (diff < 0) {
+      /* The slot still holds the record from the previous lap. */
+      errno = ENOSPC;
+      return -1;
+    }
+
+    pos = ring->hdr->head;
+  }
+
+  memcpy(((unsigned char *) slot) + sizeof(struct snmp_ring_slot), record,
+    recordlen);
+  slot->recordlen = recordlen;
+
+  /* Publish the record, then wake the consumer if it has not already been
+   * woken.  If we took so long that the consumer gave up on us, and
+   * reclaimed the slot, the record is dropped.
+   */
+  __sync_synchronize();
+  if (!__sync_bool_compare_and_swap(&(slot->seqno), pos, pos + 1)) {
+    pr_trace_msg(trace_channel, 3,
+      "ring slot at position %lu reclaimed before record was published, "
+      "dropping record", (unsigned long) pos);
+    errno = ETIMEDOUT;
+    return -1;
+  }
+  __sync_synchronize();
+
+  if (ring->hdr->wakeup == 0 &&
+      __sync_bool_compare_and_swap(&(ring->hdr->wakeup), 0, 1)) {
+    if (write(ring->fds[1], "", 1) < 0) {
+      /* If the pipe is full, a wakeup is already pending. */
+      if (errno != EAGAIN &&
+          errno != EWOULDBLOCK) {
+        pr_trace_msg(trace_channel, 3,
+          "error waking ring consumer: %s", strerror(errno));
+      }
+    }
+  }
+
+  return 0;
+#else
+  errno = ENOSYS;
+  return -1;
+#endif /* SNMP_RING_HAVE_ATOMICS */
+}
+
+int snmp_ring_next(struct snmp_ring *ring, void *record, size_t recordsz) {
+#ifdef SNMP_RING_HAVE_ATOMICS
+  struct snmp_ring_slot *slot;
+  uint32_t pos, recordlen;
+
+  if (ring == NULL ||
+      record == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  pos = ring->hdr->tail;
+  slot = ring_get_slot(ring, pos);
+
+  while ((int32_t) (slot->seqno - (pos + 1)) < 0) {
+    time_t now;
+
+    if (ring->hdr->head == pos) {
+      /* Empty. */
+      errno = ENOENT;
+      return -1;
+    }
+
+    /* A producer has claimed this slot, but not yet published its record.
+     * If it is still unpublished after a while, assume the producer died
+     * while writing, and skip the slot.
+     */
+    now = time(NULL);
+    if (ring->stall_start == 0 ||
+        ring->stall_pos != pos) {
+      ring->stall_pos = pos;
+      ring->stall_start = now;
+    }
+
+    if (now - ring->stall_start < SNMP_RING_MAX_STALL_SECS) {
+      errno = ENOENT;
+      return -1;
+    }
+
+    /* The producer may only be slow, not dead; reclaim the slot only if it
+     * is still unpublished, so that a late publish fails (and drops its
+     * record) rather than undoing the reclaim.
+     */
+    ring->stall_start = 0;
+    if (!__sync_bool_compare_and_swap(&(slot->seqno), pos,
+        pos + ring->nslots)) {
+      /* Published after all; take it. */
+      continue;
+    }
+
+    pr_trace_msg(trace_channel, 3,
+      "skipping abandoned ring slot at position %lu", (unsigned long) pos);
+
+    __sync_synchronize();
+    ring->hdr->tail = ++pos;
+    slot = ring_get_slot(ring, pos);
+  }
+
+  __sync_synchronize();
+
+  recordlen = slot->recordlen;
+  if (recordlen > recordsz) {
+    recordlen = recordsz;
+  }
+
+  memcpy(record, ((unsigned char *) slot) + sizeof(struct snmp_ring_slot),
+    recordlen);
+
+  /* Hand the slot back to the producers, for the next lap. */
+  __sync_synchronize();
+  slot->seqno = pos + ring->nslots;
+  ring->hdr->tail = pos + 1;
+
+  return (int) recordlen;
+#else
+  errno = ENOSYS;
+  return -1;
+#endif /* SNMP_RING_HAVE_ATOMICS */
+}
+
+int snmp_ring_get_fd(struct snmp_ring *ring) {
+  if (ring == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  return ring->fds[0];
+}
+
+int snmp_ring_clear_fd(struct snmp_ring *ring) {
+  char buf[64];
+
+  if (ring == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  while (read(ring->fds[0], buf, sizeof(buf)) > 0) {
+    pr_signals_handle();
+  }
+
+  /* Any records added after this will wake us again. */
+  ring->hdr->wakeup = 0;
+#ifdef SNMP_RING_HAVE_ATOMICS
+  __sync_synchronize();
+#endif /* SNMP_RING_HAVE_ATOMICS */
+
+  return 0;
+}
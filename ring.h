@@ -0,0 +1,76 @@
+/*
+ * ProFTPD - mod_snmp shared-memory rings
+ * Copyright (c) 2013 TJ Saunders
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, TJ Saunders and other respective copyright holders
+ * give permission to link this program with OpenSSL, and distribute the
+ * resulting executable, without including the source code for OpenSSL in the
+ * source distribution.
+ *
+ * $Id$
+ */
+
+#include "mod_snmp.h"
+
+#ifndef MOD_SNMP_RING_H
+#define MOD_SNMP_RING_H
+
+/* A ring is a bounded queue of fixed-size records, in shared memory, to
+ * which any number of processes (e.g. session processes) may add records
+ * without locking, and from which a single process (the SNMP agent) takes
+ * them.  The ring must be created before forking those processes.
+ *
+ * Adding a record never blocks; if the ring is full, the record is dropped.
+ * The consumer can wait for records using the ring's file descriptor,
+ * which becomes readable when records are added to an empty ring.
+ */
+struct snmp_ring;
+
+/* Rings use the GCC atomic builtins (also provided by clang, and others). */
+#if defined(__GNUC__) && \
+    ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 1))
+# define SNMP_RING_HAVE_ATOMICS
+#endif
+
+/* Creates a ring of nrecords (rounded up to a power of two) records, each of
+ * at most recordsz bytes.  Returns NULL, with errno set to ENOSYS, if rings
+ * are not supported on this platform.
+ */
+struct snmp_ring *snmp_ring_create(pool *p, unsigned int nrecords,
+  size_t recordsz);
+int snmp_ring_destroy(struct snmp_ring *ring);
+
+/* Adds a record to the ring.  Returns -1, with errno set to ENOSPC, if the
+ * ring is full, or to ETIMEDOUT, if the record took so long to write that
+ * the consumer skipped its slot; either way, the record is dropped.
+ */
+int snmp_ring_add(struct snmp_ring *ring, const void *record,
+  size_t recordlen);
+
+/* Takes the next record from the ring, and returns its length.  Returns -1,
+ * with errno set to ENOENT, if there are no more records.
+ */
+int snmp_ring_next(struct snmp_ring *ring, void *record, size_t recordsz);
+
+/* Returns the file descriptor which becomes readable when records are
+ * added.  The consumer calls snmp_ring_clear_fd() before taking the
+ * records.
+ */
+int snmp_ring_get_fd(struct snmp_ring *ring);
+int snmp_ring_clear_fd(struct snmp_ring *ring);
+
+#endif
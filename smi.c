@@ -93,15 +93,14 @@ const char *snmp_smi_get_varstr(pool *p, unsigned char var_type) {
   return varstr;
 }
 
-struct snmp_var *snmp_smi_alloc_var(pool *p, oid_t *name,
+static void smi_init_var(pool *p, struct snmp_var *var, oid_t *name,
     unsigned int namelen) {
-  pool *sub_pool;
-  struct snmp_var *var;
+  memset(var, 0, sizeof(struct snmp_var));
 
-  sub_pool = pr_pool_create_sz(p, 64);
-  var = pcalloc(sub_pool, sizeof(struct snmp_var));
-  var->pool = sub_pool;
-  var->next = NULL;
+  /* Variables are allocated out of the given pool, rather than a pool of
+   * their own; they live as long as the PDU (or packet) which holds them.
+   */
+  var->pool = p;
 
   /* Default type for newly-allocated variables. */
   var->smi_type = SNMP_SMI_NULL;
@@ -110,7 +109,7 @@ struct snmp_var *snmp_smi_alloc_var(pool *p, oid_t *name,
 
   if (var->namelen == 0) {
     /* Not sure why a caller would do this, but... */
-    return var;
+    return;
   }
 
   /* Even though the name argument may be NULL, we still allocate the space.
@@ -118,15 +117,113 @@ struct snmp_var *snmp_smi_alloc_var(pool *p, oid_t *name,
    * know the name when we are allocating the struct, but we will know at
    * some point after that.
    */
-  var->name = pcalloc(var->pool, sizeof(oid_t) * var->namelen);
+  if (var->namelen <= SNMP_SMI_INLINE_NAMELEN) {
+    var->name = var->name_buf;
+
+  } else {
+    var->name = pcalloc(var->pool, sizeof(oid_t) * var->namelen);
+  }
 
   if (name != NULL) {
     memmove(var->name, name, sizeof(oid_t) * var->namelen);
   }
+}
+
+/* Points the name/value of a copied variable at the copy's own inline
+ * storage, where those of the original variable pointed at its storage.
+ */
+static void smi_relocate_var(struct snmp_var *var,
+    struct snmp_var *orig_var) {
+
+  if (var->name == orig_var->name_buf) {
+    var->name = var->name_buf;
+  }
+
+  switch (var->smi_type) {
+    case SNMP_SMI_STRING:
+    case SNMP_SMI_IPADDR:
+    case SNMP_SMI_OPAQUE:
+      if (var->value.string == orig_var->value_buf.string) {
+        var->value.string = var->value_buf.string;
+      }
+      break;
+
+    case SNMP_SMI_OID:
+      if (var->value.oid == orig_var->value_buf.oid) {
+        var->value.oid = var->value_buf.oid;
+      }
+      break;
+  }
+}
+
+/* Appends an uninitialized variable to the list.  If the list has to grow,
+ * its variables are moved, and so are relocated.
+ */
+static struct snmp_var *smi_push_var(array_header *varlist) {
+  struct snmp_var *var, *orig_vars;
+
+  orig_vars = varlist->elts;
+  var = push_array(varlist);
+
+  if (varlist->elts != (void *) orig_vars) {
+    register unsigned int i;
+    struct snmp_var *vars;
+
+    vars = varlist->elts;
+    for (i = 0; i < (unsigned int) varlist->nelts - 1; i++) {
+      smi_relocate_var(&(vars[i]), &(orig_vars[i]));
+    }
+  }
 
   return var;
 }
 
+/* Sets the value of a string variable, storing it inline if it fits. */
+static void smi_set_string(struct snmp_var *var, const char *value,
+    size_t valuelen) {
+
+  /* Strings are NUL-terminated, for logging. */
+  if (valuelen < SNMP_SMI_INLINE_VALUELEN) {
+    var->value.string = var->value_buf.string;
+
+  } else {
+    var->value.string = palloc(var->pool, valuelen + 1);
+  }
+
+  memmove(var->value.string, value, valuelen);
+  var->value.string[valuelen] = '\0';
+  var->valuelen = valuelen;
+}
+
+/* Allocates space for an OID value of the given number of sub-ids, inline
+ * if it fits.
+ */
+static oid_t *smi_alloc_oid(struct snmp_var *var, unsigned int oidlen) {
+  if (oidlen <= (sizeof(var->value_buf.oid) / sizeof(oid_t))) {
+    return var->value_buf.oid;
+  }
+
+  return palloc(var->pool, sizeof(oid_t) * oidlen);
+}
+
+struct snmp_var *snmp_smi_alloc_var(pool *p, oid_t *name,
+    unsigned int namelen) {
+  struct snmp_var *var;
+
+  var = palloc(p, sizeof(struct snmp_var));
+  smi_init_var(p, var, name, namelen);
+
+  return var;
+}
+
+array_header *snmp_smi_alloc_varlist(pool *p, unsigned int nvars) {
+  if (nvars == 0) {
+    nvars = SNMP_SMI_DEFAULT_VARLIST_SIZE;
+  }
+
+  return make_array(p, nvars, sizeof(struct snmp_var));
+}
+
 struct snmp_var *snmp_smi_create_var(pool *p, oid_t *name, unsigned int namelen,
     unsigned char smi_type, int32_t int_value, char *str_value,
     size_t str_valuelen) {
@@ -163,13 +260,26 @@ struct snmp_var *snmp_smi_create_int(pool *p, oid_t *name, unsigned int namelen,
 
   var = snmp_smi_alloc_var(p, name, namelen);
   var->valuelen = sizeof(value);
-  var->value.integer = palloc(var->pool, var->valuelen);
-  *(var->value.integer) = value;
   var->smi_type = smi_type;
 
-  pr_trace_msg(trace_channel, 19,
-    "created SMI variable %s, value %d", snmp_smi_get_varstr(p, smi_type),
-    value);
+  switch (smi_type) {
+    case SNMP_SMI_COUNTER32:
+    case SNMP_SMI_GAUGE32:
+    case SNMP_SMI_TIMETICKS:
+      /* These are unsigned 32-bit values. */
+      var->value.integer = (long) ((uint32_t) value);
+      break;
+
+    default:
+      var->value.integer = value;
+      break;
+  }
+
+  if (snmp_trace_is_enabled(trace_channel, 19)) {
+    pr_trace_msg(trace_channel, 19,
+      "created SMI variable %s, value %d", snmp_smi_get_varstr(p, smi_type),
+      value);
+  }
   return var;
 }
 
@@ -184,13 +294,14 @@ struct snmp_var *snmp_smi_create_string(pool *p, oid_t *name,
   }
 
   var = snmp_smi_alloc_var(p, name, namelen);
-  var->valuelen = valuelen;
-  var->value.string = pstrndup(var->pool, value, var->valuelen);
+  smi_set_string(var, value, valuelen);
   var->smi_type = smi_type;
 
-  pr_trace_msg(trace_channel, 19,
-    "created SMI variable %s, value '%s'", snmp_smi_get_varstr(p, smi_type),
-    value);
+  if (snmp_trace_is_enabled(trace_channel, 19)) {
+    pr_trace_msg(trace_channel, 19,
+      "created SMI variable %s, value '%s'", snmp_smi_get_varstr(p, smi_type),
+      value);
+  }
   return var;
 }
 
@@ -215,13 +326,15 @@ struct snmp_var *snmp_smi_create_oid(pool *p, oid_t *name,
    * for an OID.
    */
   var->valuelen = valuelen;
-  var->value.oid = palloc(var->pool, sizeof(oid_t) * var->valuelen);
+  var->value.oid = smi_alloc_oid(var, var->valuelen);
   memmove(var->value.oid, value, sizeof(oid_t) * var->valuelen);
   var->smi_type = smi_type;
 
-  pr_trace_msg(trace_channel, 19,
-    "created SMI variable %s, value %s", snmp_smi_get_varstr(p, smi_type),
-    snmp_asn1_get_oidstr(p, value, valuelen));
+  if (snmp_trace_is_enabled(trace_channel, 19)) {
+    pr_trace_msg(trace_channel, 19,
+      "created SMI variable %s, value %s", snmp_smi_get_varstr(p, smi_type),
+      snmp_asn1_get_oidstr(p, value, valuelen));
+  }
   return var;
 }
 
@@ -247,42 +360,55 @@ struct snmp_var *snmp_smi_create_exception(pool *p, oid_t *name,
   var->valuelen = 0;
   var->smi_type = smi_type;
 
-  pr_trace_msg(trace_channel, 19,
-    "created SMI variable %s", snmp_smi_get_varstr(p, smi_type));
+  if (snmp_trace_is_enabled(trace_channel, 19)) {
+    pr_trace_msg(trace_channel, 19,
+      "created SMI variable %s", snmp_smi_get_varstr(p, smi_type));
+  }
   return var;
 }
 
-/* Note: This will duplicate the entire varlist represented by the head
- * variable.
- */
-struct snmp_var *snmp_smi_dup_var(pool *p, struct snmp_var *src_var) {
-  struct snmp_var *head_var = NULL, *iter_var = NULL, *tail_var = NULL;
-  unsigned int var_count = 0;
+/* Note: This makes a deep copy of the variables in the given list. */
+array_header *snmp_smi_dup_varlist(pool *p, array_header *src_varlist) {
+  register unsigned int i;
+  array_header *varlist;
+  struct snmp_var *src_vars;
 
-  for (iter_var = src_var; iter_var; iter_var = iter_var->next) {
-    struct snmp_var *var;
+  if (src_varlist == NULL) {
+    return NULL;
+  }
+
+  varlist = snmp_smi_alloc_varlist(p, src_varlist->nelts);
+  src_vars = src_varlist->elts;
+
+  for (i = 0; i < (unsigned int) src_varlist->nelts; i++) {
+    struct snmp_var *var, *src_var;
 
     pr_signals_handle();
 
-    var = snmp_smi_alloc_var(p, iter_var->name, iter_var->namelen);
-    var->smi_type = iter_var->smi_type;
-    var->valuelen = iter_var->valuelen;
+    src_var = &(src_vars[i]);
+
+    var = smi_push_var(varlist);
+    smi_init_var(p, var, src_var->name, src_var->namelen);
+    var->smi_type = src_var->smi_type;
+    var->valuelen = src_var->valuelen;
 
     if (var->valuelen > 0) {
       switch (var->smi_type) {
         case SNMP_SMI_INTEGER:
-          var->value.integer = palloc(var->pool, var->valuelen);
-          memmove(var->value.integer, iter_var->value.integer, var->valuelen);
+        case SNMP_SMI_COUNTER32:
+        case SNMP_SMI_GAUGE32:
+        case SNMP_SMI_TIMETICKS:
+          var->value.integer = src_var->value.integer;
           break;
 
         case SNMP_SMI_STRING:
-          var->value.string = pcalloc(var->pool, var->valuelen);
-          memmove(var->value.string, iter_var->value.string, var->valuelen);
+          smi_set_string(var, src_var->value.string, src_var->valuelen);
           break;
 
         case SNMP_SMI_OID:
-          var->value.oid = palloc(var->pool, var->valuelen);
-          memmove(var->value.oid, iter_var->value.oid, var->valuelen);
+          var->value.oid = smi_alloc_oid(var, var->valuelen);
+          memmove(var->value.oid, src_var->value.oid,
+            sizeof(oid_t) * var->valuelen);
           break;
 
         default:
@@ -290,41 +416,33 @@ struct snmp_var *snmp_smi_dup_var(pool *p, struct snmp_var *src_var) {
             "unable to dup variable '%s': unsupported",
             snmp_asn1_get_tagstr(p, var->smi_type));
 
-          /* XXX Destroy the entire chain? */
-          destroy_pool(var->pool);
           snmp_stacktrace_log();
           errno = EINVAL;
           return NULL;
       }
     }
 
-    if (head_var == NULL) {
-      head_var = var;
+    if (snmp_trace_is_enabled(trace_channel, 19)) {
+      pr_trace_msg(trace_channel, 19,
+        "cloned SMI variable %s", snmp_smi_get_varstr(p, src_var->smi_type));
     }
-
-    if (tail_var != NULL) {
-      tail_var->next = var;
-    }
-
-    tail_var = var;
-    var_count++;
-
-    pr_trace_msg(trace_channel, 19,
-      "cloned SMI variable %s", snmp_smi_get_varstr(p, iter_var->smi_type));
   }
 
-  pr_trace_msg(trace_channel, 19, "cloned %u SMI %s", var_count,
-    var_count != 1 ? "variables" : "variable");
-  return head_var;
+  if (snmp_trace_is_enabled(trace_channel, 19)) {
+    pr_trace_msg(trace_channel, 19, "cloned %u SMI %s", varlist->nelts,
+      varlist->nelts != 1 ? "variables" : "variable");
+  }
+  return varlist;
 }
 
 /* Decode a list of SNMPv2 variable bindings. */
 int snmp_smi_read_vars(pool *p, unsigned char **buf, size_t *buflen,
-    struct snmp_var **varlist, int snmp_version) {
-  struct snmp_var *var = NULL, *head = NULL, *tail = NULL;
+    array_header **varlist, int snmp_version) {
+  struct snmp_var *var = NULL;
+  array_header *list;
   unsigned char asn1_type;
   unsigned int total_varlen = 0;
-  int res, var_count = 0;
+  int res;
 
   res = snmp_asn1_read_header(p, buf, buflen, &asn1_type, &total_varlen, 0);
   if (res < 0) {
@@ -341,12 +459,17 @@ int snmp_smi_read_vars(pool *p, unsigned char **buf, size_t *buflen,
     return -1;
   }
 
-  pr_trace_msg(trace_channel, 17, "reading %s variables (%u bytes)",
-    snmp_msg_get_versionstr(snmp_version), total_varlen);
+  if (snmp_trace_is_enabled(trace_channel, 17)) {
+    pr_trace_msg(trace_channel, 17, "reading %s variables (%u bytes)",
+      snmp_msg_get_versionstr(snmp_version), total_varlen);
+  }
+
+  list = snmp_smi_alloc_varlist(p, 0);
 
   while (*buflen > 0) {
-    unsigned int varlen;
+    unsigned int varlen, namelen = 0, oid_datalen = 0;
     unsigned char *hdr_start = NULL, *hdr_end = NULL, *obj_start = NULL;
+    unsigned char *oid_data = NULL, *str_data = NULL;
     size_t obj_startlen = 0;
 
     pr_signals_handle();
@@ -374,14 +497,12 @@ int snmp_smi_read_vars(pool *p, unsigned char **buf, size_t *buflen,
       return -1;
     }
 
-    /* We don't know the name of this variable yet. */
-    var = snmp_smi_alloc_var(p, NULL, SNMP_SMI_MAX_NAMELEN);
-
-    /* Read the variable name/OID. */
-    res = snmp_asn1_read_oid(p, buf, buflen, &asn1_type, var->name,
-      &(var->namelen));
+    /* Validate the variable name/OID first, so that we know how many
+     * sub-identifiers it has.
+     */
+    res = snmp_asn1_read_oid_view(p, buf, buflen, &asn1_type, &oid_data,
+      &oid_datalen, &namelen);
     if (res < 0) {
-      destroy_pool(var->pool);
       return -1;
     }
 
@@ -390,13 +511,22 @@ int snmp_smi_read_vars(pool *p, unsigned char **buf, size_t *buflen,
         "expected OID tag, read tag (%s) from variable list",
         snmp_asn1_get_tagstr(p, asn1_type));
 
-      destroy_pool(var->pool);
       snmp_stacktrace_log();
       errno = EINVAL;
       return -1;
     }
 
-    if (pr_trace_get_level(trace_channel) >= 19) {
+    /* The variable is decoded in place, at the end of the list. */
+    var = smi_push_var(list);
+    smi_init_var(p, var, NULL, namelen);
+
+    res = snmp_asn1_decode_oid(oid_data, oid_datalen, var->name,
+      &(var->namelen));
+    if (res < 0) {
+      return -1;
+    }
+
+    if (snmp_trace_is_enabled(trace_channel, 19)) {
       struct snmp_mib *mib;
       int lacks_instance_id = FALSE;
 
@@ -426,22 +556,24 @@ int snmp_smi_read_vars(pool *p, unsigned char **buf, size_t *buflen,
     res = snmp_asn1_read_header(p, &obj_start, &obj_startlen, &(var->smi_type),
       &(var->valuelen), 0);
     if (res < 0) {
-      destroy_pool(var->pool);
       return -1;
     }
 
-    pr_trace_msg(trace_channel, 19,
-      "read SMI variable %s, data len %u bytes",
-      snmp_smi_get_varstr(p, var->smi_type), var->valuelen);
+    if (snmp_trace_is_enabled(trace_channel, 19)) {
+      pr_trace_msg(trace_channel, 19,
+        "read SMI variable %s, data len %u bytes",
+        snmp_smi_get_varstr(p, var->smi_type), var->valuelen);
+    }
 
     /* Now read in the value */
     switch (var->smi_type) {
       case SNMP_SMI_INTEGER:
         res = snmp_asn1_read_int(p, buf, buflen,
-          &(var->smi_type), var->value.integer, 0);
-        if (res == 0) {
+          &(var->smi_type), &(var->value.integer), 0);
+        if (res == 0 &&
+            snmp_trace_is_enabled(trace_channel, 19)) {
           pr_trace_msg(trace_channel, 19,
-            "read INTEGER variable (value %d)", *((int *) var->value.integer));
+            "read INTEGER variable (value %ld)", var->value.integer);
         }
         break;
 
@@ -449,32 +581,44 @@ int snmp_smi_read_vars(pool *p, unsigned char **buf, size_t *buflen,
       case SNMP_SMI_GAUGE32:
       case SNMP_SMI_TIMETICKS:
         res = snmp_asn1_read_uint(p, buf, buflen,
-          &(var->smi_type), (unsigned long *) var->value.integer);
-        if (res == 0) {
+          &(var->smi_type), (unsigned long *) &(var->value.integer));
+        if (res == 0 &&
+            snmp_trace_is_enabled(trace_channel, 19)) {
           pr_trace_msg(trace_channel, 19,
-            "read %s variable (value %u)",
+            "read %s variable (value %lu)",
             snmp_smi_get_varstr(p, var->smi_type),
-            *((unsigned int *) var->value.integer));
+            (unsigned long) var->value.integer);
         }
         break;
 
       case SNMP_SMI_STRING:
       case SNMP_SMI_IPADDR:
       case SNMP_SMI_OPAQUE:
-        res = snmp_asn1_read_string(p, buf, buflen,
-          &(var->smi_type), &(var->value.string), &(var->valuelen));
+        /* The value points into the request buffer; it is not copied. */
+        res = snmp_asn1_read_string_view(p, buf, buflen,
+          &(var->smi_type), &str_data, &(var->valuelen));
         if (res == 0) {
-          pr_trace_msg(trace_channel, 19,
-            "read %s variable (value '%.*s')",
-            snmp_smi_get_varstr(p, var->smi_type),
-            var->valuelen, var->value.string);
+          var->value.string = (char *) str_data;
+          if (snmp_trace_is_enabled(trace_channel, 19)) {
+            pr_trace_msg(trace_channel, 19,
+              "read %s variable (value '%.*s')",
+              snmp_smi_get_varstr(p, var->smi_type),
+              var->valuelen, var->value.string);
+          }
         }
         break;
 
       case SNMP_SMI_OID:
-        res = snmp_asn1_read_oid(p, buf, buflen,
-          &(var->smi_type), var->value.oid, &(var->valuelen));
+        res = snmp_asn1_read_oid_view(p, buf, buflen, &(var->smi_type),
+          &oid_data, &oid_datalen, &(var->valuelen));
         if (res == 0) {
+          var->value.oid = smi_alloc_oid(var, var->valuelen);
+          res = snmp_asn1_decode_oid(oid_data, oid_datalen, var->value.oid,
+            &(var->valuelen));
+        }
+
+        if (res == 0 &&
+            snmp_trace_is_enabled(trace_channel, 19)) {
           pr_trace_msg(trace_channel, 19,
             "read %s variable (%u sub-ids, value %s)",
             snmp_smi_get_varstr(p, var->smi_type), var->valuelen,
@@ -484,7 +628,8 @@ int snmp_smi_read_vars(pool *p, unsigned char **buf, size_t *buflen,
 
       case SNMP_SMI_NULL:
         res = snmp_asn1_read_null(p, buf, buflen, &(var->smi_type));
-        if (res == 0) {
+        if (res == 0 &&
+            snmp_trace_is_enabled(trace_channel, 19)) {
           pr_trace_msg(trace_channel, 19, "read %s variable",
             snmp_smi_get_varstr(p, var->smi_type));
         }
@@ -493,8 +638,10 @@ int snmp_smi_read_vars(pool *p, unsigned char **buf, size_t *buflen,
       case SNMP_SMI_NO_SUCH_OBJECT:
       case SNMP_SMI_NO_SUCH_INSTANCE:
       case SNMP_SMI_END_OF_MIB_VIEW:
-        pr_trace_msg(trace_channel, 19, "read %s variable",
-          snmp_smi_get_varstr(p, var->smi_type));
+        if (snmp_trace_is_enabled(trace_channel, 19)) {
+          pr_trace_msg(trace_channel, 19, "read %s variable",
+            snmp_smi_get_varstr(p, var->smi_type));
+        }
         break;
 
       case SNMP_SMI_COUNTER64:
@@ -505,7 +652,6 @@ int snmp_smi_read_vars(pool *p, unsigned char **buf, size_t *buflen,
       default:
         pr_trace_msg(trace_channel, 1,
           "unable to read variable type %x", var->smi_type);
-        destroy_pool(var->pool);
         snmp_stacktrace_log(); 
         errno = EINVAL;
         return -1;
@@ -514,21 +660,10 @@ int snmp_smi_read_vars(pool *p, unsigned char **buf, size_t *buflen,
     if (res < 0) {
       return -1;
     }
-
-    /* Add the variable to the end of the list. */
-    if (tail != NULL) {
-      tail->next = var;
-      tail = var;
-
-    } else {
-      head = tail = var;
-    }
-
-    var_count++;
   }
 
-  *varlist = head;
-  return var_count;
+  *varlist = list;
+  return list->nelts;
 }
 
 /* Encode an SNMPv2 variable binding.
@@ -547,165 +682,363 @@ int snmp_smi_read_vars(pool *p, unsigned char **buf, size_t *buflen,
  *     }
  *   }
  */
-int snmp_smi_write_vars(pool *p, unsigned char **buf, size_t *buflen,
-    struct snmp_var *varlist, int snmp_version) {
-  struct snmp_var *iter;
-  unsigned char asn1_type, *list_hdr_start, *list_hdr_end;
-  size_t list_hdr_startlen;
+static int smi_write_var(pool *p, unsigned char **buf, size_t *buflen,
+    struct snmp_var *var, int snmp_version) {
+  unsigned char asn1_type, *var_end;
   unsigned int asn1_len;
   int res;
 
-  /* Write the header for the varlist. */
-  asn1_type = (SNMP_ASN1_TYPE_SEQUENCE|SNMP_ASN1_CONSTRUCT);
-  asn1_len = 0;
+  var_end = *buf;
+
+  /* The value is written first, since we are writing back-to-front. */
+  switch (var->smi_type) {
+    case SNMP_SMI_INTEGER:
+      res = snmp_asn1_prepend_int(p, buf, buflen, var->smi_type,
+        var->value.integer, 0);
+      break;
+
+    case SNMP_SMI_COUNTER32:
+    case SNMP_SMI_GAUGE32:
+    case SNMP_SMI_TIMETICKS:
+      res = snmp_asn1_prepend_uint(p, buf, buflen, var->smi_type,
+        (unsigned long) var->value.integer);
+      break;
+
+    case SNMP_SMI_STRING:
+    case SNMP_SMI_IPADDR:
+    case SNMP_SMI_OPAQUE:
+      res = snmp_asn1_prepend_string(p, buf, buflen, var->smi_type,
+        var->value.string, var->valuelen);
+      break;
+
+    case SNMP_SMI_OID:
+      res = snmp_asn1_prepend_oid(p, buf, buflen, var->smi_type,
+        var->value.oid, var->valuelen);
+      break;
+
+    case SNMP_SMI_NO_SUCH_OBJECT:
+    case SNMP_SMI_NO_SUCH_INSTANCE:
+    case SNMP_SMI_END_OF_MIB_VIEW:
+      if (snmp_version == SNMP_PROTOCOL_VERSION_1) {
+        /* SNMPv1 does not support the other error codes. */
+        res = snmp_asn1_prepend_null(p, buf, buflen, SNMP_SMI_NO_SUCH_OBJECT);
 
-  list_hdr_start = *buf;
-  list_hdr_startlen = *buflen;
+      } else {
+        res = snmp_asn1_prepend_exception(p, buf, buflen, var->smi_type, 0);
+      }
+
+      break;
+
+    case SNMP_SMI_NULL:
+      res = snmp_asn1_prepend_null(p, buf, buflen, var->smi_type);
+      break;
+
+    case SNMP_SMI_COUNTER64:
+      pr_trace_msg(trace_channel, 1, "%s",
+        "unable to encode COUNTER64 SMI variable");
+      /* fall through */
+
+    default:
+      /* Unsupported type */
+      pr_trace_msg(trace_channel, 1, "%s",
+        "unable to encode unsupported SMI variable type");
+      snmp_stacktrace_log();
+      errno = ENOSYS;
+      return -1;
+  }
 
-  res = snmp_asn1_write_header(p, buf, buflen, asn1_type, asn1_len, 0);
   if (res < 0) {
     return -1;
   }
 
-  list_hdr_end = *buf;
+  asn1_type = (SNMP_ASN1_CLASS_UNIVERSAL|SNMP_ASN1_PRIMITIVE|SNMP_ASN1_TYPE_OID);
+  res = snmp_asn1_prepend_oid(p, buf, buflen, asn1_type, var->name,
+    var->namelen);
+  if (res < 0) {
+    return -1;
+  }
 
-  for (iter = varlist; iter; iter = iter->next) {
-    unsigned char *var_hdr_start = NULL, *var_hdr_end = NULL;
-    size_t var_hdr_startlen;
+  /* Now that we know the length of the variable, write its header. */
+  asn1_type = (SNMP_ASN1_TYPE_SEQUENCE|SNMP_ASN1_CONSTRUCT);
+  asn1_len = (unsigned int) (var_end - *buf);
 
-    pr_signals_handle();
+  if (snmp_trace_is_enabled(trace_channel, 18)) {
+    pr_trace_msg(trace_channel, 18,
+      "writing variable header with length %u", asn1_len);
+  }
+  return snmp_asn1_prepend_header(p, buf, buflen, asn1_type, asn1_len, 0);
+}
 
-    /* Write the header for this varible. */
-    asn1_type = (SNMP_ASN1_TYPE_SEQUENCE|SNMP_ASN1_CONSTRUCT);
-    asn1_len = 0;
+/* Writes the header for a varlist which ends at list_end, and now starts at
+ * *buf.
+ */
+static int smi_write_list_header(pool *p, unsigned char **buf,
+    size_t *buflen, unsigned char *list_end) {
+  unsigned char asn1_type;
+  unsigned int asn1_len;
 
-    var_hdr_start = *buf;
-    var_hdr_startlen = *buflen;
+  asn1_type = (SNMP_ASN1_TYPE_SEQUENCE|SNMP_ASN1_CONSTRUCT);
+  asn1_len = (unsigned int) (list_end - *buf);
 
-    res = snmp_asn1_write_header(p, buf, buflen, asn1_type, asn1_len, 0);
-    if (res < 0) {
-      return -1;
-    }
+  if (snmp_trace_is_enabled(trace_channel, 18)) {
+    pr_trace_msg(trace_channel, 18,
+      "writing variable bindings list header with length %u", asn1_len);
+  }
+  return snmp_asn1_prepend_header(p, buf, buflen, asn1_type, asn1_len, 0);
+}
 
-    var_hdr_end = *buf;
+/* Note that the variables are written back-to-front, i.e. the encoded
+ * varlist ends at the given *buf, and *buf is moved back to the start of the
+ * encoded varlist.
+ */
+int snmp_smi_write_vars(pool *p, unsigned char **buf, size_t *buflen,
+    array_header *varlist, int snmp_version) {
+  register unsigned int i;
+  unsigned char *list_end;
+  int res;
 
-    asn1_type = (SNMP_ASN1_CLASS_UNIVERSAL|SNMP_ASN1_PRIMITIVE|SNMP_ASN1_TYPE_OID);
-    res = snmp_asn1_write_oid(p, buf, buflen, asn1_type, iter->name,
-      iter->namelen);
-    if (res < 0) {
-      return -1;
+  list_end = *buf;
+
+  if (varlist != NULL) {
+    struct snmp_var *vars;
+
+    vars = varlist->elts;
+
+    for (i = varlist->nelts; i > 0; i--) {
+      pr_signals_handle();
+
+      res = smi_write_var(p, buf, buflen, &(vars[i-1]), snmp_version);
+      if (res < 0) {
+        return -1;
+      }
     }
+  }
 
-    switch (iter->smi_type) {
-      case SNMP_SMI_INTEGER:
-        res = snmp_asn1_write_int(p, buf, buflen, iter->smi_type,
-          *((long *) iter->value.integer), 0);
-        break;
+  /* Write the header for the varlist, with the length of all of the
+   * variables.
+   */
+  return smi_write_list_header(p, buf, buflen, list_end);
+}
 
-      case SNMP_SMI_COUNTER32:
-      case SNMP_SMI_GAUGE32:
-      case SNMP_SMI_TIMETICKS:
-        res = snmp_asn1_write_uint(p, buf, buflen, iter->smi_type,
-          *((unsigned long *) iter->value.integer));
-        break;
+/* Returns the number of bytes that snmp_smi_write_vars() would use to encode
+ * the given variable, including its VarBind SEQUENCE header, or zero if the
+ * variable cannot be encoded.
+ */
+size_t snmp_smi_get_varlen(struct snmp_var *var, int snmp_version) {
+  size_t varlen;
 
-      case SNMP_SMI_STRING:
-      case SNMP_SMI_IPADDR:
-      case SNMP_SMI_OPAQUE:
-        res = snmp_asn1_write_string(p, buf, buflen, iter->smi_type,
-          iter->value.string, iter->valuelen);
-        break;
+  varlen = snmp_asn1_get_oid_len(var->name, var->namelen);
 
-      case SNMP_SMI_OID:
-        res = snmp_asn1_write_oid(p, buf, buflen, iter->smi_type,
-          iter->value.oid, iter->valuelen);
-        break;
+  switch (var->smi_type) {
+    case SNMP_SMI_INTEGER:
+      varlen += snmp_asn1_get_int_len(var->value.integer);
+      break;
 
-      case SNMP_SMI_NO_SUCH_OBJECT:
-      case SNMP_SMI_NO_SUCH_INSTANCE:
-      case SNMP_SMI_END_OF_MIB_VIEW:
-        if (snmp_version == SNMP_PROTOCOL_VERSION_1) {
-          /* SNMPv1 does not support the other error codes. */
-          res = snmp_asn1_write_null(p, buf, buflen, SNMP_SMI_NO_SUCH_OBJECT);
+    case SNMP_SMI_COUNTER32:
+    case SNMP_SMI_GAUGE32:
+    case SNMP_SMI_TIMETICKS:
+      varlen += snmp_asn1_get_uint_len((unsigned long) var->value.integer);
+      break;
 
-        } else {
-          res = snmp_asn1_write_exception(p, buf, buflen, iter->smi_type, 0);
-        }
+    case SNMP_SMI_STRING:
+    case SNMP_SMI_IPADDR:
+    case SNMP_SMI_OPAQUE:
+      varlen += snmp_asn1_get_header_len(var->valuelen,
+        SNMP_ASN1_FL_KNOWN_LEN) + var->valuelen;
+      break;
 
-        break;
+    case SNMP_SMI_OID:
+      varlen += snmp_asn1_get_oid_len(var->value.oid, var->valuelen);
+      break;
 
-      case SNMP_SMI_NULL:
-        res = snmp_asn1_write_null(p, buf, buflen, iter->smi_type);
-        break;
+    case SNMP_SMI_NO_SUCH_OBJECT:
+    case SNMP_SMI_NO_SUCH_INSTANCE:
+    case SNMP_SMI_END_OF_MIB_VIEW:
+    case SNMP_SMI_NULL:
+      /* Both the NULL and the exception encodings are a zero-length value. */
+      varlen += snmp_asn1_get_header_len(0, SNMP_ASN1_FL_KNOWN_LEN);
+      break;
 
-      case SNMP_SMI_COUNTER64:
-        pr_trace_msg(trace_channel, 1, "%s",
-          "unable to encode COUNTER64 SMI variable");
-        /* fall through */
+    default:
+      return 0;
+  }
 
-      default:
-        /* Unsupported type */
-        pr_trace_msg(trace_channel, 1, "%s",
-          "unable to encode unsupported SMI variable type");
-        snmp_stacktrace_log();
-        errno = ENOSYS;
-        return -1;
-    }
+  /* The VarBind SEQUENCE header. */
+  varlen += snmp_asn1_get_header_len(varlen, SNMP_ASN1_FL_KNOWN_LEN);
+  return varlen;
+}
 
-    if (res < 0) {
-      return -1;
-    }
+/* Encodes a resolved VarBind; see smi_write_var().  The name is copied from
+ * its pre-encoded OID, if any, and the value is encoded from the binding's
+ * fields.
+ */
+static int smi_write_binding(pool *p, unsigned char **buf, size_t *buflen,
+    struct snmp_binding *binding, int snmp_version) {
+  unsigned char asn1_type, *var_end;
+  unsigned int asn1_len;
+  int res;
 
-    /* Rewrite the header, this time with the appropriate length. */
-    asn1_type = (SNMP_ASN1_TYPE_SEQUENCE|SNMP_ASN1_CONSTRUCT);
-    asn1_len = (*buf - var_hdr_end);
+  var_end = *buf;
 
-    pr_trace_msg(trace_channel, 18,
-      "updating variable header to have length %u", asn1_len);
-    res = snmp_asn1_write_header(p, &var_hdr_start, &var_hdr_startlen,
-      asn1_type, asn1_len, 0);
-    if (res < 0) {
+  switch (binding->smi_type) {
+    case SNMP_SMI_INTEGER:
+      res = snmp_asn1_prepend_int(p, buf, buflen, binding->smi_type,
+        (long) binding->int_value, 0);
+      break;
+
+    case SNMP_SMI_COUNTER32:
+    case SNMP_SMI_GAUGE32:
+    case SNMP_SMI_TIMETICKS:
+      res = snmp_asn1_prepend_uint(p, buf, buflen, binding->smi_type,
+        (unsigned long) ((uint32_t) binding->int_value));
+      break;
+
+    case SNMP_SMI_STRING:
+    case SNMP_SMI_IPADDR:
+    case SNMP_SMI_OPAQUE:
+      res = snmp_asn1_prepend_string(p, buf, buflen, binding->smi_type,
+        binding->str_value, binding->str_valuelen);
+      break;
+
+    case SNMP_SMI_NO_SUCH_OBJECT:
+    case SNMP_SMI_NO_SUCH_INSTANCE:
+    case SNMP_SMI_END_OF_MIB_VIEW:
+      if (snmp_version == SNMP_PROTOCOL_VERSION_1) {
+        /* SNMPv1 does not support the other error codes. */
+        res = snmp_asn1_prepend_null(p, buf, buflen, SNMP_SMI_NO_SUCH_OBJECT);
+
+      } else {
+        res = snmp_asn1_prepend_exception(p, buf, buflen, binding->smi_type,
+          0);
+      }
+
+      break;
+
+    case SNMP_SMI_NULL:
+      res = snmp_asn1_prepend_null(p, buf, buflen, binding->smi_type);
+      break;
+
+    default:
+      /* Unsupported type */
+      pr_trace_msg(trace_channel, 1,
+        "unable to encode unsupported SMI binding type %s",
+        snmp_smi_get_varstr(p, binding->smi_type));
+      snmp_stacktrace_log();
+      errno = ENOSYS;
       return -1;
-    }
   }
 
-  /* Rewrite the varlist header, this time with the length of all of the
-   * variables.
-   */
+  if (res < 0) {
+    return -1;
+  }
 
-  asn1_type = (SNMP_ASN1_TYPE_SEQUENCE|SNMP_ASN1_CONSTRUCT);
-  asn1_len = (*buf - list_hdr_end);
+  if (binding->enc_namelen > 0) {
+    res = snmp_asn1_prepend_encoded(p, buf, buflen, binding->enc_name,
+      binding->enc_namelen);
+
+  } else {
+    asn1_type = (SNMP_ASN1_CLASS_UNIVERSAL|SNMP_ASN1_PRIMITIVE|SNMP_ASN1_TYPE_OID);
+    res = snmp_asn1_prepend_oid(p, buf, buflen, asn1_type, binding->name,
+      binding->namelen);
+  }
 
-  pr_trace_msg(trace_channel, 18,
-    "updating variable bindings list header to have length %u", asn1_len);
-  res = snmp_asn1_write_header(p, &list_hdr_start, &list_hdr_startlen,
-    asn1_type, asn1_len, 0);
   if (res < 0) {
     return -1;
   }
 
-  return 0;
+  asn1_type = (SNMP_ASN1_TYPE_SEQUENCE|SNMP_ASN1_CONSTRUCT);
+  asn1_len = (unsigned int) (var_end - *buf);
+
+  if (snmp_trace_is_enabled(trace_channel, 18)) {
+    pr_trace_msg(trace_channel, 18,
+      "writing variable header with length %u", asn1_len);
+  }
+  return snmp_asn1_prepend_header(p, buf, buflen, asn1_type, asn1_len, 0);
 }
 
-unsigned int snmp_smi_util_add_list_var(struct snmp_var **head,
-    struct snmp_var **tail, struct snmp_var *var) {
-  unsigned int count = 0;
-  struct snmp_var *iter_var;
+int snmp_smi_write_bindings(pool *p, unsigned char **buf, size_t *buflen,
+    array_header *bindings, int snmp_version) {
+  register unsigned int i;
+  unsigned char *list_end;
+  int res;
+
+  list_end = *buf;
 
-  if (*head == NULL) {
-    *head = var;
+  if (bindings != NULL) {
+    struct snmp_binding *elts;
+
+    elts = bindings->elts;
+
+    for (i = bindings->nelts; i > 0; i--) {
+      pr_signals_handle();
+
+      res = smi_write_binding(p, buf, buflen, &(elts[i-1]), snmp_version);
+      if (res < 0) {
+        return -1;
+      }
+    }
   }
 
-  if (*tail != NULL) {
-    (*tail)->next = var;
+  return smi_write_list_header(p, buf, buflen, list_end);
+}
+
+/* Returns the number of bytes that snmp_smi_write_bindings() would use to
+ * encode the given binding, including its VarBind SEQUENCE header, or zero
+ * if the binding cannot be encoded.
+ */
+size_t snmp_smi_get_binding_len(struct snmp_binding *binding,
+    int snmp_version) {
+  size_t varlen;
+
+  if (binding->enc_namelen > 0) {
+    varlen = binding->enc_namelen;
+
+  } else {
+    varlen = snmp_asn1_get_oid_len(binding->name, binding->namelen);
   }
 
-  (*tail) = var;
+  switch (binding->smi_type) {
+    case SNMP_SMI_INTEGER:
+      varlen += snmp_asn1_get_int_len((long) binding->int_value);
+      break;
 
-  for (iter_var = *head; iter_var; iter_var = iter_var->next) {
-    count++;
+    case SNMP_SMI_COUNTER32:
+    case SNMP_SMI_GAUGE32:
+    case SNMP_SMI_TIMETICKS:
+      varlen += snmp_asn1_get_uint_len(
+        (unsigned long) ((uint32_t) binding->int_value));
+      break;
+
+    case SNMP_SMI_STRING:
+    case SNMP_SMI_IPADDR:
+    case SNMP_SMI_OPAQUE:
+      varlen += snmp_asn1_get_header_len(binding->str_valuelen,
+        SNMP_ASN1_FL_KNOWN_LEN) + binding->str_valuelen;
+      break;
+
+    case SNMP_SMI_NO_SUCH_OBJECT:
+    case SNMP_SMI_NO_SUCH_INSTANCE:
+    case SNMP_SMI_END_OF_MIB_VIEW:
+    case SNMP_SMI_NULL:
+      varlen += snmp_asn1_get_header_len(0, SNMP_ASN1_FL_KNOWN_LEN);
+      break;
+
+    default:
+      return 0;
   }
 
-  return count;
+  varlen += snmp_asn1_get_header_len(varlen, SNMP_ASN1_FL_KNOWN_LEN);
+  return varlen;
+}
+
+unsigned int snmp_smi_util_add_list_var(array_header *varlist,
+    struct snmp_var *var) {
+  struct snmp_var *elt;
+
+  elt = smi_push_var(varlist);
+  memcpy(elt, var, sizeof(struct snmp_var));
+  smi_relocate_var(elt, var);
+
+  return varlist->nelts;
 }
 
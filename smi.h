@@ -66,11 +66,26 @@
 /* Maximum length/number of sub-identifiers in an OID that we will accept. */
 #define SNMP_SMI_MAX_NAMELEN	64
 
+/* Variable binding lists are arrays of struct snmp_var (not of pointers),
+ * allocated out of the pool of the PDU which holds them.  Appending to, and
+ * counting, a list are then constant-time, and walking a list does not
+ * chase pointers.
+ */
+#define SNMP_SMI_DEFAULT_VARLIST_SIZE	8
+
+/* Names of up to SNMP_SMI_INLINE_NAMELEN sub-identifiers, and string/OID
+ * values of up to SNMP_SMI_INLINE_VALUELEN bytes, are stored within the
+ * struct snmp_var itself; only longer ones are allocated from its pool.
+ */
+#define SNMP_SMI_INLINE_NAMELEN		16
+#define SNMP_SMI_INLINE_VALUELEN	32
+
 struct snmp_var {
+  /* The pool out of which the variable's name and value were allocated,
+   * if they were too large to be stored inline.
+   */
   pool *pool;
 
-  struct snmp_var *next;
-
   /* OID identifier of this variable */
   oid_t *name;
   unsigned int namelen;
@@ -79,17 +94,50 @@ struct snmp_var {
   unsigned char smi_type;
 
   union {
-    long *integer;
+    long integer;
     char *string;
     oid_t *oid;
   } value;
 
   unsigned int valuelen;
+
+  /* Inline storage, to which the name and value pointers above may point.
+   * Since a copy of the struct would then point into the original, copies
+   * must be made using the functions here, e.g. snmp_smi_util_add_list_var().
+   */
+  oid_t name_buf[SNMP_SMI_INLINE_NAMELEN];
+  union {
+    char string[SNMP_SMI_INLINE_VALUELEN];
+    oid_t oid[SNMP_SMI_INLINE_VALUELEN / sizeof(oid_t)];
+  } value_buf;
+};
+
+/* A response variable binding, as resolved by the agent: either a MIB
+ * object and its current value, or an exception for a requested name.
+ * Bindings refer to, rather than copy, their name and value, and are
+ * encoded directly into the response buffer; nothing is allocated for
+ * them beyond the array which holds them.
+ */
+struct snmp_binding {
+  oid_t *name;
+  unsigned int namelen;
+
+  /* The name as an encoded OID, if known in advance (e.g. for MIB objects);
+   * otherwise, the name is encoded from the sub-identifiers above.
+   */
+  const unsigned char *enc_name;
+  unsigned int enc_namelen;
+
+  unsigned char smi_type;
+  int32_t int_value;
+  const char *str_value;
+  size_t str_valuelen;
 };
 
 const char *snmp_smi_get_varstr(pool *p, unsigned char var_type);
 
 struct snmp_var *snmp_smi_alloc_var(pool *p, oid_t *name, unsigned int namelen);
+array_header *snmp_smi_alloc_varlist(pool *p, unsigned int nvars);
 struct snmp_var *snmp_smi_create_var(pool *p, oid_t *name,
   unsigned int namelen, unsigned char smi_type, int32_t int_value,
   char *str_value, size_t str_valuelen);
@@ -102,14 +150,25 @@ struct snmp_var *snmp_smi_create_oid(pool *p, oid_t *name,
   unsigned int valuelen);
 struct snmp_var *snmp_smi_create_exception(pool *p, oid_t *name,
   unsigned int namelen, unsigned char smi_type);
-struct snmp_var *snmp_smi_dup_var(pool *p, struct snmp_var *var);
+array_header *snmp_smi_dup_varlist(pool *p, array_header *varlist);
 
 int snmp_smi_read_vars(pool *p, unsigned char **buf, size_t *buflen,
-    struct snmp_var **varlist, int snmp_version);
+    array_header **varlist, int snmp_version);
+/* Writes the varlist back-to-front, immediately in front of *buf. */
 int snmp_smi_write_vars(pool *p, unsigned char **buf, size_t *buflen,
-    struct snmp_var *varlist, int snmp_version);
+    array_header *varlist, int snmp_version);
+size_t snmp_smi_get_varlen(struct snmp_var *var, int snmp_version);
 
-unsigned int snmp_smi_util_add_list_var(struct snmp_var **head,
-  struct snmp_var **tail, struct snmp_var *var);
+/* Like snmp_smi_write_vars(), for a list of struct snmp_binding. */
+int snmp_smi_write_bindings(pool *p, unsigned char **buf, size_t *buflen,
+    array_header *bindings, int snmp_version);
+size_t snmp_smi_get_binding_len(struct snmp_binding *binding,
+    int snmp_version);
+
+/* Appends a copy of the given variable to the list, returning the number of
+ * variables in the list.
+ */
+unsigned int snmp_smi_util_add_list_var(array_header *varlist,
+  struct snmp_var *var);
 
 #endif
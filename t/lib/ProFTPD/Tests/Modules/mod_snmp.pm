@@ -7,6 +7,9 @@ use strict;
 use Data::Dumper;
 use File::Spec;
 use IO::Handle;
+use IO::Select;
+use IO::Socket::INET;
+use IO::Socket::UNIX;
 
 use ProFTPD::TestSuite::FTP;
 use ProFTPD::TestSuite::Utils qw(:auth :config :running :test :testsuite);
@@ -189,6 +192,76 @@ my $TESTS = {
     order => ++$order,
     test_class => [qw(forking snmp)],
   },
+
+  snmp_v2_get_bulk_partial_response => {
+    order => ++$order,
+    test_class => [qw(forking snmp)],
+  },
+
+  snmp_v2_get_bulk_max_message_size => {
+    order => ++$order,
+    test_class => [qw(forking snmp)],
+  },
+
+  snmp_config_max_message_size_bad => {
+    order => ++$order,
+    test_class => [qw(forking snmp)],
+  },
+
+  snmp_config_response_cache => {
+    order => ++$order,
+    test_class => [qw(forking snmp)],
+  },
+
+  snmp_config_log_level => {
+    order => ++$order,
+    test_class => [qw(forking snmp)],
+  },
+
+  snmp_config_log_buffer => {
+    order => ++$order,
+    test_class => [qw(forking snmp)],
+  },
+
+  snmp_notify_rate_limit => {
+    order => ++$order,
+    test_class => [qw(forking snmp)],
+  },
+
+  snmp_notify_threshold => {
+    order => ++$order,
+    test_class => [qw(forking snmp)],
+  },
+
+  snmp_notify_inform => {
+    order => ++$order,
+    test_class => [qw(forking snmp)],
+  },
+
+  snmp_notify_filters => {
+    order => ++$order,
+    test_class => [qw(forking snmp)],
+  },
+
+  snmp_notify_local => {
+    order => ++$order,
+    test_class => [qw(forking snmp)],
+  },
+
+  snmp_notify_throughput => {
+    order => ++$order,
+    test_class => [qw(forking snmp)],
+  },
+
+  snmp_config_notify_throughput_bad => {
+    order => ++$order,
+    test_class => [qw(forking snmp)],
+  },
+
+  snmp_v2_get_empty_oid => {
+    order => ++$order,
+    test_class => [qw(forking snmp)],
+  },
 };
 
 sub new {
@@ -476,6 +549,155 @@ sub upload_file {
   return 1;
 }
 
+sub get_snmp_values {
+  my $agent_port = shift;
+  my $snmp_community = shift;
+  my $oids = shift;
+
+  my ($snmp_sess, $snmp_err) = Net::SNMP->session(
+    -hostname => '127.0.0.1',
+    -port => $agent_port,
+    -version => 'snmpv1',
+    -community => $snmp_community,
+    -retries => 1,
+    -timeout => 3,
+    -translate => 1,
+  );
+  unless ($snmp_sess) {
+    die("Unable to create Net::SNMP session: $snmp_err");
+  }
+
+  if ($ENV{TEST_VERBOSE}) {
+    # From the Net::SNMP debug perldocs
+    my $debug_mask = (0x02|0x10|0x20);
+    $snmp_sess->debug($debug_mask);
+  }
+
+  my $snmp_resp = $snmp_sess->get_request(
+    -varbindList => $oids,
+  );
+  unless ($snmp_resp) {
+    die("No SNMP response received: " . $snmp_sess->error());
+  }
+
+  my $values = [];
+
+  # Do we have the requested OIDs in the response?
+
+  foreach my $oid (@$oids) {
+    unless (defined($snmp_resp->{$oid})) {
+      die("Missing required OID $oid in response");
+    }
+
+    my $value = $snmp_resp->{$oid};
+    if ($ENV{TEST_VERBOSE}) {
+      print STDERR "Requested OID $oid = $value\n";
+    }
+
+    push(@$values, $value);
+  }
+
+  $snmp_sess->close();
+  $snmp_sess = undef;
+
+  return @$values;
+}
+
+sub fail_login {
+  my $port = shift;
+  my $user = shift;
+  my $passwd = shift;
+
+  my $client = ProFTPD::TestSuite::FTP->new('127.0.0.1', $port);
+
+  eval { $client->login($user, $passwd) };
+  unless ($@) {
+    die("Login succeeded unexpectedly");
+  }
+
+  $client->quit();
+}
+
+sub recv_notifys {
+  my $sock = shift;
+  my $timeout = shift;
+
+  my $notifys = [];
+  my $sel = IO::Select->new($sock);
+
+  # Collect notifications until none arrive for $timeout seconds.
+  while ($sel->can_read($timeout)) {
+    my $pkt;
+
+    unless (defined($sock->recv($pkt, 8192))) {
+      die("Can't receive notification: $!");
+    }
+
+    push(@$notifys, $pkt);
+  }
+
+  return $notifys;
+}
+
+sub notify_has_oid {
+  my $pkt = shift;
+  my $oid = shift;
+
+  # BER-encode the OID, e.g. the snmpTrapOID.0 value, and look for it in the
+  # notification.
+  my @arcs = split(/\./, $oid);
+  my $first = shift(@arcs);
+  $arcs[0] += ($first * 40);
+
+  my $data = '';
+  foreach my $arc (@arcs) {
+    my $enc = chr($arc & 0x7f);
+
+    $arc >>= 7;
+    while ($arc > 0) {
+      $enc = chr(($arc & 0x7f) | 0x80) . $enc;
+      $arc >>= 7;
+    }
+
+    $data .= $enc;
+  }
+
+  $data = chr(0x06) . chr(length($data)) . $data;
+  return (index($pkt, $data) >= 0 ? 1 : 0);
+}
+
+sub get_ber_len {
+  my $pkt = shift;
+  my $offset = shift;
+
+  my $len = ord(substr($pkt, $offset++, 1));
+  if ($len & 0x80) {
+    my $nbytes = ($len & 0x7f);
+
+    $len = 0;
+    for (my $i = 0; $i < $nbytes; $i++) {
+      $len = ($len << 8) | ord(substr($pkt, $offset++, 1));
+    }
+  }
+
+  return ($len, $offset);
+}
+
+sub get_notify_pdu_offset {
+  my $pkt = shift;
+
+  # Skip the message SEQUENCE header, then the version and community; the
+  # PDU follows.
+  my ($len, $offset) = get_ber_len($pkt, 1);
+
+  for (my $i = 0; $i < 2; $i++) {
+    ($len, $offset) = get_ber_len($pkt, $offset + 1);
+    $offset += $len;
+  }
+
+  return $offset;
+}
+
 # Test cases
 
 sub snmp_start_existing_dirs {
@@ -6130,4 +6352,2192 @@ sub snmp_config_max_variables {
   unlink($log_file);
 }
 
+sub snmp_v2_get_bulk_partial_response {
+  my $self = shift;
+  my $tmpdir = $self->{tmpdir};
+
+  my $config_file = "$tmpdir/snmp.conf";
+  my $pid_file = File::Spec->rel2abs("$tmpdir/snmp.pid");
+  my $scoreboard_file = File::Spec->rel2abs("$tmpdir/snmp.scoreboard");
+
+  my $log_file = test_get_logfile();
+
+  my $auth_user_file = File::Spec->rel2abs("$tmpdir/snmp.passwd");
+  my $auth_group_file = File::Spec->rel2abs("$tmpdir/snmp.group");
+
+  my $user = 'proftpd';
+  my $passwd = 'test';
+  my $group = 'ftpd';
+  my $home_dir = File::Spec->rel2abs($tmpdir);
+  my $uid = 500;
+  my $gid = 500;
+
+  my $table_dir = File::Spec->rel2abs("$tmpdir/var/snmp");
+
+  # Make sure that, if we're running as root, that the home directory has
+  # permissions/privs set for the account we create
+  if ($< == 0) {
+    unless (chmod(0755, $home_dir, $table_dir)) {
+      die("Can't set perms on $home_dir to 0755: $!");
+    }
+
+    unless (chown($uid, $gid, $home_dir, $table_dir)) {
+      die("Can't set owner of $home_dir to $uid/$gid: $!");
+    }
+  }
+
+  auth_user_write($auth_user_file, $user, $passwd, $uid, $gid, $home_dir,
+    '/bin/bash');
+  auth_group_write($auth_group_file, $group, $gid, $user);
+
+  my $agent_port = ProFTPD::TestSuite::Utils::get_high_numbered_port();
+  my $snmp_community = "public";
+
+  my $request_oid = '1.3.6.1.4.1.17852.2.2.1.1.0';
+
+  my $next_oids = {
+    '1.3.6.1.4.1.17852.2.2.1.2.0' => '\d+\.\d+',
+    '1.3.6.1.4.1.17852.2.2.1.3.0' => 'root@127.0.0.1',
+  };
+
+  my $config = {
+    TraceLog => $log_file,
+    Trace => 'snmp:20 snmp.asn1:20 snmp.db:20 snmp.msg:20 snmp.pdu:20 snmp.smi:20',
+    PidFile => $pid_file,
+    ScoreboardFile => $scoreboard_file,
+    SystemLog => $log_file,
+
+    AuthUserFile => $auth_user_file,
+    AuthGroupFile => $auth_group_file,
+
+    IfModules => {
+      'mod_delay.c' => {
+        DelayEngine => 'off',
+      },
+
+      'mod_snmp.c' => {
+        SNMPAgent => "master 127.0.0.1:$agent_port",
+        SNMPCommunity => $snmp_community,
+        SNMPEngine => 'on',
+        SNMPLog => $log_file,
+        SNMPTables => $table_dir,
+
+        SNMPMaxVariables => 3,
+      },
+    },
+  };
+
+  my ($port, $config_user, $config_group) = config_write($config_file, $config);
+
+  # Open pipes, for use between the parent and child processes.  Specifically,
+  # the child will indicate when it's done with its test by writing a message
+  # to the parent.
+  my ($rfh, $wfh);
+  unless (pipe($rfh, $wfh)) {
+    die("Can't open pipe: $!");
+  }
+
+  require Net::SNMP;
+
+  my $ex;
+
+  # Fork child
+  $self->handle_sigchld();
+  defined(my $pid = fork()) or die("Can't fork: $!");
+  if ($pid) {
+    eval {
+      my ($snmp_sess, $snmp_err) = Net::SNMP->session(
+        -hostname => '127.0.0.1',
+        -port => $agent_port,
+        -version => 'snmpv2c',
+        -community => $snmp_community,
+        -retries => 1,
+        -timeout => 3,
+        -translate => 1,
+      );
+      unless ($snmp_sess) {
+        die("Unable to create Net::SNMP session: $snmp_err");
+      }
+
+      if ($ENV{TEST_VERBOSE}) {
+        # From the Net::SNMP debug perldocs
+        my $debug_mask = (0x02|0x10|0x20);
+        $snmp_sess->debug($debug_mask);
+      }
+
+      # More repetitions than SNMPMaxVariables allows; we should get as many
+      # variables as are allowed, rather than a tooBig error.
+      my $oids = [$request_oid];
+
+      my $snmp_resp = $snmp_sess->get_bulk_request(
+        -maxrepetitions => 10,
+        -varbindList => $oids,
+      );
+      unless ($snmp_resp) {
+        die("No SNMP response received: " . $snmp_sess->error());
+      }
+
+      my $count = scalar(keys(%$snmp_resp));
+      my $expected = 3;
+      $self->assert($count == $expected,
+        test_msg("Expected $expected variables in response, got $count"));
+
+      foreach my $next_oid (keys(%$next_oids)) {
+        unless (defined($snmp_resp->{$next_oid})) {
+          die("Missing required OID $next_oid in response");
+        }
+
+        my $value = $snmp_resp->{$next_oid};
+
+        if ($ENV{TEST_VERBOSE}) {
+          print STDERR "Requested OID $next_oid = $value\n";
+        }
+
+        $expected = $next_oids->{$next_oid};
+
+        $self->assert(qr/$expected/, $value,
+          test_msg("Expected value '$expected' for OID, got '$value'"));
+      }
+
+      $snmp_sess->close();
+      $snmp_sess = undef;
+    };
+
+    if ($@) {
+      $ex = $@;
+    }
+
+    $wfh->print("done\n");
+    $wfh->flush();
+
+  } else {
+    eval { server_wait($config_file, $rfh) };
+    if ($@) {
+      warn($@);
+      exit 1;
+    }
+
+    exit 0;
+  }
+
+  # Stop server
+  server_stop($pid_file);
+
+  $self->assert_child_ok($pid);
+
+  if ($ex) {
+    test_append_logfile($log_file, $ex);
+    unlink($log_file);
+
+    die($ex);
+  }
+
+  unlink($log_file);
+}
+
+sub snmp_v2_get_bulk_max_message_size {
+  my $self = shift;
+  my $tmpdir = $self->{tmpdir};
+
+  my $config_file = "$tmpdir/snmp.conf";
+  my $pid_file = File::Spec->rel2abs("$tmpdir/snmp.pid");
+  my $scoreboard_file = File::Spec->rel2abs("$tmpdir/snmp.scoreboard");
+
+  my $log_file = test_get_logfile();
+
+  my $auth_user_file = File::Spec->rel2abs("$tmpdir/snmp.passwd");
+  my $auth_group_file = File::Spec->rel2abs("$tmpdir/snmp.group");
+
+  my $user = 'proftpd';
+  my $passwd = 'test';
+  my $group = 'ftpd';
+  my $home_dir = File::Spec->rel2abs($tmpdir);
+  my $uid = 500;
+  my $gid = 500;
+
+  my $table_dir = File::Spec->rel2abs("$tmpdir/var/snmp");
+
+  # Make sure that, if we're running as root, that the home directory has
+  # permissions/privs set for the account we create
+  if ($< == 0) {
+    unless (chmod(0755, $home_dir, $table_dir)) {
+      die("Can't set perms on $home_dir to 0755: $!");
+    }
+
+    unless (chown($uid, $gid, $home_dir, $table_dir)) {
+      die("Can't set owner of $home_dir to $uid/$gid: $!");
+    }
+  }
+
+  auth_user_write($auth_user_file, $user, $passwd, $uid, $gid, $home_dir,
+    '/bin/bash');
+  auth_group_write($auth_group_file, $group, $gid, $user);
+
+  my $agent_port = ProFTPD::TestSuite::Utils::get_high_numbered_port();
+  my $snmp_community = "public";
+
+  my $request_oid = '1.3.6.1.4.1.17852.2.2.1.1.0';
+  my $next_oid = '1.3.6.1.4.1.17852.2.2.1.2.0';
+
+  my $config = {
+    TraceLog => $log_file,
+    Trace => 'snmp:20 snmp.asn1:20 snmp.db:20 snmp.msg:20 snmp.pdu:20 snmp.smi:20',
+    PidFile => $pid_file,
+    ScoreboardFile => $scoreboard_file,
+    SystemLog => $log_file,
+
+    AuthUserFile => $auth_user_file,
+    AuthGroupFile => $auth_group_file,
+
+    IfModules => {
+      'mod_delay.c' => {
+        DelayEngine => 'off',
+      },
+
+      'mod_snmp.c' => {
+        SNMPAgent => "master 127.0.0.1:$agent_port",
+        SNMPCommunity => $snmp_community,
+        SNMPEngine => 'on',
+        SNMPLog => $log_file,
+        SNMPTables => $table_dir,
+
+        SNMPMaxMessageSize => 484,
+      },
+    },
+  };
+
+  my ($port, $config_user, $config_group) = config_write($config_file, $config);
+
+  # Open pipes, for use between the parent and child processes.  Specifically,
+  # the child will indicate when it's done with its test by writing a message
+  # to the parent.
+  my ($rfh, $wfh);
+  unless (pipe($rfh, $wfh)) {
+    die("Can't open pipe: $!");
+  }
+
+  require Net::SNMP;
+
+  my $ex;
+
+  # Fork child
+  $self->handle_sigchld();
+  defined(my $pid = fork()) or die("Can't fork: $!");
+  if ($pid) {
+    eval {
+      my ($snmp_sess, $snmp_err) = Net::SNMP->session(
+        -hostname => '127.0.0.1',
+        -port => $agent_port,
+        -version => 'snmpv2c',
+        -community => $snmp_community,
+        -retries => 1,
+        -timeout => 3,
+        -translate => 1,
+      );
+      unless ($snmp_sess) {
+        die("Unable to create Net::SNMP session: $snmp_err");
+      }
+
+      if ($ENV{TEST_VERBOSE}) {
+        # From the Net::SNMP debug perldocs
+        my $debug_mask = (0x02|0x10|0x20);
+        $snmp_sess->debug($debug_mask);
+      }
+
+      # Far more repetitions than fit into 484 bytes; we should get those
+      # which fit, rather than a tooBig error.
+      my $oids = [$request_oid];
+
+      my $snmp_resp = $snmp_sess->get_bulk_request(
+        -maxrepetitions => 100,
+        -varbindList => $oids,
+      );
+      unless ($snmp_resp) {
+        die("No SNMP response received: " . $snmp_sess->error());
+      }
+
+      unless (defined($snmp_resp->{$next_oid})) {
+        die("Missing required OID $next_oid in response");
+      }
+
+      my $count = scalar(keys(%$snmp_resp));
+
+      if ($ENV{TEST_VERBOSE}) {
+        print STDERR "Received $count variables\n";
+      }
+
+      $self->assert($count > 1 && $count < 100,
+        test_msg("Expected partial response, got $count variables"));
+
+      $snmp_sess->close();
+      $snmp_sess = undef;
+    };
+
+    if ($@) {
+      $ex = $@;
+    }
+
+    $wfh->print("done\n");
+    $wfh->flush();
+
+  } else {
+    eval { server_wait($config_file, $rfh) };
+    if ($@) {
+      warn($@);
+      exit 1;
+    }
+
+    exit 0;
+  }
+
+  # Stop server
+  server_stop($pid_file);
+
+  $self->assert_child_ok($pid);
+
+  if ($ex) {
+    test_append_logfile($log_file, $ex);
+    unlink($log_file);
+
+    die($ex);
+  }
+
+  unlink($log_file);
+}
+
+sub snmp_config_max_message_size_bad {
+  my $self = shift;
+  my $tmpdir = $self->{tmpdir};
+
+  my $config_file = "$tmpdir/snmp.conf";
+  my $pid_file = File::Spec->rel2abs("$tmpdir/snmp.pid");
+  my $scoreboard_file = File::Spec->rel2abs("$tmpdir/snmp.scoreboard");
+
+  my $log_file = test_get_logfile();
+
+  my $auth_user_file = File::Spec->rel2abs("$tmpdir/snmp.passwd");
+  my $auth_group_file = File::Spec->rel2abs("$tmpdir/snmp.group");
+
+  my $user = 'proftpd';
+  my $passwd = 'test';
+  my $group = 'ftpd';
+  my $home_dir = File::Spec->rel2abs($tmpdir);
+  my $uid = 500;
+  my $gid = 500;
+
+  my $table_dir = File::Spec->rel2abs("$tmpdir/var/snmp");
+
+  # Make sure that, if we're running as root, that the home directory has
+  # permissions/privs set for the account we create
+  if ($< == 0) {
+    unless (chmod(0755, $home_dir, $table_dir)) {
+      die("Can't set perms on $home_dir to 0755: $!");
+    }
+
+    unless (chown($uid, $gid, $home_dir, $table_dir)) {
+      die("Can't set owner of $home_dir to $uid/$gid: $!");
+    }
+  }
+
+  auth_user_write($auth_user_file, $user, $passwd, $uid, $gid, $home_dir,
+    '/bin/bash');
+  auth_group_write($auth_group_file, $group, $gid, $user);
+
+  my $agent_port = ProFTPD::TestSuite::Utils::get_high_numbered_port();
+  my $snmp_community = "public";
+
+  foreach my $msgsz (qw(483 4097)) {
+    my $config = {
+      TraceLog => $log_file,
+      Trace => 'snmp:20 snmp.asn1:20 snmp.db:20 snmp.msg:20 snmp.pdu:20 snmp.smi:20',
+      PidFile => $pid_file,
+      ScoreboardFile => $scoreboard_file,
+      SystemLog => $log_file,
+
+      AuthUserFile => $auth_user_file,
+      AuthGroupFile => $auth_group_file,
+
+      IfModules => {
+        'mod_delay.c' => {
+          DelayEngine => 'off',
+        },
+
+        'mod_snmp.c' => {
+          SNMPAgent => "master 127.0.0.1:$agent_port",
+          SNMPCommunity => $snmp_community,
+          SNMPEngine => 'on',
+          SNMPLog => $log_file,
+          SNMPTables => $table_dir,
+
+          SNMPMaxMessageSize => $msgsz,
+        },
+      },
+    };
+
+    my ($port, $config_user, $config_group) = config_write($config_file,
+      $config);
+
+    # The size is out of range, so the server should fail to start.
+    eval { server_start($config_file) };
+    unless ($@) {
+      eval { server_stop($pid_file) };
+
+      my $ex = "Server started unexpectedly with SNMPMaxMessageSize $msgsz";
+      test_append_logfile($log_file, $ex);
+      unlink($log_file);
+
+      die($ex);
+    }
+  }
+
+  unlink($log_file);
+}
+
+sub snmp_config_response_cache {
+  my $self = shift;
+  my $tmpdir = $self->{tmpdir};
+
+  my $config_file = "$tmpdir/snmp.conf";
+  my $pid_file = File::Spec->rel2abs("$tmpdir/snmp.pid");
+  my $scoreboard_file = File::Spec->rel2abs("$tmpdir/snmp.scoreboard");
+
+  my $log_file = test_get_logfile();
+
+  my $auth_user_file = File::Spec->rel2abs("$tmpdir/snmp.passwd");
+  my $auth_group_file = File::Spec->rel2abs("$tmpdir/snmp.group");
+
+  my $user = 'proftpd';
+  my $passwd = 'test';
+  my $group = 'ftpd';
+  my $home_dir = File::Spec->rel2abs($tmpdir);
+  my $uid = 500;
+  my $gid = 500;
+
+  my $table_dir = File::Spec->rel2abs("$tmpdir/var/snmp");
+
+  # Make sure that, if we're running as root, that the home directory has
+  # permissions/privs set for the account we create
+  if ($< == 0) {
+    unless (chmod(0755, $home_dir, $table_dir)) {
+      die("Can't set perms on $home_dir to 0755: $!");
+    }
+
+    unless (chown($uid, $gid, $home_dir, $table_dir)) {
+      die("Can't set owner of $home_dir to $uid/$gid: $!");
+    }
+  }
+
+  auth_user_write($auth_user_file, $user, $passwd, $uid, $gid, $home_dir,
+    '/bin/bash');
+  auth_group_write($auth_group_file, $group, $gid, $user);
+
+  my $agent_port = ProFTPD::TestSuite::Utils::get_high_numbered_port();
+  my $snmp_community = "public";
+
+  # daemon.software
+  my $request_oid = '1.3.6.1.4.1.17852.2.2.1.1.0';
+
+  # snmp.responseCacheHitsTotal
+  my $cache_hits_oid = '1.3.6.1.4.1.17852.2.2.4.6.0';
+
+  my $config = {
+    TraceLog => $log_file,
+    Trace => 'snmp:20 snmp.asn1:20 snmp.db:20 snmp.msg:20 snmp.pdu:20 snmp.smi:20',
+    PidFile => $pid_file,
+    ScoreboardFile => $scoreboard_file,
+    SystemLog => $log_file,
+
+    AuthUserFile => $auth_user_file,
+    AuthGroupFile => $auth_group_file,
+
+    IfModules => {
+      'mod_delay.c' => {
+        DelayEngine => 'off',
+      },
+
+      'mod_snmp.c' => {
+        SNMPAgent => "master 127.0.0.1:$agent_port",
+        SNMPCommunity => $snmp_community,
+        SNMPEngine => 'on',
+        SNMPLog => $log_file,
+        SNMPTables => $table_dir,
+
+        SNMPResponseCache => 5000,
+      },
+    },
+  };
+
+  my ($port, $config_user, $config_group) = config_write($config_file, $config);
+
+  # Open pipes, for use between the parent and child processes.  Specifically,
+  # the child will indicate when it's done with its test by writing a message
+  # to the parent.
+  my ($rfh, $wfh);
+  unless (pipe($rfh, $wfh)) {
+    die("Can't open pipe: $!");
+  }
+
+  require Net::SNMP;
+
+  my $ex;
+
+  # Fork child
+  $self->handle_sigchld();
+  defined(my $pid = fork()) or die("Can't fork: $!");
+  if ($pid) {
+    eval {
+      my $expected;
+
+      # Request the same OID twice; the second response should come from
+      # the cache.
+      my ($value) = get_snmp_values($agent_port, $snmp_community,
+        [$request_oid]);
+
+      $expected = 'proftpd';
+      $self->assert($expected eq $value,
+        test_msg("Expected value '$expected', got '$value'"));
+
+      ($value) = get_snmp_values($agent_port, $snmp_community,
+        [$request_oid]);
+
+      $self->assert($expected eq $value,
+        test_msg("Expected cached value '$expected', got '$value'"));
+
+      my ($cache_hits) = get_snmp_values($agent_port, $snmp_community,
+        [$cache_hits_oid]);
+
+      $expected = 1;
+      $self->assert($cache_hits == $expected,
+        test_msg("Expected response cache hits $expected, got $cache_hits"));
+    };
+
+    if ($@) {
+      $ex = $@;
+    }
+
+    $wfh->print("done\n");
+    $wfh->flush();
+
+  } else {
+    eval { server_wait($config_file, $rfh) };
+    if ($@) {
+      warn($@);
+      exit 1;
+    }
+
+    exit 0;
+  }
+
+  # Stop server
+  server_stop($pid_file);
+
+  $self->assert_child_ok($pid);
+
+  if ($ex) {
+    test_append_logfile($log_file, $ex);
+    unlink($log_file);
+
+    die($ex);
+  }
+
+  unlink($log_file);
+}
+
+sub snmp_config_log_level {
+  my $self = shift;
+  my $tmpdir = $self->{tmpdir};
+
+  my $config_file = "$tmpdir/snmp.conf";
+  my $pid_file = File::Spec->rel2abs("$tmpdir/snmp.pid");
+  my $scoreboard_file = File::Spec->rel2abs("$tmpdir/snmp.scoreboard");
+
+  my $log_file = test_get_logfile();
+
+  my $auth_user_file = File::Spec->rel2abs("$tmpdir/snmp.passwd");
+  my $auth_group_file = File::Spec->rel2abs("$tmpdir/snmp.group");
+
+  my $user = 'proftpd';
+  my $passwd = 'test';
+  my $group = 'ftpd';
+  my $home_dir = File::Spec->rel2abs($tmpdir);
+  my $uid = 500;
+  my $gid = 500;
+
+  my $table_dir = File::Spec->rel2abs("$tmpdir/var/snmp");
+
+  # Make sure that, if we're running as root, that the home directory has
+  # permissions/privs set for the account we create
+  if ($< == 0) {
+    unless (chmod(0755, $home_dir, $table_dir)) {
+      die("Can't set perms on $home_dir to 0755: $!");
+    }
+
+    unless (chown($uid, $gid, $home_dir, $table_dir)) {
+      die("Can't set owner of $home_dir to $uid/$gid: $!");
+    }
+  }
+
+  auth_user_write($auth_user_file, $user, $passwd, $uid, $gid, $home_dir,
+    '/bin/bash');
+  auth_group_write($auth_group_file, $group, $gid, $user);
+
+  my $agent_port = ProFTPD::TestSuite::Utils::get_high_numbered_port();
+  my $snmp_community = "public";
+
+  my $snmp_log_file = File::Spec->rel2abs("$tmpdir/snmp.log");
+
+  # daemon.software
+  my $request_oid = '1.3.6.1.4.1.17852.2.2.1.1.0';
+
+  my $config = {
+    TraceLog => $log_file,
+    Trace => 'snmp:20 snmp.asn1:20 snmp.db:20 snmp.msg:20 snmp.pdu:20 snmp.smi:20',
+    PidFile => $pid_file,
+    ScoreboardFile => $scoreboard_file,
+    SystemLog => $log_file,
+
+    AuthUserFile => $auth_user_file,
+    AuthGroupFile => $auth_group_file,
+
+    IfModules => {
+      'mod_delay.c' => {
+        DelayEngine => 'off',
+      },
+
+      'mod_snmp.c' => {
+        SNMPAgent => "master 127.0.0.1:$agent_port",
+        SNMPCommunity => $snmp_community,
+        SNMPEngine => 'on',
+        SNMPLog => $snmp_log_file,
+        SNMPTables => $table_dir,
+
+        SNMPLogLevel => 'notice',
+      },
+    },
+  };
+
+  my ($port, $config_user, $config_group) = config_write($config_file, $config);
+
+  # Open pipes, for use between the parent and child processes.  Specifically,
+  # the child will indicate when it's done with its test by writing a message
+  # to the parent.
+  my ($rfh, $wfh);
+  unless (pipe($rfh, $wfh)) {
+    die("Can't open pipe: $!");
+  }
+
+  require Net::SNMP;
+
+  my $ex;
+
+  # Fork child
+  $self->handle_sigchld();
+  defined(my $pid = fork()) or die("Can't fork: $!");
+  if ($pid) {
+    eval {
+      my ($value) = get_snmp_values($agent_port, $snmp_community,
+        [$request_oid]);
+
+      # Requests are logged at the info level, so this one should not have
+      # been logged.
+      sleep(2);
+
+      my $logged = 0;
+
+      if (open(my $fh, "< $snmp_log_file")) {
+        while (my $line = <$fh>) {
+          chomp($line);
+
+          if ($line =~ /community '$snmp_community', request ID/) {
+            $logged = 1;
+            last;
+          }
+        }
+
+        close($fh);
+
+      } else {
+        die("Can't read $snmp_log_file: $!");
+      }
+
+      $self->assert(!$logged,
+        test_msg("Expected request not to be logged in SNMPLog"));
+    };
+
+    if ($@) {
+      $ex = $@;
+    }
+
+    $wfh->print("done\n");
+    $wfh->flush();
+
+  } else {
+    eval { server_wait($config_file, $rfh) };
+    if ($@) {
+      warn($@);
+      exit 1;
+    }
+
+    exit 0;
+  }
+
+  # Stop server
+  server_stop($pid_file);
+
+  $self->assert_child_ok($pid);
+
+  if ($ex) {
+    test_append_logfile($snmp_log_file, $ex);
+  }
+
+  unlink($snmp_log_file);
+
+  if ($ex) {
+    test_append_logfile($log_file, $ex);
+    unlink($log_file);
+
+    die($ex);
+  }
+
+  unlink($log_file);
+}
+
+sub snmp_config_log_buffer {
+  my $self = shift;
+  my $tmpdir = $self->{tmpdir};
+
+  my $config_file = "$tmpdir/snmp.conf";
+  my $pid_file = File::Spec->rel2abs("$tmpdir/snmp.pid");
+  my $scoreboard_file = File::Spec->rel2abs("$tmpdir/snmp.scoreboard");
+
+  my $log_file = test_get_logfile();
+
+  my $auth_user_file = File::Spec->rel2abs("$tmpdir/snmp.passwd");
+  my $auth_group_file = File::Spec->rel2abs("$tmpdir/snmp.group");
+
+  my $user = 'proftpd';
+  my $passwd = 'test';
+  my $group = 'ftpd';
+  my $home_dir = File::Spec->rel2abs($tmpdir);
+  my $uid = 500;
+  my $gid = 500;
+
+  my $table_dir = File::Spec->rel2abs("$tmpdir/var/snmp");
+
+  # Make sure that, if we're running as root, that the home directory has
+  # permissions/privs set for the account we create
+  if ($< == 0) {
+    unless (chmod(0755, $home_dir, $table_dir)) {
+      die("Can't set perms on $home_dir to 0755: $!");
+    }
+
+    unless (chown($uid, $gid, $home_dir, $table_dir)) {
+      die("Can't set owner of $home_dir to $uid/$gid: $!");
+    }
+  }
+
+  auth_user_write($auth_user_file, $user, $passwd, $uid, $gid, $home_dir,
+    '/bin/bash');
+  auth_group_write($auth_group_file, $group, $gid, $user);
+
+  my $agent_port = ProFTPD::TestSuite::Utils::get_high_numbered_port();
+  my $snmp_community = "public";
+
+  my $snmp_log_file = File::Spec->rel2abs("$tmpdir/snmp.log");
+
+  # daemon.software
+  my $request_oid = '1.3.6.1.4.1.17852.2.2.1.1.0';
+
+  my $config = {
+    TraceLog => $log_file,
+    Trace => 'snmp:20 snmp.asn1:20 snmp.db:20 snmp.msg:20 snmp.pdu:20 snmp.smi:20',
+    PidFile => $pid_file,
+    ScoreboardFile => $scoreboard_file,
+    SystemLog => $log_file,
+
+    AuthUserFile => $auth_user_file,
+    AuthGroupFile => $auth_group_file,
+
+    IfModules => {
+      'mod_delay.c' => {
+        DelayEngine => 'off',
+      },
+
+      'mod_snmp.c' => {
+        SNMPAgent => "master 127.0.0.1:$agent_port",
+        SNMPCommunity => $snmp_community,
+        SNMPEngine => 'on',
+        SNMPLog => $snmp_log_file,
+        SNMPTables => $table_dir,
+
+        SNMPLogBuffer => 65536,
+      },
+    },
+  };
+
+  my ($port, $config_user, $config_group) = config_write($config_file, $config);
+
+  # Open pipes, for use between the parent and child processes.  Specifically,
+  # the child will indicate when it's done with its test by writing a message
+  # to the parent.
+  my ($rfh, $wfh);
+  unless (pipe($rfh, $wfh)) {
+    die("Can't open pipe: $!");
+  }
+
+  require Net::SNMP;
+
+  my $ex;
+
+  # Fork child
+  $self->handle_sigchld();
+  defined(my $pid = fork()) or die("Can't fork: $!");
+  if ($pid) {
+    eval {
+      my ($value) = get_snmp_values($agent_port, $snmp_community,
+        [$request_oid]);
+
+      # Buffered messages are written to the SNMPLog once a second.
+      sleep(2);
+
+      my $logged = 0;
+
+      if (open(my $fh, "< $snmp_log_file")) {
+        while (my $line = <$fh>) {
+          chomp($line);
+
+          if ($line =~ /community '$snmp_community', request ID/) {
+            $logged = 1;
+            last;
+          }
+        }
+
+        close($fh);
+
+      } else {
+        die("Can't read $snmp_log_file: $!");
+      }
+
+      $self->assert($logged,
+        test_msg("Expected request to be logged in SNMPLog"));
+    };
+
+    if ($@) {
+      $ex = $@;
+    }
+
+    $wfh->print("done\n");
+    $wfh->flush();
+
+  } else {
+    eval { server_wait($config_file, $rfh) };
+    if ($@) {
+      warn($@);
+      exit 1;
+    }
+
+    exit 0;
+  }
+
+  # Stop server
+  server_stop($pid_file);
+
+  $self->assert_child_ok($pid);
+
+  if ($ex) {
+    test_append_logfile($snmp_log_file, $ex);
+  }
+
+  unlink($snmp_log_file);
+
+  if ($ex) {
+    test_append_logfile($log_file, $ex);
+    unlink($log_file);
+
+    die($ex);
+  }
+
+  unlink($log_file);
+}
+
+sub snmp_notify_rate_limit {
+  my $self = shift;
+  my $tmpdir = $self->{tmpdir};
+
+  my $config_file = "$tmpdir/snmp.conf";
+  my $pid_file = File::Spec->rel2abs("$tmpdir/snmp.pid");
+  my $scoreboard_file = File::Spec->rel2abs("$tmpdir/snmp.scoreboard");
+
+  my $log_file = test_get_logfile();
+
+  my $auth_user_file = File::Spec->rel2abs("$tmpdir/snmp.passwd");
+  my $auth_group_file = File::Spec->rel2abs("$tmpdir/snmp.group");
+
+  my $user = 'proftpd';
+  my $passwd = 'test';
+  my $group = 'ftpd';
+  my $home_dir = File::Spec->rel2abs($tmpdir);
+  my $uid = 500;
+  my $gid = 500;
+
+  my $table_dir = File::Spec->rel2abs("$tmpdir/var/snmp");
+
+  # Make sure that, if we're running as root, that the home directory has
+  # permissions/privs set for the account we create
+  if ($< == 0) {
+    unless (chmod(0755, $home_dir, $table_dir)) {
+      die("Can't set perms on $home_dir to 0755: $!");
+    }
+
+    unless (chown($uid, $gid, $home_dir, $table_dir)) {
+      die("Can't set owner of $home_dir to $uid/$gid: $!");
+    }
+  }
+
+  auth_user_write($auth_user_file, $user, $passwd, $uid, $gid, $home_dir,
+    '/bin/bash');
+  auth_group_write($auth_group_file, $group, $gid, $user);
+
+  my $agent_port = ProFTPD::TestSuite::Utils::get_high_numbered_port();
+  my $snmp_community = "public";
+
+  my $trap_port = ProFTPD::TestSuite::Utils::get_high_numbered_port();
+  my $trap_sock = IO::Socket::INET->new(
+    LocalAddr => '127.0.0.1',
+    LocalPort => $trap_port,
+    Proto => 'udp',
+  );
+  unless ($trap_sock) {
+    die("Can't listen on 127.0.0.1#$trap_port: $!");
+  }
+
+  my $timeout_idle = 45;
+
+  # loginFailedBadPassword
+  my $notify_oid = '1.3.6.1.4.1.17852.2.2.3.5.1.0';
+
+  # snmp.trapsSuppressedTotal
+  my $suppressed_oid = '1.3.6.1.4.1.17852.2.2.4.12.0';
+
+  my $config = {
+    TraceLog => $log_file,
+    Trace => 'snmp:20 snmp.asn1:20 snmp.db:20 snmp.msg:20 snmp.pdu:20 snmp.smi:20',
+    PidFile => $pid_file,
+    ScoreboardFile => $scoreboard_file,
+    SystemLog => $log_file,
+
+    AuthUserFile => $auth_user_file,
+    AuthGroupFile => $auth_group_file,
+    TimeoutIdle => $timeout_idle + 1,
+
+    IfModules => {
+      'mod_delay.c' => {
+        DelayEngine => 'off',
+      },
+
+      'mod_snmp.c' => {
+        SNMPAgent => "master 127.0.0.1:$agent_port",
+        SNMPCommunity => $snmp_community,
+        SNMPEngine => 'on',
+        SNMPLog => $log_file,
+        SNMPTables => $table_dir,
+
+        SNMPNotify => "127.0.0.1:$trap_port",
+        SNMPNotifyRateLimit => '1 60',
+      },
+    },
+  };
+
+  my ($port, $config_user, $config_group) = config_write($config_file, $config);
+
+  # Open pipes, for use between the parent and child processes.  Specifically,
+  # the child will indicate when it's done with its test by writing a message
+  # to the parent.
+  my ($rfh, $wfh);
+  unless (pipe($rfh, $wfh)) {
+    die("Can't open pipe: $!");
+  }
+
+  require Net::SNMP;
+
+  my $ex;
+
+  # Fork child
+  $self->handle_sigchld();
+  defined(my $pid = fork()) or die("Can't fork: $!");
+  if ($pid) {
+    eval {
+      # Three failed logins, but only one notification allowed per minute.
+      for (my $i = 0; $i < 3; $i++) {
+        fail_login($port, $user, 'foo');
+      }
+
+      my $notifys = recv_notifys($trap_sock, 3);
+
+      my $count = scalar(@$notifys);
+      my $expected = 1;
+      $self->assert($count == $expected,
+        test_msg("Expected $expected notification, got $count"));
+
+      $self->assert(notify_has_oid($notifys->[0], $notify_oid),
+        test_msg("Expected loginFailedBadPassword notification"));
+
+      my ($suppressed) = get_snmp_values($agent_port, $snmp_community,
+        [$suppressed_oid]);
+
+      $expected = 2;
+      $self->assert($suppressed == $expected,
+        test_msg("Expected trapsSuppressedTotal $expected, got $suppressed"));
+    };
+
+    if ($@) {
+      $ex = $@;
+    }
+
+    $wfh->print("done\n");
+    $wfh->flush();
+
+  } else {
+    eval { server_wait($config_file, $rfh, $timeout_idle) };
+    if ($@) {
+      warn($@);
+      exit 1;
+    }
+
+    exit 0;
+  }
+
+  # Stop server
+  server_stop($pid_file);
+
+  $self->assert_child_ok($pid);
+
+  $trap_sock->close();
+
+  if ($ex) {
+    test_append_logfile($log_file, $ex);
+    unlink($log_file);
+
+    die($ex);
+  }
+
+  unlink($log_file);
+}
+
+sub snmp_notify_threshold {
+  my $self = shift;
+  my $tmpdir = $self->{tmpdir};
+
+  my $config_file = "$tmpdir/snmp.conf";
+  my $pid_file = File::Spec->rel2abs("$tmpdir/snmp.pid");
+  my $scoreboard_file = File::Spec->rel2abs("$tmpdir/snmp.scoreboard");
+
+  my $log_file = test_get_logfile();
+
+  my $auth_user_file = File::Spec->rel2abs("$tmpdir/snmp.passwd");
+  my $auth_group_file = File::Spec->rel2abs("$tmpdir/snmp.group");
+
+  my $user = 'proftpd';
+  my $passwd = 'test';
+  my $group = 'ftpd';
+  my $home_dir = File::Spec->rel2abs($tmpdir);
+  my $uid = 500;
+  my $gid = 500;
+
+  my $table_dir = File::Spec->rel2abs("$tmpdir/var/snmp");
+
+  # Make sure that, if we're running as root, that the home directory has
+  # permissions/privs set for the account we create
+  if ($< == 0) {
+    unless (chmod(0755, $home_dir, $table_dir)) {
+      die("Can't set perms on $home_dir to 0755: $!");
+    }
+
+    unless (chown($uid, $gid, $home_dir, $table_dir)) {
+      die("Can't set owner of $home_dir to $uid/$gid: $!");
+    }
+  }
+
+  auth_user_write($auth_user_file, $user, $passwd, $uid, $gid, $home_dir,
+    '/bin/bash');
+  auth_group_write($auth_group_file, $group, $gid, $user);
+
+  my $agent_port = ProFTPD::TestSuite::Utils::get_high_numbered_port();
+  my $snmp_community = "public";
+
+  my $trap_port = ProFTPD::TestSuite::Utils::get_high_numbered_port();
+  my $trap_sock = IO::Socket::INET->new(
+    LocalAddr => '127.0.0.1',
+    LocalPort => $trap_port,
+    Proto => 'udp',
+  );
+  unless ($trap_sock) {
+    die("Can't listen on 127.0.0.1#$trap_port: $!");
+  }
+
+  my $timeout_idle = 45;
+
+  # thresholdExceeded
+  my $notify_oid = '1.3.6.1.4.1.17852.2.2.1.13.3.0';
+
+  my $config = {
+    TraceLog => $log_file,
+    Trace => 'snmp:20 snmp.asn1:20 snmp.db:20 snmp.msg:20 snmp.pdu:20 snmp.smi:20',
+    PidFile => $pid_file,
+    ScoreboardFile => $scoreboard_file,
+    SystemLog => $log_file,
+
+    AuthUserFile => $auth_user_file,
+    AuthGroupFile => $auth_group_file,
+    TimeoutIdle => $timeout_idle + 1,
+
+    IfModules => {
+      'mod_delay.c' => {
+        DelayEngine => 'off',
+      },
+
+      'mod_snmp.c' => {
+        SNMPAgent => "master 127.0.0.1:$agent_port",
+        SNMPCommunity => $snmp_community,
+        SNMPEngine => 'on',
+        SNMPLog => $log_file,
+        SNMPTables => $table_dir,
+
+        SNMPNotify => "127.0.0.1:$trap_port",
+        SNMPNotifyThreshold => 'ftp.sessions.sessionCount > 0',
+      },
+    },
+  };
+
+  my ($port, $config_user, $config_group) = config_write($config_file, $config);
+
+  # Open pipes, for use between the parent and child processes.  Specifically,
+  # the child will indicate when it's done with its test by writing a message
+  # to the parent.
+  my ($rfh, $wfh);
+  unless (pipe($rfh, $wfh)) {
+    die("Can't open pipe: $!");
+  }
+
+  require Net::SNMP;
+
+  my $ex;
+
+  # Fork child
+  $self->handle_sigchld();
+  defined(my $pid = fork()) or die("Can't fork: $!");
+  if ($pid) {
+    eval {
+      my $client = ProFTPD::TestSuite::FTP->new('127.0.0.1', $port);
+      $client->login($user, $passwd);
+
+      # Thresholds are checked on the agent's notification poll, every 5
+      # seconds; stay logged in until then.
+      my $notifys = recv_notifys($trap_sock, 7);
+
+      $client->quit();
+
+      my $count = scalar(@$notifys);
+      my $expected = 1;
+      $self->assert($count == $expected,
+        test_msg("Expected $expected notification, got $count"));
+
+      $self->assert(notify_has_oid($notifys->[0], $notify_oid),
+        test_msg("Expected thresholdExceeded notification"));
+    };
+
+    if ($@) {
+      $ex = $@;
+    }
+
+    $wfh->print("done\n");
+    $wfh->flush();
+
+  } else {
+    eval { server_wait($config_file, $rfh, $timeout_idle) };
+    if ($@) {
+      warn($@);
+      exit 1;
+    }
+
+    exit 0;
+  }
+
+  # Stop server
+  server_stop($pid_file);
+
+  $self->assert_child_ok($pid);
+
+  $trap_sock->close();
+
+  if ($ex) {
+    test_append_logfile($log_file, $ex);
+    unlink($log_file);
+
+    die($ex);
+  }
+
+  unlink($log_file);
+}
+
+sub snmp_notify_inform {
+  my $self = shift;
+  my $tmpdir = $self->{tmpdir};
+
+  my $config_file = "$tmpdir/snmp.conf";
+  my $pid_file = File::Spec->rel2abs("$tmpdir/snmp.pid");
+  my $scoreboard_file = File::Spec->rel2abs("$tmpdir/snmp.scoreboard");
+
+  my $log_file = test_get_logfile();
+
+  my $auth_user_file = File::Spec->rel2abs("$tmpdir/snmp.passwd");
+  my $auth_group_file = File::Spec->rel2abs("$tmpdir/snmp.group");
+
+  my $user = 'proftpd';
+  my $passwd = 'test';
+  my $group = 'ftpd';
+  my $home_dir = File::Spec->rel2abs($tmpdir);
+  my $uid = 500;
+  my $gid = 500;
+
+  my $table_dir = File::Spec->rel2abs("$tmpdir/var/snmp");
+
+  # Make sure that, if we're running as root, that the home directory has
+  # permissions/privs set for the account we create
+  if ($< == 0) {
+    unless (chmod(0755, $home_dir, $table_dir)) {
+      die("Can't set perms on $home_dir to 0755: $!");
+    }
+
+    unless (chown($uid, $gid, $home_dir, $table_dir)) {
+      die("Can't set owner of $home_dir to $uid/$gid: $!");
+    }
+  }
+
+  auth_user_write($auth_user_file, $user, $passwd, $uid, $gid, $home_dir,
+    '/bin/bash');
+  auth_group_write($auth_group_file, $group, $gid, $user);
+
+  my $agent_port = ProFTPD::TestSuite::Utils::get_high_numbered_port();
+  my $snmp_community = "public";
+
+  my $trap_port = ProFTPD::TestSuite::Utils::get_high_numbered_port();
+  my $trap_sock = IO::Socket::INET->new(
+    LocalAddr => '127.0.0.1',
+    LocalPort => $trap_port,
+    Proto => 'udp',
+  );
+  unless ($trap_sock) {
+    die("Can't listen on 127.0.0.1#$trap_port: $!");
+  }
+
+  my $timeout_idle = 45;
+
+  # snmp.informsPendingCount, snmp.informsAckedTotal
+  my $pending_oid = '1.3.6.1.4.1.17852.2.2.4.21.0';
+  my $acked_oid = '1.3.6.1.4.1.17852.2.2.4.23.0';
+
+  my $config = {
+    TraceLog => $log_file,
+    Trace => 'snmp:20 snmp.asn1:20 snmp.db:20 snmp.msg:20 snmp.pdu:20 snmp.smi:20',
+    PidFile => $pid_file,
+    ScoreboardFile => $scoreboard_file,
+    SystemLog => $log_file,
+
+    AuthUserFile => $auth_user_file,
+    AuthGroupFile => $auth_group_file,
+    TimeoutIdle => $timeout_idle + 1,
+
+    IfModules => {
+      'mod_delay.c' => {
+        DelayEngine => 'off',
+      },
+
+      'mod_snmp.c' => {
+        SNMPAgent => "master 127.0.0.1:$agent_port",
+        SNMPCommunity => $snmp_community,
+        SNMPEngine => 'on',
+        SNMPLog => $log_file,
+        SNMPTables => $table_dir,
+
+        SNMPNotify => "127.0.0.1:$trap_port Inform",
+      },
+    },
+  };
+
+  my ($port, $config_user, $config_group) = config_write($config_file, $config);
+
+  # Open pipes, for use between the parent and child processes.  Specifically,
+  # the child will indicate when it's done with its test by writing a message
+  # to the parent.
+  my ($rfh, $wfh);
+  unless (pipe($rfh, $wfh)) {
+    die("Can't open pipe: $!");
+  }
+
+  require Net::SNMP;
+
+  my $ex;
+
+  # Fork child
+  $self->handle_sigchld();
+  defined(my $pid = fork()) or die("Can't fork: $!");
+  if ($pid) {
+    eval {
+      fail_login($port, $user, 'foo');
+
+      my $sel = IO::Select->new($trap_sock);
+      unless ($sel->can_read(5)) {
+        die("No InformRequest received");
+      }
+
+      my $pkt;
+      my $peer = $trap_sock->recv($pkt, 8192);
+      unless (defined($peer)) {
+        die("Can't receive InformRequest: $!");
+      }
+
+      my $offset = get_notify_pdu_offset($pkt);
+      my $pdu_type = ord(substr($pkt, $offset, 1));
+
+      my $expected = 0xa6;
+      $self->assert($pdu_type == $expected,
+        test_msg(sprintf("Expected PDU type 0x%02x, got 0x%02x", $expected,
+          $pdu_type)));
+
+      # Acknowledge the InformRequest by sending it back as a Response.
+      substr($pkt, $offset, 1, chr(0xa2));
+      unless ($trap_sock->send($pkt, 0, $peer)) {
+        die("Can't send Response: $!");
+      }
+
+      sleep(1);
+
+      my ($pending, $acked) = get_snmp_values($agent_port, $snmp_community,
+        [$pending_oid, $acked_oid]);
+
+      $expected = 1;
+      $self->assert($acked == $expected,
+        test_msg("Expected informsAckedTotal $expected, got $acked"));
+
+      $expected = 0;
+      $self->assert($pending == $expected,
+        test_msg("Expected informsPendingCount $expected, got $pending"));
+    };
+
+    if ($@) {
+      $ex = $@;
+    }
+
+    $wfh->print("done\n");
+    $wfh->flush();
+
+  } else {
+    eval { server_wait($config_file, $rfh, $timeout_idle) };
+    if ($@) {
+      warn($@);
+      exit 1;
+    }
+
+    exit 0;
+  }
+
+  # Stop server
+  server_stop($pid_file);
+
+  $self->assert_child_ok($pid);
+
+  $trap_sock->close();
+
+  if ($ex) {
+    test_append_logfile($log_file, $ex);
+    unlink($log_file);
+
+    die($ex);
+  }
+
+  unlink($log_file);
+}
+
+sub snmp_notify_filters {
+  my $self = shift;
+  my $tmpdir = $self->{tmpdir};
+
+  my $config_file = "$tmpdir/snmp.conf";
+  my $pid_file = File::Spec->rel2abs("$tmpdir/snmp.pid");
+  my $scoreboard_file = File::Spec->rel2abs("$tmpdir/snmp.scoreboard");
+
+  my $log_file = test_get_logfile();
+
+  my $auth_user_file = File::Spec->rel2abs("$tmpdir/snmp.passwd");
+  my $auth_group_file = File::Spec->rel2abs("$tmpdir/snmp.group");
+
+  my $user = 'proftpd';
+  my $passwd = 'test';
+  my $group = 'ftpd';
+  my $home_dir = File::Spec->rel2abs($tmpdir);
+  my $uid = 500;
+  my $gid = 500;
+
+  my $table_dir = File::Spec->rel2abs("$tmpdir/var/snmp");
+
+  # Make sure that, if we're running as root, that the home directory has
+  # permissions/privs set for the account we create
+  if ($< == 0) {
+    unless (chmod(0755, $home_dir, $table_dir)) {
+      die("Can't set perms on $home_dir to 0755: $!");
+    }
+
+    unless (chown($uid, $gid, $home_dir, $table_dir)) {
+      die("Can't set owner of $home_dir to $uid/$gid: $!");
+    }
+  }
+
+  auth_user_write($auth_user_file, $user, $passwd, $uid, $gid, $home_dir,
+    '/bin/bash');
+  auth_group_write($auth_group_file, $group, $gid, $user);
+
+  my $agent_port = ProFTPD::TestSuite::Utils::get_high_numbered_port();
+  my $snmp_community = "public";
+
+  # One receiver for each kind of filter, and one for both.
+  my $trap_ports = [];
+  my $trap_socks = [];
+
+  for (my $i = 0; $i < 3; $i++) {
+    my $trap_port = ProFTPD::TestSuite::Utils::get_high_numbered_port();
+    my $trap_sock = IO::Socket::INET->new(
+      LocalAddr => '127.0.0.1',
+      LocalPort => $trap_port,
+      Proto => 'udp',
+    );
+    unless ($trap_sock) {
+      die("Can't listen on 127.0.0.1#$trap_port: $!");
+    }
+
+    push(@$trap_ports, $trap_port);
+    push(@$trap_socks, $trap_sock);
+  }
+
+  my $timeout_idle = 45;
+
+  # loginFailedBadPassword, loginFailedBadUser
+  my $bad_passwd_oid = '1.3.6.1.4.1.17852.2.2.3.5.1.0';
+  my $bad_user_oid = '1.3.6.1.4.1.17852.2.2.3.5.2.0';
+
+  my $config = {
+    TraceLog => $log_file,
+    Trace => 'snmp:20 snmp.asn1:20 snmp.db:20 snmp.msg:20 snmp.pdu:20 snmp.smi:20',
+    PidFile => $pid_file,
+    ScoreboardFile => $scoreboard_file,
+    SystemLog => $log_file,
+
+    AuthUserFile => $auth_user_file,
+    AuthGroupFile => $auth_group_file,
+    TimeoutIdle => $timeout_idle + 1,
+
+    IfModules => {
+      'mod_delay.c' => {
+        DelayEngine => 'off',
+      },
+
+      'mod_snmp.c' => [
+        "SNMPAgent master 127.0.0.1:$agent_port",
+        "SNMPCommunity $snmp_community",
+        'SNMPEngine on',
+        "SNMPLog $log_file",
+        "SNMPTables $table_dir",
+
+        "SNMPNotify 127.0.0.1:$trap_ports->[0] Notifications " .
+          "loginFailedBadUser",
+        "SNMPNotify 127.0.0.1:$trap_ports->[1] Severity critical",
+        "SNMPNotify 127.0.0.1:$trap_ports->[2] Notifications " .
+          "loginFailedBadPassword,loginFailedBadUser Severity warning",
+      ],
+    },
+  };
+
+  my ($port, $config_user, $config_group) = config_write($config_file, $config);
+
+  # Open pipes, for use between the parent and child processes.  Specifically,
+  # the child will indicate when it's done with its test by writing a message
+  # to the parent.
+  my ($rfh, $wfh);
+  unless (pipe($rfh, $wfh)) {
+    die("Can't open pipe: $!");
+  }
+
+  require Net::SNMP;
+
+  my $ex;
+
+  # Fork child
+  $self->handle_sigchld();
+  defined(my $pid = fork()) or die("Can't fork: $!");
+  if ($pid) {
+    eval {
+      fail_login($port, $user, 'foo');
+      fail_login($port, 'nosuchuser', 'foo');
+
+      # The first receiver only wants loginFailedBadUser notifications.
+      my $notifys = recv_notifys($trap_socks->[0], 3);
+
+      my $count = scalar(@$notifys);
+      my $expected = 1;
+      $self->assert($count == $expected,
+        test_msg("Expected $expected notification, got $count"));
+
+      $self->assert(notify_has_oid($notifys->[0], $bad_user_oid),
+        test_msg("Expected loginFailedBadUser notification"));
+
+      # Failed logins are only warnings, too low for the second receiver.
+      $notifys = recv_notifys($trap_socks->[1], 1);
+
+      $count = scalar(@$notifys);
+      $expected = 0;
+      $self->assert($count == $expected,
+        test_msg("Expected $expected notifications, got $count"));
+
+      # The third receiver wants both.
+      $notifys = recv_notifys($trap_socks->[2], 1);
+
+      $count = scalar(@$notifys);
+      $expected = 2;
+      $self->assert($count == $expected,
+        test_msg("Expected $expected notifications, got $count"));
+
+      $self->assert(notify_has_oid($notifys->[0], $bad_passwd_oid),
+        test_msg("Expected loginFailedBadPassword notification"));
+
+      $self->assert(notify_has_oid($notifys->[1], $bad_user_oid),
+        test_msg("Expected loginFailedBadUser notification"));
+    };
+
+    if ($@) {
+      $ex = $@;
+    }
+
+    $wfh->print("done\n");
+    $wfh->flush();
+
+  } else {
+    eval { server_wait($config_file, $rfh, $timeout_idle) };
+    if ($@) {
+      warn($@);
+      exit 1;
+    }
+
+    exit 0;
+  }
+
+  # Stop server
+  server_stop($pid_file);
+
+  $self->assert_child_ok($pid);
+
+  foreach my $trap_sock (@$trap_socks) {
+    $trap_sock->close();
+  }
+
+  if ($ex) {
+    test_append_logfile($log_file, $ex);
+    unlink($log_file);
+
+    die($ex);
+  }
+
+  unlink($log_file);
+}
+
+sub snmp_notify_local {
+  my $self = shift;
+  my $tmpdir = $self->{tmpdir};
+
+  my $config_file = "$tmpdir/snmp.conf";
+  my $pid_file = File::Spec->rel2abs("$tmpdir/snmp.pid");
+  my $scoreboard_file = File::Spec->rel2abs("$tmpdir/snmp.scoreboard");
+
+  my $log_file = test_get_logfile();
+
+  my $auth_user_file = File::Spec->rel2abs("$tmpdir/snmp.passwd");
+  my $auth_group_file = File::Spec->rel2abs("$tmpdir/snmp.group");
+
+  my $user = 'proftpd';
+  my $passwd = 'test';
+  my $group = 'ftpd';
+  my $home_dir = File::Spec->rel2abs($tmpdir);
+  my $uid = 500;
+  my $gid = 500;
+
+  my $table_dir = File::Spec->rel2abs("$tmpdir/var/snmp");
+
+  # Make sure that, if we're running as root, that the home directory has
+  # permissions/privs set for the account we create
+  if ($< == 0) {
+    unless (chmod(0755, $home_dir, $table_dir)) {
+      die("Can't set perms on $home_dir to 0755: $!");
+    }
+
+    unless (chown($uid, $gid, $home_dir, $table_dir)) {
+      die("Can't set owner of $home_dir to $uid/$gid: $!");
+    }
+  }
+
+  auth_user_write($auth_user_file, $user, $passwd, $uid, $gid, $home_dir,
+    '/bin/bash');
+  auth_group_write($auth_group_file, $group, $gid, $user);
+
+  my $agent_port = ProFTPD::TestSuite::Utils::get_high_numbered_port();
+  my $snmp_community = "public";
+
+  # The agent connects to local receivers when it starts, so the receiver
+  # must be listening first.
+  my $notify_path = File::Spec->rel2abs("$tmpdir/notify.sock");
+  my $notify_sock = IO::Socket::UNIX->new(
+    Local => $notify_path,
+    Type => SOCK_DGRAM,
+  );
+  unless ($notify_sock) {
+    die("Can't listen on $notify_path: $!");
+  }
+
+  my $timeout_idle = 45;
+
+  my $config = {
+    TraceLog => $log_file,
+    Trace => 'snmp:20 snmp.asn1:20 snmp.db:20 snmp.msg:20 snmp.pdu:20 snmp.smi:20',
+    PidFile => $pid_file,
+    ScoreboardFile => $scoreboard_file,
+    SystemLog => $log_file,
+
+    AuthUserFile => $auth_user_file,
+    AuthGroupFile => $auth_group_file,
+    TimeoutIdle => $timeout_idle + 1,
+
+    IfModules => {
+      'mod_delay.c' => {
+        DelayEngine => 'off',
+      },
+
+      'mod_snmp.c' => {
+        SNMPAgent => "master 127.0.0.1:$agent_port",
+        SNMPCommunity => $snmp_community,
+        SNMPEngine => 'on',
+        SNMPLog => $log_file,
+        SNMPTables => $table_dir,
+
+        SNMPNotify => $notify_path,
+      },
+    },
+  };
+
+  my ($port, $config_user, $config_group) = config_write($config_file, $config);
+
+  # Open pipes, for use between the parent and child processes.  Specifically,
+  # the child will indicate when it's done with its test by writing a message
+  # to the parent.
+  my ($rfh, $wfh);
+  unless (pipe($rfh, $wfh)) {
+    die("Can't open pipe: $!");
+  }
+
+  require Net::SNMP;
+
+  my $ex;
+
+  # Fork child
+  $self->handle_sigchld();
+  defined(my $pid = fork()) or die("Can't fork: $!");
+  if ($pid) {
+    eval {
+      fail_login($port, $user, 'foo');
+
+      my $notifys = recv_notifys($notify_sock, 3);
+
+      my $count = scalar(@$notifys);
+      my $expected = 1;
+      $self->assert($count == $expected,
+        test_msg("Expected $expected notification, got $count"));
+
+      # The record is a struct snmp_notify_local, in host byte order; the
+      # user name follows the server name and addresses.
+      my $record = $notifys->[0];
+      $self->assert(length($record) >= 256,
+        test_msg("Expected notification record, got " . length($record) .
+          " bytes"));
+
+      my ($version, $notify_id) = unpack('LL', $record);
+
+      $expected = 2;
+      $self->assert($version == $expected,
+        test_msg("Expected record version $expected, got $version"));
+
+      # loginFailedBadPassword
+      $expected = 1000;
+      $self->assert($notify_id == $expected,
+        test_msg("Expected notification ID $expected, got $notify_id"));
+
+      my $user_name = unpack('Z64', substr($record, 192, 64));
+      $self->assert($user_name eq $user,
+        test_msg("Expected user name '$user', got '$user_name'"));
+    };
+
+    if ($@) {
+      $ex = $@;
+    }
+
+    $wfh->print("done\n");
+    $wfh->flush();
+
+  } else {
+    eval { server_wait($config_file, $rfh, $timeout_idle) };
+    if ($@) {
+      warn($@);
+      exit 1;
+    }
+
+    exit 0;
+  }
+
+  # Stop server
+  server_stop($pid_file);
+
+  $self->assert_child_ok($pid);
+
+  $notify_sock->close();
+  unlink($notify_path);
+
+  if ($ex) {
+    test_append_logfile($log_file, $ex);
+    unlink($log_file);
+
+    die($ex);
+  }
+
+  unlink($log_file);
+}
+
+sub snmp_notify_throughput {
+  my $self = shift;
+  my $tmpdir = $self->{tmpdir};
+
+  my $config_file = "$tmpdir/snmp.conf";
+  my $pid_file = File::Spec->rel2abs("$tmpdir/snmp.pid");
+  my $scoreboard_file = File::Spec->rel2abs("$tmpdir/snmp.scoreboard");
+
+  my $log_file = test_get_logfile();
+
+  my $auth_user_file = File::Spec->rel2abs("$tmpdir/snmp.passwd");
+  my $auth_group_file = File::Spec->rel2abs("$tmpdir/snmp.group");
+
+  my $user = 'proftpd';
+  my $passwd = 'test';
+  my $group = 'ftpd';
+  my $home_dir = File::Spec->rel2abs($tmpdir);
+  my $uid = 500;
+  my $gid = 500;
+
+  my $table_dir = File::Spec->rel2abs("$tmpdir/var/snmp");
+
+  # Make sure that, if we're running as root, that the home directory has
+  # permissions/privs set for the account we create
+  if ($< == 0) {
+    unless (chmod(0755, $home_dir, $table_dir)) {
+      die("Can't set perms on $home_dir to 0755: $!");
+    }
+
+    unless (chown($uid, $gid, $home_dir, $table_dir)) {
+      die("Can't set owner of $home_dir to $uid/$gid: $!");
+    }
+  }
+
+  auth_user_write($auth_user_file, $user, $passwd, $uid, $gid, $home_dir,
+    '/bin/bash');
+  auth_group_write($auth_group_file, $group, $gid, $user);
+
+  my $agent_port = ProFTPD::TestSuite::Utils::get_high_numbered_port();
+  my $snmp_community = "public";
+
+  my $trap_port = ProFTPD::TestSuite::Utils::get_high_numbered_port();
+  my $trap_sock = IO::Socket::INET->new(
+    LocalAddr => '127.0.0.1',
+    LocalPort => $trap_port,
+    Proto => 'udp',
+  );
+  unless ($trap_sock) {
+    die("Can't listen on 127.0.0.1#$trap_port: $!");
+  }
+
+  my $timeout_idle = 45;
+
+  my $config = {
+    TraceLog => $log_file,
+    Trace => 'snmp:20 snmp.asn1:20 snmp.db:20 snmp.msg:20 snmp.pdu:20 snmp.smi:20',
+    PidFile => $pid_file,
+    ScoreboardFile => $scoreboard_file,
+    SystemLog => $log_file,
+
+    AuthUserFile => $auth_user_file,
+    AuthGroupFile => $auth_group_file,
+    TimeoutIdle => $timeout_idle + 1,
+
+    IfModules => {
+      'mod_delay.c' => {
+        DelayEngine => 'off',
+      },
+
+      'mod_snmp.c' => {
+        SNMPAgent => "master 127.0.0.1:$agent_port",
+        SNMPCommunity => $snmp_community,
+        SNMPEngine => 'on',
+        SNMPLog => $log_file,
+        SNMPTables => $table_dir,
+
+        SNMPNotify => "127.0.0.1:$trap_port",
+        SNMPNotifyThroughput => '0.5',
+      },
+    },
+  };
+
+  my ($port, $config_user, $config_group) = config_write($config_file, $config);
+
+  # Open pipes, for use between the parent and child processes.  Specifically,
+  # the child will indicate when it's done with its test by writing a message
+  # to the parent.
+  my ($rfh, $wfh);
+  unless (pipe($rfh, $wfh)) {
+    die("Can't open pipe: $!");
+  }
+
+  require Net::SNMP;
+
+  my $ex;
+
+  # Fork child
+  $self->handle_sigchld();
+  defined(my $pid = fork()) or die("Can't fork: $!");
+  if ($pid) {
+    eval {
+      # Transfers large enough to be sampled.
+      my $file_kb_len = 300;
+      my $nfiles = 3;
+
+      for (my $i = 0; $i < $nfiles; $i++) {
+        upload_file($port, $user, $passwd, "test$i.txt", $file_kb_len);
+      }
+
+      my ($file_count, $file_total, $kb_count) = get_ftp_xfer_upload_info(
+        $agent_port, $snmp_community);
+
+      my $expected = $nfiles;
+      $self->assert($file_total == $expected,
+        test_msg("Expected upload file total $expected, got $file_total"));
+
+      # There is no baseline yet, so throughput cannot have degraded.
+      my $notifys = recv_notifys($trap_sock, 7);
+
+      my $count = scalar(@$notifys);
+      $expected = 0;
+      $self->assert($count == $expected,
+        test_msg("Expected $expected notifications, got $count"));
+    };
+
+    if ($@) {
+      $ex = $@;
+    }
+
+    $wfh->print("done\n");
+    $wfh->flush();
+
+  } else {
+    eval { server_wait($config_file, $rfh, $timeout_idle) };
+    if ($@) {
+      warn($@);
+      exit 1;
+    }
+
+    exit 0;
+  }
+
+  # Stop server
+  server_stop($pid_file);
+
+  $self->assert_child_ok($pid);
+
+  $trap_sock->close();
+
+  if ($ex) {
+    test_append_logfile($log_file, $ex);
+    unlink($log_file);
+
+    die($ex);
+  }
+
+  unlink($log_file);
+}
+
+sub snmp_config_notify_throughput_bad {
+  my $self = shift;
+  my $tmpdir = $self->{tmpdir};
+
+  my $config_file = "$tmpdir/snmp.conf";
+  my $pid_file = File::Spec->rel2abs("$tmpdir/snmp.pid");
+  my $scoreboard_file = File::Spec->rel2abs("$tmpdir/snmp.scoreboard");
+
+  my $log_file = test_get_logfile();
+
+  my $auth_user_file = File::Spec->rel2abs("$tmpdir/snmp.passwd");
+  my $auth_group_file = File::Spec->rel2abs("$tmpdir/snmp.group");
+
+  my $user = 'proftpd';
+  my $passwd = 'test';
+  my $group = 'ftpd';
+  my $home_dir = File::Spec->rel2abs($tmpdir);
+  my $uid = 500;
+  my $gid = 500;
+
+  my $table_dir = File::Spec->rel2abs("$tmpdir/var/snmp");
+
+  # Make sure that, if we're running as root, that the home directory has
+  # permissions/privs set for the account we create
+  if ($< == 0) {
+    unless (chmod(0755, $home_dir, $table_dir)) {
+      die("Can't set perms on $home_dir to 0755: $!");
+    }
+
+    unless (chown($uid, $gid, $home_dir, $table_dir)) {
+      die("Can't set owner of $home_dir to $uid/$gid: $!");
+    }
+  }
+
+  auth_user_write($auth_user_file, $user, $passwd, $uid, $gid, $home_dir,
+    '/bin/bash');
+  auth_group_write($auth_group_file, $group, $gid, $user);
+
+  my $agent_port = ProFTPD::TestSuite::Utils::get_high_numbered_port();
+  my $snmp_community = "public";
+
+  foreach my $fraction (qw(0 1.5)) {
+    my $config = {
+      TraceLog => $log_file,
+      Trace => 'snmp:20 snmp.asn1:20 snmp.db:20 snmp.msg:20 snmp.pdu:20 snmp.smi:20',
+      PidFile => $pid_file,
+      ScoreboardFile => $scoreboard_file,
+      SystemLog => $log_file,
+
+      AuthUserFile => $auth_user_file,
+      AuthGroupFile => $auth_group_file,
+
+      IfModules => {
+        'mod_delay.c' => {
+          DelayEngine => 'off',
+        },
+
+        'mod_snmp.c' => {
+          SNMPAgent => "master 127.0.0.1:$agent_port",
+          SNMPCommunity => $snmp_community,
+          SNMPEngine => 'on',
+          SNMPLog => $log_file,
+          SNMPTables => $table_dir,
+
+          SNMPNotifyThroughput => $fraction,
+        },
+      },
+    };
+
+    my ($port, $config_user, $config_group) = config_write($config_file,
+      $config);
+
+    # The fraction is out of range, so the server should fail to start.
+    eval { server_start($config_file) };
+    unless ($@) {
+      eval { server_stop($pid_file) };
+
+      my $ex = "Server started unexpectedly with SNMPNotifyThroughput " .
+        $fraction;
+      test_append_logfile($log_file, $ex);
+      unlink($log_file);
+
+      die($ex);
+    }
+  }
+
+  unlink($log_file);
+}
+
+sub snmp_v2_get_empty_oid {
+  my $self = shift;
+  my $tmpdir = $self->{tmpdir};
+
+  my $config_file = "$tmpdir/snmp.conf";
+  my $pid_file = File::Spec->rel2abs("$tmpdir/snmp.pid");
+  my $scoreboard_file = File::Spec->rel2abs("$tmpdir/snmp.scoreboard");
+
+  my $log_file = test_get_logfile();
+
+  my $auth_user_file = File::Spec->rel2abs("$tmpdir/snmp.passwd");
+  my $auth_group_file = File::Spec->rel2abs("$tmpdir/snmp.group");
+
+  my $user = 'proftpd';
+  my $passwd = 'test';
+  my $group = 'ftpd';
+  my $home_dir = File::Spec->rel2abs($tmpdir);
+  my $uid = 500;
+  my $gid = 500;
+
+  my $table_dir = File::Spec->rel2abs("$tmpdir/var/snmp");
+
+  # Make sure that, if we're running as root, that the home directory has
+  # permissions/privs set for the account we create
+  if ($< == 0) {
+    unless (chmod(0755, $home_dir, $table_dir)) {
+      die("Can't set perms on $home_dir to 0755: $!");
+    }
+
+    unless (chown($uid, $gid, $home_dir, $table_dir)) {
+      die("Can't set owner of $home_dir to $uid/$gid: $!");
+    }
+  }
+
+  auth_user_write($auth_user_file, $user, $passwd, $uid, $gid, $home_dir,
+    '/bin/bash');
+  auth_group_write($auth_group_file, $group, $gid, $user);
+
+  my $agent_port = ProFTPD::TestSuite::Utils::get_high_numbered_port();
+  my $snmp_community = "public";
+
+  my $config = {
+    TraceLog => $log_file,
+    Trace => 'snmp:20 snmp.asn1:20 snmp.db:20 snmp.msg:20 snmp.pdu:20 snmp.smi:20',
+    PidFile => $pid_file,
+    ScoreboardFile => $scoreboard_file,
+    SystemLog => $log_file,
+
+    AuthUserFile => $auth_user_file,
+    AuthGroupFile => $auth_group_file,
+
+    IfModules => {
+      'mod_delay.c' => {
+        DelayEngine => 'off',
+      },
+
+      'mod_snmp.c' => {
+        SNMPAgent => "master 127.0.0.1:$agent_port",
+        SNMPCommunity => $snmp_community,
+        SNMPEngine => 'on',
+        SNMPLog => $log_file,
+        SNMPTables => $table_dir,
+      },
+    },
+  };
+
+  my ($port, $config_user, $config_group) = config_write($config_file, $config);
+
+  # Open pipes, for use between the parent and child processes.  Specifically,
+  # the child will indicate when it's done with its test by writing a message
+  # to the parent.
+  my ($rfh, $wfh);
+  unless (pipe($rfh, $wfh)) {
+    die("Can't open pipe: $!");
+  }
+
+  require Net::SNMP;
+
+  my $ex;
+
+  # Fork child
+  $self->handle_sigchld();
+  defined(my $pid = fork()) or die("Can't fork: $!");
+  if ($pid) {
+    eval {
+      # Net::SNMP will not send an empty OID, so build the GetRequest by
+      # hand: SNMPv2c, community "public", request ID 42, and a single
+      # variable whose name is the empty OID (06 00).
+      my $req = pack('C*',
+        0x30, 0x1e,
+          0x02, 0x01, 0x01,
+          0x04, 0x06) . $snmp_community . pack('C*',
+          0xa0, 0x11,
+            0x02, 0x01, 0x2a,
+            0x02, 0x01, 0x00,
+            0x02, 0x01, 0x00,
+            0x30, 0x06,
+              0x30, 0x04,
+                0x06, 0x00,
+                0x05, 0x00);
+
+      my $sock = IO::Socket::INET->new(
+        PeerAddr => '127.0.0.1',
+        PeerPort => $agent_port,
+        Proto => 'udp',
+      );
+      unless ($sock) {
+        die("Can't connect to 127.0.0.1#$agent_port: $!");
+      }
+
+      unless ($sock->send($req)) {
+        die("Can't send GetRequest: $!");
+      }
+
+      my $sel = IO::Select->new($sock);
+      unless ($sel->can_read(5)) {
+        die("No SNMP response received");
+      }
+
+      my $resp;
+      unless (defined($sock->recv($resp, 8192))) {
+        die("Can't receive Response: $!");
+      }
+
+      $sock->close();
+
+      my $offset = get_notify_pdu_offset($resp);
+      my $pdu_type = ord(substr($resp, $offset, 1));
+
+      my $expected = 0xa2;
+      $self->assert($pdu_type == $expected,
+        test_msg(sprintf("Expected PDU type 0x%02x, got 0x%02x", $expected,
+          $pdu_type)));
+
+      # The request ID follows the PDU header.
+      my ($len, $id_offset) = get_ber_len($resp, $offset + 1);
+      my $request_id = ord(substr($resp, $id_offset + 2, 1));
+
+      $expected = 42;
+      $self->assert($request_id == $expected,
+        test_msg("Expected request ID $expected, got $request_id"));
+    };
+
+    if ($@) {
+      $ex = $@;
+    }
+
+    $wfh->print("done\n");
+    $wfh->flush();
+
+  } else {
+    eval { server_wait($config_file, $rfh) };
+    if ($@) {
+      warn($@);
+      exit 1;
+    }
+
+    exit 0;
+  }
+
+  # Stop server
+  server_stop($pid_file);
+
+  $self->assert_child_ok($pid);
+
+  if ($ex) {
+    test_append_logfile($log_file, $ex);
+    unlink($log_file);
+
+    die($ex);
+  }
+
+  unlink($log_file);
+}
+
 1;
@@ -0,0 +1,494 @@
+/*
+ * ProFTPD - mod_snmp notification thresholds
+ * Copyright (c) 2013 TJ Saunders
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, TJ Saunders and other respective copyright holders
+ * give permission to link this program with OpenSSL, and distribute the
+ * resulting executable, without including the source code for OpenSSL in the
+ * source distribution.
+ *
+ * $Id$
+ */
+
+#include "mod_snmp.h"
+#include "smi.h"
+#include "mib.h"
+#include "db.h"
+#include "notify.h"
+#include "threshold.h"
+
+/* A compiled threshold, and its state. */
+struct snmp_threshold_rule {
+  const struct snmp_threshold *threshold;
+
+  /* Where this threshold's field is in the snapshot of values. */
+  unsigned int value_idx;
+
+  int exceeded;
+
+  /* For rate() thresholds, the previous value, and when it was read. */
+  int have_prev;
+  int32_t prev_value;
+  struct timeval prev_tv;
+};
+
+static pool *threshold_pool = NULL;
+
+static struct snmp_threshold_rule *threshold_rules = NULL;
+static unsigned int threshold_nrules = 0;
+
+/* The distinct fields used by the thresholds, sorted by table, and the
+ * buffer into which their values are read on each evaluation.
+ */
+static unsigned int *threshold_fields = NULL;
+static int32_t *threshold_values = NULL;
+static unsigned int threshold_nfields = 0;
+
+static const char *trace_channel = "snmp.threshold";
+
+static int parse_op(const char *op) {
+  if (strcmp(op, ">") == 0) {
+    return SNMP_THRESHOLD_OP_GT;
+  }
+
+  if (strcmp(op, ">=") == 0) {
+    return SNMP_THRESHOLD_OP_GE;
+  }
+
+  if (strcmp(op, "<") == 0) {
+    return SNMP_THRESHOLD_OP_LT;
+  }
+
+  if (strcmp(op, "<=") == 0) {
+    return SNMP_THRESHOLD_OP_LE;
+  }
+
+  return -1;
+}
+
+static int parse_value(const char *str, int32_t *value,
+    unsigned int *rate_secs) {
+  char *ptr = NULL;
+  long num;
+
+  num = strtol(str, &ptr, 10);
+  if (ptr == str ||
+      num < 0 ||
+      num > 0x7fffffffL) {
+    return -1;
+  }
+
+  *value = (int32_t) num;
+
+  if (*ptr == '\0') {
+    return 0;
+  }
+
+  if (rate_secs == NULL ||
+      *ptr != '/') {
+    return -1;
+  }
+
+  if (strcmp(ptr, "/s") == 0) {
+    *rate_secs = 1;
+
+  } else if (strcmp(ptr, "/m") == 0) {
+    *rate_secs = 60;
+
+  } else if (strcmp(ptr, "/h") == 0) {
+    *rate_secs = 3600;
+
+  } else {
+    return -1;
+  }
+
+  return 0;
+}
+
+struct snmp_threshold *snmp_threshold_parse(pool *p, const char *expr,
+    const char *op, const char *limit, const char *clear,
+    const char **errstr) {
+  struct snmp_threshold *threshold;
+  struct snmp_mib *mib;
+  const char *mib_name;
+  size_t exprlen;
+  int is_rate = FALSE;
+
+  if (p == NULL ||
+      expr == NULL ||
+      op == NULL ||
+      limit == NULL ||
+      errstr == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  threshold = pcalloc(p, sizeof(struct snmp_threshold));
+
+  mib_name = expr;
+  exprlen = strlen(expr);
+  if (strncmp(expr, "rate(", 5) == 0 &&
+      exprlen > 6 &&
+      expr[exprlen-1] == ')') {
+    mib_name = pstrndup(p, expr + 5, exprlen - 6);
+    is_rate = TRUE;
+  }
+
+  threshold->mib_idx = snmp_mib_get_idx_by_name(mib_name);
+  if (threshold->mib_idx < 0) {
+    *errstr = pstrcat(p, "unknown MIB '", mib_name, "'", NULL);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  /* Only the numeric values which the agent tracks (as opposed to the
+   * per-session values used in notifications) can have thresholds.
+   */
+  mib = snmp_mib_get_by_idx(threshold->mib_idx);
+  if (mib->notify_only == TRUE ||
+      (mib->smi_type != SNMP_SMI_COUNTER32 &&
+       mib->smi_type != SNMP_SMI_GAUGE32 &&
+       mib->smi_type != SNMP_SMI_INTEGER)) {
+    *errstr = pstrcat(p, "MIB '", mib_name,
+      "' cannot be used for thresholds", NULL);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  if (is_rate == TRUE &&
+      mib->smi_type != SNMP_SMI_COUNTER32) {
+    *errstr = pstrcat(p, "MIB '", mib_name,
+      "' is not a counter, and cannot be used with rate()", NULL);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  threshold->db_field = mib->db_field;
+
+  threshold->op = parse_op(op);
+  if (threshold->op < 0) {
+    *errstr = pstrcat(p, "unknown operator '", op, "'", NULL);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  if (parse_value(limit, &(threshold->limit),
+      is_rate ? &(threshold->rate_secs) : NULL) < 0) {
+    *errstr = pstrcat(p, "invalid limit '", limit, "'", NULL);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  if (is_rate == TRUE &&
+      threshold->rate_secs == 0) {
+    threshold->rate_secs = 1;
+  }
+
+  if (clear != NULL) {
+    if (parse_value(clear, &(threshold->clear), NULL) < 0) {
+      *errstr = pstrcat(p, "invalid clear value '", clear, "'", NULL);
+      errno = EINVAL;
+      return NULL;
+    }
+
+    if (((threshold->op == SNMP_THRESHOLD_OP_GT ||
+          threshold->op == SNMP_THRESHOLD_OP_GE) &&
+         threshold->clear > threshold->limit) ||
+        ((threshold->op == SNMP_THRESHOLD_OP_LT ||
+          threshold->op == SNMP_THRESHOLD_OP_LE) &&
+         threshold->clear < threshold->limit)) {
+      *errstr = pstrcat(p, "clear value '", clear,
+        "' must not be past the limit '", limit, "'", NULL);
+      errno = EINVAL;
+      return NULL;
+    }
+
+  } else {
+    /* By default, a threshold clears once the value is 10% back from the
+     * limit, so that a value hovering around the limit does not cause a
+     * stream of notifications.
+     */
+    if (threshold->op == SNMP_THRESHOLD_OP_GT ||
+        threshold->op == SNMP_THRESHOLD_OP_GE) {
+      threshold->clear = threshold->limit - (threshold->limit / 10);
+
+    } else {
+      threshold->clear = threshold->limit + (threshold->limit / 10);
+      if (threshold->clear < threshold->limit) {
+        threshold->clear = 0x7fffffff;
+      }
+    }
+  }
+
+  threshold->text = pstrcat(p, expr, " ", op, " ", limit, NULL);
+  return threshold;
+}
+
+/* Sorts fields by table, then by field. */
+static int field_cmp(const void *a, const void *b) {
+  unsigned int field_a, field_b;
+  int db_id_a, db_id_b;
+
+  field_a = *((const unsigned int *) a);
+  field_b = *((const unsigned int *) b);
+
+  db_id_a = snmp_db_get_field_db_id(field_a);
+  db_id_b = snmp_db_get_field_db_id(field_b);
+
+  if (db_id_a != db_id_b) {
+    return db_id_a < db_id_b ? -1 : 1;
+  }
+
+  if (field_a != field_b) {
+    return field_a < field_b ? -1 : 1;
+  }
+
+  return 0;
+}
+
+int snmp_threshold_set(array_header *thresholds) {
+  register unsigned int i;
+  struct snmp_threshold **elts;
+
+  if (threshold_pool != NULL) {
+    destroy_pool(threshold_pool);
+    threshold_pool = NULL;
+  }
+
+  threshold_rules = NULL;
+  threshold_nrules = 0;
+  threshold_fields = NULL;
+  threshold_values = NULL;
+  threshold_nfields = 0;
+
+  if (thresholds == NULL ||
+      thresholds->nelts == 0) {
+    return 0;
+  }
+
+  threshold_pool = make_sub_pool(permanent_pool);
+  pr_pool_tag(threshold_pool, "SNMP Threshold Pool");
+
+  threshold_rules = pcalloc(threshold_pool,
+    thresholds->nelts * sizeof(struct snmp_threshold_rule));
+  threshold_fields = pcalloc(threshold_pool,
+    thresholds->nelts * sizeof(unsigned int));
+
+  elts = thresholds->elts;
+  for (i = 0; i < thresholds->nelts; i++) {
+    struct snmp_mib *mib;
+
+    /* Skip thresholds on MIBs which are not available, e.g. those of
+     * modules which are not loaded.
+     */
+    mib = snmp_mib_get_by_idx(elts[i]->mib_idx);
+    if (mib == NULL ||
+        mib->mib_enabled == FALSE) {
+      (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+        "ignoring threshold '%s': MIB not available", elts[i]->text);
+      continue;
+    }
+
+    threshold_rules[threshold_nrules++].threshold = elts[i];
+    threshold_fields[threshold_nfields++] = elts[i]->db_field;
+  }
+
+  if (threshold_nrules == 0) {
+    return 0;
+  }
+
+  /* Read each field once, and each table under one lock, per evaluation. */
+  qsort(threshold_fields, threshold_nfields, sizeof(unsigned int), field_cmp);
+
+  if (threshold_nfields > 1) {
+    unsigned int nfields = 1;
+
+    for (i = 1; i < threshold_nfields; i++) {
+      if (threshold_fields[i] != threshold_fields[nfields-1]) {
+        threshold_fields[nfields++] = threshold_fields[i];
+      }
+    }
+
+    threshold_nfields = nfields;
+  }
+
+  threshold_values = pcalloc(threshold_pool,
+    threshold_nfields * sizeof(int32_t));
+
+  for (i = 0; i < threshold_nrules; i++) {
+    unsigned int *field;
+
+    field = bsearch(&(threshold_rules[i].threshold->db_field),
+      threshold_fields, threshold_nfields, sizeof(unsigned int), field_cmp);
+    threshold_rules[i].value_idx = field - threshold_fields;
+  }
+
+  pr_trace_msg(trace_channel, 9, "compiled %u %s, using %u %s",
+    threshold_nrules, threshold_nrules != 1 ? "thresholds" : "threshold",
+    threshold_nfields, threshold_nfields != 1 ? "fields" : "field");
+  return 0;
+}
+
+/* Returns TRUE if the value is past the given limit. */
+static int is_past(int op, int32_t value, int32_t limit) {
+  switch (op) {
+    case SNMP_THRESHOLD_OP_GT:
+      return value > limit;
+
+    case SNMP_THRESHOLD_OP_GE:
+      return value >= limit;
+
+    case SNMP_THRESHOLD_OP_LT:
+      return value < limit;
+
+    case SNMP_THRESHOLD_OP_LE:
+      return value <= limit;
+  }
+
+  return FALSE;
+}
+
+/* Computes the rate of a counter, per the threshold's period, since the
+ * previous evaluation.  Returns -1 if there is no rate yet.
+ */
+static int get_rate(struct snmp_threshold_rule *rule, int32_t value,
+    struct timeval *now, int32_t *rate) {
+  uint32_t curr_value, prev_value;
+  long elapsed_ms;
+  uint64_t per_period;
+
+  if (rule->have_prev == FALSE) {
+    rule->have_prev = TRUE;
+    rule->prev_value = value;
+    rule->prev_tv = *now;
+    return -1;
+  }
+
+  elapsed_ms = ((now->tv_sec - rule->prev_tv.tv_sec) * 1000) +
+    ((now->tv_usec - rule->prev_tv.tv_usec) / 1000);
+  if (elapsed_ms <= 0) {
+    return -1;
+  }
+
+  curr_value = (uint32_t) value;
+  prev_value = (uint32_t) rule->prev_value;
+
+  rule->prev_value = value;
+  rule->prev_tv = *now;
+
+  if (curr_value < prev_value) {
+    /* The counters were reset. */
+    return -1;
+  }
+
+  per_period = ((uint64_t) (curr_value - prev_value) *
+    rule->threshold->rate_secs * 1000) / elapsed_ms;
+  if (per_period > 0x7fffffffUL) {
+    per_period = 0x7fffffffUL;
+  }
+
+  *rate = (int32_t) per_period;
+  return 0;
+}
+
+static int queue_threshold_notify(pool *p, struct snmp_threshold_rule *rule,
+    unsigned int notify_id, int32_t value, struct timeval *now) {
+  struct snmp_notify_record record;
+
+  memset(&record, 0, sizeof(record));
+  record.notify_id = notify_id;
+  record.server_id = main_server->sid;
+  record.notify_tv = *now;
+  record.pid = record.server_port = record.maxinst_conf = -1;
+
+  sstrncpy(record.threshold_text, rule->threshold->text,
+    sizeof(record.threshold_text));
+  record.threshold_mib_idx = rule->threshold->mib_idx;
+  record.threshold_value = value;
+  if (notify_id == SNMP_NOTIFY_DAEMON_THRESHOLD_EXCEEDED) {
+    record.threshold_limit = rule->threshold->limit;
+
+  } else {
+    record.threshold_limit = rule->threshold->clear;
+  }
+
+  pr_trace_msg(trace_channel, 9, "threshold '%s' %s (value %ld)",
+    rule->threshold->text,
+    notify_id == SNMP_NOTIFY_DAEMON_THRESHOLD_EXCEEDED ? "exceeded" : "cleared",
+    (long) value);
+
+  return snmp_notify_queue_add(p, &record);
+}
+
+int snmp_threshold_poll(pool *p) {
+  register unsigned int i;
+  struct timeval now;
+  int count = 0;
+
+  if (threshold_nrules == 0) {
+    return 0;
+  }
+
+  if (snmp_db_get_values(p, threshold_fields, threshold_nfields,
+      threshold_values) < 0) {
+    pr_trace_msg(trace_channel, 3,
+      "unable to read threshold values: %s", strerror(errno));
+    return -1;
+  }
+
+  gettimeofday(&now, NULL);
+
+  for (i = 0; i < threshold_nrules; i++) {
+    struct snmp_threshold_rule *rule;
+    const struct snmp_threshold *threshold;
+    int32_t value;
+
+    rule = &(threshold_rules[i]);
+    threshold = rule->threshold;
+    value = threshold_values[rule->value_idx];
+
+    if (threshold->rate_secs > 0 &&
+        get_rate(rule, value, &now, &value) < 0) {
+      continue;
+    }
+
+    /* The rule's state only changes once its notification has been queued;
+     * if the queue is full, the notification is tried again on the next
+     * poll, rather than being lost for as long as the condition persists.
+     */
+    if (rule->exceeded == FALSE) {
+      if (is_past(threshold->op, value, threshold->limit)) {
+        if (queue_threshold_notify(p, rule,
+            SNMP_NOTIFY_DAEMON_THRESHOLD_EXCEEDED, value, &now) == 0) {
+          rule->exceeded = TRUE;
+          count++;
+        }
+      }
+
+    } else {
+      if (!is_past(threshold->op, value, threshold->clear)) {
+        if (queue_threshold_notify(p, rule,
+            SNMP_NOTIFY_DAEMON_THRESHOLD_CLEARED, value, &now) == 0) {
+          rule->exceeded = FALSE;
+          count++;
+        }
+      }
+    }
+  }
+
+  return count;
+}
@@ -0,0 +1,81 @@
+/*
+ * ProFTPD - mod_snmp notification thresholds
+ * Copyright (c) 2013 TJ Saunders
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, TJ Saunders and other respective copyright holders
+ * give permission to link this program with OpenSSL, and distribute the
+ * resulting executable, without including the source code for OpenSSL in the
+ * source distribution.
+ *
+ * $Id$
+ */
+
+#include "mod_snmp.h"
+
+#ifndef MOD_SNMP_THRESHOLD_H
+#define MOD_SNMP_THRESHOLD_H
+
+#define SNMP_THRESHOLD_OP_GT		1
+#define SNMP_THRESHOLD_OP_GE		2
+#define SNMP_THRESHOLD_OP_LT		3
+#define SNMP_THRESHOLD_OP_LE		4
+
+/* A threshold, as configured via SNMPNotifyThreshold, e.g.:
+ *
+ *  ftp.sessions.sessionCount > 500
+ *  rate(ftp.logins.loginFailedTotal) > 20/s
+ *
+ * A thresholdExceeded notification is sent when the value (or rate) crosses
+ * the limit, and a thresholdCleared notification when it crosses back past
+ * the clear value; nothing is sent while it stays on one side.
+ */
+struct snmp_threshold {
+  const char *text;
+
+  int mib_idx;
+  unsigned int db_field;
+
+  int op;
+  int32_t limit;
+  int32_t clear;
+
+  /* For rate() thresholds, the period of the rate in seconds (e.g. 1 for
+   * "/s"); zero otherwise.
+   */
+  unsigned int rate_secs;
+};
+
+/* Parses a threshold from its configured expression, operator, limit, and
+ * optional clear value.  Returns NULL, with errno set to EINVAL and errstr
+ * describing the problem, if the threshold is invalid.
+ */
+struct snmp_threshold *snmp_threshold_parse(pool *p, const char *expr,
+  const char *op, const char *limit, const char *clear, const char **errstr);
+
+/* Compiles the given thresholds (an array of struct snmp_threshold
+ * pointers) into the table evaluated by snmp_threshold_poll().  A NULL
+ * array removes all thresholds.
+ */
+int snmp_threshold_set(array_header *thresholds);
+
+/* Evaluates the thresholds against a single snapshot of their values, and
+ * queues notifications for those crossed since the last evaluation.
+ * Returns the number of notifications queued.
+ */
+int snmp_threshold_poll(pool *p);
+
+#endif
@@ -0,0 +1,394 @@
+/*
+ * ProFTPD - mod_snmp transfer throughput statistics
+ * Copyright (c) 2013 TJ Saunders
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, TJ Saunders and other respective copyright holders
+ * give permission to link this program with OpenSSL, and distribute the
+ * resulting executable, without including the source code for OpenSSL in the
+ * source distribution.
+ *
+ * $Id$
+ */
+
+#include "mod_snmp.h"
+#include "notify.h"
+#include "ring.h"
+#include "throughput.h"
+
+/* Transfers of fewer bytes than this are not sampled; their throughput is
+ * mostly a measure of latency, rather than of the disks or network.
+ */
+#define SNMP_THROUGHPUT_MIN_BYTES		(256 * 1024)
+
+/* Maximum number of transfers queued for the SNMP agent between its polls;
+ * any more are dropped, which only thins the samples.
+ */
+#define SNMP_THROUGHPUT_QUEUE_MAX_RECORDS	1024
+
+/* The number of recent throughputs, per protocol, whose median is compared
+ * with the baseline.
+ */
+#define SNMP_THROUGHPUT_WINDOW_SIZE		32
+
+/* The number of earlier medians, each of a full window of throughputs,
+ * whose median is the baseline; and how many of them there must be before
+ * there is a baseline.
+ */
+#define SNMP_THROUGHPUT_HISTORY_SIZE		16
+#define SNMP_THROUGHPUT_MIN_HISTORY		4
+
+/* A completed transfer, as queued for the SNMP agent. */
+struct snmp_throughput_sample {
+  uint32_t proto_idx;
+  uint32_t duration_ms;
+  uint64_t nbytes;
+};
+
+/* The statistics for a protocol.  Each throughput (in bytes/sec) is added to
+ * a circular window of the most recent ones; each time the window has been
+ * filled with new throughputs, its median is added to a circular history,
+ * whose median is the baseline.  A sustained change in throughput thus
+ * becomes, in time, the new baseline; but not while throughput is degraded.
+ */
+struct snmp_throughput_stats {
+  const char *proto;
+
+  uint32_t window[SNMP_THROUGHPUT_WINDOW_SIZE];
+  unsigned int window_pos;
+  unsigned int window_count;
+
+  /* The throughputs added since the last evaluation, and since the last
+   * median was added to the history.
+   */
+  unsigned int nadded;
+  unsigned int epoch_count;
+
+  uint32_t history[SNMP_THROUGHPUT_HISTORY_SIZE];
+  unsigned int history_pos;
+  unsigned int history_count;
+  uint32_t baseline;
+
+  int degraded;
+};
+
+static struct snmp_throughput_stats throughput_stats[] = {
+  { "ftp" },
+  { "ftps" },
+  { "sftp" },
+  { "scp" },
+  { NULL }
+};
+
+static struct snmp_ring *throughput_queue = NULL;
+static unsigned int throughput_permille = 0;
+
+static const char *trace_channel = "snmp.throughput";
+
+int snmp_throughput_set(unsigned int permille) {
+  register unsigned int i;
+
+  if (permille >= 1000) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  throughput_permille = permille;
+
+  for (i = 0; throughput_stats[i].proto != NULL; i++) {
+    const char *proto;
+
+    proto = throughput_stats[i].proto;
+    memset(&(throughput_stats[i]), 0, sizeof(struct snmp_throughput_stats));
+    throughput_stats[i].proto = proto;
+  }
+
+  return 0;
+}
+
+int snmp_throughput_open(pool *p) {
+  if (throughput_queue != NULL) {
+    return 0;
+  }
+
+  throughput_queue = snmp_ring_create(p, SNMP_THROUGHPUT_QUEUE_MAX_RECORDS,
+    sizeof(struct snmp_throughput_sample));
+  if (throughput_queue == NULL) {
+    return -1;
+  }
+
+  return 0;
+}
+
+int snmp_throughput_close(void) {
+  int res;
+
+  if (throughput_queue == NULL) {
+    return 0;
+  }
+
+  res = snmp_ring_destroy(throughput_queue);
+  throughput_queue = NULL;
+  return res;
+}
+
+int snmp_throughput_add(const char *proto, off_t nbytes,
+    struct timeval *start_tv) {
+  register unsigned int i;
+  struct snmp_throughput_sample sample;
+  struct timeval now;
+  long duration_ms;
+
+  if (proto == NULL ||
+      start_tv == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (throughput_queue == NULL ||
+      throughput_permille == 0 ||
+      nbytes < SNMP_THROUGHPUT_MIN_BYTES ||
+      start_tv->tv_sec == 0) {
+    return 0;
+  }
+
+  for (i = 0; throughput_stats[i].proto != NULL; i++) {
+    if (strcmp(throughput_stats[i].proto, proto) == 0) {
+      break;
+    }
+  }
+
+  if (throughput_stats[i].proto == NULL) {
+    return 0;
+  }
+
+  gettimeofday(&now, NULL);
+  duration_ms = ((now.tv_sec - start_tv->tv_sec) * 1000) +
+    ((now.tv_usec - start_tv->tv_usec) / 1000);
+  if (duration_ms < 1) {
+    duration_ms = 1;
+  }
+
+  sample.proto_idx = i;
+  sample.duration_ms = (uint32_t) duration_ms;
+  sample.nbytes = (uint64_t) nbytes;
+
+  return snmp_ring_add(throughput_queue, &sample, sizeof(sample));
+}
+
+/* Returns the median of the values, by selection (Hoare's FIND) on a copy
+ * of them.
+ */
+static uint32_t get_median(const uint32_t *values, unsigned int nvalues) {
+  uint32_t buf[SNMP_THROUGHPUT_WINDOW_SIZE > SNMP_THROUGHPUT_HISTORY_SIZE ?
+    SNMP_THROUGHPUT_WINDOW_SIZE : SNMP_THROUGHPUT_HISTORY_SIZE];
+  int lo, hi, k;
+
+  memcpy(buf, values, nvalues * sizeof(uint32_t));
+
+  k = nvalues / 2;
+  lo = 0;
+  hi = nvalues - 1;
+
+  while (lo < hi) {
+    uint32_t pivot;
+    int i, j;
+
+    pivot = buf[k];
+    i = lo;
+    j = hi;
+
+    while (i <= j) {
+      while (buf[i] < pivot) {
+        i++;
+      }
+
+      while (pivot < buf[j]) {
+        j--;
+      }
+
+      if (i <= j) {
+        uint32_t tmp;
+
+        tmp = buf[i];
+        buf[i] = buf[j];
+        buf[j] = tmp;
+        i++;
+        j--;
+      }
+    }
+
+    if (j < k) {
+      lo = i;
+    }
+
+    if (k < i) {
+      hi = j;
+    }
+  }
+
+  return buf[k];
+}
+
+static void add_throughput(struct snmp_throughput_stats *stats,
+    struct snmp_throughput_sample *sample) {
+  uint64_t bytes_per_sec;
+
+  bytes_per_sec = (sample->nbytes * 1000) / sample->duration_ms;
+  if (bytes_per_sec > 0x7fffffffUL) {
+    bytes_per_sec = 0x7fffffffUL;
+  }
+
+  stats->window[stats->window_pos] = (uint32_t) bytes_per_sec;
+  stats->window_pos = (stats->window_pos + 1) % SNMP_THROUGHPUT_WINDOW_SIZE;
+  if (stats->window_count < SNMP_THROUGHPUT_WINDOW_SIZE) {
+    stats->window_count++;
+  }
+
+  stats->nadded++;
+}
+
+static void add_history(struct snmp_throughput_stats *stats, uint32_t median) {
+  stats->history[stats->history_pos] = median;
+  stats->history_pos = (stats->history_pos + 1) % SNMP_THROUGHPUT_HISTORY_SIZE;
+  if (stats->history_count < SNMP_THROUGHPUT_HISTORY_SIZE) {
+    stats->history_count++;
+  }
+
+  stats->baseline = get_median(stats->history, stats->history_count);
+}
+
+static int queue_throughput_notify(pool *p,
+    struct snmp_throughput_stats *stats, unsigned int notify_id,
+    uint32_t median, struct timeval *now) {
+  struct snmp_notify_record record;
+
+  memset(&record, 0, sizeof(record));
+  record.notify_id = notify_id;
+  record.server_id = main_server->sid;
+  record.notify_tv = *now;
+  record.pid = record.server_port = record.maxinst_conf = -1;
+
+  sstrncpy(record.protocol, stats->proto, sizeof(record.protocol));
+  record.throughput_median = (int32_t) median;
+  record.throughput_baseline = (int32_t) stats->baseline;
+
+  pr_trace_msg(trace_channel, 9, "%s throughput %s (median %lu, baseline %lu)",
+    stats->proto,
+    notify_id == SNMP_NOTIFY_DAEMON_THROUGHPUT_DEGRADED ? "degraded" :
+      "recovered", (unsigned long) median, (unsigned long) stats->baseline);
+
+  return snmp_notify_queue_add(p, &record);
+}
+
+int snmp_throughput_poll(pool *p) {
+  register unsigned int i;
+  struct snmp_throughput_sample sample;
+  struct timeval now;
+  int count = 0;
+
+  if (throughput_queue == NULL ||
+      throughput_permille == 0) {
+    return 0;
+  }
+
+  /* The queue is drained here, on the agent's timer, rather than whenever
+   * its fd is readable; the fd is never cleared, so producers do not bother
+   * writing to it.
+   */
+  while (snmp_ring_next(throughput_queue, &sample, sizeof(sample)) ==
+      (int) sizeof(sample)) {
+    pr_signals_handle();
+
+    if (sample.proto_idx >= (sizeof(throughput_stats) /
+        sizeof(struct snmp_throughput_stats)) - 1 ||
+        sample.duration_ms == 0) {
+      continue;
+    }
+
+    add_throughput(&(throughput_stats[sample.proto_idx]), &sample);
+  }
+
+  gettimeofday(&now, NULL);
+
+  for (i = 0; throughput_stats[i].proto != NULL; i++) {
+    struct snmp_throughput_stats *stats;
+    uint32_t median;
+
+    /* A full window is evaluated on every poll, even without new
+     * throughputs, so that a notification which could not be queued is
+     * tried again.
+     */
+    stats = &(throughput_stats[i]);
+    if (stats->window_count < SNMP_THROUGHPUT_WINDOW_SIZE) {
+      continue;
+    }
+
+    stats->epoch_count += stats->nadded;
+    stats->nadded = 0;
+
+    median = get_median(stats->window, SNMP_THROUGHPUT_WINDOW_SIZE);
+
+    if (stats->history_count >= SNMP_THROUGHPUT_MIN_HISTORY) {
+      uint32_t limit, clear;
+
+      limit = (uint32_t) (((uint64_t) stats->baseline * throughput_permille) /
+        1000);
+
+      /* As for thresholds, throughput recovers once it is 10% back from the
+       * limit (but no further than the baseline), so that throughput
+       * hovering around the limit does not cause a stream of notifications.
+       */
+      clear = limit + (limit / 10);
+      if (clear > stats->baseline) {
+        clear = stats->baseline;
+      }
+
+      if (stats->degraded == FALSE) {
+        if (median < limit) {
+          if (queue_throughput_notify(p, stats,
+              SNMP_NOTIFY_DAEMON_THROUGHPUT_DEGRADED, median, &now) == 0) {
+            stats->degraded = TRUE;
+            count++;
+          }
+        }
+
+      } else {
+        if (median >= clear) {
+          if (queue_throughput_notify(p, stats,
+              SNMP_NOTIFY_DAEMON_THROUGHPUT_RECOVERED, median, &now) == 0) {
+            stats->degraded = FALSE;
+            count++;
+          }
+        }
+      }
+    }
+
+    /* The baseline is frozen while throughput is degraded; otherwise the
+     * degraded medians would, in time, become the baseline, and throughput
+     * would "recover" without getting any better.
+     */
+    if (stats->epoch_count >= SNMP_THROUGHPUT_WINDOW_SIZE) {
+      if (stats->degraded == FALSE) {
+        add_history(stats, median);
+      }
+
+      stats->epoch_count = 0;
+    }
+  }
+
+  return count;
+}
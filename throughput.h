@@ -0,0 +1,66 @@
+/*
+ * ProFTPD - mod_snmp transfer throughput statistics
+ * Copyright (c) 2013 TJ Saunders
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, TJ Saunders and other respective copyright holders
+ * give permission to link this program with OpenSSL, and distribute the
+ * resulting executable, without including the source code for OpenSSL in the
+ * source distribution.
+ *
+ * $Id$
+ */
+
+#include "mod_snmp.h"
+
+#ifndef MOD_SNMP_THROUGHPUT_H
+#define MOD_SNMP_THROUGHPUT_H
+
+/* Session processes report the size and duration of each completed
+ * transfer to the SNMP agent, which keeps the recent throughputs of each
+ * protocol.  When the median of the recent throughputs drops below the
+ * configured fraction of its baseline (the median of earlier such medians),
+ * a throughputDegraded notification is sent, and a throughputRecovered
+ * notification once it is back.
+ */
+
+/* Sets the fraction of the baseline, in thousandths, below which throughput
+ * is degraded; zero disables throughput statistics.
+ */
+int snmp_throughput_set(unsigned int permille);
+
+/* The sample queue carries the transfers from the session processes to the
+ * SNMP agent.  It is opened in the daemon process, before the agent and
+ * session processes are forked.
+ */
+int snmp_throughput_open(pool *p);
+int snmp_throughput_close(void);
+
+/* Reports a completed transfer, of nbytes bytes, which started at start_tv,
+ * using the given protocol.  Small transfers, and transfers using other
+ * protocols, are ignored.
+ */
+int snmp_throughput_add(const char *proto, off_t nbytes,
+  struct timeval *start_tv);
+
+/* Used by the SNMP agent: takes the reported transfers, and queues
+ * notifications for any protocols whose throughput has become degraded, or
+ * recovered, since the last evaluation.  Returns the number of
+ * notifications queued.
+ */
+int snmp_throughput_poll(pool *p);
+
+#endif
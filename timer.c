@@ -0,0 +1,274 @@
+/*
+ * ProFTPD - mod_snmp agent timers
+ * Copyright (c) 2013 TJ Saunders
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, TJ Saunders and other respective copyright holders
+ * give permission to link this program with OpenSSL, and distribute the
+ * resulting executable, without including the source code for OpenSSL in the
+ * source distribution.
+ *
+ * $Id$
+ */
+
+#include "mod_snmp.h"
+#include "timer.h"
+
+#if defined(HAVE_SYS_TIMERFD_H) && defined(HAVE_TIMERFD_CREATE)
+# include <sys/timerfd.h>
+# define SNMP_USE_TIMERFD
+#endif
+
+struct snmp_timer {
+  int timer_id;
+  const char *name;
+
+  unsigned long interval_ms;
+  unsigned long long next_ms;
+
+  void (*cb)(void *);
+  void *user_data;
+};
+
+static struct snmp_timer timers[SNMP_TIMER_MAX_TIMERS];
+static unsigned int timer_count = 0;
+static int timer_next_id = 1;
+static int timer_fd = -1;
+
+static const char *trace_channel = "snmp.timer";
+
+/* The timers use the monotonic clock, where available, so that changes to
+ * the system time do not cause timers to fire early, or very late.
+ */
+static unsigned long long timer_get_now_ms(void) {
+  struct timeval tv;
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+    return ((unsigned long long) ts.tv_sec * 1000ULL) +
+      (ts.tv_nsec / 1000000);
+  }
+#endif /* HAVE_CLOCK_GETTIME and CLOCK_MONOTONIC */
+
+  gettimeofday(&tv, NULL);
+  return ((unsigned long long) tv.tv_sec * 1000ULL) + (tv.tv_usec / 1000);
+}
+
+/* Returns the number of millisecs until the next timer is due, or -1 if
+ * there are no timers.
+ */
+static long long timer_get_next_ms(void) {
+  register unsigned int i;
+  unsigned long long now_ms, next_ms = 0;
+
+  if (timer_count == 0) {
+    return -1;
+  }
+
+  for (i = 0; i < timer_count; i++) {
+    if (i == 0 ||
+        timers[i].next_ms < next_ms) {
+      next_ms = timers[i].next_ms;
+    }
+  }
+
+  now_ms = timer_get_now_ms();
+  if (next_ms <= now_ms) {
+    return 0;
+  }
+
+  return (long long) (next_ms - now_ms);
+}
+
+static int timer_rearm(void) {
+#ifdef SNMP_USE_TIMERFD
+  struct itimerspec its;
+  long long next_ms;
+
+  if (timer_fd < 0) {
+    return 0;
+  }
+
+  memset(&its, 0, sizeof(its));
+
+  next_ms = timer_get_next_ms();
+  if (next_ms >= 0) {
+    /* An all-zero it_value would disarm the timer, rather than have it
+     * fire immediately.
+     */
+    its.it_value.tv_sec = next_ms / 1000;
+    its.it_value.tv_nsec = (next_ms % 1000) * 1000000;
+    if (next_ms == 0) {
+      its.it_value.tv_nsec = 1;
+    }
+  }
+
+  if (timerfd_settime(timer_fd, 0, &its, NULL) < 0) {
+    int xerrno = errno;
+
+    (void) pr_log_writefile(snmp_logfd, MOD_SNMP_VERSION,
+      "error arming timer fd %d: %s", timer_fd, strerror(xerrno));
+
+    errno = xerrno;
+    return -1;
+  }
+#endif /* SNMP_USE_TIMERFD */
+
+  return 0;
+}
+
+int snmp_timer_init(void) {
+  memset(timers, 0, sizeof(timers));
+  timer_count = 0;
+
+  if (timer_fd >= 0) {
+    (void) close(timer_fd);
+    timer_fd = -1;
+  }
+
+#ifdef SNMP_USE_TIMERFD
+  timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
+  if (timer_fd < 0) {
+    pr_trace_msg(trace_channel, 3,
+      "unable to create timer fd, using select(2) timeouts: %s",
+      strerror(errno));
+  }
+#endif /* SNMP_USE_TIMERFD */
+
+  return 0;
+}
+
+int snmp_timer_add(unsigned long interval_ms, void (*cb)(void *),
+    void *user_data, const char *name) {
+  struct snmp_timer *timer;
+
+  if (interval_ms == 0 ||
+      cb == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (timer_count == SNMP_TIMER_MAX_TIMERS) {
+    errno = ENOSPC;
+    return -1;
+  }
+
+  timer = &(timers[timer_count++]);
+  timer->timer_id = timer_next_id++;
+  timer->name = name;
+  timer->interval_ms = interval_ms;
+  timer->next_ms = timer_get_now_ms() + interval_ms;
+  timer->cb = cb;
+  timer->user_data = user_data;
+
+  pr_trace_msg(trace_channel, 9, "added timer ID %d (%s), every %lu ms",
+    timer->timer_id, name ? name : "(unnamed)", interval_ms);
+
+  (void) timer_rearm();
+  return timer->timer_id;
+}
+
+int snmp_timer_remove(int timer_id) {
+  register unsigned int i;
+
+  for (i = 0; i < timer_count; i++) {
+    if (timers[i].timer_id == timer_id) {
+      pr_trace_msg(trace_channel, 9, "removed timer ID %d (%s)", timer_id,
+        timers[i].name ? timers[i].name : "(unnamed)");
+
+      /* Order does not matter; move the last timer into this slot. */
+      timer_count--;
+      if (i != timer_count) {
+        memcpy(&(timers[i]), &(timers[timer_count]),
+          sizeof(struct snmp_timer));
+      }
+
+      (void) timer_rearm();
+      return 0;
+    }
+  }
+
+  errno = ENOENT;
+  return -1;
+}
+
+int snmp_timer_get_fd(void) {
+  return timer_fd;
+}
+
+int snmp_timer_get_timeout(struct timeval *tv) {
+  long long next_ms;
+
+  if (tv == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  next_ms = timer_get_next_ms();
+  if (next_ms < 0) {
+    errno = ENOENT;
+    return -1;
+  }
+
+  tv->tv_sec = next_ms / 1000;
+  tv->tv_usec = (next_ms % 1000) * 1000;
+  return 0;
+}
+
+int snmp_timer_run(void) {
+  register unsigned int i;
+  unsigned long long now_ms;
+
+  if (timer_fd >= 0) {
+    uint64_t expirations;
+
+    /* Drain the expiration count; we check the deadlines ourselves. */
+    (void) read(timer_fd, &expirations, sizeof(expirations));
+  }
+
+  now_ms = timer_get_now_ms();
+
+  /* Note that a callback may add or remove timers, including its own.  We
+   * run the timers from the last one: a removed timer's slot is taken by the
+   * last timer, which has already been visited, and an added timer is not
+   * yet due.
+   */
+  for (i = timer_count; i > 0; i--) {
+    struct snmp_timer *timer;
+
+    if (i > timer_count) {
+      continue;
+    }
+
+    timer = &(timers[i-1]);
+    if (timer->next_ms > now_ms) {
+      continue;
+    }
+
+    timer->next_ms += timer->interval_ms;
+    if (timer->next_ms <= now_ms) {
+      /* We fell behind; skip the missed runs rather than bursting. */
+      timer->next_ms = now_ms + timer->interval_ms;
+    }
+
+    pr_trace_msg(trace_channel, 17, "running timer ID %d (%s)",
+      timer->timer_id, timer->name ? timer->name : "(unnamed)");
+    timer->cb(timer->user_data);
+  }
+
+  return timer_rearm();
+}
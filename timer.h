@@ -0,0 +1,62 @@
+/*
+ * ProFTPD - mod_snmp agent timers
+ * Copyright (c) 2013 TJ Saunders
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, TJ Saunders and other respective copyright holders
+ * give permission to link this program with OpenSSL, and distribute the
+ * resulting executable, without including the source code for OpenSSL in the
+ * source distribution.
+ *
+ * $Id$
+ */
+
+#include "mod_snmp.h"
+
+#ifndef MOD_SNMP_TIMER_H
+#define MOD_SNMP_TIMER_H
+
+/* Maximum number of periodic tasks which can be registered in the SNMP
+ * agent process.
+ */
+#define SNMP_TIMER_MAX_TIMERS			16
+
+int snmp_timer_init(void);
+
+/* Registers a callback to be invoked every interval_ms millisecs, from the
+ * SNMP agent event loop.  Returns the ID of the new timer, or -1 on error.
+ */
+int snmp_timer_add(unsigned long interval_ms, void (*cb)(void *),
+  void *user_data, const char *name);
+int snmp_timer_remove(int timer_id);
+
+/* Returns the file descriptor which becomes readable when a timer is due,
+ * or -1 if timerfd(2) is not available.  In the latter case, the caller
+ * should use snmp_timer_get_timeout() as its select(2) timeout.
+ */
+int snmp_timer_get_fd(void);
+
+/* Fills in the time until the next timer is due.  Returns -1, with errno
+ * set to ENOENT, if there are no timers.
+ */
+int snmp_timer_get_timeout(struct timeval *tv);
+
+/* Invokes the callbacks of all timers which are due, and rearms the
+ * timer file descriptor for the next one.
+ */
+int snmp_timer_run(void);
+
+#endif